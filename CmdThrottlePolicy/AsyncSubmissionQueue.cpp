@@ -0,0 +1,243 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "AsyncSubmissionQueue.h"
+
+#include <cstring>
+#include <memory>
+
+#include "DXSampleHelper.h"
+#include "Tracer.h"
+
+namespace {
+
+ComPtr<ID3D12Resource> CreateReadbackBuffer(ID3D12Device* device, uint64_t size, void** data) {
+    D3D12_HEAP_PROPERTIES heapProperties = {};
+    heapProperties.Type = D3D12_HEAP_TYPE_READBACK;
+
+    D3D12_RESOURCE_DESC bufferDescriptor = {};
+    bufferDescriptor.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferDescriptor.Width = size;
+    bufferDescriptor.Height = 1;
+    bufferDescriptor.DepthOrArraySize = 1;
+    bufferDescriptor.MipLevels = 1;
+    bufferDescriptor.Format = DXGI_FORMAT_UNKNOWN;
+    bufferDescriptor.SampleDesc.Count = 1;
+    bufferDescriptor.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    bufferDescriptor.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+    ComPtr<ID3D12Resource> buffer;
+    ThrowIfFailed(device->CreateCommittedResource(
+        &heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDescriptor, D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr, IID_PPV_ARGS(&buffer)));
+    ThrowIfFailed(buffer->Map(0, nullptr, data));
+    return buffer;
+}
+
+void RecordTransition(
+    ID3D12GraphicsCommandList* commandList,
+    ID3D12Resource* resource,
+    D3D12_RESOURCE_STATES before,
+    D3D12_RESOURCE_STATES after) {
+    D3D12_RESOURCE_BARRIER barrierDesc = {};
+    barrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    barrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    barrierDesc.Transition.pResource = resource;
+    barrierDesc.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+    barrierDesc.Transition.StateBefore = before;
+    barrierDesc.Transition.StateAfter = after;
+    commandList->ResourceBarrier(1, &barrierDesc);
+}
+
+}  // anonymous namespace
+
+AsyncSubmissionQueue::AsyncSubmissionQueue(
+    ID3D12Device* device,
+    ID3D12CommandQueue* queue,
+    FenceCompletionThread* completionThread,
+    uint32_t slotCount)
+    : mDevice(device),
+      mQueue(queue),
+      mCompletionThread(completionThread),
+      mSlots(slotCount > 0 ? slotCount : 1) {
+    const uint32_t count = static_cast<uint32_t>(mSlots.size());
+    ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
+    ThrowIfFailed(queue->GetTimestampFrequency(&mTimestampFrequency));
+
+    D3D12_QUERY_HEAP_DESC queryHeapDescriptor = {};
+    queryHeapDescriptor.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    queryHeapDescriptor.Count = 2 * count;
+    ThrowIfFailed(device->CreateQueryHeap(&queryHeapDescriptor, IID_PPV_ARGS(&mQueryHeap)));
+    void* timestamps = nullptr;
+    mTimestampBuffer = CreateReadbackBuffer(device, 2 * count * sizeof(uint64_t), &timestamps);
+    mTimestamps = static_cast<const uint64_t*>(timestamps);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        Slot& slot = mSlots[i];
+        ThrowIfFailed(device->CreateCommandAllocator(
+            D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&slot.commandAllocator)));
+        ThrowIfFailed(device->CreateCommandList(
+            0, D3D12_COMMAND_LIST_TYPE_DIRECT, slot.commandAllocator.Get(), nullptr,
+            IID_PPV_ARGS(&slot.commandList)));
+        ThrowIfFailed(slot.commandList->Close());
+        mFreeSlots.push_back(count - 1 - i);
+    }
+}
+
+AsyncSubmissionQueue::~AsyncSubmissionQueue() {
+    // The slots must not be released while the GPU or a callback still uses them.
+    WaitForIdle();
+
+    D3D12_RANGE writtenRange = { 0, 0 };
+    mTimestampBuffer->Unmap(0, &writtenRange);
+    for (Slot& slot : mSlots) {
+        if (slot.readbackBuffer != nullptr) {
+            slot.readbackBuffer->Unmap(0, &writtenRange);
+        }
+    }
+}
+
+uint32_t AsyncSubmissionQueue::AcquireSlot() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (mFreeSlots.empty()) {
+        TRACE_SCOPE("AsyncSubmissionQueue::AcquireSlot wait");
+        mSlotReleased.wait(lock, [this]() { return !mFreeSlots.empty(); });
+    }
+    const uint32_t slot = mFreeSlots.back();
+    mFreeSlots.pop_back();
+    return slot;
+}
+
+uint64_t AsyncSubmissionQueue::Submit(
+    const RecordFunction& record,
+    ID3D12Resource* readbackSource,
+    uint64_t readbackSize,
+    Callback callback) {
+    TRACE_SCOPE("AsyncSubmissionQueue::Submit");
+    const uint32_t slotIndex = AcquireSlot();
+    Slot& slot = mSlots[slotIndex];
+
+    // The slot is free, so the GPU is done with its readback buffer.
+    if (readbackSize > slot.readbackBufferSize) {
+        if (slot.readbackBuffer != nullptr) {
+            D3D12_RANGE writtenRange = { 0, 0 };
+            slot.readbackBuffer->Unmap(0, &writtenRange);
+        }
+        void* data = nullptr;
+        slot.readbackBuffer = CreateReadbackBuffer(mDevice.Get(), readbackSize, &data);
+        slot.readbackBufferSize = readbackSize;
+        slot.readbackData = static_cast<const uint8_t*>(data);
+    }
+
+    ThrowIfFailed(slot.commandAllocator->Reset());
+    ThrowIfFailed(slot.commandList->Reset(slot.commandAllocator.Get(), nullptr));
+    ID3D12GraphicsCommandList* commandList = slot.commandList.Get();
+    commandList->EndQuery(mQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * slotIndex);
+    record(commandList);
+    commandList->EndQuery(mQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * slotIndex + 1);
+    commandList->ResolveQueryData(
+        mQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * slotIndex, 2, mTimestampBuffer.Get(),
+        2 * slotIndex * sizeof(uint64_t));
+    if (readbackSize > 0) {
+        RecordTransition(
+            commandList, readbackSource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+            D3D12_RESOURCE_STATE_COPY_SOURCE);
+        commandList->CopyBufferRegion(
+            slot.readbackBuffer.Get(), 0, readbackSource, 0, readbackSize);
+        RecordTransition(
+            commandList, readbackSource, D3D12_RESOURCE_STATE_COPY_SOURCE,
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    }
+    ThrowIfFailed(commandList->Close());
+
+    // The fence values must be signaled in increasing order.
+    uint64_t fenceValue;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        ID3D12CommandList* ppCommandLists[] = { commandList };
+        mQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+        fenceValue = mNextFenceValue++;
+        ThrowIfFailed(mQueue->Signal(mFence.Get(), fenceValue));
+    }
+
+    mCompletionThread->NotifyOnCompletion(
+        mFence.Get(), fenceValue,
+        [this, slotIndex, fenceValue, readbackSize, callback = std::move(callback)]() {
+            CompleteSubmit(slotIndex, fenceValue, readbackSize, callback);
+        });
+    return fenceValue;
+}
+
+std::future<SubmitCompletion> AsyncSubmissionQueue::Submit(
+    const RecordFunction& record,
+    ID3D12Resource* readbackSource,
+    uint64_t readbackSize) {
+    // std::function needs a copyable callback.
+    auto promise = std::make_shared<std::promise<SubmitCompletion>>();
+    std::future<SubmitCompletion> future = promise->get_future();
+    Submit(record, readbackSource, readbackSize, [promise](const SubmitCompletion& completion) {
+        promise->set_value(completion);
+    });
+    return future;
+}
+
+void AsyncSubmissionQueue::CompleteSubmit(
+    uint32_t slotIndex,
+    uint64_t fenceValue,
+    uint64_t readbackSize,
+    const Callback& callback) {
+    const Slot& slot = mSlots[slotIndex];
+    SubmitCompletion completion;
+    completion.fenceValue = fenceValue;
+    const uint64_t beginTimestamp = mTimestamps[2 * slotIndex];
+    const uint64_t endTimestamp = mTimestamps[2 * slotIndex + 1];
+    completion.gpuTimeUS =
+        static_cast<double>(endTimestamp - beginTimestamp) * 1e6 / mTimestampFrequency;
+    if (readbackSize > 0) {
+        completion.readbackData.assign(slot.readbackData, slot.readbackData + readbackSize);
+    }
+
+    callback(completion);
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFreeSlots.push_back(slotIndex);
+    }
+    mSlotReleased.notify_all();
+}
+
+void AsyncSubmissionQueue::WaitForIdle() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mSlotReleased.wait(lock, [this]() { return mFreeSlots.size() == mSlots.size(); });
+}
+
+uint32_t AsyncSubmissionQueue::GetSlotCount() const {
+    return static_cast<uint32_t>(mSlots.size());
+}
+
+ID3D12Fence* AsyncSubmissionQueue::GetFence() const {
+    return mFence.Get();
+}
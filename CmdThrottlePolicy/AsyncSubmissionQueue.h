@@ -0,0 +1,131 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef ASYNC_SUBMISSION_QUEUE_
+#define ASYNC_SUBMISSION_QUEUE_
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <vector>
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include "FenceCompletionThread.h"
+
+using Microsoft::WRL::ComPtr;
+
+// What the GPU measured and read back for a submit, handed over once it has completed.
+struct SubmitCompletion {
+    // The fence value signaled after the submit on the fence of its AsyncSubmissionQueue.
+    uint64_t fenceValue = 0;
+    double gpuTimeUS = 0.0;
+    // The bytes of the readback source, empty if none was requested.
+    std::vector<uint8_t> readbackData;
+};
+
+// Submits command lists to a command queue without ever blocking on their completion, which is
+// delivered by a FenceCompletionThread instead.
+//
+// Each submit takes one of slotCount slots, which owns a command allocator, a command list, a pair
+// of timestamp queries and a readback buffer, so that up to slotCount submits can be in flight
+// and none of them shares anything with the others. A submit only blocks when all the slots are
+// in flight. Submit() can be called from several threads, but not from a callback while all the
+// slots are in flight: the slots are released on the completion thread, so that would deadlock.
+class AsyncSubmissionQueue {
+public:
+    using RecordFunction = std::function<void(ID3D12GraphicsCommandList*)>;
+    using Callback = std::function<void(const SubmitCompletion&)>;
+
+    AsyncSubmissionQueue(
+        ID3D12Device* device,
+        ID3D12CommandQueue* queue,
+        FenceCompletionThread* completionThread,
+        uint32_t slotCount);
+    // Waits for every submit and its callback.
+    ~AsyncSubmissionQueue();
+
+    // Record the work with record between two timestamps and execute it. If readbackSize is not
+    // 0, the first readbackSize bytes of readbackSource, which must be in the UNORDERED_ACCESS
+    // state, are then read back. callback is called on the completion thread once it's done.
+    // Returns the fence value of the submit.
+    uint64_t Submit(
+        const RecordFunction& record,
+        ID3D12Resource* readbackSource,
+        uint64_t readbackSize,
+        Callback callback);
+    // Same with a future instead of a callback.
+    std::future<SubmitCompletion> Submit(
+        const RecordFunction& record,
+        ID3D12Resource* readbackSource,
+        uint64_t readbackSize);
+
+    // Wait until every submit has completed and its callback has returned.
+    void WaitForIdle();
+
+    uint32_t GetSlotCount() const;
+    ID3D12Fence* GetFence() const;
+
+private:
+    struct Slot {
+        ComPtr<ID3D12CommandAllocator> commandAllocator;
+        ComPtr<ID3D12GraphicsCommandList> commandList;
+        // Grown on demand, persistently mapped.
+        ComPtr<ID3D12Resource> readbackBuffer;
+        uint64_t readbackBufferSize = 0;
+        const uint8_t* readbackData = nullptr;
+    };
+
+    uint32_t AcquireSlot();
+    // Called on the completion thread.
+    void CompleteSubmit(
+        uint32_t slot,
+        uint64_t fenceValue,
+        uint64_t readbackSize,
+        const Callback& callback);
+
+    ComPtr<ID3D12Device> mDevice;
+    ComPtr<ID3D12CommandQueue> mQueue;
+    FenceCompletionThread* mCompletionThread;
+    ComPtr<ID3D12Fence> mFence;
+    uint64_t mTimestampFrequency = 0;
+
+    ComPtr<ID3D12QueryHeap> mQueryHeap;
+    ComPtr<ID3D12Resource> mTimestampBuffer;
+    const uint64_t* mTimestamps = nullptr;
+
+    std::vector<Slot> mSlots;
+
+    // Guards mFreeSlots, and orders the ExecuteCommandLists() and Signal() of the submits.
+    std::mutex mMutex;
+    std::condition_variable mSlotReleased;
+    std::vector<uint32_t> mFreeSlots;
+    uint64_t mNextFenceValue = 1;
+};
+
+#endif
@@ -0,0 +1,247 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "BenchmarkResults.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "BenchmarkStatistics.h"
+
+namespace {
+
+std::string EscapeCSV(const std::string& text) {
+    if (text.find_first_of(",\"\n") == std::string::npos) {
+        return text;
+    }
+    std::string escaped = "\"";
+    for (char c : text) {
+        if (c == '"') {
+            escaped += '"';
+        }
+        escaped += c;
+    }
+    return escaped + "\"";
+}
+
+void WriteJSONSummary(FILE* file, const char* name, const DistributionSummary& summary) {
+    fprintf(
+        file,
+        "    \"%s\": {\"min\": %.3f, \"median\": %.3f, \"mean\": %.3f, \"p90\": %.3f, "
+        "\"p99\": %.3f, \"max\": %.3f, \"stddev\": %.3f},\n",
+        name, summary.min, summary.median, summary.mean, summary.p90, summary.p99, summary.max,
+        summary.stddev);
+}
+
+void WriteJSON(FILE* file, const BenchmarkResults& results) {
+    const RunMetadata& metadata = results.metadata;
+    fprintf(file, "{\n");
+    fprintf(file, "  \"schema_version\": %u,\n", kResultsSchemaVersion);
+    fprintf(file, "  \"adapter\": {\n");
+    fprintf(file, "    \"name\": \"%s\",\n", EscapeJSON(metadata.adapterName).c_str());
+    fprintf(file, "    \"vendor_id\": %u,\n", metadata.vendorId);
+    fprintf(file, "    \"device_id\": %u,\n", metadata.deviceId);
+    fprintf(file, "    \"subsys_id\": %u,\n", metadata.subSysId);
+    fprintf(file, "    \"revision\": %u,\n", metadata.revision);
+    fprintf(file, "    \"driver_version\": \"%s\"\n", EscapeJSON(metadata.driverVersion).c_str());
+    fprintf(file, "  },\n");
+    if (metadata.hasIntelDeviceInfo) {
+        fprintf(
+            file,
+            "  \"intel_device_info\": {\"eu_count\": %u, \"gpu_max_frequency_mhz\": %u, "
+            "\"package_tdp_w\": %u, \"gt_generation\": %u},\n",
+            metadata.euCount, metadata.gpuMaxFrequencyMHz, metadata.packageTDPW,
+            metadata.gtGeneration);
+    } else {
+        fprintf(file, "  \"intel_device_info\": null,\n");
+    }
+    fprintf(
+        file, "  \"throttle_policy\": \"%s\",\n", EscapeJSON(metadata.throttlePolicy).c_str());
+    fprintf(file, "  \"kernel_variant\": \"%s\",\n", EscapeJSON(metadata.kernelVariant).c_str());
+    fprintf(file, "  \"shader_source\": \"%s\",\n", EscapeJSON(metadata.shaderSource).c_str());
+    fprintf(
+        file, "  \"shape\": {\"m\": %d, \"n\": %d, \"k\": %d},\n", metadata.m, metadata.n,
+        metadata.k);
+    fprintf(file, "  \"dispatches_per_submit\": %u,\n", metadata.dispatchesPerSubmit);
+    fprintf(file, "  \"frames_in_flight\": %u,\n", metadata.framesInFlight);
+    if (results.timeToFirstDispatchMS > 0.0) {
+        fprintf(
+            file, "  \"time_to_first_dispatch_ms\": %.3f,\n", results.timeToFirstDispatchMS);
+    } else {
+        fprintf(file, "  \"time_to_first_dispatch_ms\": null,\n");
+    }
+    fprintf(file, "  \"warmup_iterations\": %u,\n", results.warmupIterations);
+
+    const size_t warmupCount =
+        std::min<size_t>(results.warmupIterations, results.gpuTimesUS.size());
+    const std::vector<double> measured(
+        results.gpuTimesUS.begin() + warmupCount, results.gpuTimesUS.end());
+    fprintf(file, "  \"summary\": {\n");
+    fprintf(file, "    \"measured_iterations\": %zu,\n", measured.size());
+    WriteJSONSummary(file, "gpu_time_us", Summarize(measured));
+    WriteJSONSummary(file, "gflops", Summarize(ToGFLOPS(measured, results.flopsPerIteration)));
+    fprintf(file, "    \"outliers\": %zu,\n", DetectOutliers(measured).size());
+    fprintf(
+        file, "    \"steady_state_start\": %zu,\n", FindSteadyStateStart(results.gpuTimesUS));
+    fprintf(
+        file, "    \"wall_clock_gflops\": %.3f\n",
+        results.wallTimeS > 0.0
+            ? measured.size() * results.flopsPerIteration / results.wallTimeS * 1e-9
+            : 0.0);
+    fprintf(file, "  },\n");
+
+    const VerificationSummary& verification = results.verification;
+    if (verification.checked) {
+        fprintf(
+            file,
+            "  \"verification\": {\"passed\": %s, \"checked_elements\": %llu, "
+            "\"mismatched_elements\": %llu, \"tolerance_ulp\": %d},\n",
+            verification.passed ? "true" : "false",
+            static_cast<unsigned long long>(verification.checkedElements),
+            static_cast<unsigned long long>(verification.mismatchedElements),
+            verification.toleranceULP);
+    } else {
+        fprintf(file, "  \"verification\": null,\n");
+    }
+
+    fprintf(file, "  \"iterations\": [\n");
+    for (size_t i = 0; i < results.gpuTimesUS.size(); ++i) {
+        const double timeUS = results.gpuTimesUS[i];
+        fprintf(
+            file,
+            "    {\"index\": %zu, \"warmup\": %s, \"gpu_time_us\": %.3f, \"gflops\": %.3f}%s\n",
+            i, i < warmupCount ? "true" : "false", timeUS,
+            timeUS > 0.0 ? results.flopsPerIteration / (timeUS * 1e3) : 0.0,
+            i + 1 < results.gpuTimesUS.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+}
+
+void WriteCSV(FILE* file, const BenchmarkResults& results, bool writeHeader) {
+    const RunMetadata& metadata = results.metadata;
+    const VerificationSummary& verification = results.verification;
+    if (writeHeader) {
+        fprintf(
+            file,
+            "schema_version,adapter_name,vendor_id,device_id,subsys_id,revision,driver_version,"
+            "eu_count,gpu_max_frequency_mhz,package_tdp_w,gt_generation,throttle_policy,"
+            "kernel_variant,shader_source,m,n,k,dispatches_per_submit,frames_in_flight,"
+            "time_to_first_dispatch_ms,verification,iteration,warmup,gpu_time_us,gflops\n");
+    }
+
+    // Unknown values are left empty.
+    std::string intelDeviceInfo = ",,,";
+    if (metadata.hasIntelDeviceInfo) {
+        intelDeviceInfo = std::to_string(metadata.euCount) + "," +
+            std::to_string(metadata.gpuMaxFrequencyMHz) + "," +
+            std::to_string(metadata.packageTDPW) + "," + std::to_string(metadata.gtGeneration);
+    }
+    const std::string timeToFirstDispatch = results.timeToFirstDispatchMS > 0.0
+        ? std::to_string(results.timeToFirstDispatchMS)
+        : "";
+    const char* verificationResult =
+        !verification.checked ? "" : (verification.passed ? "passed" : "failed");
+
+    const size_t warmupCount =
+        std::min<size_t>(results.warmupIterations, results.gpuTimesUS.size());
+    for (size_t i = 0; i < results.gpuTimesUS.size(); ++i) {
+        const double timeUS = results.gpuTimesUS[i];
+        fprintf(
+            file, "%u,%s,%u,%u,%u,%u,%s,%s,%s,%s,%s,%d,%d,%d,%u,%u,%s,%s,%zu,%d,%.3f,%.3f\n",
+            kResultsSchemaVersion, EscapeCSV(metadata.adapterName).c_str(), metadata.vendorId,
+            metadata.deviceId, metadata.subSysId, metadata.revision,
+            EscapeCSV(metadata.driverVersion).c_str(), intelDeviceInfo.c_str(),
+            EscapeCSV(metadata.throttlePolicy).c_str(), EscapeCSV(metadata.kernelVariant).c_str(),
+            EscapeCSV(metadata.shaderSource).c_str(), metadata.m, metadata.n, metadata.k,
+            metadata.dispatchesPerSubmit, metadata.framesInFlight, timeToFirstDispatch.c_str(),
+            verificationResult, i,
+            i < warmupCount ? 1 : 0, timeUS,
+            timeUS > 0.0 ? results.flopsPerIteration / (timeUS * 1e3) : 0.0);
+    }
+}
+
+}  // anonymous namespace
+
+std::string EscapeJSON(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        switch (c) {
+            case '"':
+                escaped += "\\\"";
+                break;
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char code[8];
+                    snprintf(code, sizeof(code), "\\u%04x", c);
+                    escaped += code;
+                } else {
+                    escaped += c;
+                }
+                break;
+        }
+    }
+    return escaped;
+}
+
+bool ParseResultsFormat(const char* name, ResultsFormat* format) {
+    if (strcmp(name, "json") == 0) {
+        *format = ResultsFormat::JSON;
+    } else if (strcmp(name, "csv") == 0) {
+        *format = ResultsFormat::CSV;
+    } else if (strcmp(name, "csv-rows") == 0) {
+        *format = ResultsFormat::CSVRows;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool WriteResults(const std::string& path, ResultsFormat format, const BenchmarkResults& results) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        printf("ERROR: failed to open %s for writing.\n", path.c_str());
+        return false;
+    }
+    if (format == ResultsFormat::JSON) {
+        WriteJSON(file, results);
+    } else {
+        WriteCSV(file, results, format == ResultsFormat::CSV);
+    }
+    const bool written = ferror(file) == 0;
+    if (fclose(file) != 0 || !written) {
+        printf("ERROR: failed to write %s.\n", path.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,107 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef BENCHMARK_RESULTS_
+#define BENCHMARK_RESULTS_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Incremented whenever a field of the JSON or CSV output is renamed, removed or changes meaning.
+// New fields may be added without changing it.
+constexpr uint32_t kResultsSchemaVersion = 2;
+
+struct RunMetadata {
+    std::string adapterName;
+    uint32_t vendorId = 0;
+    uint32_t deviceId = 0;
+    uint32_t subSysId = 0;
+    uint32_t revision = 0;
+    // "a.b.c.d", empty if unknown.
+    std::string driverVersion;
+
+    // Only filled when the Intel extension context could be created.
+    bool hasIntelDeviceInfo = false;
+    uint32_t euCount = 0;
+    uint32_t gpuMaxFrequencyMHz = 0;
+    uint32_t packageTDPW = 0;
+    uint32_t gtGeneration = 0;
+
+    std::string throttlePolicy;
+    std::string kernelVariant;
+    // Where the kernel bytecode came from: "embedded", "cached" or "compiled".
+    std::string shaderSource;
+    int32_t m = 0;
+    int32_t n = 0;
+    int32_t k = 0;
+    uint32_t dispatchesPerSubmit = 0;
+    uint32_t framesInFlight = 0;
+};
+
+struct VerificationSummary {
+    bool checked = false;
+    bool passed = false;
+    uint64_t checkedElements = 0;
+    uint64_t mismatchedElements = 0;
+    int32_t toleranceULP = 0;
+};
+
+// Everything a run measured, in the form written by WriteResults().
+struct BenchmarkResults {
+    RunMetadata metadata;
+    // The GPU time of every dispatch, including the warm-up ones, in microseconds.
+    std::vector<double> gpuTimesUS;
+    uint32_t warmupIterations = 0;
+    double flopsPerIteration = 0.0;
+    // The wall time of the measured dispatches, 0 if unknown.
+    double wallTimeS = 0.0;
+    // The wall time from the start of the initialization to the submit of the first dispatch, 0
+    // if unknown.
+    double timeToFirstDispatchMS = 0.0;
+    VerificationSummary verification;
+};
+
+enum class ResultsFormat {
+    JSON,
+    CSV,
+    // CSV without the header row.
+    CSVRows,
+};
+
+bool ParseResultsFormat(const char* name, ResultsFormat* format);
+
+// Returns text escaped for a JSON string literal.
+std::string EscapeJSON(const std::string& text);
+
+// Write results to path. The JSON file holds one object with the metadata, the summary of the
+// measured iterations and every iteration; the CSV file holds a header row and one row per
+// iteration with all the metadata repeated on every row. The CSVRows files of other runs can be
+// concatenated to a CSV file, as they only hold the rows. Returns false if the file couldn't be
+// written.
+bool WriteResults(const std::string& path, ResultsFormat format, const BenchmarkResults& results);
+
+#endif
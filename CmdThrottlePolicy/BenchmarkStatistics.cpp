@@ -0,0 +1,268 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "BenchmarkStatistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+double Median(std::vector<double> samples) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return Percentile(samples, 50.0);
+}
+
+void PrintPhase(
+    const char* name,
+    const std::vector<double>& timesUS,
+    size_t begin,
+    size_t end,
+    double flopsPerIteration) {
+    if (begin >= end) {
+        printf("%s: no iterations\n", name);
+        return;
+    }
+    std::vector<double> phase(timesUS.begin() + begin, timesUS.begin() + end);
+    DistributionSummary summary = Summarize(phase);
+    printf(
+        "%s: iterations [%zu, %zu), median %.2f us (%.2f GFLOPS), max %.2f us\n", name, begin,
+        end, summary.median, flopsPerIteration / (summary.median * 1e3), summary.max);
+}
+
+}  // anonymous namespace
+
+double Percentile(const std::vector<double>& sortedSamples, double p) {
+    if (sortedSamples.empty()) {
+        return 0.0;
+    }
+    double rank = (p / 100.0) * static_cast<double>(sortedSamples.size() - 1);
+    size_t lower = static_cast<size_t>(std::floor(rank));
+    size_t upper = std::min(lower + 1, sortedSamples.size() - 1);
+    double fraction = rank - static_cast<double>(lower);
+    return sortedSamples[lower] + (sortedSamples[upper] - sortedSamples[lower]) * fraction;
+}
+
+DistributionSummary Summarize(const std::vector<double>& samples) {
+    DistributionSummary summary;
+    summary.count = samples.size();
+    if (samples.empty()) {
+        return summary;
+    }
+
+    std::vector<double> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+    summary.min = sorted.front();
+    summary.max = sorted.back();
+    summary.median = Percentile(sorted, 50.0);
+    summary.p90 = Percentile(sorted, 90.0);
+    summary.p99 = Percentile(sorted, 99.0);
+
+    double sum = 0.0;
+    for (double sample : sorted) {
+        sum += sample;
+    }
+    summary.mean = sum / static_cast<double>(sorted.size());
+
+    if (sorted.size() > 1) {
+        double squaredDeviationSum = 0.0;
+        for (double sample : sorted) {
+            squaredDeviationSum += (sample - summary.mean) * (sample - summary.mean);
+        }
+        summary.stddev = std::sqrt(squaredDeviationSum / static_cast<double>(sorted.size() - 1));
+    }
+    return summary;
+}
+
+std::vector<size_t> DetectOutliers(const std::vector<double>& samples, double threshold) {
+    std::vector<size_t> outliers;
+    if (samples.size() < 3) {
+        return outliers;
+    }
+
+    double median = Median(samples);
+    std::vector<double> absoluteDeviations(samples.size());
+    for (size_t i = 0; i < samples.size(); ++i) {
+        absoluteDeviations[i] = std::fabs(samples[i] - median);
+    }
+    double mad = Median(absoluteDeviations);
+    if (mad == 0.0) {
+        return outliers;
+    }
+
+    // 0.6745 is the 0.75 quantile of the standard normal distribution, which makes the modified
+    // z-score comparable to a regular z-score for normally distributed samples.
+    for (size_t i = 0; i < samples.size(); ++i) {
+        double modifiedZScore = 0.6745 * (samples[i] - median) / mad;
+        if (std::fabs(modifiedZScore) > threshold) {
+            outliers.push_back(i);
+        }
+    }
+    return outliers;
+}
+
+size_t FindSteadyStateStart(const std::vector<double>& samples, double tolerance) {
+    const size_t windowSize = std::max<size_t>(3, samples.size() / 20);
+    if (samples.size() < windowSize * 2) {
+        return 0;
+    }
+
+    std::vector<double> secondHalf(samples.begin() + samples.size() / 2, samples.end());
+    double reference = Median(secondHalf);
+
+    for (size_t begin = 0; begin + windowSize <= samples.size(); ++begin) {
+        std::vector<double> window(
+            samples.begin() + begin, samples.begin() + begin + windowSize);
+        if (std::fabs(Median(window) - reference) <= reference * tolerance) {
+            return begin;
+        }
+    }
+    return samples.size() - windowSize;
+}
+
+MannWhitneyResult MannWhitneyUTest(const std::vector<double>& a, const std::vector<double>& b) {
+    MannWhitneyResult result;
+    if (a.empty() || b.empty()) {
+        return result;
+    }
+
+    struct RankedSample {
+        double value;
+        bool fromA;
+    };
+    std::vector<RankedSample> samples;
+    samples.reserve(a.size() + b.size());
+    for (double value : a) {
+        samples.push_back({ value, true });
+    }
+    for (double value : b) {
+        samples.push_back({ value, false });
+    }
+    std::sort(samples.begin(), samples.end(), [](const RankedSample& lhs, const RankedSample& rhs) {
+        return lhs.value < rhs.value;
+    });
+
+    // Tied samples all get the average of their ranks.
+    double rankSumA = 0.0;
+    double tieCorrection = 0.0;
+    for (size_t begin = 0; begin < samples.size();) {
+        size_t end = begin + 1;
+        while (end < samples.size() && samples[end].value == samples[begin].value) {
+            ++end;
+        }
+        const double averageRank = (static_cast<double>(begin + end) + 1.0) / 2.0;
+        for (size_t i = begin; i < end; ++i) {
+            if (samples[i].fromA) {
+                rankSumA += averageRank;
+            }
+        }
+        const double tieCount = static_cast<double>(end - begin);
+        tieCorrection += tieCount * tieCount * tieCount - tieCount;
+        begin = end;
+    }
+
+    const double n1 = static_cast<double>(a.size());
+    const double n2 = static_cast<double>(b.size());
+    const double n = n1 + n2;
+    result.u = rankSumA - n1 * (n1 + 1.0) / 2.0;
+
+    const double mean = n1 * n2 / 2.0;
+    const double variance = n1 * n2 / 12.0 * ((n + 1.0) - tieCorrection / (n * (n - 1.0)));
+    if (variance <= 0.0) {
+        return result;
+    }
+    const double difference = result.u - mean;
+    const double correctedDifference =
+        difference > 0.0 ? std::max(0.0, difference - 0.5) : std::min(0.0, difference + 0.5);
+    result.z = correctedDifference / std::sqrt(variance);
+    result.pValue = std::erfc(std::fabs(result.z) / std::sqrt(2.0));
+    return result;
+}
+
+std::vector<double> ToGFLOPS(const std::vector<double>& timesUS, double flopsPerIteration) {
+    std::vector<double> gflops(timesUS.size());
+    for (size_t i = 0; i < timesUS.size(); ++i) {
+        gflops[i] = timesUS[i] > 0.0 ? flopsPerIteration / (timesUS[i] * 1e3) : 0.0;
+    }
+    return gflops;
+}
+
+void PrintSummaryHeader() {
+    printf(
+        "%-20s%12s%12s%12s%12s%12s%12s\n", "", "min", "median", "mean", "p90", "p99", "stddev");
+}
+
+void PrintSummaryRow(const char* name, const DistributionSummary& summary) {
+    printf(
+        "%-20s%12.2f%12.2f%12.2f%12.2f%12.2f%12.2f\n", name, summary.min, summary.median,
+        summary.mean, summary.p90, summary.p99, summary.stddev);
+}
+
+void PrintBenchmarkReport(
+    const std::vector<double>& timesUS,
+    size_t warmupCount,
+    double flopsPerIteration) {
+    warmupCount = std::min(warmupCount, timesUS.size());
+    std::vector<double> measured(timesUS.begin() + warmupCount, timesUS.end());
+    printf(
+        "Warm-up iterations: %zu, measured iterations: %zu\n", warmupCount, measured.size());
+    if (measured.empty()) {
+        printf("\n");
+        return;
+    }
+
+    PrintSummaryHeader();
+    PrintSummaryRow("Time (us)", Summarize(measured));
+    PrintSummaryRow("GFLOPS", Summarize(ToGFLOPS(measured, flopsPerIteration)));
+
+    std::vector<size_t> outliers = DetectOutliers(measured);
+    printf("Outliers: %zu of %zu measured iterations", outliers.size(), measured.size());
+    if (!outliers.empty()) {
+        printf(" (iterations");
+        for (size_t index : outliers) {
+            printf(" %zu", index + warmupCount);
+        }
+        printf(")");
+    }
+    printf("\n");
+
+    // The phases are computed over all the iterations including the warm-up ones, as the cold
+    // start is exactly what the warm-up iterations are meant to absorb.
+    size_t steadyStateStart = FindSteadyStateStart(timesUS);
+    PrintPhase("Cold start", timesUS, 0, steadyStateStart, flopsPerIteration);
+    PrintPhase("Steady state", timesUS, steadyStateStart, timesUS.size(), flopsPerIteration);
+    if (steadyStateStart > warmupCount) {
+        printf(
+            "WARNING: the steady state was only reached after %zu iterations, consider more "
+            "warm-up iterations.\n",
+            steadyStateStart);
+    }
+    printf("\n");
+}
@@ -0,0 +1,88 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef BENCHMARK_STATISTICS_
+#define BENCHMARK_STATISTICS_
+
+#include <cstddef>
+#include <vector>
+
+// Summary of a distribution of samples. stddev is the sample standard deviation.
+struct DistributionSummary {
+    size_t count = 0;
+    double min = 0.0;
+    double median = 0.0;
+    double mean = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+    double stddev = 0.0;
+};
+
+DistributionSummary Summarize(const std::vector<double>& samples);
+
+// Returns the p-th percentile (0 <= p <= 100) of sortedSamples with linear interpolation between
+// the closest ranks.
+double Percentile(const std::vector<double>& sortedSamples, double p);
+
+// Returns the indices of the samples whose modified z-score, computed from the median absolute
+// deviation, is above threshold. The MAD is used instead of the standard deviation so that the
+// outliers themselves don't hide each other.
+std::vector<size_t> DetectOutliers(const std::vector<double>& samples, double threshold = 3.5);
+
+// Returns the index of the first sample of the steady-state phase. The reference is the median of
+// the second half of the samples, and the steady state starts at the first sliding window whose
+// median is within tolerance (relative) of that reference. Everything before it is the cold-start
+// phase, which on a GPU is mostly the clock ramping up from an idle power state.
+size_t FindSteadyStateStart(const std::vector<double>& samples, double tolerance = 0.05);
+
+// Result of a two-sided Mann-Whitney U test, computed with the normal approximation including the
+// tie and continuity corrections. It makes no assumption on the shape of the distributions, which
+// are usually skewed for GPU timings.
+struct MannWhitneyResult {
+    // The U statistic of the first sample set.
+    double u = 0.0;
+    double z = 0.0;
+    double pValue = 1.0;
+};
+
+MannWhitneyResult MannWhitneyUTest(const std::vector<double>& a, const std::vector<double>& b);
+
+// Converts execution times in microseconds to GFLOPS.
+std::vector<double> ToGFLOPS(const std::vector<double>& timesUS, double flopsPerIteration);
+
+// Print the column names matching PrintSummaryRow().
+void PrintSummaryHeader();
+void PrintSummaryRow(const char* name, const DistributionSummary& summary);
+
+// Print the distribution of timesUS, where the first warmupCount samples are warm-up iterations
+// that are excluded from the measured distribution but included in the cold-start analysis.
+void PrintBenchmarkReport(
+    const std::vector<double>& timesUS,
+    size_t warmupCount,
+    double flopsPerIteration);
+
+#endif
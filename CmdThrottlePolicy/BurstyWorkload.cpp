@@ -0,0 +1,224 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "BurstyWorkload.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+
+#include "BenchmarkStatistics.h"
+
+namespace {
+
+// The upper bound of the first gap bin. The next bins double in size.
+constexpr double kFirstGapBinUS = 250.0;
+
+using PolicyLatencies = std::array<std::vector<double>, kThrottlePolicyCount>;
+
+bool LoadGapTrace(const std::string& path, std::vector<double>* gapsUS) {
+    std::ifstream file(path);
+    if (!file) {
+        printf("ERROR: failed to open the gap trace %s.\n", path.c_str());
+        return false;
+    }
+
+    std::string line;
+    uint32_t lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#') {
+            continue;
+        }
+        char* end = nullptr;
+        double gapMs = strtod(line.c_str() + begin, &end);
+        if (end == line.c_str() + begin || gapMs < 0.0) {
+            printf("ERROR: invalid gap at line %u of %s.\n", lineNumber, path.c_str());
+            return false;
+        }
+        gapsUS->push_back(gapMs * 1000.0);
+    }
+    if (gapsUS->empty()) {
+        printf("ERROR: the gap trace %s is empty.\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+size_t GetGapBin(double gapUS) {
+    if (gapUS < kFirstGapBinUS) {
+        return 0;
+    }
+    return static_cast<size_t>(std::floor(std::log2(gapUS / kFirstGapBinUS))) + 1;
+}
+
+double GetGapBinBeginUS(size_t bin) {
+    return bin == 0 ? 0.0 : kFirstGapBinUS * std::ldexp(1.0, static_cast<int>(bin) - 1);
+}
+
+void PrintLatencyRow(const char* name, const PolicyLatencies& latenciesUS) {
+    printf("%-20s", name);
+    double medians[kThrottlePolicyCount] = {};
+    for (int i = 0; i < kThrottlePolicyCount; ++i) {
+        DistributionSummary summary = Summarize(latenciesUS[i]);
+        medians[i] = summary.median;
+        printf("%8zu%12.1f%12.1f", summary.count, summary.median, summary.p90);
+    }
+    const double dynamicMedian = medians[static_cast<int>(ThrottlePolicy::Dynamic)];
+    const double maxPerformanceMedian = medians[static_cast<int>(ThrottlePolicy::MaxPerformance)];
+    if (dynamicMedian > 0.0 && maxPerformanceMedian > 0.0) {
+        printf("%12.1f%%", (1.0 - maxPerformanceMedian / dynamicMedian) * 100.0);
+    }
+    printf("\n");
+}
+
+}  // anonymous namespace
+
+bool ParseGapDistribution(const char* text, GapDistribution* distribution) {
+    if (strcmp(text, "fixed") == 0) {
+        *distribution = GapDistribution::Fixed;
+    } else if (strcmp(text, "poisson") == 0) {
+        *distribution = GapDistribution::Poisson;
+    } else if (strcmp(text, "trace") == 0) {
+        *distribution = GapDistribution::Trace;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool BuildIdleGaps(const BurstyWorkloadSettings& settings, std::vector<double>* gapsUS) {
+    gapsUS->clear();
+    switch (settings.gapDistribution) {
+        case GapDistribution::Fixed:
+            gapsUS->assign(settings.burstCount, settings.gapUS);
+            return true;
+        case GapDistribution::Poisson: {
+            // The distribution needs a positive mean, and a zero mean only gives zero gaps.
+            if (settings.gapUS <= 0.0) {
+                gapsUS->assign(settings.burstCount, 0.0);
+                return true;
+            }
+            std::mt19937 random(settings.seed);
+            std::exponential_distribution<double> distribution(1.0 / settings.gapUS);
+            for (uint32_t i = 0; i < settings.burstCount; ++i) {
+                gapsUS->push_back(distribution(random));
+            }
+            return true;
+        }
+        case GapDistribution::Trace:
+            return LoadGapTrace(settings.traceFile, gapsUS);
+    }
+    return false;
+}
+
+std::vector<BurstSample> RunBurstyWorkload(
+    PolicyTrialExecutor* executor,
+    const BurstyWorkloadSettings& settings) {
+    std::vector<BurstSample> samples;
+    std::vector<double> gapsUS;
+    if (!BuildIdleGaps(settings, &gapsUS)) {
+        return samples;
+    }
+
+    const uint32_t burstCount = static_cast<uint32_t>(gapsUS.size());
+    const double submitIntervalUS =
+        settings.submissionRateHz > 0.0 ? 1e6 / settings.submissionRateHz : 0.0;
+    printf(
+        "Running %u bursts of %u dispatches per throttle policy on %s, mean gap %.2f ms, ",
+        burstCount, settings.burstLength, executor->GetName(),
+        Summarize(gapsUS).mean / 1000.0);
+    if (submitIntervalUS > 0.0) {
+        printf("one dispatch every %.2f ms in a burst\n", submitIntervalUS / 1000.0);
+    } else {
+        printf("back to back dispatches in a burst\n");
+    }
+
+    // The schedule holds one run of each policy per gap, in a random order.
+    std::vector<ThrottlePolicy> schedule = BuildTrialSchedule(burstCount, settings.seed);
+    samples.reserve(schedule.size() * settings.burstLength);
+    for (size_t i = 0; i < schedule.size(); ++i) {
+        const uint32_t burst = static_cast<uint32_t>(i / kThrottlePolicyCount);
+        executor->Idle(gapsUS[burst]);
+        std::vector<DispatchLatency> latencies =
+            executor->RunBurst(schedule[i], settings.burstLength, submitIntervalUS);
+        for (uint32_t dispatch = 0; dispatch < latencies.size(); ++dispatch) {
+            samples.push_back({ schedule[i], gapsUS[burst], burst, dispatch, latencies[dispatch] });
+        }
+    }
+    return samples;
+}
+
+void PrintLatencyVsGap(const std::vector<BurstSample>& samples) {
+    if (samples.empty()) {
+        return;
+    }
+
+    std::map<size_t, PolicyLatencies> firstDispatchLatenciesUS;
+    PolicyLatencies allFirstDispatchLatenciesUS;
+    PolicyLatencies followingDispatchLatenciesUS;
+    for (const BurstSample& sample : samples) {
+        const int policy = static_cast<int>(sample.policy);
+        if (sample.dispatch == 0) {
+            firstDispatchLatenciesUS[GetGapBin(sample.precedingIdleUS)][policy].push_back(
+                sample.latency.latencyUS);
+            allFirstDispatchLatenciesUS[policy].push_back(sample.latency.latencyUS);
+        } else {
+            followingDispatchLatenciesUS[policy].push_back(sample.latency.latencyUS);
+        }
+    }
+
+    printf("\nLatency from submit to completion (us) against the idle gap before the burst:\n");
+    printf("%-20s", "");
+    for (int i = 0; i < kThrottlePolicyCount; ++i) {
+        printf("%32s", GetThrottlePolicyName(static_cast<ThrottlePolicy>(i)));
+    }
+    printf("\n%-20s", "gap (ms)");
+    for (int i = 0; i < kThrottlePolicyCount; ++i) {
+        printf("%8s%12s%12s", "count", "median", "p90");
+    }
+    printf("%13s\n", "saving");
+
+    for (const auto& bin : firstDispatchLatenciesUS) {
+        char name[32];
+        snprintf(
+            name, sizeof(name), "[%.2f, %.2f)", GetGapBinBeginUS(bin.first) / 1000.0,
+            GetGapBinBeginUS(bin.first + 1) / 1000.0);
+        PrintLatencyRow(name, bin.second);
+    }
+    PrintLatencyRow("first dispatches", allFirstDispatchLatenciesUS);
+    if (!followingDispatchLatenciesUS[0].empty()) {
+        PrintLatencyRow("following dispatches", followingDispatchLatenciesUS);
+    }
+    printf(
+        "The saving is the reduction of the median latency with MAX_PERFORMANCE over DYNAMIC.\n\n");
+}
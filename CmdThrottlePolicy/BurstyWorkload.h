@@ -0,0 +1,89 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef BURSTY_WORKLOAD_
+#define BURSTY_WORKLOAD_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "PolicyComparison.h"
+#include "ThrottlePolicy.h"
+
+// How the idle gaps before the bursts are generated.
+enum class GapDistribution {
+    // Every gap is BurstyWorkloadSettings::gapUS.
+    Fixed,
+    // Exponentially distributed gaps with a mean of BurstyWorkloadSettings::gapUS, i.e. the bursts
+    // arrive as a Poisson process.
+    Poisson,
+    // The gaps are read from BurstyWorkloadSettings::traceFile.
+    Trace,
+};
+
+bool ParseGapDistribution(const char* text, GapDistribution* distribution);
+
+struct BurstyWorkloadSettings {
+    GapDistribution gapDistribution = GapDistribution::Poisson;
+    double gapUS = 10000.0;
+    // A text file with the idle gap before each burst in milliseconds, one per line, for instance
+    // recorded from the frame cadence of an application. Empty lines and lines starting with '#'
+    // are ignored.
+    std::string traceFile;
+    // Number of bursts per throttle policy. With a trace, there is one burst per gap instead.
+    uint32_t burstCount = 100;
+    // Number of dispatches in each burst.
+    uint32_t burstLength = 1;
+    // Rate at which the dispatches of a burst are submitted, 0 to submit them back to back.
+    double submissionRateHz = 0.0;
+    uint32_t seed = 1;
+};
+
+struct BurstSample {
+    ThrottlePolicy policy;
+    // The idle time before the burst this dispatch belongs to.
+    double precedingIdleUS;
+    uint32_t burst;
+    // The index of the dispatch in its burst.
+    uint32_t dispatch;
+    DispatchLatency latency;
+};
+
+// Returns the idle gap before each burst, or false if the trace can't be read.
+bool BuildIdleGaps(const BurstyWorkloadSettings& settings, std::vector<double>* gapsUS);
+
+// Run the bursts on executor with each throttle policy. Every gap is used once per policy, and the
+// policy that runs first is randomized for each gap so that both see the same cadence and drifts.
+std::vector<BurstSample> RunBurstyWorkload(
+    PolicyTrialExecutor* executor,
+    const BurstyWorkloadSettings& settings);
+
+// Print the latency of the first dispatch of the bursts against the idle time before them, with
+// the gaps grouped in power of two bins, and the latency of the other dispatches of the bursts.
+void PrintLatencyVsGap(const std::vector<BurstSample>& samples);
+
+#endif
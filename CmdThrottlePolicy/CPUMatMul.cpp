@@ -0,0 +1,334 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+
+#include "CPUMatMul.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "BenchmarkStatistics.h"
+#include "Tracer.h"
+
+namespace {
+
+// A 256 x 256 block of the second input is 256 KB, which stays in the L2 cache while every row of
+// the first input is multiplied with it.
+constexpr int32_t kBlockN = 256;
+constexpr int32_t kBlockK = 256;
+
+// Split count items into partCount contiguous parts and return the range of one of them.
+void SplitRange(int32_t count, uint32_t part, uint32_t partCount, int32_t* first, int32_t* size) {
+    const int64_t begin = static_cast<int64_t>(count) * part / partCount;
+    const int64_t end = static_cast<int64_t>(count) * (part + 1) / partCount;
+    *first = static_cast<int32_t>(begin);
+    *size = static_cast<int32_t>(end - begin);
+}
+
+void CopyRows(
+    const float* source,
+    size_t sourceStride,
+    float* destination,
+    int32_t rowCount,
+    int32_t rowSize) {
+    for (int32_t y = 0; y < rowCount; ++y) {
+        memcpy(
+            destination + static_cast<size_t>(y) * rowSize, source + y * sourceStride,
+            rowSize * sizeof(float));
+    }
+}
+
+}  // anonymous namespace
+
+bool ParseCPUReference(const char* name, CPUReference* reference) {
+    if (strcmp(name, "naive") == 0) {
+        *reference = CPUReference::Naive;
+    } else if (strcmp(name, "numa") == 0) {
+        *reference = CPUReference::Numa;
+    } else if (strcmp(name, "strassen") == 0) {
+        *reference = CPUReference::Strassen;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void MultiplyMatricesBlocked(
+    int32_t m,
+    int32_t n,
+    int32_t k,
+    const float* a,
+    size_t lda,
+    const float* b,
+    size_t ldb,
+    float* c,
+    size_t ldc) {
+    for (int32_t y = 0; y < m; ++y) {
+        std::fill(c + y * ldc, c + y * ldc + n, 0.0f);
+    }
+    for (int32_t column = 0; column < n; column += kBlockN) {
+        const int32_t columnCount = std::min(kBlockN, n - column);
+        for (int32_t depth = 0; depth < k; depth += kBlockK) {
+            const int32_t depthCount = std::min(kBlockK, k - depth);
+            for (int32_t y = 0; y < m; ++y) {
+                const float* inputRow1 = a + y * lda + depth;
+                float* outputRow = c + y * ldc + column;
+                for (int32_t x2 = 0; x2 < depthCount; ++x2) {
+                    const float value = inputRow1[x2];
+                    const float* inputRow2 = b + (depth + x2) * ldb + column;
+                    for (int32_t x = 0; x < columnCount; ++x) {
+                        outputRow[x] += value * inputRow2[x];
+                    }
+                }
+            }
+        }
+    }
+}
+
+NumaMatMul::NumaMatMul(const CPUTopology& topology, uint32_t nodeCount, bool localPlacement)
+    : mLocalPlacement(localPlacement) {
+    const uint32_t availableNodeCount = static_cast<uint32_t>(topology.nodes.size());
+    if (nodeCount == 0 || nodeCount > availableNodeCount) {
+        nodeCount = availableNodeCount;
+    }
+    mPartitions.resize(nodeCount);
+    for (uint32_t partition = 0; partition < nodeCount; ++partition) {
+        mPartitions[partition].workerCount =
+            static_cast<uint32_t>(topology.nodes[partition].processors.size());
+    }
+    for (uint32_t partition = 0; partition < nodeCount; ++partition) {
+        const NumaNode& node = topology.nodes[partition];
+        for (uint32_t worker = 0; worker < node.processors.size(); ++worker) {
+            mThreads.emplace_back(
+                &NumaMatMul::WorkerMain, this, partition, worker, node.processors[worker]);
+        }
+    }
+}
+
+NumaMatMul::~NumaMatMul() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mExit = true;
+    }
+    mWorkReady.notify_all();
+    for (std::thread& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void NumaMatMul::SetInputs(
+    int32_t m,
+    int32_t n,
+    int32_t k,
+    const float* a,
+    size_t lda,
+    const float* b,
+    size_t ldb) {
+    TRACE_SCOPE("NumaMatMul::SetInputs");
+    mM = m;
+    mN = n;
+    mK = k;
+
+    // The rows are split in proportion to the workers of each node.
+    const uint32_t threadCount = GetThreadCount();
+    uint32_t workersBefore = 0;
+    for (NodePartition& partition : mPartitions) {
+        partition.firstRow = static_cast<int32_t>(int64_t(m) * workersBefore / threadCount);
+        workersBefore += partition.workerCount;
+        partition.rowCount =
+            static_cast<int32_t>(int64_t(m) * workersBefore / threadCount) - partition.firstRow;
+
+        const size_t rowCount = partition.rowCount;
+        partition.inputMatrix1.reset(new float[std::max<size_t>(1, rowCount * k)]);
+        partition.inputMatrix2.reset(new float[std::max<size_t>(1, size_t(k) * n)]);
+        partition.outputMatrix.reset(new float[std::max<size_t>(1, rowCount * n)]);
+    }
+
+    // Each worker first writes the rows it multiplies later, and its share of the replica of the
+    // second input.
+    RunOnWorkers([&](uint32_t partition, uint32_t worker) {
+        const uint32_t workerCount = mPartitions[partition].workerCount;
+        for (uint32_t target = 0; target < mPartitions.size(); ++target) {
+            if (mLocalPlacement ? target != partition : partition != 0) {
+                continue;
+            }
+            NodePartition& node = mPartitions[target];
+            int32_t firstRow = 0;
+            int32_t rowCount = 0;
+            SplitRange(node.rowCount, worker, workerCount, &firstRow, &rowCount);
+            CopyRows(
+                a + (node.firstRow + firstRow) * lda, lda,
+                node.inputMatrix1.get() + size_t(firstRow) * k, rowCount, k);
+            std::fill(
+                node.outputMatrix.get() + size_t(firstRow) * n,
+                node.outputMatrix.get() + size_t(firstRow + rowCount) * n, 0.0f);
+
+            SplitRange(k, worker, workerCount, &firstRow, &rowCount);
+            CopyRows(
+                b + firstRow * ldb, ldb, node.inputMatrix2.get() + size_t(firstRow) * n, rowCount,
+                n);
+        }
+    });
+}
+
+double NumaMatMul::Multiply() {
+    TRACE_SCOPE("NumaMatMul::Multiply");
+    const auto start = std::chrono::steady_clock::now();
+    RunOnWorkers([&](uint32_t partition, uint32_t worker) {
+        NodePartition& node = mPartitions[partition];
+        int32_t firstRow = 0;
+        int32_t rowCount = 0;
+        SplitRange(node.rowCount, worker, node.workerCount, &firstRow, &rowCount);
+        MultiplyMatricesBlocked(
+            rowCount, mN, mK, node.inputMatrix1.get() + size_t(firstRow) * mK, mK,
+            node.inputMatrix2.get(), mN, node.outputMatrix.get() + size_t(firstRow) * mN, mN);
+    });
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void NumaMatMul::GetOutput(float* output) const {
+    for (const NodePartition& partition : mPartitions) {
+        memcpy(
+            output + size_t(partition.firstRow) * mN, partition.outputMatrix.get(),
+            size_t(partition.rowCount) * mN * sizeof(float));
+    }
+}
+
+uint32_t NumaMatMul::GetNodeCount() const {
+    return static_cast<uint32_t>(mPartitions.size());
+}
+
+uint32_t NumaMatMul::GetThreadCount() const {
+    return static_cast<uint32_t>(mThreads.size());
+}
+
+uint32_t NumaMatMul::GetUnpinnedThreadCount() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mUnpinnedCount;
+}
+
+void NumaMatMul::RunOnWorkers(const WorkFunction& work) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mWork = &work;
+    mRunningCount = GetThreadCount();
+    ++mGeneration;
+    mWorkReady.notify_all();
+    mWorkDone.wait(lock, [this] { return mRunningCount == 0; });
+    mWork = nullptr;
+}
+
+void NumaMatMul::WorkerMain(uint32_t partition, uint32_t worker, LogicalProcessor processor) {
+    const bool pinned = PinCurrentThread(processor);
+    uint64_t generation = 0;
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (!pinned) {
+        ++mUnpinnedCount;
+    }
+    while (true) {
+        mWorkReady.wait(lock, [&] { return mExit || mGeneration != generation; });
+        if (mExit) {
+            return;
+        }
+        generation = mGeneration;
+        const WorkFunction* work = mWork;
+        lock.unlock();
+        (*work)(partition, worker);
+        lock.lock();
+        if (--mRunningCount == 0) {
+            mWorkDone.notify_one();
+        }
+    }
+}
+
+void BenchmarkNumaMatMulScaling(const CPUTopology& topology, int32_t size, uint32_t iterations) {
+    TRACE_SCOPE("BenchmarkNumaMatMulScaling");
+    PrintCPUTopology(topology);
+    iterations = std::max(1u, iterations);
+
+    const size_t elementCount = size_t(size) * size;
+    std::vector<float> inputMatrix1(elementCount);
+    std::vector<float> inputMatrix2(elementCount);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    for (size_t i = 0; i < elementCount; ++i) {
+        inputMatrix1[i] = distribution(random);
+        inputMatrix2[i] = distribution(random);
+    }
+
+    printf(
+        "\nMultiply %dx%d matrices on 1 to %zu NUMA nodes, median of %u iterations:\n", size,
+        size, topology.nodes.size(), iterations);
+    printf(
+        "%-8s%-10s%10s%14s%12s%12s%14s\n", "Nodes", "Memory", "Threads", "Median (ms)",
+        "GFLOPS", "Scaling", "GFLOPS/thread");
+
+    const double flops = 2.0 * size * size * size;
+    double singleNodeGFLOPS = 0.0;
+    std::vector<float> reference;
+    std::vector<float> output(elementCount);
+    for (uint32_t nodeCount = 1; nodeCount <= topology.nodes.size(); ++nodeCount) {
+        // Placing the memory of every node on the first one is only different with several nodes.
+        for (bool localPlacement : { true, false }) {
+            if (!localPlacement && nodeCount == 1) {
+                continue;
+            }
+            NumaMatMul matMul(topology, nodeCount, localPlacement);
+            matMul.SetInputs(
+                size, size, size, inputMatrix1.data(), size, inputMatrix2.data(), size);
+            std::vector<double> timesMS;
+            for (uint32_t i = 0; i < iterations; ++i) {
+                timesMS.push_back(matMul.Multiply() * 1e3);
+            }
+            const double medianMS = Summarize(timesMS).median;
+            const double gflops = flops / (medianMS * 1e6);
+            if (nodeCount == 1) {
+                singleNodeGFLOPS = gflops;
+            }
+            printf(
+                "%-8u%-10s%10u%14.2f%12.2f%11.2fx%14.2f\n", nodeCount,
+                localPlacement ? "local" : "node 0", matMul.GetThreadCount(), medianMS, gflops,
+                gflops / singleNodeGFLOPS, gflops / matMul.GetThreadCount());
+            if (matMul.GetUnpinnedThreadCount() > 0) {
+                printf(
+                    "WARNING: %u of the threads could not be pinned to their processor.\n",
+                    matMul.GetUnpinnedThreadCount());
+            }
+
+            // Every partitioning sums the products in the same order, so the outputs are equal.
+            matMul.GetOutput(output.data());
+            if (reference.empty()) {
+                reference = output;
+            } else if (output != reference) {
+                printf(
+                    "ERROR: the output on %u nodes differs from the one on 1 node.\n", nodeCount);
+            }
+        }
+    }
+    printf("\n");
+}
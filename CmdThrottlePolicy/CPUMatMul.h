@@ -0,0 +1,161 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+
+#ifndef CPU_MAT_MUL_
+#define CPU_MAT_MUL_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "CPUTopology.h"
+
+// How CheckGPUResult() computes the result on CPU.
+enum class CPUReference {
+    // One dot product per element on the calling thread.
+    Naive,
+    // NumaMatMul on every NUMA node.
+    Numa,
+    // MultiplyMatricesStrassen(), for the largest shapes.
+    Strassen,
+};
+
+inline const char* GetCPUReferenceName(CPUReference reference) {
+    switch (reference) {
+        case CPUReference::Naive:
+            return "naive";
+        case CPUReference::Numa:
+            return "numa";
+        case CPUReference::Strassen:
+            return "strassen";
+    }
+    return "unknown";
+}
+
+// Parse the name returned by GetCPUReferenceName(). Returns false if it isn't one.
+bool ParseCPUReference(const char* name, CPUReference* reference);
+
+// c = a * b, where a is m x k, b is k x n and c is m x n, and the rows of each matrix are lda,
+// ldb and ldc floats apart. The columns of b are blocked to stay in the cache, but every element
+// of c still sums its products in the order of k, so the result is the same as with one dot
+// product per element.
+void MultiplyMatricesBlocked(
+    int32_t m,
+    int32_t n,
+    int32_t k,
+    const float* a,
+    size_t lda,
+    const float* b,
+    size_t ldb,
+    float* c,
+    size_t ldc);
+
+// Multiplies matrices on the CPU with a worker thread pinned to each logical processor of the
+// selected NUMA nodes.
+//
+// The rows of the output are partitioned across the nodes in proportion to their processors.
+// Each node has its own copy of its rows of the first input and of the output and a replica of
+// the second input, which are written first by the workers of the node so that the OS places
+// their pages on it, so the multiplication only streams memory local to each node.
+class NumaMatMul {
+public:
+    // Use the first nodeCount nodes of topology, or all of them if nodeCount is 0. Without
+    // localPlacement, the memory of every node is first written by the workers of the first
+    // node, to compare with.
+    NumaMatMul(const CPUTopology& topology, uint32_t nodeCount = 0, bool localPlacement = true);
+    ~NumaMatMul();
+
+    NumaMatMul(const NumaMatMul&) = delete;
+    NumaMatMul& operator=(const NumaMatMul&) = delete;
+
+    // Copy the inputs to the nodes: a is m x k and b is k x n, with their rows lda and ldb floats
+    // apart.
+    void SetInputs(
+        int32_t m,
+        int32_t n,
+        int32_t k,
+        const float* a,
+        size_t lda,
+        const float* b,
+        size_t ldb);
+
+    // Multiply the inputs and return the wall time in seconds.
+    double Multiply();
+
+    // Copy the m x n output packed into output.
+    void GetOutput(float* output) const;
+
+    uint32_t GetNodeCount() const;
+    uint32_t GetThreadCount() const;
+    // The number of workers that couldn't be pinned to their processor.
+    uint32_t GetUnpinnedThreadCount() const;
+
+private:
+    struct NodePartition {
+        uint32_t workerCount = 0;
+        int32_t firstRow = 0;
+        int32_t rowCount = 0;
+        // Allocated without being written, so that the pages are placed on first touch.
+        std::unique_ptr<float[]> inputMatrix1;
+        std::unique_ptr<float[]> inputMatrix2;
+        std::unique_ptr<float[]> outputMatrix;
+    };
+
+    // Called on every worker with the index of its partition and its index in the partition.
+    using WorkFunction = std::function<void(uint32_t partition, uint32_t worker)>;
+
+    // Run work on every worker and wait for all of them.
+    void RunOnWorkers(const WorkFunction& work);
+    void WorkerMain(uint32_t partition, uint32_t worker, LogicalProcessor processor);
+
+    bool mLocalPlacement;
+    std::vector<NodePartition> mPartitions;
+    int32_t mM = 0;
+    int32_t mN = 0;
+    int32_t mK = 0;
+
+    std::vector<std::thread> mThreads;
+    mutable std::mutex mMutex;
+    std::condition_variable mWorkReady;
+    std::condition_variable mWorkDone;
+    const WorkFunction* mWork = nullptr;
+    uint64_t mGeneration = 0;
+    uint32_t mRunningCount = 0;
+    uint32_t mUnpinnedCount = 0;
+    bool mExit = false;
+};
+
+// Multiply size x size matrices with the NUMA nodes of topology, first on 1 node and then on
+// more and more of them, and print the time, the GFLOPS and the scaling against 1 node, with the
+// memory placed on the local node and on the first node.
+void BenchmarkNumaMatMulScaling(const CPUTopology& topology, int32_t size, uint32_t iterations);
+
+#endif
@@ -0,0 +1,222 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+
+#include "CPUTopology.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+CPUTopology GetSingleNodeTopology() {
+    CPUTopology topology;
+    NumaNode node = { 0, {} };
+    const uint32_t processorCount = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t number = 0; number < processorCount; ++number) {
+        node.processors.push_back({ 0, number });
+    }
+    topology.nodes.push_back(node);
+    return topology;
+}
+
+#ifdef _WIN32
+
+CPUTopology DetectNumaNodes() {
+    CPUTopology topology;
+    DWORD size = 0;
+    GetLogicalProcessorInformationEx(RelationNumaNode, nullptr, &size);
+    if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
+        return topology;
+    }
+    std::vector<uint8_t> buffer(size);
+    auto* info = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data());
+    if (!GetLogicalProcessorInformationEx(RelationNumaNode, info, &size)) {
+        return topology;
+    }
+
+    GROUP_AFFINITY processAffinity = {};
+    const bool hasProcessAffinity =
+        GetThreadGroupAffinity(GetCurrentThread(), &processAffinity) != FALSE;
+    for (DWORD offset = 0; offset < size;) {
+        const auto* entry =
+            reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(&buffer[offset]);
+        const GROUP_AFFINITY& groupMask = entry->NumaNode.GroupMask;
+        NumaNode node = { entry->NumaNode.NodeNumber, {} };
+        for (uint32_t number = 0; number < sizeof(KAFFINITY) * 8; ++number) {
+            const KAFFINITY bit = KAFFINITY(1) << number;
+            // Within the group of the calling thread, skip the processors it may not run on.
+            if ((groupMask.Mask & bit) == 0 ||
+                (hasProcessAffinity && processAffinity.Group == groupMask.Group &&
+                 (processAffinity.Mask & bit) == 0)) {
+                continue;
+            }
+            node.processors.push_back({ groupMask.Group, number });
+        }
+        if (!node.processors.empty()) {
+            topology.nodes.push_back(node);
+        }
+        offset += entry->Size;
+    }
+    return topology;
+}
+
+#else
+
+bool ReadFirstLine(const std::string& path, std::string* line) {
+    std::ifstream file(path);
+    return file && std::getline(file, *line);
+}
+
+CPUTopology DetectNumaNodes() {
+    CPUTopology topology;
+    std::string line;
+    if (!ReadFirstLine("/sys/devices/system/node/online", &line)) {
+        return topology;
+    }
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    const bool hasAffinity = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+    for (uint32_t nodeId : ParseCPUList(line)) {
+        std::string cpuList;
+        if (!ReadFirstLine(
+                "/sys/devices/system/node/node" + std::to_string(nodeId) + "/cpulist",
+                &cpuList)) {
+            continue;
+        }
+        NumaNode node = { nodeId, {} };
+        for (uint32_t cpu : ParseCPUList(cpuList)) {
+            if (!hasAffinity || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))) {
+                node.processors.push_back({ 0, cpu });
+            }
+        }
+        if (!node.processors.empty()) {
+            topology.nodes.push_back(node);
+        }
+    }
+    return topology;
+}
+
+#endif
+
+}  // anonymous namespace
+
+std::vector<uint32_t> ParseCPUList(const std::string& text) {
+    std::vector<uint32_t> cpus;
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = text.find(',', begin);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        const std::string range = text.substr(begin, end - begin);
+        unsigned first = 0;
+        unsigned last = 0;
+        const int fieldCount = sscanf(range.c_str(), "%u-%u", &first, &last);
+        if (fieldCount == 1) {
+            last = first;
+        }
+        if (fieldCount >= 1) {
+            for (unsigned cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        begin = end + 1;
+    }
+    return cpus;
+}
+
+uint32_t CPUTopology::GetProcessorCount() const {
+    uint32_t count = 0;
+    for (const NumaNode& node : nodes) {
+        count += static_cast<uint32_t>(node.processors.size());
+    }
+    return count;
+}
+
+CPUTopology DetectCPUTopology() {
+    CPUTopology topology = DetectNumaNodes();
+    if (topology.nodes.empty()) {
+        return GetSingleNodeTopology();
+    }
+    return topology;
+}
+
+bool PinCurrentThread(const LogicalProcessor& processor) {
+#ifdef _WIN32
+    GROUP_AFFINITY affinity = {};
+    affinity.Group = processor.group;
+    affinity.Mask = KAFFINITY(1) << processor.number;
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != FALSE;
+#else
+    if (processor.number >= CPU_SETSIZE) {
+        return false;
+    }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(processor.number, &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#endif
+}
+
+void PrintCPUTopology(const CPUTopology& topology) {
+    printf(
+        "CPU topology: %zu NUMA node(s), %u logical processors\n", topology.nodes.size(),
+        topology.GetProcessorCount());
+    for (const NumaNode& node : topology.nodes) {
+        printf("Node %u: %zu logical processors\n", node.id, node.processors.size());
+    }
+}
+
+uint64_t GetAvailableMemorySize() {
+#ifdef _WIN32
+    MEMORYSTATUSEX status = {};
+    status.dwLength = sizeof(status);
+    if (!GlobalMemoryStatusEx(&status)) {
+        return 0;
+    }
+    return status.ullAvailPhys;
+#else
+    const long pageCount = sysconf(_SC_AVPHYS_PAGES);
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    if (pageCount <= 0 || pageSize <= 0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(pageCount) * static_cast<uint64_t>(pageSize);
+#endif
+}
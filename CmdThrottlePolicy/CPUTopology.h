@@ -0,0 +1,71 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+
+#ifndef CPU_TOPOLOGY_
+#define CPU_TOPOLOGY_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A logical processor, identified the way the OS pins threads: a processor group and a number in
+// the group on Windows, and the CPU number in group 0 on Linux.
+struct LogicalProcessor {
+    uint16_t group;
+    uint32_t number;
+};
+
+struct NumaNode {
+    uint32_t id;
+    std::vector<LogicalProcessor> processors;
+};
+
+struct CPUTopology {
+    // Only the nodes with processors the process is allowed to run on.
+    std::vector<NumaNode> nodes;
+
+    uint32_t GetProcessorCount() const;
+};
+
+// Detect the NUMA nodes and their logical processors, with GetLogicalProcessorInformationEx() on
+// Windows and from /sys/devices/system/node on Linux. Falls back to a single node of
+// std::thread::hardware_concurrency() processors.
+CPUTopology DetectCPUTopology();
+
+// Parse a list of CPUs or NUMA nodes like "0-3,8,10-11" as used by /sys/devices/system on Linux.
+// Ranges that don't parse are skipped.
+std::vector<uint32_t> ParseCPUList(const std::string& text);
+
+// Pin the calling thread to a logical processor. Returns false if the OS refused.
+bool PinCurrentThread(const LogicalProcessor& processor);
+
+void PrintCPUTopology(const CPUTopology& topology);
+
+// Returns the physical memory that is currently available, or 0 if it's unknown.
+uint64_t GetAvailableMemorySize();
+
+#endif
@@ -24,7 +24,22 @@
 //
 //*********************************************************
 
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <string>
+
+#include "BurstyWorkload.h"
+#include "CPUMatMul.h"
+#include "CooperativeMatMul.h"
 #include "D3D12MatMul.h"
+#include "HeapSuballocator.h"
+#include "PolicyComparison.h"
+#include "RegressionGate.h"
+#include "SelfTest.h"
+#include "SizeSweep.h"
+#include "StrassenMatMul.h"
+#include "Tracer.h"
 
 void PrintUsage() {
     printf("Supported command line parameters:\n");
@@ -35,12 +50,233 @@ void PrintUsage() {
     printf(
         "--check-gpu-result Do matrix multiplication on CPU and compare the result with the one on "
         "GPU.\n");
+    printf(
+        "--check-region <row> <column> <rows> <columns> Only read back and check this block of "
+        "the result, implies --check-gpu-result. A count of 0 extends it to the last row or "
+        "column.\n");
+    printf(
+        "--cpu-reference <naive|numa|strassen> How --check-gpu-result computes the result on CPU: "
+        "one dot product per element on one thread, partitioned across the NUMA nodes with a "
+        "thread pinned to each logical processor, or with Strassen-Winograd for the largest "
+        "shapes, with a tolerance widened by its error bound (default: naive).\n");
+    printf(
+        "--strassen-cutoff <size> The size below which --cpu-reference strassen uses the "
+        "classical multiplication, at least 32 (default: 256).\n");
+    printf(
+        "--warmup-iterations <count> Number of dispatches executed before the measured ones "
+        "(default: 10).\n");
+    printf(
+        "--serial-init Run the initialization stages one after the other instead of "
+        "overlapping the independent ones on several threads, to compare the time to first "
+        "dispatch.\n");
+    printf("--iterations <count> Number of measured dispatches (default: 100).\n");
+    printf(
+        "--time-budget-ms <milliseconds> Keep dispatching until this much time has elapsed "
+        "instead of running a fixed number of iterations.\n");
+    printf(
+        "--dispatches-per-submit <count> Number of timed dispatches recorded into one command "
+        "list (default: 10). Counts above 1024, the number of timestamp pairs the query ring "
+        "holds, are split across several command lists.\n");
+    printf(
+        "--frames-in-flight <count> Number of command lists that can be in flight on the GPU "
+        "while the next one is recorded (default: 3).\n");
+    printf(
+        "--prerecorded Also submit the iterations one by one from a pre-recorded command list "
+        "and compare the CPU time of each submit with recording a command list for it.\n");
+    printf(
+        "--job-table <count> Also run this many matrix multiplications of random shapes, first "
+        "recording each of them and then all at once with ExecuteIndirect.\n");
+    printf(
+        "--sweep-m <sizes>, --sweep-n <sizes>, --sweep-k <sizes> Also measure every combination "
+        "of these sizes, reusing the device, the pipeline and the buffers. A size list is comma "
+        "separated sizes or ranges like 64-4096*2 or 256-1024+256, missing dimensions are "
+        "1024. Sizes are rounded up to the tiling of the kernel, and shapes with a matrix larger "
+        "than the largest buffer of the device are skipped.\n");
+    printf(
+        "--sweep-preset <square|tall-skinny|short-wide|small-k> Also measure this family of "
+        "shapes for each of the --sweep-sizes. Can be repeated.\n");
+    printf("--sweep-sizes <sizes> The sizes of --sweep-preset (default: 64-4096*2).\n");
+    printf("--sweep-csv <file> Write the GFLOPS and bandwidth of every size of the sweep.\n");
+    printf(
+        "--streaming-jobs <count> Also run this many jobs that upload their inputs and read back "
+        "their output on a copy queue, with and without overlapping the transfers with the "
+        "computation.\n");
+    printf(
+        "--async-jobs <count> Also submit this many multiplications from one thread, waiting for "
+        "each of them and then keeping them in flight with completion callbacks.\n");
+    printf(
+        "--service-requests <count> Also submit this many small requests of random shapes to a "
+        "matrix multiplication service from several client threads, without and with dynamic "
+        "batching.\n");
+    printf("--service-clients <count> Number of client threads of the service (default: 8).\n");
+    printf(
+        "--service-max-delay-us <microseconds> How long a request can wait for a batch "
+        "(default: 500).\n");
+    printf(
+        "--cooperative Also split the rows of the multiplication between the GPU and the CPU, "
+        "adapting the split to their throughput, and compare with the GPU alone.\n");
+    printf(
+        "--cooperative-iterations <count> Number of iterations of --cooperative (default: "
+        "20).\n");
+    printf(
+        "--results-file <file> Write the metadata of the run, every timing and the verification "
+        "summary to this file.\n");
+    printf(
+        "--results-format <json|csv|csv-rows> The format of --results-file (default: json). "
+        "csv-rows leaves out the CSV header row.\n");
+    printf(
+        "--trace-file <file> Write the time spent in each stage on the CPU and the GPU time of "
+        "the measured iterations as a Chrome trace, for chrome://tracing or Perfetto.\n");
+    printf(
+        "--baseline-file <file> Compare the timings with the baseline of the same device, driver, "
+        "throttle policy and shape in this file, or with the most recent one of another driver, "
+        "and exit with 1 if they significantly regressed.\n");
+    printf("--update-baseline Replace the baseline of this run in --baseline-file with it.\n");
+    printf("--require-baseline Exit with 1 if a run has no baseline with any driver.\n");
+    printf(
+        "--regression-significance <p-value> The p-value of the Mann-Whitney U test below which "
+        "the timings differ from the baseline (default: 0.01).\n");
+    printf(
+        "--regression-threshold <percent> The change of the median time below which a "
+        "significant difference is still ignored (default: 3).\n");
+    printf(
+        "--compare-policies Interleave randomized trials on one queue with the DYNAMIC and one "
+        "with the MAX_PERFORMANCE command throttle policy and compare their distributions.\n");
+    printf(
+        "--simulate Run --compare-policies and --priority-scheduling against a simulated GPU "
+        "instead of the real one, and --service-requests and --cooperative on the CPU.\n");
+    printf("--policy-trials <count> Number of trials per throttle policy (default: 20).\n");
+    printf("--dispatches-per-trial <count> Number of dispatches in each trial (default: 20).\n");
+    printf(
+        "--idle-between-trials-ms <milliseconds> Idle time before each trial (default: 100).\n");
+    printf(
+        "--bursty Issue bursts of dispatches separated by idle gaps with each throttle policy and "
+        "print the latency against the idle time before the bursts.\n");
+    printf(
+        "--gap-distribution <fixed|poisson|trace> How the idle gaps are generated with --bursty "
+        "(default: poisson).\n");
+    printf("--gap-ms <milliseconds> The fixed or mean idle gap with --bursty (default: 10).\n");
+    printf(
+        "--gap-trace <file> A file with one idle gap in milliseconds per line, implies "
+        "--gap-distribution trace.\n");
+    printf("--bursts <count> Number of bursts per throttle policy (default: 100).\n");
+    printf("--burst-length <count> Number of dispatches in each burst (default: 1).\n");
+    printf(
+        "--submission-rate <hz> Rate at which the dispatches of a burst are submitted (default: "
+        "0, back to back).\n");
+    printf(
+        "--priority-scheduling Run latency-critical jobs and background jobs once on one shared "
+        "queue and once on a HIGH priority MAX_PERFORMANCE queue and a NORMAL priority DYNAMIC "
+        "queue, and print the latency of each class.\n");
+    printf(
+        "--critical-interval-ms <milliseconds> The mean interval between the latency-critical "
+        "jobs with --priority-scheduling (default: 20).\n");
+    printf(
+        "--shader-cache-dir <directory> Directory of the shader bytecode and pipeline state cache "
+        "(default: ShaderCache).\n");
+    printf("--disable-shader-cache Always compile the shader and the pipeline state.\n");
+    printf(
+        "--benchmark-heap-allocator Benchmark the placed buffer heap sub-allocator on the host, "
+        "without any GPU.\n");
+    printf(
+        "--benchmark-cpu-matmul <size> Multiply size x size matrices on the CPU with 1 to all of "
+        "the NUMA nodes and print the scaling, without any GPU.\n");
+    printf(
+        "--benchmark-strassen <size> Multiply size x size matrices on the CPU with the classical "
+        "multiplication and with Strassen-Winograd at several cutoffs, without any GPU.\n");
+    printf(
+        "--self-test Check the host-side logic of the benchmarks against known results, the "
+        "simulated GPU and the CPU, without any GPU, and exit with 1 if a check fails.\n");
     printf("-h Print helper information.\n");
 }
 
+// Returns the D3D12MatMul to run the throttle policy trials on, or nullptr when they have to run on
+// the simulated GPU because simulate is set or there is no GPU with the Command Throttle Policy
+// Extension.
+std::unique_ptr<D3D12MatMul> CreatePolicyTrialMatMul(const Settings& settings, bool simulate) {
+    if (simulate) {
+        return nullptr;
+    }
+    try {
+        std::unique_ptr<D3D12MatMul> matMul = std::make_unique<D3D12MatMul>(settings);
+        if (matMul->HasThrottlePolicyExtension()) {
+            return matMul;
+        }
+        printf(
+            "The Command Throttle Policy Extension is not available, falling back to the "
+            "simulated GPU.\n\n");
+    } catch (const std::exception& e) {
+        printf(
+            "Failed to initialize D3D12 (%s), falling back to the simulated GPU.\n\n", e.what());
+    }
+    return nullptr;
+}
+
+bool ParseUInt32(const char* text, uint32_t* value) {
+    char* end = nullptr;
+    unsigned long parsed = strtoul(text, &end, 10);
+    if (end == text || *end != '\0' || parsed > UINT32_MAX) {
+        return false;
+    }
+    *value = static_cast<uint32_t>(parsed);
+    return true;
+}
+
+bool ParseDouble(const char* text, double* value) {
+    char* end = nullptr;
+    double parsed = strtod(text, &end);
+    if (end == text || *end != '\0' || parsed < 0.0) {
+        return false;
+    }
+    *value = parsed;
+    return true;
+}
+
+void WriteTraceFile(const std::string& path) {
+    if (!path.empty() && WriteChromeTrace(path)) {
+        printf("The trace was written to %s.\n", path.c_str());
+    }
+}
+
 int main(int argc, char* argv[]) {
     bool checkGPUResult = false;
+    uint32_t checkRegionRow = 0;
+    uint32_t checkRegionColumn = 0;
+    uint32_t checkRegionRowCount = 0;
+    uint32_t checkRegionColumnCount = 0;
+    bool comparePolicies = false;
+    bool simulate = false;
+    bool bursty = false;
+    bool priorityScheduling = false;
+    double criticalIntervalMs = 20.0;
+    bool benchmarkHeapAllocator = false;
+    bool selfTest = false;
+    uint32_t cpuMatMulBenchmarkSize = 0;
+    uint32_t strassenBenchmarkSize = 0;
+    uint32_t strassenCutoff = kDefaultStrassenCutoff;
+    bool prerecorded = false;
+    double gapMs = 10.0;
+    uint32_t submissionRateHz = 0;
+    uint32_t streamingJobCount = 0;
+    uint32_t asyncJobCount = 0;
+    uint32_t serviceRequestCount = 0;
+    MatMulServiceBenchmarkSettings serviceSettings;
+    bool cooperative = false;
+    CooperativeMatMulSettings cooperativeSettings;
+    uint32_t jobTableCount = 0;
+    std::string resultsFile;
+    ResultsFormat resultsFormat = ResultsFormat::JSON;
+    SizeSweepDesc sweepDesc = {};
+    std::string sweepCSVFile;
+    std::string traceFile;
+    std::string baselineFile;
+    bool updateBaseline = false;
+    double regressionThresholdPercent = 3.0;
+    RegressionSettings regressionSettings = {};
+    uint32_t idleBetweenTrialsMs = 100;
     Settings settings = {};
+    PolicyComparisonSettings comparisonSettings = {};
+    BurstyWorkloadSettings burstySettings = {};
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "-h") == 0) {
             PrintUsage();
@@ -49,6 +285,158 @@ int main(int argc, char* argv[]) {
             settings.disableCommandThrottlePolicyExtension = true;
         } else if (strcmp(argv[i], "--check-gpu-result") == 0) {
             checkGPUResult = true;
+        } else if (strcmp(argv[i], "--check-region") == 0 && i + 4 < argc &&
+                   ParseUInt32(argv[i + 1], &checkRegionRow) &&
+                   ParseUInt32(argv[i + 2], &checkRegionColumn) &&
+                   ParseUInt32(argv[i + 3], &checkRegionRowCount) &&
+                   ParseUInt32(argv[i + 4], &checkRegionColumnCount)) {
+            checkGPUResult = true;
+            i += 4;
+        } else if (strcmp(argv[i], "--cpu-reference") == 0 && i + 1 < argc &&
+                   ParseCPUReference(argv[i + 1], &settings.cpuReference)) {
+            ++i;
+        } else if (strcmp(argv[i], "--strassen-cutoff") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &strassenCutoff) &&
+                   strassenCutoff >= kMinStrassenCutoff && strassenCutoff <= INT32_MAX) {
+            ++i;
+        } else if (strcmp(argv[i], "--serial-init") == 0) {
+            settings.parallelInitialization = false;
+        } else if (strcmp(argv[i], "--warmup-iterations") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &settings.warmupIterations)) {
+            ++i;
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &settings.iterations)) {
+            ++i;
+        } else if (strcmp(argv[i], "--time-budget-ms") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &settings.timeBudgetMs)) {
+            ++i;
+        } else if (strcmp(argv[i], "--dispatches-per-submit") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &settings.dispatchesPerSubmit)) {
+            ++i;
+        } else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &settings.framesInFlight)) {
+            ++i;
+        } else if (strcmp(argv[i], "--prerecorded") == 0) {
+            prerecorded = true;
+        } else if (strcmp(argv[i], "--job-table") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &jobTableCount)) {
+            ++i;
+        } else if (strcmp(argv[i], "--sweep-m") == 0 && i + 1 < argc &&
+                   ParseSizeList(argv[i + 1], &sweepDesc.m)) {
+            ++i;
+        } else if (strcmp(argv[i], "--sweep-n") == 0 && i + 1 < argc &&
+                   ParseSizeList(argv[i + 1], &sweepDesc.n)) {
+            ++i;
+        } else if (strcmp(argv[i], "--sweep-k") == 0 && i + 1 < argc &&
+                   ParseSizeList(argv[i + 1], &sweepDesc.k)) {
+            ++i;
+        } else if (strcmp(argv[i], "--sweep-preset") == 0 && i + 1 < argc) {
+            SweepPreset preset;
+            if (!ParseSweepPreset(argv[i + 1], &preset)) {
+                printf("Unsupported sweep preset: %s\n\n", argv[i + 1]);
+                PrintUsage();
+                return 0;
+            }
+            sweepDesc.presets.push_back(preset);
+            ++i;
+        } else if (strcmp(argv[i], "--sweep-sizes") == 0 && i + 1 < argc &&
+                   ParseSizeList(argv[i + 1], &sweepDesc.presetSizes)) {
+            ++i;
+        } else if (strcmp(argv[i], "--sweep-csv") == 0 && i + 1 < argc) {
+            sweepCSVFile = argv[++i];
+        } else if (strcmp(argv[i], "--results-file") == 0 && i + 1 < argc) {
+            resultsFile = argv[++i];
+        } else if (strcmp(argv[i], "--results-format") == 0 && i + 1 < argc &&
+                   ParseResultsFormat(argv[i + 1], &resultsFormat)) {
+            ++i;
+        } else if (strcmp(argv[i], "--trace-file") == 0 && i + 1 < argc) {
+            traceFile = argv[++i];
+        } else if (strcmp(argv[i], "--baseline-file") == 0 && i + 1 < argc) {
+            baselineFile = argv[++i];
+        } else if (strcmp(argv[i], "--update-baseline") == 0) {
+            updateBaseline = true;
+        } else if (strcmp(argv[i], "--require-baseline") == 0) {
+            regressionSettings.requireBaseline = true;
+        } else if (strcmp(argv[i], "--regression-significance") == 0 && i + 1 < argc &&
+                   ParseDouble(argv[i + 1], &regressionSettings.significance)) {
+            ++i;
+        } else if (strcmp(argv[i], "--regression-threshold") == 0 && i + 1 < argc &&
+                   ParseDouble(argv[i + 1], &regressionThresholdPercent)) {
+            ++i;
+        } else if (strcmp(argv[i], "--streaming-jobs") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &streamingJobCount)) {
+            ++i;
+        } else if (strcmp(argv[i], "--async-jobs") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &asyncJobCount)) {
+            ++i;
+        } else if (strcmp(argv[i], "--cooperative") == 0) {
+            cooperative = true;
+        } else if (strcmp(argv[i], "--cooperative-iterations") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &cooperativeSettings.cooperativeIterations)) {
+            ++i;
+        } else if (strcmp(argv[i], "--service-requests") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &serviceRequestCount)) {
+            ++i;
+        } else if (strcmp(argv[i], "--service-clients") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &serviceSettings.clientCount)) {
+            ++i;
+        } else if (strcmp(argv[i], "--service-max-delay-us") == 0 && i + 1 < argc &&
+                   ParseDouble(argv[i + 1], &serviceSettings.service.maxBatchDelayUS)) {
+            ++i;
+        } else if (strcmp(argv[i], "--shader-cache-dir") == 0 && i + 1 < argc) {
+            settings.shaderCacheDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--disable-shader-cache") == 0) {
+            settings.shaderCacheDirectory.clear();
+        } else if (strcmp(argv[i], "--benchmark-heap-allocator") == 0) {
+            benchmarkHeapAllocator = true;
+        } else if (strcmp(argv[i], "--self-test") == 0) {
+            selfTest = true;
+        } else if (strcmp(argv[i], "--benchmark-cpu-matmul") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &cpuMatMulBenchmarkSize) &&
+                   cpuMatMulBenchmarkSize > 0 && cpuMatMulBenchmarkSize <= INT32_MAX) {
+            ++i;
+        } else if (strcmp(argv[i], "--benchmark-strassen") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &strassenBenchmarkSize) &&
+                   strassenBenchmarkSize > 0 && strassenBenchmarkSize <= INT32_MAX) {
+            ++i;
+        } else if (strcmp(argv[i], "--compare-policies") == 0) {
+            comparePolicies = true;
+        } else if (strcmp(argv[i], "--simulate") == 0) {
+            simulate = true;
+        } else if (strcmp(argv[i], "--policy-trials") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &comparisonSettings.trialsPerPolicy)) {
+            ++i;
+        } else if (strcmp(argv[i], "--dispatches-per-trial") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &comparisonSettings.dispatchesPerTrial)) {
+            ++i;
+        } else if (strcmp(argv[i], "--idle-between-trials-ms") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &idleBetweenTrialsMs)) {
+            ++i;
+        } else if (strcmp(argv[i], "--bursty") == 0) {
+            bursty = true;
+        } else if (strcmp(argv[i], "--gap-distribution") == 0 && i + 1 < argc &&
+                   ParseGapDistribution(argv[i + 1], &burstySettings.gapDistribution)) {
+            ++i;
+        } else if (strcmp(argv[i], "--gap-ms") == 0 && i + 1 < argc &&
+                   ParseDouble(argv[i + 1], &gapMs)) {
+            ++i;
+        } else if (strcmp(argv[i], "--gap-trace") == 0 && i + 1 < argc) {
+            burstySettings.gapDistribution = GapDistribution::Trace;
+            burstySettings.traceFile = argv[++i];
+        } else if (strcmp(argv[i], "--bursts") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &burstySettings.burstCount)) {
+            ++i;
+        } else if (strcmp(argv[i], "--burst-length") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &burstySettings.burstLength)) {
+            ++i;
+        } else if (strcmp(argv[i], "--submission-rate") == 0 && i + 1 < argc &&
+                   ParseUInt32(argv[i + 1], &submissionRateHz)) {
+            ++i;
+        } else if (strcmp(argv[i], "--priority-scheduling") == 0) {
+            priorityScheduling = true;
+        } else if (strcmp(argv[i], "--critical-interval-ms") == 0 && i + 1 < argc &&
+                   ParseDouble(argv[i + 1], &criticalIntervalMs)) {
+            ++i;
         } else {
             printf("Unsupported command line parameter: %s\n\n", argv[i]);
             PrintUsage();
@@ -56,12 +444,156 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    settings.keepInputData = checkGPUResult;
+    settings.strassenCutoff = static_cast<int32_t>(strassenCutoff);
+
+    // Enabled before anything is created so that the trace also shows the initialization.
+    if (!traceFile.empty()) {
+        EnableTracing();
+    }
+
+    if (selfTest) {
+        return RunSelfTest() ? 0 : 1;
+    }
+
+    if (benchmarkHeapAllocator) {
+        BenchmarkHeapSuballocator(1000000, 1);
+        return 0;
+    }
+
+    if (cpuMatMulBenchmarkSize > 0) {
+        BenchmarkNumaMatMulScaling(
+            DetectCPUTopology(), static_cast<int32_t>(cpuMatMulBenchmarkSize), 5);
+        WriteTraceFile(traceFile);
+        return 0;
+    }
+
+    if (strassenBenchmarkSize > 0) {
+        BenchmarkStrassenCutoffs(static_cast<int32_t>(strassenBenchmarkSize));
+        WriteTraceFile(traceFile);
+        return 0;
+    }
+
+    if (comparePolicies || bursty || priorityScheduling) {
+        // 2 * M * N * K of the 1024x1024x1024 matrix multiplication done by D3D12MatMul.
+        constexpr double kFlopsPerDispatch = 2.0 * 1024.0 * 1024.0 * 1024.0;
+
+        std::unique_ptr<D3D12MatMul> matMul = CreatePolicyTrialMatMul(settings, simulate);
+        std::unique_ptr<PolicyTrialExecutor> executor;
+        if (matMul != nullptr) {
+            executor = std::make_unique<D3D12PolicyTrialExecutor>(matMul.get());
+        } else {
+            executor = std::make_unique<SimulatedPolicyTrialExecutor>(
+                SimulatedGPUDesc(), kFlopsPerDispatch);
+        }
+
+        if (comparePolicies) {
+            comparisonSettings.idleBetweenTrialsUS = idleBetweenTrialsMs * 1000.0;
+            ComparePolicies(executor.get(), comparisonSettings);
+        }
+        if (bursty) {
+            burstySettings.gapUS = gapMs * 1000.0;
+            burstySettings.submissionRateHz = submissionRateHz;
+            PrintLatencyVsGap(RunBurstyWorkload(executor.get(), burstySettings));
+        }
+        if (priorityScheduling) {
+            std::unique_ptr<MultiQueueExecutor> multiQueueExecutor;
+            if (matMul != nullptr) {
+                multiQueueExecutor = std::make_unique<D3D12MultiQueueExecutor>(matMul.get());
+            } else {
+                multiQueueExecutor = std::make_unique<SimulatedMultiQueueExecutor>(
+                    SimulatedGPUDesc(), kFlopsPerDispatch);
+            }
+            PriorityWorkloadSettings workload;
+            workload.criticalIntervalUS = criticalIntervalMs * 1000.0;
+            ComparePriorityScheduling(
+                multiQueueExecutor.get(), PrioritySchedulerSettings(), workload);
+        }
+        WriteTraceFile(traceFile);
+        return 0;
+    }
+
+    serviceSettings.requestCount = serviceRequestCount;
+    if (simulate && (serviceRequestCount > 0 || cooperative)) {
+        if (serviceRequestCount > 0) {
+            CPUMatMulBatchExecutor executor;
+            RunMatMulServiceBenchmark(&executor, serviceSettings);
+        }
+        bool passed = true;
+        if (cooperative) {
+            passed = SimulateCooperativeMatMul(1024, cooperativeSettings);
+        }
+        WriteTraceFile(traceFile);
+        return passed ? 0 : 1;
+    }
+
     D3D12MatMul matMul(settings);
 
     matMul.DoMatMul();
 
+    if (prerecorded) {
+        matMul.DoPrerecordedMatMul();
+    }
+
+    if (jobTableCount > 0) {
+        matMul.DoJobTableMatMul(jobTableCount);
+    }
+
+    // Every size of the sweep is also checked by the regression gate.
+    std::vector<BenchmarkResults> gatedRuns;
+    if (!sweepDesc.presets.empty() && sweepDesc.presetSizes.empty()) {
+        ParseSizeList("64-4096*2", &sweepDesc.presetSizes);
+    }
+    const std::vector<MatMulShape> sweepShapes =
+        BuildSweepShapes(sweepDesc, matMul.GetTiling(), matMul.GetMaxBufferSize());
+    if (!sweepShapes.empty()) {
+        const std::vector<SweepPointResult> points = matMul.DoSizeSweep(sweepShapes, &gatedRuns);
+        if (!sweepCSVFile.empty() && WriteSweepCSV(sweepCSVFile, points)) {
+            printf("The size sweep was written to %s.\n\n", sweepCSVFile.c_str());
+        }
+    }
+
+    if (streamingJobCount > 0) {
+        matMul.DoStreamingMatMul(streamingJobCount);
+    }
+
+    if (asyncJobCount > 0) {
+        matMul.DoAsyncMatMul(asyncJobCount);
+    }
+
+    if (serviceRequestCount > 0) {
+        D3D12MatMulBatchExecutor executor(&matMul);
+        RunMatMulServiceBenchmark(&executor, serviceSettings);
+    }
+
+    if (cooperative) {
+        matMul.DoCooperativeMatMul(cooperativeSettings);
+    }
+
     if (checkGPUResult) {
-        matMul.CheckGPUResult();
+        MatrixRegion region;
+        region.row = static_cast<int32_t>(std::min<uint32_t>(checkRegionRow, INT32_MAX));
+        region.column = static_cast<int32_t>(std::min<uint32_t>(checkRegionColumn, INT32_MAX));
+        region.rowCount = static_cast<int32_t>(std::min<uint32_t>(checkRegionRowCount, INT32_MAX));
+        region.columnCount =
+            static_cast<int32_t>(std::min<uint32_t>(checkRegionColumnCount, INT32_MAX));
+        matMul.CheckGPUResult(region);
+    }
+
+    if (!resultsFile.empty() && WriteResults(resultsFile, resultsFormat, matMul.GetResults())) {
+        printf("The results were written to %s.\n", resultsFile.c_str());
+    }
+
+    WriteTraceFile(traceFile);
+
+    if (!baselineFile.empty()) {
+        regressionSettings.minRelativeChange = regressionThresholdPercent / 100.0;
+        gatedRuns.insert(gatedRuns.begin(), matMul.GetResults());
+        if (!RunRegressionGate(baselineFile, gatedRuns, updateBaseline, regressionSettings)) {
+            return 1;
+        }
+    } else if (updateBaseline) {
+        printf("WARNING: --update-baseline requires --baseline-file.\n");
     }
 
     return 0;
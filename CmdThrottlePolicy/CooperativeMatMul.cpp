@@ -0,0 +1,240 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+
+#include "CooperativeMatMul.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <future>
+#include <random>
+#include <thread>
+
+#include "BenchmarkStatistics.h"
+#include "CPUMatMul.h"
+#include "Tracer.h"
+
+namespace {
+
+double GetMedian(const std::vector<double>& samples) {
+    return Summarize(samples).median;
+}
+
+}  // anonymous namespace
+
+CPURowRangeExecutor::CPURowRangeExecutor(
+    const char* name,
+    int32_t n,
+    int32_t k,
+    const float* inputMatrix1,
+    const float* inputMatrix2,
+    float* outputMatrix,
+    uint32_t threadCount,
+    uint32_t slowdown)
+    : mName(name),
+      mN(n),
+      mK(k),
+      mInputMatrix1(inputMatrix1),
+      mInputMatrix2(inputMatrix2),
+      mOutputMatrix(outputMatrix),
+      mThreadCount(std::max(1u, threadCount)),
+      mSlowdown(std::max(1u, slowdown)) {
+}
+
+const char* CPURowRangeExecutor::GetName() const {
+    return mName;
+}
+
+double CPURowRangeExecutor::MultiplyRows(int32_t firstRow, int32_t rowCount) {
+    TRACE_SCOPE("CPURowRangeExecutor::MultiplyRows");
+    const auto start = std::chrono::steady_clock::now();
+    auto multiply = [&](uint32_t thread) {
+        const int32_t begin =
+            firstRow + static_cast<int32_t>(int64_t(rowCount) * thread / mThreadCount);
+        const int32_t end =
+            firstRow + static_cast<int32_t>(int64_t(rowCount) * (thread + 1) / mThreadCount);
+        for (uint32_t i = 0; i < mSlowdown; ++i) {
+            MultiplyMatricesBlocked(
+                end - begin, mN, mK, mInputMatrix1 + size_t(begin) * mK, mK, mInputMatrix2, mN,
+                mOutputMatrix + size_t(begin) * mN, mN);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (uint32_t thread = 1; thread < mThreadCount; ++thread) {
+        threads.emplace_back(multiply, thread);
+    }
+    multiply(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+RowPartitioner::RowPartitioner(
+    int32_t rowCount,
+    int32_t rowBlockSize,
+    double initialFraction,
+    double smoothing)
+    : mRowCount(rowCount),
+      mRowBlockSize(std::max(1, rowBlockSize)),
+      mFraction(std::min(std::max(initialFraction, 0.0), 1.0)),
+      mSmoothing(std::min(std::max(smoothing, 0.0), 1.0)) {
+    UpdateSplitRow();
+}
+
+int32_t RowPartitioner::GetSplitRow() const {
+    return mSplitRow;
+}
+
+double RowPartitioner::GetFraction() const {
+    return mFraction;
+}
+
+void RowPartitioner::Update(double firstTimeS, double secondTimeS) {
+    const int32_t firstRowCount = mSplitRow;
+    const int32_t secondRowCount = mRowCount - mSplitRow;
+    if (firstRowCount == 0 || secondRowCount == 0 || firstTimeS <= 0.0 || secondTimeS <= 0.0) {
+        return;
+    }
+    // Both executors finish at the same time when each gets rows in proportion to its rate.
+    const double firstRate = firstRowCount / firstTimeS;
+    const double secondRate = secondRowCount / secondTimeS;
+    const double balancedFraction = firstRate / (firstRate + secondRate);
+    mFraction = (1.0 - mSmoothing) * mFraction + mSmoothing * balancedFraction;
+    UpdateSplitRow();
+}
+
+void RowPartitioner::UpdateSplitRow() {
+    const int32_t blockCount = (mRowCount + mRowBlockSize - 1) / mRowBlockSize;
+    if (blockCount < 2) {
+        mSplitRow = mRowCount;
+        return;
+    }
+    const int32_t firstBlockCount = std::min(
+        std::max(static_cast<int32_t>(std::lround(mFraction * blockCount)), 1), blockCount - 1);
+    mSplitRow = firstBlockCount * mRowBlockSize;
+}
+
+CooperativeMatMulResult RunCooperativeMatMul(
+    RowRangeExecutor* first,
+    RowRangeExecutor* second,
+    int32_t rowCount,
+    double flops,
+    const CooperativeMatMulSettings& settings) {
+    TRACE_SCOPE("RunCooperativeMatMul");
+    CooperativeMatMulResult result;
+
+    std::vector<double> singleTimesS;
+    for (uint32_t i = 0; i < std::max(1u, settings.singleIterations); ++i) {
+        singleTimesS.push_back(first->MultiplyRows(0, rowCount));
+    }
+    result.singleTimeS = GetMedian(singleTimesS);
+    printf(
+        "%s only: %.2f ms (%.2f GFLOPS)\n", first->GetName(), result.singleTimeS * 1e3,
+        flops / result.singleTimeS * 1e-9);
+
+    RowPartitioner partitioner(
+        rowCount, settings.rowBlockSize, settings.initialFraction, settings.smoothing);
+    printf(
+        "%-10s%10s%10s%14s%14s%12s\n", "Iteration", first->GetName(), second->GetName(),
+        "Time 1 (ms)", "Time 2 (ms)", "Wall (ms)");
+    std::vector<double> cooperativeTimesS;
+    for (uint32_t i = 0; i < std::max(1u, settings.cooperativeIterations); ++i) {
+        const int32_t splitRow = partitioner.GetSplitRow();
+        const auto start = std::chrono::steady_clock::now();
+        // The second executor runs on a thread of its own while the first one runs on this one.
+        std::future<double> secondTimeS = std::async(std::launch::async, [&] {
+            return splitRow < rowCount ? second->MultiplyRows(splitRow, rowCount - splitRow)
+                                       : 0.0;
+        });
+        const double firstTimeS = splitRow > 0 ? first->MultiplyRows(0, splitRow) : 0.0;
+        const double secondTime = secondTimeS.get();
+        const double wallTimeS =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        cooperativeTimesS.push_back(wallTimeS);
+        result.splitRow = splitRow;
+        printf(
+            "%-10u%10d%10d%14.2f%14.2f%12.2f\n", i, splitRow, rowCount - splitRow,
+            firstTimeS * 1e3, secondTime * 1e3, wallTimeS * 1e3);
+        partitioner.Update(firstTimeS, secondTime);
+    }
+
+    result.cooperativeTimeS = GetMedian(std::vector<double>(
+        cooperativeTimesS.begin() + cooperativeTimesS.size() / 2, cooperativeTimesS.end()));
+    result.fraction = partitioner.GetFraction();
+    printf(
+        "%s and %s: %.2f ms (%.2f GFLOPS), %.2fx %s only, %.0f%% of the rows on %s\n\n",
+        first->GetName(), second->GetName(), result.cooperativeTimeS * 1e3,
+        flops / result.cooperativeTimeS * 1e-9, result.singleTimeS / result.cooperativeTimeS,
+        first->GetName(), result.fraction * 100.0, first->GetName());
+    return result;
+}
+
+bool SimulateCooperativeMatMul(int32_t size, const CooperativeMatMulSettings& settings) {
+    TRACE_SCOPE("SimulateCooperativeMatMul");
+    const size_t elementCount = size_t(size) * size;
+    std::vector<float> inputMatrix1(elementCount);
+    std::vector<float> inputMatrix2(elementCount);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    for (size_t i = 0; i < elementCount; ++i) {
+        inputMatrix1[i] = distribution(random);
+        inputMatrix2[i] = distribution(random);
+    }
+
+    // Half of the processors each, so that the two executors don't compete for them.
+    const uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency() / 2);
+    std::vector<float> output(elementCount);
+    CPURowRangeExecutor fast(
+        "Fast", size, size, inputMatrix1.data(), inputMatrix2.data(), output.data(),
+        threadCount);
+    CPURowRangeExecutor slow(
+        "Slow", size, size, inputMatrix1.data(), inputMatrix2.data(), output.data(), threadCount,
+        3);
+    printf(
+        "Cooperative %dx%d multiplication on two CPU executors of %u threads, the second one 3 "
+        "times slower:\n",
+        size, size, threadCount);
+    RunCooperativeMatMul(&fast, &slow, size, 2.0 * size * size * size, settings);
+
+    // Both executors sum the products in the same order, so the merged output is exact.
+    std::vector<float> reference(elementCount);
+    MultiplyMatricesBlocked(
+        size, size, size, inputMatrix1.data(), size, inputMatrix2.data(), size, reference.data(),
+        size);
+    size_t mismatchCount = 0;
+    for (size_t i = 0; i < elementCount; ++i) {
+        mismatchCount += output[i] != reference[i];
+    }
+    if (mismatchCount > 0) {
+        printf("ERROR: %zu elements of the merged output are wrong.\n\n", mismatchCount);
+        return false;
+    }
+    printf("The merged output is the same as the one of a single executor.\n\n");
+    return true;
+}
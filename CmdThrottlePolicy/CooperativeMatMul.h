@@ -0,0 +1,141 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+
+#ifndef COOPERATIVE_MAT_MUL_
+#define COOPERATIVE_MAT_MUL_
+
+#include <cstdint>
+#include <vector>
+
+// Computes ranges of rows of one matrix multiplication into an output shared with the other
+// executors, on the GPU or on the CPU.
+class RowRangeExecutor {
+public:
+    virtual ~RowRangeExecutor() = default;
+
+    virtual const char* GetName() const = 0;
+
+    // Compute rows [firstRow, firstRow + rowCount) of the output, write them to the shared output
+    // and return the wall time it took in seconds. Called concurrently with the other executors.
+    virtual double MultiplyRows(int32_t firstRow, int32_t rowCount) = 0;
+};
+
+// Multiplies the rows with MultiplyMatricesBlocked() on threadCount threads, straight into the
+// shared output. Every row is multiplied slowdown times, to stand for a slower device.
+class CPURowRangeExecutor : public RowRangeExecutor {
+public:
+    // inputMatrix1 has k columns, and inputMatrix2 and outputMatrix have n columns.
+    CPURowRangeExecutor(
+        const char* name,
+        int32_t n,
+        int32_t k,
+        const float* inputMatrix1,
+        const float* inputMatrix2,
+        float* outputMatrix,
+        uint32_t threadCount,
+        uint32_t slowdown = 1);
+
+    const char* GetName() const override;
+    double MultiplyRows(int32_t firstRow, int32_t rowCount) override;
+
+private:
+    const char* mName;
+    int32_t mN;
+    int32_t mK;
+    const float* mInputMatrix1;
+    const float* mInputMatrix2;
+    float* mOutputMatrix;
+    uint32_t mThreadCount;
+    uint32_t mSlowdown;
+};
+
+// Splits rows, in blocks, between two executors so that they take the same time. The first
+// executor gets the rows before the split and the second one the rows after it, so only the last
+// block of the second one can be partial.
+class RowPartitioner {
+public:
+    // smoothing is the weight of the last measurement when the split is updated.
+    RowPartitioner(
+        int32_t rowCount,
+        int32_t rowBlockSize,
+        double initialFraction,
+        double smoothing);
+
+    int32_t GetSplitRow() const;
+    // The fraction of the rows given to the first executor, before rounding to blocks.
+    double GetFraction() const;
+
+    // Move the split toward the rows each executor does in the same time, from the times they
+    // took for their rows at the current split. Each of them keeps at least one block, so that
+    // both can still be measured.
+    void Update(double firstTimeS, double secondTimeS);
+
+private:
+    void UpdateSplitRow();
+
+    int32_t mRowCount;
+    int32_t mRowBlockSize;
+    double mFraction;
+    double mSmoothing;
+    int32_t mSplitRow = 0;
+};
+
+struct CooperativeMatMulSettings {
+    // The iterations on the first executor alone, to compare with.
+    uint32_t singleIterations = 5;
+    uint32_t cooperativeIterations = 20;
+    // The first executor is given multiples of this many rows, the tile of the GPU kernel.
+    int32_t rowBlockSize = 64;
+    double initialFraction = 0.5;
+    double smoothing = 0.5;
+};
+
+struct CooperativeMatMulResult {
+    // The median wall time of an iteration on the first executor alone, and on both of them over
+    // the second half of the cooperative iterations, once the split has settled.
+    double singleTimeS = 0.0;
+    double cooperativeTimeS = 0.0;
+    // The fraction of the rows given to the first executor at the end.
+    double fraction = 0.0;
+    // The split of the last iteration, which produced the output.
+    int32_t splitRow = 0;
+};
+
+// Run the multiplication of rowCount rows on the first executor alone, and then on both executors
+// concurrently with the split adapted after every iteration, and print the throughput of both.
+CooperativeMatMulResult RunCooperativeMatMul(
+    RowRangeExecutor* first,
+    RowRangeExecutor* second,
+    int32_t rowCount,
+    double flops,
+    const CooperativeMatMulSettings& settings);
+
+// Run RunCooperativeMatMul() on size x size matrices with two CPU executors, the second one three
+// times slower, and return whether the merged output is right, without any GPU.
+bool SimulateCooperativeMatMul(int32_t size, const CooperativeMatMulSettings& settings);
+
+#endif
@@ -26,64 +26,76 @@
 
 #include "D3D12MatMul.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
 #include <string>
+#include <thread>
 
 #include <d3dcompiler.h>
 
+#include "BenchmarkStatistics.h"
 #include "DXSampleHelper.h"
+#include "ShaderLibrary.h"
+#include "TaskGraph.h"
+#include "Tracer.h"
 
 namespace {
 
-ComPtr<ID3D12Resource> CreateBuffer(
-    ID3D12Device* device,
-    D3D12_HEAP_TYPE heapType,
-    uint64_t size,
-    D3D12_RESOURCE_FLAGS flags,
-    D3D12_RESOURCE_STATES initialState) {
+// The inputs are generated from a fixed seed, so that they can be generated on any thread and
+// generated again when they are needed after being released.
+void InitializeInputData(uint64_t count, uint32_t seed, std::vector<float>* inputData) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    inputData->resize(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        (*inputData)[i] = distribution(random);
+    }
+}
+
+// Writes the same values as InitializeInputData() straight into the mapped chunks of an upload,
+// so that inputs which are only uploaded once don't need a copy in system memory.
+UploadRing::WriteCallback MakeInputDataWriter(uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    return [random, distribution](void* destination, uint64_t, uint64_t size) mutable {
+        float* values = static_cast<float*>(destination);
+        for (uint64_t i = 0; i < size / sizeof(float); ++i) {
+            values[i] = distribution(random);
+        }
+    };
+}
+
+ComPtr<ID3D12Resource> CreateUploadBuffer(ID3D12Device* device, uint64_t size, uint8_t** data) {
     D3D12_HEAP_PROPERTIES heapProperties = {};
-    heapProperties.Type = heapType;
-    heapProperties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-    heapProperties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-    heapProperties.CreationNodeMask = 0;
-    heapProperties.VisibleNodeMask = 0;
+    heapProperties.Type = D3D12_HEAP_TYPE_UPLOAD;
 
     D3D12_RESOURCE_DESC bufferDescriptor = {};
     bufferDescriptor.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-    bufferDescriptor.Alignment = 0;
     bufferDescriptor.Width = size;
     bufferDescriptor.Height = 1;
     bufferDescriptor.DepthOrArraySize = 1;
     bufferDescriptor.MipLevels = 1;
     bufferDescriptor.Format = DXGI_FORMAT_UNKNOWN;
     bufferDescriptor.SampleDesc.Count = 1;
-    bufferDescriptor.SampleDesc.Quality = 0;
     bufferDescriptor.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-    bufferDescriptor.Flags = flags;
+    bufferDescriptor.Flags = D3D12_RESOURCE_FLAG_NONE;
 
     ComPtr<ID3D12Resource> buffer;
-    device->CreateCommittedResource(
-        &heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDescriptor, initialState, nullptr,
-        IID_PPV_ARGS(&buffer));
+    ThrowIfFailed(device->CreateCommittedResource(
+        &heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDescriptor,
+        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&buffer)));
+    D3D12_RANGE readRange = { 0, 0 };
+    ThrowIfFailed(buffer->Map(0, &readRange, reinterpret_cast<void**>(data)));
     return buffer;
 }
 
-void InitializeUploadBufferForInputBuffer(
-    ID3D12Resource* uploadBuffer,
-    uint64_t bufferSize,
-    std::vector<float>* inputData) {
-    uint64_t inputDataCount = bufferSize / sizeof(float);
-    inputData->resize(inputDataCount);
-    int sign = 1;
-    for (uint64_t i = 0; i < inputDataCount; ++i) {
-        (*inputData)[i] = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-    }
-
-    void* uploadPtr;
-    ThrowIfFailed(uploadBuffer->Map(0, nullptr, &uploadPtr));
-    memcpy(uploadPtr, inputData->data(), bufferSize);
-    uploadBuffer->Unmap(0, nullptr);
-}
-
 void RecordResourceBarrier(
     ID3D12GraphicsCommandList* commandList,
     ID3D12Resource* resource,
@@ -101,6 +113,79 @@ void RecordResourceBarrier(
     commandList->ResourceBarrier(1, &barrierDesc);
 }
 
+void RecordUAVBarrier(ID3D12GraphicsCommandList* commandList, ID3D12Resource* resource) {
+    D3D12_RESOURCE_BARRIER barrierDesc = {};
+
+    barrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+    barrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    barrierDesc.UAV.pResource = resource;
+
+    commandList->ResourceBarrier(1, &barrierDesc);
+}
+
+INTC_D3D12_COMMAND_QUEUE_THROTTLE_POLICY ToINTCThrottlePolicy(ThrottlePolicy policy) {
+    switch (policy) {
+        case ThrottlePolicy::Dynamic:
+            return INTC_D3D12_COMMAND_QUEUE_THROTTLE_DYNAMIC;
+        case ThrottlePolicy::MaxPerformance:
+            return INTC_D3D12_COMMAND_QUEUE_THROTTLE_MAX_PERFORMANCE;
+    }
+    return INTC_D3D12_COMMAND_QUEUE_THROTTLE_DYNAMIC;
+}
+
+// Sleep until shortly before deadline and spin for the rest, as sleeping alone is only accurate
+// to the scheduler tick, which is coarser than the short idle gaps of the bursty workloads.
+void WaitUntil(std::chrono::steady_clock::time_point deadline) {
+    constexpr std::chrono::milliseconds kSpinTime(2);
+    const auto now = std::chrono::steady_clock::now();
+    if (deadline - now > kSpinTime) {
+        std::this_thread::sleep_for(deadline - now - kSpinTime);
+    }
+    while (std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+}
+
+bool ReadTextFile(const char* path, std::string* text) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::ostringstream stream;
+    stream << file.rdbuf();
+    *text = stream.str();
+    return true;
+}
+
+// Smaller than the input matrices, which are uploaded in chunks.
+constexpr uint64_t kUploadRingSize = 4 * 1024 * 1024;
+// Currently we accept at most 3 ULP between CPU and GPU results.
+constexpr int32_t kToleranceULP = 3;
+// Beyond 2^16 ULPs, a result that differs from the reference in its leading bits still matches.
+constexpr int32_t kMaxToleranceULP = 16;
+
+// Smaller than the output matrix, which is read back in blocks of rows.
+constexpr uint64_t kReadbackRingSize = 4 * 1024 * 1024;
+
+// Enough streaming slots for the copy queue to upload the inputs of the next job and read back
+// the output of the previous one while the compute queue runs the current one.
+constexpr uint32_t kStreamingSlotCount = 3;
+// Enough command lists for the upload and readback of each streaming slot.
+constexpr uint32_t kCopyQueueFrameCount = 2 * kStreamingSlotCount;
+
+constexpr uint32_t kInputMatrix1Seed = 1;
+constexpr uint32_t kInputMatrix2Seed = 2;
+
+// The number of multiplications that can be in flight on the asynchronous queue.
+constexpr uint32_t kAsyncSlotCount = 16;
+
+// The number of batches of the matrix multiplication service that can be in flight.
+constexpr uint32_t kBatchSlotCount = 3;
+
+// Room for the begin and end timestamps of 1024 dispatches that haven't been read back yet.
+constexpr uint32_t kTimestampQueryCount = 2048;
+
+// Mirrors the cbuffer of the kernel, which is filled from root constants.
 struct ConstantBufferData {
     uint32_t M;
     uint32_t K;
@@ -110,24 +195,65 @@ struct ConstantBufferData {
 
 }  // anonymous namespace
 
-D3D12MatMul::D3D12MatMul(const Settings& settings) {
+D3D12MatMul::D3D12MatMul(const Settings& settings)
+    : mSettings(settings), mConstructionStart(std::chrono::steady_clock::now()) {
+    TRACE_SCOPE("D3D12MatMul::D3D12MatMul");
     InitDevice();
 
-    if (settings.disableCommandThrottlePolicyExtension || !InitIntelExtension()) {
-        printf("The Command Throttle Policy Extension is disabled.\n\n");
-    } else {
-        printf("The Command Throttle Policy Extension is enabled.\n");
-        printf(
-            "You can disable the Command Throttle Policy Extension with "
-            "--disable-command-throttle-policy-extension.\n\n");
+    if (!settings.shaderCacheDirectory.empty()) {
+        mShaderCache = std::make_unique<ShaderCache>(settings.shaderCacheDirectory);
     }
 
-    InitQueue(settings);
-
-    InitResources();
+    // Everything else only needs the device, and the queue, the pipeline, the input data and the
+    // buffers don't depend on each other, so the shader compilation, the generation of the inputs
+    // and the creation of the resources overlap. Only the upload waits for all but the pipeline.
+    TaskGraph graph;
+    const TaskGraph::TaskId queueTask = graph.AddTask("Extension and queue", [this]() {
+        if (mSettings.disableCommandThrottlePolicyExtension || !InitIntelExtension()) {
+            printf("The Command Throttle Policy Extension is disabled.\n\n");
+        } else {
+            printf("The Command Throttle Policy Extension is enabled.\n");
+            printf(
+                "You can disable the Command Throttle Policy Extension with "
+                "--disable-command-throttle-policy-extension.\n\n");
+        }
+        InitQueue(mSettings);
+        CreateTimestampQueryHeap();
+    });
+    graph.AddTask("Pipeline", [this]() {
+        CreateRootSignature();
+        CreateComputePipeline();
+        mMatMulCommandSignature =
+            CreateMatMulCommandSignature(mDevice.Get(), mRootSignature.Get());
+    });
+    // Without a copy to keep, the inputs are generated straight into the upload ring instead.
+    const TaskGraph::TaskId input1Task = graph.AddTask("Input matrix 1", [this]() {
+        if (mSettings.keepInputData) {
+            InitializeInputData(mM * mK, kInputMatrix1Seed, &mInputData1);
+        }
+    });
+    const TaskGraph::TaskId input2Task = graph.AddTask("Input matrix 2", [this]() {
+        if (mSettings.keepInputData) {
+            InitializeInputData(mK * mN, kInputMatrix2Seed, &mInputData2);
+        }
+    });
+    const TaskGraph::TaskId bufferTask = graph.AddTask("Buffers", [this]() { CreateBuffers(); });
+    graph.AddTask(
+        "Upload", [this]() { InitBufferData(); },
+        { queueTask, input1Task, input2Task, bufferTask });
+    graph.Run(settings.parallelInitialization ? 0 : 1);
+    graph.PrintTimings();
 }
 
 D3D12MatMul::~D3D12MatMul() {
+    // The resources are released before the queues, make sure the GPU doesn't use them anymore.
+    if (mQueue != nullptr) {
+        mQueue->WaitForIdle();
+    }
+    if (mCopyQueue != nullptr) {
+        mCopyQueue->WaitForIdle();
+    }
+
     if (mINTCExtensionContext != nullptr) {
         HRESULT hr = INTC_DestroyDeviceExtensionContext(&mINTCExtensionContext);
         if (FAILED(hr)) {
@@ -141,6 +267,7 @@ D3D12MatMul::~D3D12MatMul() {
 }
 
 void D3D12MatMul::InitDevice() {
+    TRACE_SCOPE("D3D12MatMul::InitDevice");
     ComPtr<ID3D12Debug3> debugController;
     ThrowIfFailed(D3D12GetDebugInterface(IID_PPV_ARGS(&debugController)));
     debugController->EnableDebugLayer();
@@ -174,11 +301,16 @@ void D3D12MatMul::InitDevice() {
     if (mHardwareAdapter.Get() == nullptr) {
         mHardwareAdapter = nonIntelAdapter;
     }
+    if (mHardwareAdapter.Get() == nullptr) {
+        printf("ERROR: no hardware adapter supports D3D12.\n");
+        ThrowIfFailed(DXGI_ERROR_NOT_FOUND);
+    }
 
     PrintAdapterInfo();
 }
 
 bool D3D12MatMul::InitIntelExtension() {
+    TRACE_SCOPE("D3D12MatMul::InitIntelExtension");
     constexpr INTCExtensionVersion kRequiredVersion = { 1, 0, 0 }; //version 1.0.0
 
     if (SUCCEEDED(INTC_LoadExtensionsLibrary(false))) {
@@ -245,6 +377,13 @@ bool D3D12MatMul::InitIntelExtension() {
             intcExtensionInfo.IntelDeviceInfo.EUCount, intcExtensionInfo.IntelDeviceInfo.PackageTDP,
             intcExtensionInfo.IntelDeviceInfo.MaxFillRate);
         printf("Done reporting intcExtensionInfo\n\n");
+
+        RunMetadata& metadata = mResults.metadata;
+        metadata.hasIntelDeviceInfo = true;
+        metadata.euCount = intcExtensionInfo.IntelDeviceInfo.EUCount;
+        metadata.gpuMaxFrequencyMHz = intcExtensionInfo.IntelDeviceInfo.GPUMaxFreq;
+        metadata.packageTDPW = intcExtensionInfo.IntelDeviceInfo.PackageTDP;
+        metadata.gtGeneration = intcExtensionInfo.IntelDeviceInfo.GTGeneration;
     } else {
         mINTCExtensionContext = nullptr;
         printf("ERROR: INTC_D3D12_CreateDeviceExtensionContext failed.\n");
@@ -255,31 +394,38 @@ bool D3D12MatMul::InitIntelExtension() {
 }
 
 void D3D12MatMul::InitQueue(const Settings& settings) {
+    TRACE_SCOPE("D3D12MatMul::InitQueue");
     D3D12_COMMAND_QUEUE_DESC queueDescriptor = {};
     queueDescriptor.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
     queueDescriptor.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
 
+    // Create command queue with MAX_PERFORMANCE Command Throttle Policy
+    mQueue = std::make_unique<SubmissionQueue>(
+        mDevice.Get(),
+        CreateCommandQueue(queueDescriptor, INTC_D3D12_COMMAND_QUEUE_THROTTLE_MAX_PERFORMANCE),
+        D3D12_COMMAND_LIST_TYPE_DIRECT, settings.framesInFlight);
+    mTimestampFrequency = mQueue->GetTimestampFrequency();
+
+    // Without the extension, the queue gets the default policy of the driver.
+    mResults.metadata.throttlePolicy = mINTCExtensionContext != nullptr
+        ? GetThrottlePolicyName(ThrottlePolicy::MaxPerformance)
+        : "DRIVER_DEFAULT";
+}
+
+ComPtr<ID3D12CommandQueue> D3D12MatMul::CreateCommandQueue(
+    D3D12_COMMAND_QUEUE_DESC queueDescriptor,
+    INTC_D3D12_COMMAND_QUEUE_THROTTLE_POLICY throttlePolicy) {
+    ComPtr<ID3D12CommandQueue> queue;
     if (mINTCExtensionContext != nullptr) {
-        // Create command queue with MAX_PERFORMANCE Command Throttle Policy
         INTC_D3D12_COMMAND_QUEUE_DESC intcQueueDescriptor = {};
         intcQueueDescriptor.pD3D12Desc = &queueDescriptor;
-        intcQueueDescriptor.CommandThrottlePolicy =
-            INTC_D3D12_COMMAND_QUEUE_THROTTLE_MAX_PERFORMANCE;
+        intcQueueDescriptor.CommandThrottlePolicy = throttlePolicy;
         ThrowIfFailed(INTC_D3D12_CreateCommandQueue(
-            mINTCExtensionContext, &intcQueueDescriptor, IID_PPV_ARGS(&mQueue)));
+            mINTCExtensionContext, &intcQueueDescriptor, IID_PPV_ARGS(&queue)));
     } else {
-        ThrowIfFailed(mDevice->CreateCommandQueue(&queueDescriptor, IID_PPV_ARGS(&mQueue)));
-    }
-
-    ThrowIfFailed(mQueue->GetTimestampFrequency(&mTimestampFrequency));
-
-    // Create objects for synchronization with mQueue.
-    ThrowIfFailed(mDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
-    mFenceValue = 1;
-    mFenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-    if (mFenceEvent == nullptr) {
-        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+        ThrowIfFailed(mDevice->CreateCommandQueue(&queueDescriptor, IID_PPV_ARGS(&queue)));
     }
+    return queue;
 }
 
 void D3D12MatMul::PrintAdapterInfo() {
@@ -289,75 +435,56 @@ void D3D12MatMul::PrintAdapterInfo() {
         L"Device: %s (VendorID: 0x%04x DeviceID: 0x%04x)\n",
         adapterDescriptor.Description, adapterDescriptor.VendorId, adapterDescriptor.DeviceId);
 
+    RunMetadata& metadata = mResults.metadata;
+    char adapterName[256] = {};
+    WideCharToMultiByte(
+        CP_UTF8, 0, adapterDescriptor.Description, -1, adapterName, sizeof(adapterName), nullptr,
+        nullptr);
+    metadata.adapterName = adapterName;
+    metadata.vendorId = adapterDescriptor.VendorId;
+    metadata.deviceId = adapterDescriptor.DeviceId;
+    metadata.subSysId = adapterDescriptor.SubSysId;
+    metadata.revision = adapterDescriptor.Revision;
+
     LARGE_INTEGER driverVersion;
     if (SUCCEEDED(mHardwareAdapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &driverVersion))) {
         uint64_t encoded = driverVersion.QuadPart;
-        wprintf(
-            L"Driver version: %d.%d.%d.%d\n", static_cast<uint16_t>((encoded >> 48) & 0xFFFF),
+        char version[32];
+        snprintf(
+            version, sizeof(version), "%d.%d.%d.%d",
+            static_cast<uint16_t>((encoded >> 48) & 0xFFFF),
             static_cast<uint16_t>((encoded >> 32) & 0xFFFF),
             static_cast<uint16_t>((encoded >> 16) & 0xFFFF),
             static_cast<uint16_t>(encoded & 0xFFFF));
+        metadata.driverVersion = version;
+        printf("Driver version: %s\n", version);
     }
     printf("\n");
 }
 
-void D3D12MatMul::InitResources() {
-    CreateDescriptorHeap();
-    CreateRootSignature();
-    CreateComputePipeline();
-    CreateBuffers();
-    CreateBufferViews();
-    CreateTimestampQueryHeap();
-    CreateCommandList();
-
-    InitBufferData();
-}
-
-void D3D12MatMul::CreateDescriptorHeap() {
-    D3D12_DESCRIPTOR_HEAP_DESC heapDescriptor = {};
-    // 1 CBV, 2 SRVs, 1 UAV
-    heapDescriptor.NumDescriptors = 4;
-    heapDescriptor.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-    heapDescriptor.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-    ThrowIfFailed(mDevice->CreateDescriptorHeap(&heapDescriptor, IID_PPV_ARGS(&mCBVSRVUAVHeap)));
-
-    mCBVSRCUAVDescriptorSize =
-        mDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-}
-
 void D3D12MatMul::CreateRootSignature() {
-    D3D12_DESCRIPTOR_RANGE descriptorRanges[3];
-    descriptorRanges[0].BaseShaderRegister = 0;
-    descriptorRanges[0].NumDescriptors = 1;
-    descriptorRanges[0].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
-    descriptorRanges[0].RegisterSpace = 0;
-    descriptorRanges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
-
-    descriptorRanges[1].BaseShaderRegister = 0;
-    descriptorRanges[1].NumDescriptors = 2;
-    descriptorRanges[1].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
-    descriptorRanges[1].RegisterSpace = 0;
-    descriptorRanges[1].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
-
-    descriptorRanges[2].BaseShaderRegister = 0;
-    descriptorRanges[2].NumDescriptors = 1;
-    descriptorRanges[2].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
-    descriptorRanges[2].RegisterSpace = 0;
-    descriptorRanges[2].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
-
-    D3D12_ROOT_PARAMETER rootParameters[3];
-    rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-    rootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
-    rootParameters[0].DescriptorTable.NumDescriptorRanges = 1;
-    rootParameters[0].DescriptorTable.pDescriptorRanges = &descriptorRanges[0];
-    rootParameters[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-    rootParameters[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
-    rootParameters[1].DescriptorTable.NumDescriptorRanges = 1;
-    rootParameters[1].DescriptorTable.pDescriptorRanges = &descriptorRanges[1];
-    rootParameters[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-    rootParameters[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
-    rootParameters[2].DescriptorTable.NumDescriptorRanges = 1;
-    rootParameters[2].DescriptorTable.pDescriptorRanges = &descriptorRanges[2];
+    TRACE_SCOPE("D3D12MatMul::CreateRootSignature");
+    // The shape is passed as root constants and the matrices as root descriptors, so that a
+    // dispatch with another shape or other buffers only costs a few command list writes.
+    D3D12_ROOT_PARAMETER rootParameters[kRootParameterCount];
+    rootParameters[kRootConstants].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+    rootParameters[kRootConstants].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+    rootParameters[kRootConstants].Constants.ShaderRegister = 0;
+    rootParameters[kRootConstants].Constants.RegisterSpace = 0;
+    rootParameters[kRootConstants].Constants.Num32BitValues =
+        sizeof(ConstantBufferData) / sizeof(uint32_t);
+    rootParameters[kRootInputMatrix1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+    rootParameters[kRootInputMatrix1].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+    rootParameters[kRootInputMatrix1].Descriptor.ShaderRegister = 0;
+    rootParameters[kRootInputMatrix1].Descriptor.RegisterSpace = 0;
+    rootParameters[kRootInputMatrix2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+    rootParameters[kRootInputMatrix2].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+    rootParameters[kRootInputMatrix2].Descriptor.ShaderRegister = 1;
+    rootParameters[kRootInputMatrix2].Descriptor.RegisterSpace = 0;
+    rootParameters[kRootOutputMatrix].ParameterType = D3D12_ROOT_PARAMETER_TYPE_UAV;
+    rootParameters[kRootOutputMatrix].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+    rootParameters[kRootOutputMatrix].Descriptor.ShaderRegister = 0;
+    rootParameters[kRootOutputMatrix].Descriptor.RegisterSpace = 0;
 
     D3D12_ROOT_SIGNATURE_DESC rootSignatureDescriptor = {};
     rootSignatureDescriptor.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
@@ -374,310 +501,1709 @@ void D3D12MatMul::CreateRootSignature() {
         IID_PPV_ARGS(&mRootSignature)));
 }
 
-void D3D12MatMul::CreateComputePipeline() {
-    ComPtr<ID3DBlob> computeShader;
+const char* D3D12MatMul::LoadComputeShader(
+    std::vector<uint8_t>* bytecode,
+    ShaderCacheKey* shaderKey) {
+    TRACE_SCOPE("D3D12MatMul::LoadComputeShader");
+    constexpr char kKernelName[] = "SLM_4X4_16X16_4_floats";
+    const std::string localGroupXStr = std::to_string(mLocalGroupSizeX);
+    const std::string localGroupYStr = std::to_string(mLocalGroupSizeY);
+
+    // The variants precompiled at build time don't need any compiler nor the .hlsl file.
+    const std::string variantKey = MakeShaderVariantKey(
+        kKernelName,
+        { { "LOCAL_GROUP_SIZE_X", localGroupXStr }, { "LOCAL_GROUP_SIZE_Y", localGroupYStr } });
+    mResults.metadata.kernelVariant = variantKey;
+    ShaderLibrary::Shader shader;
+    if (ShaderLibrary::GetEmbedded().Find(variantKey, ShaderFormat::DXIL, &shader)) {
+        const uint8_t* data = static_cast<const uint8_t*>(shader.bytecode);
+        bytecode->assign(data, data + shader.size);
+        shaderKey->Add(shader.bytecode, shader.size);
+        return "embedded";
+    }
+    printf(
+        "WARNING: %s is not in the embedded shader library, compiling it at runtime.\n",
+        variantKey.c_str());
+
+    const std::string shaderPath = std::string(kKernelName) + ".hlsl";
+    constexpr char kEntryPoint[] = "main";
+    constexpr char kShaderProfile[] = "cs_5_0";
     constexpr uint32_t kCompileFlags = 0;
     D3D_SHADER_MACRO defines[3];
     defines[0].Name = "LOCAL_GROUP_SIZE_X";
-    std::string localGroupXStr = std::to_string(mLocalGroupSizeX);
     defines[0].Definition = localGroupXStr.c_str();
     defines[1].Name = "LOCAL_GROUP_SIZE_Y";
-    std::string localGroupYStr = std::to_string(mLocalGroupSizeY);
     defines[1].Definition = localGroupYStr.c_str();
     defines[2] = {};
-    ThrowIfFailed(D3DCompileFromFile(
-        L"SLM_4X4_16X16_4_floats.hlsl", defines, nullptr, "main", "cs_5_0", kCompileFlags, 0,
-        &computeShader, nullptr));
+
+    std::string source;
+    if (!ReadTextFile(shaderPath.c_str(), &source)) {
+        printf("ERROR: failed to read %s.\n", shaderPath.c_str());
+        ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND));
+    }
+
+    shaderKey->Add(source).Add(kEntryPoint).Add(kShaderProfile).Add(uint64_t(kCompileFlags));
+    shaderKey->Add(uint64_t(D3D_COMPILER_VERSION));
+    for (const D3D_SHADER_MACRO& define : defines) {
+        if (define.Name != nullptr) {
+            shaderKey->Add(define.Name).Add(define.Definition);
+        }
+    }
+
+    if (mShaderCache != nullptr && mShaderCache->Load("shader", shaderKey->Get(), bytecode)) {
+        return "cached";
+    }
+
+    ComPtr<ID3DBlob> computeShader;
+    ThrowIfFailed(D3DCompile(
+        source.data(), source.size(), shaderPath.c_str(), defines, nullptr, kEntryPoint,
+        kShaderProfile, kCompileFlags, 0, &computeShader, nullptr));
+    const uint8_t* data = static_cast<const uint8_t*>(computeShader->GetBufferPointer());
+    bytecode->assign(data, data + computeShader->GetBufferSize());
+    if (mShaderCache != nullptr) {
+        mShaderCache->Store("shader", shaderKey->Get(), bytecode->data(), bytecode->size());
+    }
+    return "compiled";
+}
+
+void D3D12MatMul::CreateComputePipeline() {
+    TRACE_SCOPE("D3D12MatMul::CreateComputePipeline");
+    const auto start = std::chrono::steady_clock::now();
+
+    // The bytecode only depends on the compiler inputs, while the pipeline state object blob also
+    // depends on the root signature and on the adapter and driver that compiled it.
+    std::vector<uint8_t> bytecode;
+    ShaderCacheKey shaderKey;
+    const char* shaderOrigin = LoadComputeShader(&bytecode, &shaderKey);
+    mResults.metadata.shaderSource = shaderOrigin;
+
+    DXGI_ADAPTER_DESC1 adapterDescriptor;
+    mHardwareAdapter->GetDesc1(&adapterDescriptor);
+    LARGE_INTEGER driverVersion = {};
+    mHardwareAdapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &driverVersion);
+    ShaderCacheKey pipelineKey;
+    pipelineKey.Add(shaderKey.Get())
+        .Add(mRootSignatureBlob->GetBufferPointer(), mRootSignatureBlob->GetBufferSize())
+        .Add(uint64_t(adapterDescriptor.VendorId))
+        .Add(uint64_t(adapterDescriptor.DeviceId))
+        .Add(uint64_t(adapterDescriptor.SubSysId))
+        .Add(uint64_t(adapterDescriptor.Revision))
+        .Add(uint64_t(driverVersion.QuadPart));
 
     D3D12_COMPUTE_PIPELINE_STATE_DESC computePipelineDescriptor = {};
     computePipelineDescriptor.pRootSignature = mRootSignature.Get();
     computePipelineDescriptor.NodeMask = 0;
     computePipelineDescriptor.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
-    computePipelineDescriptor.CachedPSO.CachedBlobSizeInBytes = 0;
-    computePipelineDescriptor.CachedPSO.pCachedBlob = nullptr;
-    computePipelineDescriptor.CS.BytecodeLength = computeShader->GetBufferSize();
-    computePipelineDescriptor.CS.pShaderBytecode = computeShader->GetBufferPointer();
-    ThrowIfFailed(mDevice->CreateComputePipelineState(
-        &computePipelineDescriptor, IID_PPV_ARGS(&mComputePipeline)));
+    computePipelineDescriptor.CS.BytecodeLength = bytecode.size();
+    computePipelineDescriptor.CS.pShaderBytecode = bytecode.data();
+
+    std::vector<uint8_t> cachedPipeline;
+    bool pipelineCacheHit = mShaderCache != nullptr &&
+                            mShaderCache->Load("pipeline", pipelineKey.Get(), &cachedPipeline);
+    if (pipelineCacheHit) {
+        computePipelineDescriptor.CachedPSO.CachedBlobSizeInBytes = cachedPipeline.size();
+        computePipelineDescriptor.CachedPSO.pCachedBlob = cachedPipeline.data();
+        HRESULT hr = mDevice->CreateComputePipelineState(
+            &computePipelineDescriptor, IID_PPV_ARGS(&mComputePipeline));
+        if (FAILED(hr)) {
+            // D3D12_ERROR_DRIVER_VERSION_MISMATCH and D3D12_ERROR_ADAPTER_NOT_FOUND are expected
+            // after a driver update, but any failure falls back to a full compilation.
+            printf(
+                "WARNING: the cached pipeline state object was rejected (0x%08x), recompiling "
+                "it.\n",
+                static_cast<uint32_t>(hr));
+            mShaderCache->Remove("pipeline", pipelineKey.Get());
+            pipelineCacheHit = false;
+        }
+    }
+    if (!pipelineCacheHit) {
+        computePipelineDescriptor.CachedPSO.CachedBlobSizeInBytes = 0;
+        computePipelineDescriptor.CachedPSO.pCachedBlob = nullptr;
+        ThrowIfFailed(mDevice->CreateComputePipelineState(
+            &computePipelineDescriptor, IID_PPV_ARGS(&mComputePipeline)));
+
+        ComPtr<ID3DBlob> pipelineBlob;
+        if (mShaderCache != nullptr && SUCCEEDED(mComputePipeline->GetCachedBlob(&pipelineBlob))) {
+            mShaderCache->Store(
+                "pipeline", pipelineKey.Get(), pipelineBlob->GetBufferPointer(),
+                pipelineBlob->GetBufferSize());
+        }
+    }
+
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    printf(
+        "Compute pipeline created in %.2f ms (shader bytecode: %s, pipeline state: %s).\n\n",
+        elapsed.count(), shaderOrigin, pipelineCacheHit ? "cached" : "compiled");
 }
 
 void D3D12MatMul::CreateBuffers() {
-    uint64_t constantBufferSize = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
-    mConstantBuffer = CreateBuffer(
-        mDevice.Get(), D3D12_HEAP_TYPE_DEFAULT, constantBufferSize,
-        D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST);
+    TRACE_SCOPE("D3D12MatMul::CreateBuffers");
+    mBufferAllocator =
+        std::make_unique<PlacedBufferAllocator>(mDevice.Get(), HeapSuballocator::Desc());
 
     uint64_t inputBufferSize1 = mM * mK * sizeof(float);
-    mInputBuffer1 = CreateBuffer(
-        mDevice.Get(), D3D12_HEAP_TYPE_DEFAULT, inputBufferSize1, D3D12_RESOURCE_FLAG_NONE,
-        D3D12_RESOURCE_STATE_COPY_DEST);
+    mInputBuffer1 = mBufferAllocator->CreateBuffer(
+        inputBufferSize1, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST,
+        &mInputBuffer1Allocation);
 
     uint64_t inputBufferSize2 = mK * mN * sizeof(float);
-    mInputBuffer2 = CreateBuffer(
-        mDevice.Get(), D3D12_HEAP_TYPE_DEFAULT, inputBufferSize2, D3D12_RESOURCE_FLAG_NONE,
-        D3D12_RESOURCE_STATE_COPY_DEST);
+    mInputBuffer2 = mBufferAllocator->CreateBuffer(
+        inputBufferSize2, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST,
+        &mInputBuffer2Allocation);
 
     uint64_t outputBufferSize = mM * mN * sizeof(float);
-    mOutputBuffer = CreateBuffer(
-        mDevice.Get(), D3D12_HEAP_TYPE_DEFAULT, outputBufferSize,
-        D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-
-    uint64_t timestampsSize = 2 * sizeof(uint64_t);
-    mTimestampBuffer = CreateBuffer(
-        mDevice.Get(), D3D12_HEAP_TYPE_READBACK, timestampsSize, D3D12_RESOURCE_FLAG_NONE,
-        D3D12_RESOURCE_STATE_COPY_DEST);
-}
+    mOutputBuffer = mBufferAllocator->CreateBuffer(
+        outputBufferSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+        D3D12_RESOURCE_STATE_UNORDERED_ACCESS, &mOutputBufferAllocation);
 
-void D3D12MatMul::CreateBufferViews() {
-    uint64_t constantBufferSize = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
-    D3D12_CPU_DESCRIPTOR_HANDLE heapStart = mCBVSRVUAVHeap->GetCPUDescriptorHandleForHeapStart();
-    D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDescriptor = {};
-    cbvDescriptor.BufferLocation = mConstantBuffer->GetGPUVirtualAddress();
-    cbvDescriptor.SizeInBytes = static_cast<uint32_t>(constantBufferSize);
-    mDevice->CreateConstantBufferView(&cbvDescriptor, heapStart);
-
-    uint64_t inputElementsCount1 = mM * mK;
-    D3D12_SHADER_RESOURCE_VIEW_DESC srvDescriptor = {};
-    srvDescriptor.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    srvDescriptor.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
-    srvDescriptor.Format = DXGI_FORMAT_R32_TYPELESS;
-    srvDescriptor.Buffer.FirstElement = 0;
-    srvDescriptor.Buffer.NumElements = static_cast<uint32_t>(inputElementsCount1);
-    srvDescriptor.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
-    D3D12_CPU_DESCRIPTOR_HANDLE srvHandle1 = heapStart;
-    srvHandle1.ptr += mCBVSRCUAVDescriptorSize;
-    mDevice->CreateShaderResourceView(mInputBuffer1.Get(), &srvDescriptor, srvHandle1);
-
-    uint64_t inputElementsCount2 = mK * mN;
-    srvDescriptor.Buffer.NumElements = static_cast<uint32_t>(inputElementsCount2);
-    D3D12_CPU_DESCRIPTOR_HANDLE srvHandle2 = heapStart;
-    srvHandle2.ptr += mCBVSRCUAVDescriptorSize * 2;
-    mDevice->CreateShaderResourceView(mInputBuffer2.Get(), &srvDescriptor, srvHandle2);
-
-    uint64_t outputElementsCount = mM * mN;
-    D3D12_UNORDERED_ACCESS_VIEW_DESC uavDescriptor = {};
-    uavDescriptor.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-    uavDescriptor.Format = DXGI_FORMAT_R32_TYPELESS;
-    uavDescriptor.Buffer.FirstElement = 0;
-    uavDescriptor.Buffer.CounterOffsetInBytes = 0;
-    uavDescriptor.Buffer.NumElements = static_cast<uint32_t>(outputElementsCount);
-    uavDescriptor.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_RAW;
-    uavDescriptor.Buffer.StructureByteStride = 0;
-    D3D12_CPU_DESCRIPTOR_HANDLE uavHandle = heapStart;
-    uavHandle.ptr += mCBVSRCUAVDescriptorSize * 3;
-    mDevice->CreateUnorderedAccessView(mOutputBuffer.Get(), nullptr, &uavDescriptor, uavHandle);
+    mUploadRing = std::make_unique<UploadRing>(mDevice.Get(), kUploadRingSize);
 }
 
 void D3D12MatMul::CreateTimestampQueryHeap() {
-    D3D12_QUERY_HEAP_DESC timestampHeapDesc = {};
-    timestampHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
-    timestampHeapDesc.Count = 2;
-    ThrowIfFailed(mDevice->CreateQueryHeap(&timestampHeapDesc, IID_PPV_ARGS(&mTimestampQueryHeap)));
-}
-
-void D3D12MatMul::CreateCommandList() {
-    ThrowIfFailed(mDevice->CreateCommandAllocator(
-        D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&mCommandAllocator)));
-    ThrowIfFailed(mDevice->CreateCommandList(
-        0, D3D12_COMMAND_LIST_TYPE_DIRECT, mCommandAllocator.Get(), nullptr,
-        IID_PPV_ARGS(&mCommandList)));
+    mTimestampRing = std::make_unique<TimestampQueryRing>(
+        mDevice.Get(), kTimestampQueryCount, mTimestampFrequency);
 }
 
 void D3D12MatMul::InitBufferData() {
-    const uint64_t uploadBufferSize1 = mM * mK * sizeof(float);
-    ComPtr<ID3D12Resource> uploadBuffer1 = CreateBuffer(
-        mDevice.Get(), D3D12_HEAP_TYPE_UPLOAD, uploadBufferSize1,
-        D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ);
-    InitializeUploadBufferForInputBuffer(uploadBuffer1.Get(), uploadBufferSize1, &mInputData1);
-
-    const uint64_t uploadBufferSize2 = mK * mN * sizeof(float);
-    ComPtr<ID3D12Resource> uploadBuffer2 = CreateBuffer(
-        mDevice.Get(), D3D12_HEAP_TYPE_UPLOAD, uploadBufferSize2,
-        D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ);
-    InitializeUploadBufferForInputBuffer(uploadBuffer2.Get(), uploadBufferSize2, &mInputData2);
-
-    mCommandList->CopyBufferRegion(
-        mInputBuffer1.Get(), 0, uploadBuffer1.Get(), 0, uploadBufferSize1);
-    mCommandList->CopyBufferRegion(
-        mInputBuffer2.Get(), 0, uploadBuffer2.Get(), 0, uploadBufferSize2);
-
-    ComPtr<ID3D12Resource> uploadBufferForConstantBufferData = CreateBuffer(
-        mDevice.Get(), D3D12_HEAP_TYPE_UPLOAD, sizeof(ConstantBufferData), D3D12_RESOURCE_FLAG_NONE,
-        D3D12_RESOURCE_STATE_GENERIC_READ);
-    void* uploadPtrForConstantBufferData = nullptr;
-    ThrowIfFailed(uploadBufferForConstantBufferData->Map(
-        0, nullptr, &uploadPtrForConstantBufferData));
-    ConstantBufferData* constantBufferDataPtr =
-        static_cast<ConstantBufferData*>(uploadPtrForConstantBufferData);
-    constantBufferDataPtr->M = mM;
-    constantBufferDataPtr->N = mN;
-    constantBufferDataPtr->K = mK;
-    constantBufferDataPtr->TILE_K = mTileK;
-    uploadBufferForConstantBufferData->Unmap(0, nullptr);
-    mCommandList->CopyBufferRegion(
-        mConstantBuffer.Get(), 0, uploadBufferForConstantBufferData.Get(), 0,
-        sizeof(ConstantBufferData));
+    TRACE_SCOPE("D3D12MatMul::InitBufferData");
+    ID3D12GraphicsCommandList* commandList = mQueue->BeginFrame();
+    mUploadRing->Reclaim(mQueue->GetCompletedFenceValue());
+
+    // The input matrices are larger than the ring, so they are uploaded in chunks.
+    const uint64_t inputSize1 = uint64_t(mM) * mK * sizeof(float);
+    const uint64_t inputSize2 = uint64_t(mK) * mN * sizeof(float);
+    if (mSettings.keepInputData) {
+        commandList = mUploadRing->Upload(
+            mQueue.get(), commandList, mInputBuffer1.Get(), 0, mInputData1.data(), inputSize1);
+        commandList = mUploadRing->Upload(
+            mQueue.get(), commandList, mInputBuffer2.Get(), 0, mInputData2.data(), inputSize2);
+    } else {
+        commandList = mUploadRing->Upload(
+            mQueue.get(), commandList, mInputBuffer1.Get(), 0, inputSize1,
+            MakeInputDataWriter(kInputMatrix1Seed));
+        commandList = mUploadRing->Upload(
+            mQueue.get(), commandList, mInputBuffer2.Get(), 0, inputSize2,
+            MakeInputDataWriter(kInputMatrix2Seed));
+    }
 
     RecordResourceBarrier(
-        mCommandList.Get(), mInputBuffer1.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
+        commandList, mInputBuffer1.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
         D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
     RecordResourceBarrier(
-        mCommandList.Get(), mInputBuffer2.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
+        commandList, mInputBuffer2.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
         D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-    RecordResourceBarrier(
-        mCommandList.Get(), mConstantBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
-        D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
 
-    mCommandList->Close();
-    ID3D12CommandList* ppCommandLists[] = { mCommandList.Get() };
-    mQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
-    WaitForGPUCompletion();
-}
+    mUploadRing->FinishSubmit(mQueue->GetNextFenceValue());
+    mQueue->SubmitFrame();
 
-void D3D12MatMul::WaitForGPUCompletion() {
-    ThrowIfFailed(mQueue->Signal(mFence.Get(), mFenceValue));
+    // The dispatches are submitted after the upload on the same queue, so nothing waits for it.
+    // The inputs are generated again by InitInputData() when they are needed on the CPU.
+}
 
-    ThrowIfFailed(mFence->SetEventOnCompletion(mFenceValue, mFenceEvent));
-    WaitForSingleObjectEx(mFenceEvent, INFINITE, FALSE);
+void D3D12MatMul::InitInputData() {
+    if (mInputData1.empty()) {
+        InitializeInputData(mM * mK, kInputMatrix1Seed, &mInputData1);
+    }
+    if (mInputData2.empty()) {
+        InitializeInputData(mK * mN, kInputMatrix2Seed, &mInputData2);
+    }
+}
 
-    ++mFenceValue;
+void D3D12MatMul::GetDispatchSize(int32_t* dispatchX, int32_t* dispatchY) const {
+    GetDispatchSize(mM, mN, dispatchX, dispatchY);
 }
 
-void D3D12MatMul::DoMatMul() {
+void D3D12MatMul::GetDispatchSize(
+    int32_t m,
+    int32_t n,
+    int32_t* dispatchX,
+    int32_t* dispatchY) const {
     constexpr int32_t kRowPerThread = 4;
     constexpr int32_t kColPerThread = 4;
 
     int32_t tileM = mLocalGroupSizeY * kRowPerThread;
     int32_t tileN = mLocalGroupSizeX * kColPerThread;
-    int32_t dispatchX = static_cast<int32_t>(ceil(float(mN) / float(tileN)));
-    int32_t dispatchY = static_cast<int32_t>(ceil(float(mM) / float(tileM)));
+    *dispatchX = static_cast<int32_t>(ceil(float(n) / float(tileN)));
+    *dispatchY = static_cast<int32_t>(ceil(float(m) / float(tileM)));
+}
+
+double D3D12MatMul::MeasureMatMuls(
+    const MatMulArguments& arguments,
+    ID3D12Resource* outputBuffer,
+    std::vector<double>* gpuTimesUS) {
+    // Several dispatches are recorded into each command list. Their timestamps are resolved once
+    // per submit and only read back when the fence of that submit has passed.
+    const uint32_t batchSize = std::max(1u, mSettings.dispatchesPerSubmit);
+    uint32_t submittedCount = 0;
+    auto submitUntil = [&](uint32_t count) {
+        while (submittedCount < count) {
+            uint32_t batch = std::min(batchSize, count - submittedCount);
+            SubmitTimedMatMuls(
+                mQueue.get(), mTimestampRing.get(), &mRegionTimings, arguments, outputBuffer,
+                submittedCount, batch);
+            submittedCount += batch;
+        }
+    };
+
+    mRegionTimings.clear();
+    submitUntil(mSettings.warmupIterations);
+
+    // The wall time must not include the warm-up dispatches that are still executing, so the
+    // last warm-up submit is waited for before the clock starts.
+    if (submittedCount != 0) {
+        mQueue->WaitForFenceValue(mQueue->GetLastSubmittedFenceValue());
+    }
+    const auto start = std::chrono::steady_clock::now();
+    if (mSettings.timeBudgetMs != 0) {
+        const auto budget = std::chrono::milliseconds(mSettings.timeBudgetMs);
+        while (std::chrono::steady_clock::now() - start < budget) {
+            submitUntil(submittedCount + batchSize);
+        }
+    } else {
+        submitUntil(mSettings.warmupIterations + mSettings.iterations);
+    }
+
+    mQueue->WaitForIdle();
+    const std::chrono::duration<double> wallTime = std::chrono::steady_clock::now() - start;
+    mTimestampRing->CollectCompleted(mQueue->GetCompletedFenceValue(), &mRegionTimings);
+
+    gpuTimesUS->assign(submittedCount, 0.0);
+    for (const TimestampQueryRing::RegionTiming& timing : mRegionTimings) {
+        (*gpuTimesUS)[timing.regionId] = timing.gpuTimeUS;
+    }
+    TraceGPUTimings(mQueue.get(), "Compute queue", mRegionTimings);
+    return wallTime.count();
+}
+
+void D3D12MatMul::TraceGPUTimings(
+    SubmissionQueue* queue,
+    const char* track,
+    const std::vector<TimestampQueryRing::RegionTiming>& timings) const {
+    if (!IsTracingEnabled() || timings.empty()) {
+        return;
+    }
+
+    const std::function<double(uint64_t)> toTraceUS = GetTraceClockConversion(queue);
+    for (const TimestampQueryRing::RegionTiming& timing : timings) {
+        AddGPUTraceSpan(
+            track, "Iteration " + std::to_string(timing.regionId),
+            toTraceUS(timing.beginTimestamp), toTraceUS(timing.endTimestamp));
+    }
+}
+
+std::function<double(uint64_t)> D3D12MatMul::GetTraceClockConversion(
+    SubmissionQueue* queue) const {
+    // GetClockCalibration() pairs a GPU timestamp with a QueryPerformanceCounter() value, which
+    // is then related to the trace clock by reading both clocks back to back.
+    uint64_t gpuCalibrationTimestamp;
+    uint64_t cpuCalibrationTimestamp;
+    ThrowIfFailed(queue->GetQueue()->GetClockCalibration(
+        &gpuCalibrationTimestamp, &cpuCalibrationTimestamp));
+    LARGE_INTEGER cpuNow;
+    QueryPerformanceCounter(&cpuNow);
+    const double traceNowUS = GetTraceTimeUS();
+    LARGE_INTEGER cpuFrequency;
+    QueryPerformanceFrequency(&cpuFrequency);
+
+    const double calibrationTraceUS =
+        traceNowUS - (static_cast<double>(cpuNow.QuadPart) -
+                      static_cast<double>(cpuCalibrationTimestamp)) *
+                         1e6 / static_cast<double>(cpuFrequency.QuadPart);
+    const double gpuFrequency = static_cast<double>(queue->GetTimestampFrequency());
+    return [=](uint64_t timestamp) {
+        return calibrationTraceUS +
+               (static_cast<double>(timestamp) - static_cast<double>(gpuCalibrationTimestamp)) *
+                   1e6 / gpuFrequency;
+    };
+}
+
+MatMulTiling D3D12MatMul::GetTiling() const {
+    constexpr int32_t kRowPerThread = 4;
+    constexpr int32_t kColPerThread = 4;
+    MatMulTiling tiling;
+    tiling.tileM = mLocalGroupSizeY * kRowPerThread;
+    tiling.tileN = mLocalGroupSizeX * kColPerThread;
+    tiling.tileK = mTileK;
+    return tiling;
+}
+
+uint64_t D3D12MatMul::GetMaxBufferSize() const {
+    // min(max(A, B * dedicated video memory), C) MB, the limit of the size of a resource.
+    DXGI_ADAPTER_DESC1 adapterDescriptor;
+    mHardwareAdapter->GetDesc1(&adapterDescriptor);
+    constexpr uint64_t kMB = 1024 * 1024;
+    const uint64_t scaledMemorySize = static_cast<uint64_t>(
+        D3D12_REQ_RESOURCE_SIZE_IN_MEGABYTES_EXPRESSION_B_TERM *
+        static_cast<double>(adapterDescriptor.DedicatedVideoMemory));
+    return std::min(
+        std::max(D3D12_REQ_RESOURCE_SIZE_IN_MEGABYTES_EXPRESSION_A_TERM * kMB, scaledMemorySize),
+        D3D12_REQ_RESOURCE_SIZE_IN_MEGABYTES_EXPRESSION_C_TERM * kMB);
+}
+
+void D3D12MatMul::DoMatMul() {
+    TRACE_SCOPE("D3D12MatMul::DoMatMul");
+    int32_t dispatchX;
+    int32_t dispatchY;
+    GetDispatchSize(&dispatchX, &dispatchY);
     printf(
         "M = %d, N = %d, K = %d, dispatchX = %d, dispatchY = %d\n\n", mM, mN, mK, dispatchX,
         dispatchY);
 
-    ThrowIfFailed(mCommandList->Reset(mCommandAllocator.Get(), mComputePipeline.Get()));
-
-    uint32_t beginTimestampIndex = 0;
-    mCommandList->EndQuery(mTimestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0);
+    std::vector<double> gpuTimesUS;
+    const double wallTimeS = MeasureMatMuls(
+        GetMatMulArguments(mInputBuffer1.Get(), mInputBuffer2.Get(), mOutputBuffer.Get()),
+        mOutputBuffer.Get(), &gpuTimesUS);
+    const uint32_t submittedCount = static_cast<uint32_t>(gpuTimesUS.size());
+
+    const double flopsPerIteration = 2.0 * mM * mN * mK;
+    PrintBenchmarkReport(gpuTimesUS, mSettings.warmupIterations, flopsPerIteration);
+
+    RunMetadata& metadata = mResults.metadata;
+    metadata.m = mM;
+    metadata.n = mN;
+    metadata.k = mK;
+    metadata.dispatchesPerSubmit = std::max(1u, mSettings.dispatchesPerSubmit);
+    metadata.framesInFlight = mQueue->GetFrameCount();
+    mResults.gpuTimesUS = gpuTimesUS;
+    mResults.warmupIterations = mSettings.warmupIterations;
+    mResults.flopsPerIteration = flopsPerIteration;
+    mResults.wallTimeS = wallTimeS;
+
+    const uint32_t measuredCount =
+        submittedCount - std::min(submittedCount, mSettings.warmupIterations);
+    if (measuredCount > 0) {
+        printf(
+            "Throughput with %u frames in flight: %.1f dispatches/s, %.2f GFLOPS (wall "
+            "clock)\n\n",
+            mQueue->GetFrameCount(), measuredCount / wallTimeS,
+            measuredCount * flopsPerIteration / wallTimeS * 1e-9);
+    }
+}
 
-    ID3D12DescriptorHeap* pHeaps[] = { mCBVSRVUAVHeap.Get() };
-    mCommandList->SetDescriptorHeaps(_countof(pHeaps), pHeaps);
+MatMulArguments D3D12MatMul::GetMatMulArguments(
+    ID3D12Resource* inputBuffer1,
+    ID3D12Resource* inputBuffer2,
+    ID3D12Resource* outputBuffer) const {
+    MatMulArguments arguments;
+    arguments.m = mM;
+    arguments.n = mN;
+    arguments.k = mK;
+    arguments.inputMatrix1 = inputBuffer1->GetGPUVirtualAddress();
+    arguments.inputMatrix2 = inputBuffer2->GetGPUVirtualAddress();
+    arguments.outputMatrix = outputBuffer->GetGPUVirtualAddress();
+    return arguments;
+}
 
-    mCommandList->SetComputeRootSignature(mRootSignature.Get());
+IndirectMatMulCommand D3D12MatMul::GetIndirectMatMulCommand(
+    const MatMulArguments& arguments) const {
+    int32_t dispatchX;
+    int32_t dispatchY;
+    GetDispatchSize(arguments.m, arguments.n, &dispatchX, &dispatchY);
+
+    IndirectMatMulCommand command = {};
+    command.m = arguments.m;
+    command.k = arguments.k;
+    command.n = arguments.n;
+    command.tileK = mTileK;
+    command.inputMatrix1 = arguments.inputMatrix1;
+    command.inputMatrix2 = arguments.inputMatrix2;
+    command.outputMatrix = arguments.outputMatrix;
+    command.threadGroupCountX = dispatchX;
+    command.threadGroupCountY = dispatchY;
+    command.threadGroupCountZ = 1;
+    return command;
+}
 
-    D3D12_GPU_DESCRIPTOR_HANDLE cbvHandle = mCBVSRVUAVHeap->GetGPUDescriptorHandleForHeapStart();
-    mCommandList->SetComputeRootDescriptorTable(0, cbvHandle);
-    D3D12_GPU_DESCRIPTOR_HANDLE srvHandle = mCBVSRVUAVHeap->GetGPUDescriptorHandleForHeapStart();
-    srvHandle.ptr += mCBVSRCUAVDescriptorSize;
-    mCommandList->SetComputeRootDescriptorTable(1, srvHandle);
-    D3D12_GPU_DESCRIPTOR_HANDLE uavHandle = mCBVSRVUAVHeap->GetGPUDescriptorHandleForHeapStart();
-    uavHandle.ptr += 3 * mCBVSRCUAVDescriptorSize;
-    mCommandList->SetComputeRootDescriptorTable(2, uavHandle);
+void D3D12MatMul::RecordMatMulBindings(
+    ID3D12GraphicsCommandList* commandList,
+    const MatMulArguments& arguments) {
+    commandList->SetComputeRootSignature(mRootSignature.Get());
+    commandList->SetPipelineState(mComputePipeline.Get());
+
+    ConstantBufferData constants;
+    constants.M = arguments.m;
+    constants.K = arguments.k;
+    constants.N = arguments.n;
+    constants.TILE_K = mTileK;
+    commandList->SetComputeRoot32BitConstants(
+        kRootConstants, sizeof(constants) / sizeof(uint32_t), &constants, 0);
+    commandList->SetComputeRootShaderResourceView(kRootInputMatrix1, arguments.inputMatrix1);
+    commandList->SetComputeRootShaderResourceView(kRootInputMatrix2, arguments.inputMatrix2);
+    commandList->SetComputeRootUnorderedAccessView(kRootOutputMatrix, arguments.outputMatrix);
+}
 
-    mCommandList->SetPipelineState(mComputePipeline.Get());
-    mCommandList->Dispatch(dispatchX, dispatchY, 1);
+void D3D12MatMul::SubmitTimedMatMuls(
+    SubmissionQueue* queue,
+    TimestampQueryRing* timestampRing,
+    std::vector<TimestampQueryRing::RegionTiming>* timings,
+    uint32_t firstIteration,
+    uint32_t count) {
+    SubmitTimedMatMuls(
+        queue, timestampRing, timings,
+        GetMatMulArguments(mInputBuffer1.Get(), mInputBuffer2.Get(), mOutputBuffer.Get()),
+        mOutputBuffer.Get(), firstIteration, count);
+}
 
-    uint32_t endTimestampIndex = 1;
-    mCommandList->EndQuery(
-        mTimestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, endTimestampIndex);
-    mCommandList->ResolveQueryData(
-        mTimestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, beginTimestampIndex, 2,
-        mTimestampBuffer.Get(), 0);
+void D3D12MatMul::SubmitTimedMatMuls(
+    SubmissionQueue* queue,
+    TimestampQueryRing* timestampRing,
+    std::vector<TimestampQueryRing::RegionTiming>* timings,
+    const MatMulArguments& arguments,
+    ID3D12Resource* outputBuffer,
+    uint32_t firstIteration,
+    uint32_t count) {
+    TRACE_SCOPE("D3D12MatMul::SubmitTimedMatMuls");
+    // A submit can't time more dispatches than the ring has pairs of queries, so larger ones are
+    // split into several command lists.
+    const uint32_t maxRegions = timestampRing->GetMaxRegionsPerSubmit();
+    if (count > maxRegions) {
+        for (uint32_t first = 0; first < count; first += maxRegions) {
+            SubmitTimedMatMuls(
+                queue, timestampRing, timings, arguments, outputBuffer, firstIteration + first,
+                std::min(maxRegions, count - first));
+        }
+        return;
+    }
 
-    ThrowIfFailed(mCommandList->Close());
+    while (!timestampRing->BeginSubmit(count)) {
+        // All the queries are used by submits whose timestamps haven't been read back yet.
+        queue->WaitForFenceValue(timestampRing->GetOldestPendingFenceValue());
+        timestampRing->CollectCompleted(queue->GetCompletedFenceValue(), timings);
+    }
 
-    ID3D12CommandList* ppCommandLists[] = { mCommandList.Get() };
-    mQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
-    WaitForGPUCompletion();
+    int32_t dispatchX;
+    int32_t dispatchY;
+    GetDispatchSize(arguments.m, arguments.n, &dispatchX, &dispatchY);
+
+    // This only waits when the frame is still in flight, so the queue is kept fed with up to
+    // framesInFlight command lists. Starving the queue would let the dynamic throttle policy lower
+    // the GPU clock between the submits.
+    ID3D12GraphicsCommandList* commandList = queue->BeginFrame(mComputePipeline.Get());
+    RecordMatMulBindings(commandList, arguments);
+    for (uint32_t i = 0; i < count; ++i) {
+        // Serialize the dispatches so that each region only measures its own dispatch.
+        if (i > 0) {
+            RecordUAVBarrier(commandList, outputBuffer);
+        }
+        uint32_t region = timestampRing->BeginRegion(commandList, firstIteration + i);
+        commandList->Dispatch(dispatchX, dispatchY, 1);
+        timestampRing->EndRegion(commandList, region);
+    }
 
-    void* pData = nullptr;
-    ThrowIfFailed(mTimestampBuffer->Map(0, nullptr, &pData));
-    const UINT64* pTimestamps = reinterpret_cast<UINT64*>(static_cast<UINT8*>(pData));
+    timestampRing->EndSubmit(commandList, queue->GetNextFenceValue());
+    queue->SubmitFrame();
 
-    const UINT64 gpuTimeUS = ((pTimestamps[1] - pTimestamps[0]) * 1000000) / mTimestampFrequency;
-    printf("GPU execution time: %llu us\n\n", gpuTimeUS);
+    if (mResults.timeToFirstDispatchMS == 0.0) {
+        mResults.timeToFirstDispatchMS = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - mConstructionStart).count();
+        printf(
+            "Time to first dispatch: %.2f ms with %s initialization.\n\n",
+            mResults.timeToFirstDispatchMS,
+            mSettings.parallelInitialization ? "parallel" : "serial");
+    }
 
-    mTimestampBuffer->Unmap(0, nullptr);
+    // Read back the timestamps of the submits that have already completed, if any.
+    timestampRing->CollectCompleted(queue->GetCompletedFenceValue(), timings);
 }
 
-void D3D12MatMul::CheckGPUResult() {
-    std::vector<float> outputDataCPU(mM * mN);
-    std::vector<float> inputData1(mK);
-    std::vector<float> inputData2(mK);
-    printf("Do Matrix Multiplication on CPU.\n");
-    printf("Total:\t\t");
-    for (int32_t i = 0; i < mM / 100 + 1; ++i) {
-        printf("-");
+void D3D12MatMul::DoPrerecordedMatMul() {
+    TRACE_SCOPE("D3D12MatMul::DoPrerecordedMatMul");
+    const uint32_t count = std::max(1u, mSettings.iterations);
+    const uint32_t frameCount = mQueue->GetFrameCount();
+    const MatMulArguments arguments =
+        GetMatMulArguments(mInputBuffer1.Get(), mInputBuffer2.Get(), mOutputBuffer.Get());
+    int32_t dispatchX;
+    int32_t dispatchY;
+    GetDispatchSize(&dispatchX, &dispatchY);
+
+    // Only the CPU time to record and submit is measured: before starting the clock, wait for the
+    // submit that used the same frame or slot, which is what BeginFrame() or Execute() would wait
+    // for otherwise.
+    std::vector<uint64_t> fenceValues;
+    auto waitForFrame = [&](uint32_t i) {
+        if (i >= frameCount) {
+            mQueue->WaitForFenceValue(fenceValues[i - frameCount]);
+        }
+    };
+
+    std::vector<double> recordedCPUTimesUS;
+    for (uint32_t i = 0; i < count; ++i) {
+        waitForFrame(i);
+        const auto start = std::chrono::steady_clock::now();
+        ID3D12GraphicsCommandList* commandList = mQueue->BeginFrame(mComputePipeline.Get());
+        RecordMatMulBindings(commandList, arguments);
+        commandList->Dispatch(dispatchX, dispatchY, 1);
+        fenceValues.push_back(mQueue->SubmitFrame());
+        recordedCPUTimesUS.push_back(std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+    mQueue->WaitForIdle();
+
+    MatMulJob job(
+        mDevice.Get(), mQueue.get(), mRootSignature.Get(), mComputePipeline.Get(),
+        mMatMulCommandSignature.Get(), frameCount);
+    const IndirectMatMulCommand command = GetIndirectMatMulCommand(arguments);
+    fenceValues.clear();
+    std::vector<double> prerecordedCPUTimesUS;
+    for (uint32_t i = 0; i < count; ++i) {
+        waitForFrame(i);
+        const auto start = std::chrono::steady_clock::now();
+        job.Execute(command);
+        prerecordedCPUTimesUS.push_back(std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count());
+        fenceValues.push_back(mQueue->GetLastSubmittedFenceValue());
     }
+    const std::vector<double> gpuTimesUS = job.CollectGPUTimesUS();
+
+    printf("Submitting %u matrix multiplications one per command list:\n", count);
+    PrintSummaryHeader();
+    PrintSummaryRow("Record CPU (us)", Summarize(recordedCPUTimesUS));
+    PrintSummaryRow("Reuse CPU (us)", Summarize(prerecordedCPUTimesUS));
+    PrintSummaryRow("Reuse GPU (us)", Summarize(gpuTimesUS));
     printf("\n");
-    printf("Current:\t");
-    for (int32_t y = 0; y < mM; ++y) {
-        if (y % 100 == 0) {
-            printf("-");
-        }
-        for (int32_t x = 0; x < mN; ++x) {
-            for (int32_t x1 = 0; x1 < mK; ++x1) {
-                inputData1[x1] = mInputData1[y * mK + x1];
-            }
-            for (int32_t x2 = 0; x2 < mK; ++x2) {
-                inputData2[x2] = mInputData2[x2 * mK + x];
-            }
-            float output = 0;
-            for (int32_t outputIndex = 0; outputIndex < mK; ++outputIndex) {
-                output += inputData1[outputIndex] * inputData2[outputIndex];
+}
+
+void D3D12MatMul::DoJobTableMatMul(uint32_t jobCount) {
+    TRACE_SCOPE("D3D12MatMul::DoJobTableMatMul");
+    constexpr uint32_t kMaxJobSize = 512;
+    MatMulJobTable table(GetTiling());
+    table.AddRandomJobs(jobCount, kMaxJobSize, 1);
+    const std::vector<MatMulJobDesc>& jobs = table.GetJobs();
+    printf(
+        "%zu independent matrix multiplications of %u different shapes up to %ux%ux%u:\n",
+        jobs.size(), table.GetDistinctShapeCount(), kMaxJobSize, kMaxJobSize, kMaxJobSize);
+
+    // The matrices of all the jobs are packed into pooled buffers, which only live as long as
+    // this phase and alias the buffers of the other phases.
+    ResetTransientBuffers();
+    const uint64_t argumentBufferSize = jobs.size() * sizeof(IndirectMatMulCommand);
+    ComPtr<ID3D12Resource> inputPool1 = mBufferAllocator->CreateTransientBuffer(
+        table.GetInputMatrix1PoolSize(), D3D12_RESOURCE_FLAG_NONE,
+        D3D12_RESOURCE_STATE_COPY_DEST);
+    ComPtr<ID3D12Resource> inputPool2 = mBufferAllocator->CreateTransientBuffer(
+        table.GetInputMatrix2PoolSize(), D3D12_RESOURCE_FLAG_NONE,
+        D3D12_RESOURCE_STATE_COPY_DEST);
+    ComPtr<ID3D12Resource> outputPool = mBufferAllocator->CreateTransientBuffer(
+        table.GetOutputMatrixPoolSize(), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+        D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    ComPtr<ID3D12Resource> argumentBuffer = mBufferAllocator->CreateTransientBuffer(
+        argumentBufferSize, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST);
+
+    std::vector<IndirectMatMulCommand> commands(jobs.size());
+    table.BuildCommands(
+        inputPool1->GetGPUVirtualAddress(), inputPool2->GetGPUVirtualAddress(),
+        outputPool->GetGPUVirtualAddress(), commands.data());
+
+    // The whole job table is uploaded once and stays on the GPU.
+    ID3D12GraphicsCommandList* commandList = mQueue->BeginFrame();
+    for (ID3D12Resource* buffer :
+         { inputPool1.Get(), inputPool2.Get(), outputPool.Get(), argumentBuffer.Get() }) {
+        RecordAliasingBarrier(commandList, buffer);
+    }
+    mUploadRing->Reclaim(mQueue->GetCompletedFenceValue());
+    commandList = mUploadRing->Upload(
+        mQueue.get(), commandList, inputPool1.Get(), 0, table.GetInputMatrix1PoolSize(),
+        MakeInputDataWriter(kInputMatrix1Seed));
+    commandList = mUploadRing->Upload(
+        mQueue.get(), commandList, inputPool2.Get(), 0, table.GetInputMatrix2PoolSize(),
+        MakeInputDataWriter(kInputMatrix2Seed));
+    commandList = mUploadRing->Upload(
+        mQueue.get(), commandList, argumentBuffer.Get(), 0, commands.data(), argumentBufferSize);
+    RecordResourceBarrier(
+        commandList, inputPool1.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
+        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    RecordResourceBarrier(
+        commandList, inputPool2.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
+        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    RecordResourceBarrier(
+        commandList, argumentBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
+        D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+    mUploadRing->FinishSubmit(mQueue->GetNextFenceValue());
+    mQueue->SubmitFrame();
+
+    // Run the whole table once recording every job, and once with a single ExecuteIndirect.
+    const char* modes[] = { "Recorded per job", "ExecuteIndirect" };
+    double cpuTimesUS[2];
+    std::vector<TimestampQueryRing::RegionTiming> timings;
+    for (uint32_t mode = 0; mode < 2; ++mode) {
+        while (!mTimestampRing->BeginSubmit(1)) {
+            mQueue->WaitForFenceValue(mTimestampRing->GetOldestPendingFenceValue());
+            mTimestampRing->CollectCompleted(mQueue->GetCompletedFenceValue(), &timings);
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        commandList = mQueue->BeginFrame(mComputePipeline.Get());
+        uint32_t region = mTimestampRing->BeginRegion(commandList, mode);
+        if (mode == 0) {
+            for (const IndirectMatMulCommand& command : commands) {
+                MatMulArguments arguments;
+                arguments.m = command.m;
+                arguments.n = command.n;
+                arguments.k = command.k;
+                arguments.inputMatrix1 = command.inputMatrix1;
+                arguments.inputMatrix2 = command.inputMatrix2;
+                arguments.outputMatrix = command.outputMatrix;
+                RecordMatMulBindings(commandList, arguments);
+                commandList->Dispatch(
+                    command.threadGroupCountX, command.threadGroupCountY,
+                    command.threadGroupCountZ);
             }
-            outputDataCPU[y * mN + x] = output;
+        } else {
+            commandList->SetComputeRootSignature(mRootSignature.Get());
+            commandList->SetPipelineState(mComputePipeline.Get());
+            commandList->ExecuteIndirect(
+                mMatMulCommandSignature.Get(), static_cast<uint32_t>(commands.size()),
+                argumentBuffer.Get(), 0, nullptr, 0);
         }
+        mTimestampRing->EndRegion(commandList, region);
+        mTimestampRing->EndSubmit(commandList, mQueue->GetNextFenceValue());
+        mQueue->SubmitFrame();
+        cpuTimesUS[mode] = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count();
     }
-    printf("\nMatrix Multiplication on CPU is completed.\n");
+    mQueue->WaitForIdle();
+    mTimestampRing->CollectCompleted(mQueue->GetCompletedFenceValue(), &timings);
 
-    ThrowIfFailed(mCommandList->Reset(mCommandAllocator.Get(), nullptr));
+    for (const TimestampQueryRing::RegionTiming& timing : timings) {
+        const uint32_t mode = static_cast<uint32_t>(timing.regionId);
+        printf(
+            "%-18s: CPU record and submit %.1f us, GPU %.1f us, %.2f GFLOPS\n", modes[mode],
+            cpuTimesUS[mode], timing.gpuTimeUS, table.GetFlops() / (timing.gpuTimeUS * 1e3));
+    }
+    printf("\n");
 
-    const uint64_t readbackBufferSize = mM * mN * sizeof(float);
-    ComPtr<ID3D12Resource> readbackBuffer = CreateBuffer(
-        mDevice.Get(), D3D12_HEAP_TYPE_READBACK, readbackBufferSize,
-        D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST);
+}
 
+std::vector<SweepPointResult> D3D12MatMul::DoSizeSweep(
+    const std::vector<MatMulShape>& shapes,
+    std::vector<BenchmarkResults>* results) {
+    TRACE_SCOPE("D3D12MatMul::DoSizeSweep");
+    // One pooled buffer per operand, large enough for the largest point, is shared by all the
+    // points. Each point only uses the beginning of them.
+    uint64_t inputPool1Size = 0;
+    uint64_t inputPool2Size = 0;
+    uint64_t outputPoolSize = 0;
+    for (const MatMulShape& shape : shapes) {
+        inputPool1Size = std::max(inputPool1Size, uint64_t(shape.m) * shape.k * sizeof(float));
+        inputPool2Size = std::max(inputPool2Size, uint64_t(shape.k) * shape.n * sizeof(float));
+        outputPoolSize = std::max(outputPoolSize, uint64_t(shape.m) * shape.n * sizeof(float));
+    }
+    printf(
+        "Size sweep of %zu shapes with %.1f MB of pooled buffers:\n", shapes.size(),
+        (inputPool1Size + inputPool2Size + outputPoolSize) / (1024.0 * 1024.0));
+    if (shapes.empty()) {
+        return {};
+    }
+
+    // The pooled buffers only live as long as the sweep and alias the buffers of the other phases.
+    ResetTransientBuffers();
+    ComPtr<ID3D12Resource> inputPool1 = mBufferAllocator->CreateTransientBuffer(
+        inputPool1Size, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST);
+    ComPtr<ID3D12Resource> inputPool2 = mBufferAllocator->CreateTransientBuffer(
+        inputPool2Size, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST);
+    ComPtr<ID3D12Resource> outputPool = mBufferAllocator->CreateTransientBuffer(
+        outputPoolSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+        D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+    ID3D12GraphicsCommandList* commandList = mQueue->BeginFrame();
+    for (ID3D12Resource* buffer : { inputPool1.Get(), inputPool2.Get(), outputPool.Get() }) {
+        RecordAliasingBarrier(commandList, buffer);
+    }
+    mUploadRing->Reclaim(mQueue->GetCompletedFenceValue());
+    commandList = mUploadRing->Upload(
+        mQueue.get(), commandList, inputPool1.Get(), 0, inputPool1Size,
+        MakeInputDataWriter(kInputMatrix1Seed));
+    commandList = mUploadRing->Upload(
+        mQueue.get(), commandList, inputPool2.Get(), 0, inputPool2Size,
+        MakeInputDataWriter(kInputMatrix2Seed));
     RecordResourceBarrier(
-        mCommandList.Get(), mOutputBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-        D3D12_RESOURCE_STATE_COPY_SOURCE);
-    mCommandList->CopyBufferRegion(
-        readbackBuffer.Get(), 0, mOutputBuffer.Get(), 0, readbackBufferSize);
+        commandList, inputPool1.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
+        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
     RecordResourceBarrier(
-        mCommandList.Get(), mOutputBuffer.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE,
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        commandList, inputPool2.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
+        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    mUploadRing->FinishSubmit(mQueue->GetNextFenceValue());
+    mQueue->SubmitFrame();
+
+    // Every point gets its own warm-up, as the clocks and the caches settle differently for each
+    // shape.
+    std::vector<SweepPointResult> points;
+    PrintSweepHeader();
+    for (const MatMulShape& shape : shapes) {
+        MatMulArguments arguments;
+        arguments.m = static_cast<int32_t>(shape.m);
+        arguments.n = static_cast<int32_t>(shape.n);
+        arguments.k = static_cast<int32_t>(shape.k);
+        arguments.inputMatrix1 = inputPool1->GetGPUVirtualAddress();
+        arguments.inputMatrix2 = inputPool2->GetGPUVirtualAddress();
+        arguments.outputMatrix = outputPool->GetGPUVirtualAddress();
+
+        BenchmarkResults pointResults;
+        pointResults.metadata = mResults.metadata;
+        pointResults.metadata.m = arguments.m;
+        pointResults.metadata.n = arguments.n;
+        pointResults.metadata.k = arguments.k;
+        pointResults.metadata.dispatchesPerSubmit = std::max(1u, mSettings.dispatchesPerSubmit);
+        pointResults.metadata.framesInFlight = mQueue->GetFrameCount();
+        pointResults.wallTimeS =
+            MeasureMatMuls(arguments, outputPool.Get(), &pointResults.gpuTimesUS);
+        pointResults.warmupIterations = std::min<uint32_t>(
+            mSettings.warmupIterations, static_cast<uint32_t>(pointResults.gpuTimesUS.size()));
+        pointResults.flopsPerIteration = 2.0 * shape.m * shape.n * shape.k;
+
+        const std::vector<double> measuredTimesUS(
+            pointResults.gpuTimesUS.begin() + pointResults.warmupIterations,
+            pointResults.gpuTimesUS.end());
+        points.push_back(SummarizeSweepPoint(shape, measuredTimesUS));
+        PrintSweepPoint(points.back());
+        if (results != nullptr) {
+            results->push_back(std::move(pointResults));
+        }
+    }
+    printf("\n");
+    return points;
+}
+
+AsyncSubmissionQueue* D3D12MatMul::GetAsyncQueue() {
+    if (mAsyncQueue == nullptr) {
+        mCompletionThread = std::make_unique<FenceCompletionThread>();
+        mAsyncQueue = std::make_unique<AsyncSubmissionQueue>(
+            mDevice.Get(), mQueue->GetQueue(), mCompletionThread.get(), kAsyncSlotCount);
+    }
+    return mAsyncQueue.get();
+}
 
-    ThrowIfFailed(mCommandList->Close());
+uint64_t D3D12MatMul::SubmitMatMulAsync(
+    bool readBackOutput,
+    AsyncSubmissionQueue::Callback callback) {
+    const MatMulArguments arguments =
+        GetMatMulArguments(mInputBuffer1.Get(), mInputBuffer2.Get(), mOutputBuffer.Get());
+    int32_t dispatchX;
+    int32_t dispatchY;
+    GetDispatchSize(&dispatchX, &dispatchY);
+    return GetAsyncQueue()->Submit(
+        [&](ID3D12GraphicsCommandList* commandList) {
+            RecordMatMulBindings(commandList, arguments);
+            commandList->Dispatch(dispatchX, dispatchY, 1);
+        },
+        mOutputBuffer.Get(), readBackOutput ? mM * mN * sizeof(float) : 0, std::move(callback));
+}
 
-    ID3D12CommandList* ppCommandLists[] = { mCommandList.Get() };
-    mQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
-    WaitForGPUCompletion();
+std::future<SubmitCompletion> D3D12MatMul::SubmitMatMulAsync(bool readBackOutput) {
+    auto promise = std::make_shared<std::promise<SubmitCompletion>>();
+    std::future<SubmitCompletion> future = promise->get_future();
+    SubmitMatMulAsync(readBackOutput, [promise](const SubmitCompletion& completion) {
+        promise->set_value(completion);
+    });
+    return future;
+}
 
-    void* pData = nullptr;
-    ThrowIfFailed(readbackBuffer->Map(0, nullptr, &pData));
-    const float* outputData = static_cast<const float*>(pData);
+void D3D12MatMul::DoAsyncMatMul(uint32_t count) {
+    TRACE_SCOPE("D3D12MatMul::DoAsyncMatMul");
+    AsyncSubmissionQueue* asyncQueue = GetAsyncQueue();
+    count = std::max(1u, count);
+    printf(
+        "%u matrix multiplications submitted from one thread, completed by a completion "
+        "thread:\n",
+        count);
+
+    // Waiting for each future is what a blocking fence wait after each submit would do.
+    std::vector<double> blockingTimesUS(count);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < count; ++i) {
+        blockingTimesUS[i] = SubmitMatMulAsync(false).get().gpuTimeUS;
+    }
+    const std::chrono::duration<double> blockingTime = std::chrono::steady_clock::now() - start;
+
+    // The callbacks only write their own element, and WaitForIdle() synchronizes with them.
+    std::vector<double> asyncTimesUS(count);
+    std::atomic<uint32_t> completedCount(0);
+    uint32_t maxInFlight = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < count; ++i) {
+        SubmitMatMulAsync(false, [&asyncTimesUS, &completedCount, i](const SubmitCompletion& c) {
+            asyncTimesUS[i] = c.gpuTimeUS;
+            completedCount.fetch_add(1, std::memory_order_relaxed);
+        });
+        maxInFlight = std::max(maxInFlight, i + 1 - completedCount.load());
+    }
+    asyncQueue->WaitForIdle();
+    const std::chrono::duration<double> asyncTime = std::chrono::steady_clock::now() - start;
 
-    // Currently we accept at most 3 ULP between CPU and GPU results.
-    constexpr int32_t kToleranceULP = 3;
-    constexpr int32_t kToleranceInBytes = 1 << kToleranceULP;
+    PrintSummaryHeader();
+    PrintSummaryRow("Blocking GPU (us)", Summarize(blockingTimesUS));
+    PrintSummaryRow("Callbacks GPU (us)", Summarize(asyncTimesUS));
+    printf("Blocking on each submit: %.1f dispatches/s\n", count / blockingTime.count());
+    printf(
+        "Callbacks, up to %u of %u slots in flight: %.1f dispatches/s (%.2fx)\n", maxInFlight,
+        asyncQueue->GetSlotCount(), count / asyncTime.count(),
+        blockingTime.count() / asyncTime.count());
+
+    // The output is read back by the submit itself and handed over with its completion.
+    const SubmitCompletion completion = SubmitMatMulAsync(true).get();
+    InitInputData();
+    MatrixRegion region;
+    region.rowCount = mM;
+    region.columnCount = mN;
+    const int32_t checkedRowCount = std::min(mM, 4);
+    const uint64_t mismatchCount = CompareRows(
+        region, 0, checkedRowCount, reinterpret_cast<const float*>(completion.readbackData.data()),
+        nullptr, kToleranceULP);
     printf(
-        "Check the GPU result with the CPU result. Tolerance: %d ULPs\n", kToleranceULP);
-    bool acceptGPUResult = true;
-    for (int32_t y = 0; y < mM; ++y) {
-        for (int32_t x = 0; x < mN; ++x) {
-            int32_t outputDataGPUBytes = *reinterpret_cast<const int32_t*>(&outputData[y * mN + x]);
-            int32_t outputDataCPUBytes =
-                *reinterpret_cast<const int32_t*>(&outputDataCPU[y * mN + x]);
-            if (abs(outputDataGPUBytes - outputDataCPUBytes) > kToleranceInBytes) {
-                printf(
-                    "At (%d, %d): GPU: %f CPU: %f\n", x, y, outputData[y * mN + x],
-                    outputDataCPU[y * mN + x]);
-                acceptGPUResult = false;
+        "Output read back with the completion: %zu bytes, %llu mismatches in the first %d "
+        "rows\n\n",
+        completion.readbackData.size(), static_cast<unsigned long long>(mismatchCount),
+        checkedRowCount);
+}
+
+uint32_t D3D12MatMul::AcquireBatchSlot() {
+    std::unique_lock<std::mutex> lock(mBatchSlotMutex);
+    if (mBatchSlots.empty()) {
+        mBatchSlots.resize(kBatchSlotCount);
+        for (uint32_t i = 0; i < kBatchSlotCount; ++i) {
+            BatchSlot& slot = mBatchSlots[i];
+            slot.uploadBuffer = CreateUploadBuffer(
+                mDevice.Get(),
+                2 * kMaxBatchPoolSize + kMaxBatchJobCount * sizeof(IndirectMatMulCommand),
+                &slot.uploadData);
+            slot.inputPool1 = mBufferAllocator->CreateBuffer(
+                kMaxBatchPoolSize, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST,
+                &slot.inputPool1Allocation);
+            slot.inputPool2 = mBufferAllocator->CreateBuffer(
+                kMaxBatchPoolSize, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST,
+                &slot.inputPool2Allocation);
+            slot.outputPool = mBufferAllocator->CreateBuffer(
+                kMaxBatchPoolSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+                D3D12_RESOURCE_STATE_UNORDERED_ACCESS, &slot.outputPoolAllocation);
+            mFreeBatchSlots.push_back(kBatchSlotCount - 1 - i);
+        }
+    }
+    if (mFreeBatchSlots.empty()) {
+        TRACE_SCOPE("D3D12MatMul::AcquireBatchSlot wait");
+        mBatchSlotReleased.wait(lock, [this]() { return !mFreeBatchSlots.empty(); });
+    }
+    const uint32_t slot = mFreeBatchSlots.back();
+    mFreeBatchSlots.pop_back();
+    return slot;
+}
+
+void D3D12MatMul::ExecuteMatMulBatch(
+    const MatMulJobTable& table,
+    const MatMulBatchExecutor::WriteInputsFunction& writeInputs,
+    MatMulBatchExecutor::DoneFunction done) {
+    TRACE_SCOPE("D3D12MatMul::ExecuteMatMulBatch");
+    if (table.GetInputMatrix1PoolSize() > kMaxBatchPoolSize ||
+        table.GetInputMatrix2PoolSize() > kMaxBatchPoolSize ||
+        table.GetOutputMatrixPoolSize() > kMaxBatchPoolSize ||
+        table.GetJobs().size() > kMaxBatchJobCount) {
+        printf("ERROR: the batch doesn't fit in the batch slots.\n");
+        done(nullptr);
+        return;
+    }
+
+    AsyncSubmissionQueue* asyncQueue = GetAsyncQueue();
+    const uint32_t slotIndex = AcquireBatchSlot();
+    BatchSlot& slot = mBatchSlots[slotIndex];
+
+    // The commands read their arguments straight from the upload buffer, after the inputs.
+    writeInputs(slot.uploadData, slot.uploadData + kMaxBatchPoolSize);
+    const uint64_t commandOffset = 2 * kMaxBatchPoolSize;
+    table.BuildCommands(
+        slot.inputPool1->GetGPUVirtualAddress(), slot.inputPool2->GetGPUVirtualAddress(),
+        slot.outputPool->GetGPUVirtualAddress(),
+        reinterpret_cast<IndirectMatMulCommand*>(slot.uploadData + commandOffset));
+
+    // The outputs of the jobs don't overlap, so they don't need any barrier between them.
+    const uint32_t commandCount = static_cast<uint32_t>(table.GetJobs().size());
+    auto record = [&](ID3D12GraphicsCommandList* commandList) {
+        commandList->CopyBufferRegion(
+            slot.inputPool1.Get(), 0, slot.uploadBuffer.Get(), 0,
+            table.GetInputMatrix1PoolSize());
+        commandList->CopyBufferRegion(
+            slot.inputPool2.Get(), 0, slot.uploadBuffer.Get(), kMaxBatchPoolSize,
+            table.GetInputMatrix2PoolSize());
+        RecordResourceBarrier(
+            commandList, slot.inputPool1.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
+            D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        RecordResourceBarrier(
+            commandList, slot.inputPool2.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
+            D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        commandList->SetComputeRootSignature(mRootSignature.Get());
+        commandList->SetPipelineState(mComputePipeline.Get());
+        commandList->ExecuteIndirect(
+            mMatMulCommandSignature.Get(), commandCount, slot.uploadBuffer.Get(), commandOffset,
+            nullptr, 0);
+        RecordResourceBarrier(
+            commandList, slot.inputPool1.Get(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+            D3D12_RESOURCE_STATE_COPY_DEST);
+        RecordResourceBarrier(
+            commandList, slot.inputPool2.Get(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+            D3D12_RESOURCE_STATE_COPY_DEST);
+    };
+    asyncQueue->Submit(
+        record, slot.outputPool.Get(), table.GetOutputMatrixPoolSize(),
+        [this, slotIndex, done](const SubmitCompletion& completion) {
+            done(completion.readbackData.data());
+            {
+                std::lock_guard<std::mutex> lock(mBatchSlotMutex);
+                mFreeBatchSlots.push_back(slotIndex);
             }
+            mBatchSlotReleased.notify_one();
+        });
+}
+
+void D3D12MatMul::WaitForMatMulBatches() {
+    if (mAsyncQueue != nullptr) {
+        mAsyncQueue->WaitForIdle();
+    }
+}
+
+void D3D12MatMul::CreateStreamingSlots() {
+    // The inputs of every job are uploaded from the CPU copy.
+    InitInputData();
+
+    D3D12_COMMAND_QUEUE_DESC queueDescriptor = {};
+    queueDescriptor.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+    queueDescriptor.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+    ComPtr<ID3D12CommandQueue> copyQueue;
+    ThrowIfFailed(mDevice->CreateCommandQueue(&queueDescriptor, IID_PPV_ARGS(&copyQueue)));
+    mCopyQueue = std::make_unique<SubmissionQueue>(
+        mDevice.Get(), copyQueue, D3D12_COMMAND_LIST_TYPE_COPY, kCopyQueueFrameCount);
+
+    // The buffers stay in the COMMON state: buffers are implicitly promoted to the state of their
+    // first use in a command list, and decay back to COMMON when it completes, which is what lets
+    // them go back and forth between the copy and compute queues without any barrier.
+    const uint64_t inputBufferSize1 = mM * mK * sizeof(float);
+    const uint64_t inputBufferSize2 = mK * mN * sizeof(float);
+    const uint64_t outputBufferSize = mM * mN * sizeof(float);
+    mStreamingSlots.resize(kStreamingSlotCount);
+    for (uint32_t i = 0; i < kStreamingSlotCount; ++i) {
+        StreamingSlot& slot = mStreamingSlots[i];
+        slot.inputBuffer1 = mBufferAllocator->CreateBuffer(
+            inputBufferSize1, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COMMON,
+            &slot.inputBuffer1Allocation);
+        slot.inputBuffer2 = mBufferAllocator->CreateBuffer(
+            inputBufferSize2, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COMMON,
+            &slot.inputBuffer2Allocation);
+        slot.outputBuffer = mBufferAllocator->CreateBuffer(
+            outputBufferSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+            D3D12_RESOURCE_STATE_COMMON, &slot.outputBufferAllocation);
+    }
+
+    // Room for the inputs and the output of two jobs, so that the CPU can write the next inputs
+    // while the GPU copies the current ones.
+    mStreamingUploadRing = std::make_unique<UploadRing>(
+        mDevice.Get(), 2 * (inputBufferSize1 + inputBufferSize2));
+    mStreamingReadbackRing =
+        std::make_unique<ReadbackRing>(mDevice.Get(), 2 * outputBufferSize);
+}
+
+void D3D12MatMul::SubmitStreamingUpload(uint32_t job) {
+    StreamingSlot& slot = mStreamingSlots[job % kStreamingSlotCount];
+
+    // The inputs of the slot must not be overwritten before the previous job in this slot has
+    // read them.
+    ID3D12GraphicsCommandList* commandList = mCopyQueue->BeginFrame();
+    mCopyQueue->WaitOnGPU(*mQueue, slot.computeFenceValue);
+    commandList = mStreamingUploadRing->Upload(
+        mCopyQueue.get(), commandList, slot.inputBuffer1.Get(), 0, mInputData1.data(),
+        mInputData1.size() * sizeof(float));
+    commandList = mStreamingUploadRing->Upload(
+        mCopyQueue.get(), commandList, slot.inputBuffer2.Get(), 0, mInputData2.data(),
+        mInputData2.size() * sizeof(float));
+    mStreamingUploadRing->FinishSubmit(mCopyQueue->GetNextFenceValue());
+    slot.uploadFenceValue = mCopyQueue->SubmitFrame();
+}
+
+void D3D12MatMul::SubmitStreamingCompute(uint32_t job) {
+    StreamingSlot& slot = mStreamingSlots[job % kStreamingSlotCount];
+
+    int32_t dispatchX;
+    int32_t dispatchY;
+    GetDispatchSize(&dispatchX, &dispatchY);
+
+    // The readback of the previous output of the slot was submitted to the copy queue before the
+    // upload of the inputs, so waiting for the upload also waits for it.
+    mQueue->WaitOnGPU(*mCopyQueue, slot.uploadFenceValue);
+    ID3D12GraphicsCommandList* commandList = mQueue->BeginFrame(mComputePipeline.Get());
+    const MatMulArguments arguments = GetMatMulArguments(
+        slot.inputBuffer1.Get(), slot.inputBuffer2.Get(), slot.outputBuffer.Get());
+    RecordMatMulBindings(commandList, arguments);
+    commandList->Dispatch(dispatchX, dispatchY, 1);
+    slot.computeFenceValue = mQueue->SubmitFrame();
+}
+
+void D3D12MatMul::SubmitStreamingReadback(uint32_t job, ReadbackRing::Callback callback) {
+    StreamingSlot& slot = mStreamingSlots[job % kStreamingSlotCount];
+
+    ID3D12GraphicsCommandList* commandList = mCopyQueue->BeginFrame();
+    const uint64_t rowPitch = mN * sizeof(float);
+    while (!mStreamingReadbackRing->ReadRows(
+        commandList, slot.outputBuffer.Get(), rowPitch, 0, mM, 0, rowPitch, callback)) {
+        // The ring is full of outputs the CPU hasn't received yet.
+        mCopyQueue->WaitForFenceValue(mStreamingReadbackRing->GetOldestPendingFenceValue());
+        mStreamingReadbackRing->DeliverCompleted(mCopyQueue->GetCompletedFenceValue());
+    }
+    mStreamingReadbackRing->FinishSubmit(mCopyQueue->GetNextFenceValue());
+    mCopyQueue->WaitOnGPU(*mQueue, slot.computeFenceValue);
+    mCopyQueue->SubmitFrame();
+}
+
+double D3D12MatMul::RunStreamingJobs(uint32_t jobCount, bool overlap) {
+    if (mCopyQueue == nullptr) {
+        CreateStreamingSlots();
+    }
+
+    uint32_t receivedCount = 0;
+    ReadbackRing::Callback receive = [&receivedCount](const void*) {
+        ++receivedCount;
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    if (overlap) {
+        // The copy queue executes the upload of job i + 1 while the compute queue runs job i, and
+        // then reads back job i while the compute queue runs job i + 1.
+        if (jobCount > 0) {
+            SubmitStreamingUpload(0);
+        }
+        for (uint32_t job = 0; job < jobCount; ++job) {
+            SubmitStreamingCompute(job);
+            if (job + 1 < jobCount) {
+                SubmitStreamingUpload(job + 1);
+            }
+            SubmitStreamingReadback(job, receive);
+            mStreamingReadbackRing->DeliverCompleted(mCopyQueue->GetCompletedFenceValue());
+        }
+    } else {
+        for (uint32_t job = 0; job < jobCount; ++job) {
+            SubmitStreamingUpload(job);
+            SubmitStreamingCompute(job);
+            SubmitStreamingReadback(job, receive);
+            mCopyQueue->WaitForIdle();
+            mStreamingReadbackRing->DeliverCompleted(mCopyQueue->GetCompletedFenceValue());
         }
     }
-    if (acceptGPUResult) {
+    mCopyQueue->WaitForIdle();
+    mStreamingReadbackRing->DeliverCompleted(mCopyQueue->GetCompletedFenceValue());
+    const std::chrono::duration<double> wallTime = std::chrono::steady_clock::now() - start;
+
+    if (receivedCount != jobCount) {
+        printf("ERROR: %u of the %u streaming jobs were read back.\n", receivedCount, jobCount);
+    }
+    return wallTime.count();
+}
+
+void D3D12MatMul::DoStreamingMatMul(uint32_t jobCount) {
+    TRACE_SCOPE("D3D12MatMul::DoStreamingMatMul");
+    const double flopsPerJob = 2.0 * mM * mN * mK;
+    const double bytesPerJob = (mM * mK + mK * mN + mM * mN) * sizeof(float);
+    printf(
+        "Streaming %u jobs, each uploading its %dx%d and %dx%d inputs and reading back its "
+        "%dx%d output on a copy queue.\n",
+        jobCount, mM, mK, mK, mN, mM, mN);
+
+    // Warm up the queues, the rings and the GPU clocks once before measuring.
+    RunStreamingJobs(std::min(jobCount, kStreamingSlotCount), true);
+
+    const char* modes[] = { "off", "on" };
+    double wallTimes[2];
+    for (int overlap = 0; overlap < 2; ++overlap) {
+        wallTimes[overlap] = RunStreamingJobs(jobCount, overlap != 0);
+        printf(
+            "Copy/compute overlap %-3s: %.1f jobs/s, %.2f GFLOPS, %.2f GB/s transferred\n",
+            modes[overlap], jobCount / wallTimes[overlap],
+            jobCount * flopsPerJob / wallTimes[overlap] * 1e-9,
+            jobCount * bytesPerJob / wallTimes[overlap] * 1e-9);
+    }
+    if (wallTimes[1] > 0.0) {
+        printf("Speedup with overlap: %.2fx\n\n", wallTimes[0] / wallTimes[1]);
+    }
+}
+
+void D3D12MatMul::ResetTransientBuffers() {
+    mQueue->WaitForIdle();
+    mBufferAllocator->ResetTransient();
+}
+
+void D3D12MatMul::ReserveReadbackRing(uint64_t rowSize) {
+    // A single row that doesn't fit would never be read back, so the ring grows to hold several
+    // rows of the widest matrices.
+    const uint64_t size = std::max(kReadbackRingSize, 4 * rowSize);
+    if (mReadbackRing != nullptr && mReadbackRing->GetSize() >= size) {
+        return;
+    }
+    if (mReadbackRing != nullptr) {
+        mQueue->WaitForIdle();
+        mReadbackRing->DeliverCompleted(mQueue->GetCompletedFenceValue());
+    }
+    mReadbackRing = std::make_unique<ReadbackRing>(mDevice.Get(), size);
+}
+
+double D3D12MatMul::MultiplyRowsOnGPU(int32_t firstRow, int32_t rowCount, float* output) {
+    TRACE_SCOPE("D3D12MatMul::MultiplyRowsOnGPU");
+    const uint64_t rowPitch = mN * sizeof(float);
+    ReserveReadbackRing(rowPitch);
+    const auto start = std::chrono::steady_clock::now();
+
+    MatMulArguments arguments =
+        GetMatMulArguments(mInputBuffer1.Get(), mInputBuffer2.Get(), mOutputBuffer.Get());
+    arguments.m = rowCount;
+    arguments.inputMatrix1 += static_cast<uint64_t>(firstRow) * mK * sizeof(float);
+    arguments.outputMatrix += static_cast<uint64_t>(firstRow) * mN * sizeof(float);
+    int32_t dispatchX;
+    int32_t dispatchY;
+    GetDispatchSize(arguments.m, arguments.n, &dispatchX, &dispatchY);
+    ID3D12GraphicsCommandList* commandList = mQueue->BeginFrame(mComputePipeline.Get());
+    RecordMatMulBindings(commandList, arguments);
+    commandList->Dispatch(dispatchX, dispatchY, 1);
+    mQueue->SubmitFrame();
+
+    // The rows are read back in blocks small enough for several of them to be in flight, and
+    // copied into their place in the shared output as soon as each block completes.
+    const int32_t rowsPerReadback = static_cast<int32_t>(std::max<uint64_t>(
+        1, std::min<uint64_t>(rowCount, mReadbackRing->GetSize() / 4 / rowPitch)));
+    for (int32_t row = firstRow; row < firstRow + rowCount; row += rowsPerReadback) {
+        const int32_t blockRowCount = std::min(rowsPerReadback, firstRow + rowCount - row);
+        ReadbackRing::Callback merge = [=](const void* data) {
+            memcpy(&output[static_cast<size_t>(row) * mN], data, blockRowCount * rowPitch);
+        };
+
+        commandList = mQueue->BeginFrame();
+        RecordResourceBarrier(
+            commandList, mOutputBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+            D3D12_RESOURCE_STATE_COPY_SOURCE);
+        while (!mReadbackRing->ReadRows(
+            commandList, mOutputBuffer.Get(), rowPitch, row, blockRowCount, 0, rowPitch, merge)) {
+            // The ring is full of blocks that haven't been merged yet.
+            mQueue->WaitForFenceValue(mReadbackRing->GetOldestPendingFenceValue());
+            mReadbackRing->DeliverCompleted(mQueue->GetCompletedFenceValue());
+        }
+        RecordResourceBarrier(
+            commandList, mOutputBuffer.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE,
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        mReadbackRing->FinishSubmit(mQueue->GetNextFenceValue());
+        mQueue->SubmitFrame();
+        mReadbackRing->DeliverCompleted(mQueue->GetCompletedFenceValue());
+    }
+    mQueue->WaitForIdle();
+    mReadbackRing->DeliverCompleted(mQueue->GetCompletedFenceValue());
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void D3D12MatMul::DoCooperativeMatMul(const CooperativeMatMulSettings& settings) {
+    TRACE_SCOPE("D3D12MatMul::DoCooperativeMatMul");
+    InitInputData();
+    std::vector<float> output(static_cast<size_t>(mM) * mN);
+
+    // One processor is left to the thread feeding the GPU.
+    const uint32_t threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    D3D12RowRangeExecutor gpu(this, output.data());
+    CPURowRangeExecutor cpu(
+        "CPU", mN, mK, mInputData1.data(), mInputData2.data(), output.data(), threadCount);
+    CooperativeMatMulSettings cooperativeSettings = settings;
+    cooperativeSettings.rowBlockSize = static_cast<int32_t>(GetTiling().tileM);
+    printf(
+        "Cooperative %dx%dx%d multiplication on the GPU and %u CPU threads:\n", mM, mN, mK,
+        threadCount);
+    const CooperativeMatMulResult result =
+        RunCooperativeMatMul(&gpu, &cpu, mM, 2.0 * mM * mN * mK, cooperativeSettings);
+
+    // Check the rows around the last split, where the output of the GPU meets the one of the CPU.
+    const int32_t splitRow = result.splitRow;
+    MatrixRegion region;
+    region.rowCount = mM;
+    region.columnCount = mN;
+    uint64_t mismatchCount = 0;
+    for (int32_t row : { 0, splitRow - 1, splitRow, mM - 1 }) {
+        if (row >= 0 && row < mM) {
+            mismatchCount += CompareRows(
+                region, row, 1, &output[static_cast<size_t>(row) * mN], nullptr, kToleranceULP);
+        }
+    }
+    printf(
+        "Merged output: %llu mismatches in the first, last and split rows\n\n",
+        static_cast<unsigned long long>(mismatchCount));
+}
+
+const BenchmarkResults& D3D12MatMul::GetResults() const {
+    return mResults;
+}
+
+bool D3D12MatMul::HasThrottlePolicyExtension() const {
+    return mINTCExtensionContext != nullptr;
+}
+
+D3D12MatMul::PolicyQueue& D3D12MatMul::GetPolicyQueue(ThrottlePolicy policy) {
+    PolicyQueue& policyQueue = mPolicyQueues[static_cast<int>(policy)];
+    if (policyQueue.queue == nullptr) {
+        D3D12_COMMAND_QUEUE_DESC queueDescriptor = {};
+        queueDescriptor.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+        queueDescriptor.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+        policyQueue.queue = std::make_unique<SubmissionQueue>(
+            mDevice.Get(), CreateCommandQueue(queueDescriptor, ToINTCThrottlePolicy(policy)),
+            D3D12_COMMAND_LIST_TYPE_DIRECT, mSettings.framesInFlight);
+        policyQueue.timestampRing = std::make_unique<TimestampQueryRing>(
+            mDevice.Get(), kTimestampQueryCount, policyQueue.queue->GetTimestampFrequency());
+    }
+    return policyQueue;
+}
+
+std::vector<double> D3D12MatMul::RunPolicyTrial(ThrottlePolicy policy, uint32_t dispatchCount) {
+    TRACE_SCOPE("D3D12MatMul::RunPolicyTrial");
+    PolicyQueue& policyQueue = GetPolicyQueue(policy);
+
+    std::vector<TimestampQueryRing::RegionTiming> timings;
+    const uint32_t batchSize = std::max(1u, mSettings.dispatchesPerSubmit);
+    for (uint32_t submitted = 0; submitted < dispatchCount; submitted += batchSize) {
+        SubmitTimedMatMuls(
+            policyQueue.queue.get(), policyQueue.timestampRing.get(), &timings, submitted,
+            std::min(batchSize, dispatchCount - submitted));
+    }
+    policyQueue.queue->WaitForIdle();
+    policyQueue.timestampRing->CollectCompleted(
+        policyQueue.queue->GetCompletedFenceValue(), &timings);
+
+    std::vector<double> gpuTimesUS(dispatchCount);
+    for (const TimestampQueryRing::RegionTiming& timing : timings) {
+        gpuTimesUS[timing.regionId] = timing.gpuTimeUS;
+    }
+    return gpuTimesUS;
+}
+
+std::vector<DispatchLatency> D3D12MatMul::RunPolicyBurst(
+    ThrottlePolicy policy,
+    uint32_t dispatchCount,
+    double submitIntervalUS) {
+    TRACE_SCOPE("D3D12MatMul::RunPolicyBurst");
+    PolicyQueue& policyQueue = GetPolicyQueue(policy);
+
+    // Each dispatch is submitted on its own so that it starts as soon as possible, and the CPU
+    // time of its submit is compared with the GPU timestamp at its end.
+    std::vector<TimestampQueryRing::RegionTiming> timings;
+    std::vector<LARGE_INTEGER> submitTimes(dispatchCount);
+    const auto burstStart = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < dispatchCount; ++i) {
+        WaitUntil(
+            burstStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                             std::chrono::duration<double, std::micro>(submitIntervalUS * i)));
+        QueryPerformanceCounter(&submitTimes[i]);
+        SubmitTimedMatMuls(
+            policyQueue.queue.get(), policyQueue.timestampRing.get(), &timings, i, 1);
+    }
+    policyQueue.queue->WaitForIdle();
+    policyQueue.timestampRing->CollectCompleted(
+        policyQueue.queue->GetCompletedFenceValue(), &timings);
+
+    // Correlate the GPU timestamps with the CPU performance counter.
+    uint64_t gpuCalibrationTimestamp;
+    uint64_t cpuCalibrationTimestamp;
+    ThrowIfFailed(policyQueue.queue->GetQueue()->GetClockCalibration(
+        &gpuCalibrationTimestamp, &cpuCalibrationTimestamp));
+    LARGE_INTEGER cpuFrequency;
+    QueryPerformanceFrequency(&cpuFrequency);
+    const double gpuFrequency =
+        static_cast<double>(policyQueue.timestampRing->GetTimestampFrequency());
+
+    std::vector<DispatchLatency> latencies(dispatchCount);
+    for (const TimestampQueryRing::RegionTiming& timing : timings) {
+        const double endUS = (static_cast<double>(timing.endTimestamp) -
+                              static_cast<double>(gpuCalibrationTimestamp)) *
+                             1e6 / gpuFrequency;
+        const double submitUS = (static_cast<double>(submitTimes[timing.regionId].QuadPart) -
+                                 static_cast<double>(cpuCalibrationTimestamp)) *
+                                1e6 / static_cast<double>(cpuFrequency.QuadPart);
+        latencies[timing.regionId].gpuTimeUS = timing.gpuTimeUS;
+        latencies[timing.regionId].latencyUS = endUS - submitUS;
+    }
+    return latencies;
+}
+
+uint32_t D3D12MatMul::CreateScheduledQueue(const ClassQueueDesc& desc) {
+    D3D12_COMMAND_QUEUE_DESC queueDescriptor = {};
+    queueDescriptor.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+    queueDescriptor.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+    queueDescriptor.Priority = desc.priority == QueuePriority::High
+                                   ? D3D12_COMMAND_QUEUE_PRIORITY_HIGH
+                                   : D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
+
+    ScheduledQueue scheduledQueue;
+    scheduledQueue.queue = std::make_unique<SubmissionQueue>(
+        mDevice.Get(), CreateCommandQueue(queueDescriptor, ToINTCThrottlePolicy(desc.policy)),
+        D3D12_COMMAND_LIST_TYPE_DIRECT, mSettings.framesInFlight);
+    scheduledQueue.timestampRing = std::make_unique<TimestampQueryRing>(
+        mDevice.Get(), kTimestampQueryCount, scheduledQueue.queue->GetTimestampFrequency());
+    mScheduledQueues.push_back(std::move(scheduledQueue));
+    return static_cast<uint32_t>(mScheduledQueues.size() - 1);
+}
+
+void D3D12MatMul::SubmitScheduledJob(uint32_t queue, uint64_t jobId, uint32_t dispatchCount) {
+    TRACE_SCOPE("D3D12MatMul::SubmitScheduledJob");
+    ScheduledQueue& scheduledQueue = mScheduledQueues[queue];
+    dispatchCount = std::max(1u, dispatchCount);
+    SubmitTimedMatMuls(
+        scheduledQueue.queue.get(), scheduledQueue.timestampRing.get(), &scheduledQueue.timings,
+        scheduledQueue.nextRegion, dispatchCount);
+    scheduledQueue.nextRegion += dispatchCount;
+    scheduledQueue.jobs.push_back(
+        { jobId, scheduledQueue.queue->GetLastSubmittedFenceValue(), scheduledQueue.nextRegion });
+}
+
+size_t D3D12MatMul::CollectScheduledJobs(std::vector<CompletedJob>* completed) {
+    size_t inFlightCount = 0;
+    for (ScheduledQueue& scheduledQueue : mScheduledQueues) {
+        std::deque<ScheduledJob>& jobs = scheduledQueue.jobs;
+        const uint64_t completedFenceValue = scheduledQueue.queue->GetCompletedFenceValue();
+        if (!jobs.empty() && jobs.front().fenceValue <= completedFenceValue) {
+            std::vector<TimestampQueryRing::RegionTiming>& timings = scheduledQueue.timings;
+            scheduledQueue.timestampRing->CollectCompleted(completedFenceValue, &timings);
+            const std::function<double(uint64_t)> toTraceUS =
+                GetTraceClockConversion(scheduledQueue.queue.get());
+            while (!jobs.empty() && jobs.front().fenceValue <= completedFenceValue) {
+                const ScheduledJob& job = jobs.front();
+                CompletedJob completedJob = { job.jobId, 0.0, 0.0 };
+                auto end = std::find_if(
+                    timings.begin(), timings.end(),
+                    [&](const TimestampQueryRing::RegionTiming& timing) {
+                        return timing.regionId >= job.regionEnd;
+                    });
+                for (auto timing = timings.begin(); timing != end; ++timing) {
+                    completedJob.gpuTimeUS += timing->gpuTimeUS;
+                    completedJob.endTimeUS =
+                        std::max(completedJob.endTimeUS, toTraceUS(timing->endTimestamp));
+                }
+                timings.erase(timings.begin(), end);
+                completed->push_back(completedJob);
+                jobs.pop_front();
+            }
+        }
+        inFlightCount += jobs.size();
+    }
+    return inFlightCount;
+}
+
+D3D12MultiQueueExecutor::D3D12MultiQueueExecutor(D3D12MatMul* matMul) : mMatMul(matMul) {
+}
+
+const char* D3D12MultiQueueExecutor::GetName() const {
+    return "GPU";
+}
+
+uint32_t D3D12MultiQueueExecutor::CreateQueue(const ClassQueueDesc& desc) {
+    return mMatMul->CreateScheduledQueue(desc);
+}
+
+void D3D12MultiQueueExecutor::Submit(uint32_t queue, uint64_t jobId, uint32_t dispatchCount) {
+    mMatMul->SubmitScheduledJob(queue, jobId, dispatchCount);
+}
+
+double D3D12MultiQueueExecutor::GetTimeUS() {
+    return GetTraceTimeUS();
+}
+
+void D3D12MultiQueueExecutor::Wait(double timeUS, std::vector<CompletedJob>* completed) {
+    // The fences are polled at a fine grain. The latencies don't depend on how soon a completion
+    // is seen, as they are taken from the GPU timestamps.
+    constexpr double kPollIntervalUS = 100.0;
+    const size_t initialCompletedCount = completed->size();
+    while (true) {
+        const size_t inFlightCount = mMatMul->CollectScheduledJobs(completed);
+        const double nowUS = GetTraceTimeUS();
+        if (completed->size() > initialCompletedCount || nowUS >= timeUS ||
+            (inFlightCount == 0 && !std::isfinite(timeUS))) {
+            return;
+        }
+        WaitUntil(
+            std::chrono::steady_clock::now() +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double, std::micro>(
+                    std::min(timeUS - nowUS, kPollIntervalUS))));
+    }
+}
+
+D3D12PolicyTrialExecutor::D3D12PolicyTrialExecutor(D3D12MatMul* matMul) : mMatMul(matMul) {
+}
+
+const char* D3D12PolicyTrialExecutor::GetName() const {
+    return "GPU";
+}
+
+std::vector<double> D3D12PolicyTrialExecutor::RunTrial(
+    ThrottlePolicy policy,
+    uint32_t dispatchCount) {
+    return mMatMul->RunPolicyTrial(policy, dispatchCount);
+}
+
+std::vector<DispatchLatency> D3D12PolicyTrialExecutor::RunBurst(
+    ThrottlePolicy policy,
+    uint32_t dispatchCount,
+    double submitIntervalUS) {
+    return mMatMul->RunPolicyBurst(policy, dispatchCount, submitIntervalUS);
+}
+
+void D3D12PolicyTrialExecutor::Idle(double microseconds) {
+    WaitUntil(
+        std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double, std::micro>(microseconds)));
+}
+
+D3D12RowRangeExecutor::D3D12RowRangeExecutor(D3D12MatMul* matMul, float* outputMatrix)
+    : mMatMul(matMul), mOutputMatrix(outputMatrix) {
+}
+
+const char* D3D12RowRangeExecutor::GetName() const {
+    return "GPU";
+}
+
+double D3D12RowRangeExecutor::MultiplyRows(int32_t firstRow, int32_t rowCount) {
+    return mMatMul->MultiplyRowsOnGPU(firstRow, rowCount, mOutputMatrix);
+}
+
+D3D12MatMulBatchExecutor::D3D12MatMulBatchExecutor(D3D12MatMul* matMul) : mMatMul(matMul) {
+}
+
+const char* D3D12MatMulBatchExecutor::GetName() const {
+    return "GPU";
+}
+
+MatMulTiling D3D12MatMulBatchExecutor::GetTiling() const {
+    return mMatMul->GetTiling();
+}
+
+uint64_t D3D12MatMulBatchExecutor::GetMaxPoolSize() const {
+    return D3D12MatMul::kMaxBatchPoolSize;
+}
+
+uint32_t D3D12MatMulBatchExecutor::GetMaxJobCount() const {
+    return D3D12MatMul::kMaxBatchJobCount;
+}
+
+void D3D12MatMulBatchExecutor::Execute(
+    const MatMulJobTable& table,
+    const WriteInputsFunction& writeInputs,
+    DoneFunction done) {
+    mMatMul->ExecuteMatMulBatch(table, writeInputs, std::move(done));
+}
+
+void D3D12MatMulBatchExecutor::WaitForIdle() {
+    mMatMul->WaitForMatMulBatches();
+}
+
+uint64_t D3D12MatMul::CompareRows(
+    const MatrixRegion& region,
+    int32_t firstRow,
+    int32_t rowCount,
+    const float* outputData,
+    const float* referenceData,
+    int32_t toleranceULP) const {
+    TRACE_SCOPE("D3D12MatMul::CompareRows");
+    assert(toleranceULP >= 0 && toleranceULP <= kMaxToleranceULP);
+    const int32_t toleranceInBytes = 1 << toleranceULP;
+
+    uint64_t mismatchCount = 0;
+    std::vector<float> inputData2(mK);
+    for (int32_t y = firstRow; y < firstRow + rowCount; ++y) {
+        const float* inputData1 = &mInputData1[y * mK];
+        for (int32_t x = region.column; x < region.column + region.columnCount; ++x) {
+            float outputCPU = 0;
+            if (referenceData != nullptr) {
+                outputCPU = referenceData
+                    [static_cast<size_t>(y - region.row) * region.columnCount + x - region.column];
+            } else {
+                for (int32_t x2 = 0; x2 < mK; ++x2) {
+                    inputData2[x2] = mInputData2[x2 * mN + x];
+                }
+                for (int32_t outputIndex = 0; outputIndex < mK; ++outputIndex) {
+                    outputCPU += inputData1[outputIndex] * inputData2[outputIndex];
+                }
+            }
+
+            const float outputGPU =
+                outputData[(y - firstRow) * region.columnCount + x - region.column];
+            int32_t outputDataGPUBytes = *reinterpret_cast<const int32_t*>(&outputGPU);
+            int32_t outputDataCPUBytes = *reinterpret_cast<const int32_t*>(&outputCPU);
+            if (abs(outputDataGPUBytes - outputDataCPUBytes) > toleranceInBytes) {
+                printf("At (%d, %d): GPU: %f CPU: %f\n", x, y, outputGPU, outputCPU);
+                ++mismatchCount;
+            }
+        }
+    }
+    return mismatchCount;
+}
+
+std::vector<float> D3D12MatMul::ComputeNumaReference(const MatrixRegion& region) {
+    TRACE_SCOPE("D3D12MatMul::ComputeNumaReference");
+    const CPUTopology topology = DetectCPUTopology();
+    NumaMatMul matMul(topology);
+    matMul.SetInputs(
+        region.rowCount, region.columnCount, mK, &mInputData1[region.row * mK], mK,
+        &mInputData2[region.column], mN);
+    const double seconds = matMul.Multiply();
+    printf(
+        "Computed the CPU result on %u NUMA node(s) with %u threads in %.2f ms.\n",
+        matMul.GetNodeCount(), matMul.GetThreadCount(), seconds * 1e3);
+    if (matMul.GetUnpinnedThreadCount() > 0) {
+        printf(
+            "WARNING: %u of the threads could not be pinned to their processor.\n",
+            matMul.GetUnpinnedThreadCount());
+    }
+
+    std::vector<float> reference(static_cast<size_t>(region.rowCount) * region.columnCount);
+    matMul.GetOutput(reference.data());
+    return reference;
+}
+
+std::vector<float> D3D12MatMul::ComputeStrassenReference(
+    const MatrixRegion& region,
+    int32_t* toleranceULP) {
+    TRACE_SCOPE("D3D12MatMul::ComputeStrassenReference");
+    StrassenSettings settings;
+    settings.cutoff = mSettings.strassenCutoff;
+
+    // The tolerance of the classical multiplication is widened by the ratio of the two error
+    // bounds, rounded up to a power of two. Past kMaxToleranceULP, the check would accept almost
+    // any result, so the Strassen reference isn't computed.
+    const StrassenErrorBound bound =
+        GetStrassenErrorBound(region.rowCount, region.columnCount, mK, settings.cutoff);
+    const double ratio = bound.strassenFactor / bound.classicalFactor;
+    const int32_t widenedToleranceULP =
+        *toleranceULP + static_cast<int32_t>(std::ceil(std::log2(ratio)));
+    if (widenedToleranceULP > kMaxToleranceULP) {
+        printf(
+            "WARNING: the error bound of Strassen-Winograd with a cutoff of %d needs a tolerance "
+            "of %d ULPs, more than %d.\n",
+            settings.cutoff, widenedToleranceULP, kMaxToleranceULP);
+        return {};
+    }
+    *toleranceULP = widenedToleranceULP;
+
+    const float* inputData1 = &mInputData1[region.row * mK];
+    const float* inputData2 = &mInputData2[region.column];
+    std::vector<float> reference(static_cast<size_t>(region.rowCount) * region.columnCount);
+    size_t workspaceSize = 0;
+    const auto start = std::chrono::steady_clock::now();
+    MultiplyMatricesStrassen(
+        region.rowCount, region.columnCount, mK, inputData1, mK, inputData2, mN,
+        reference.data(), region.columnCount, settings, &workspaceSize);
+    const std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+
+    float maxInput1 = 0.0f;
+    for (int32_t y = 0; y < region.rowCount; ++y) {
+        for (int32_t x = 0; x < mK; ++x) {
+            maxInput1 = std::max(maxInput1, std::fabs(inputData1[y * mK + x]));
+        }
+    }
+    float maxInput2 = 0.0f;
+    for (int32_t y = 0; y < mK; ++y) {
+        for (int32_t x = 0; x < region.columnCount; ++x) {
+            maxInput2 = std::max(maxInput2, std::fabs(inputData2[y * mN + x]));
+        }
+    }
+
+    printf(
+        "Computed the CPU result with %u Strassen-Winograd levels and leaves of %d in %.2f ms "
+        "(arena: %.1f MB).\n",
+        bound.levelCount, bound.leafSize, time.count(), workspaceSize / double(1 << 20));
+    printf(
+        "Error bound: %.3g u max|A| max|B| = %.3g, %.1fx the bound of the classical "
+        "multiplication.\n",
+        bound.strassenFactor, bound.strassenFactor * std::ldexp(1.0, -24) * maxInput1 * maxInput2,
+        ratio);
+    return reference;
+}
+
+void D3D12MatMul::CheckGPUResult(const MatrixRegion& requestedRegion) {
+    TRACE_SCOPE("D3D12MatMul::CheckGPUResult");
+    InitInputData();
+
+    MatrixRegion region = requestedRegion;
+    region.row = std::min(region.row, mM);
+    region.column = std::min(region.column, mN);
+    if (region.rowCount == 0 || region.rowCount > mM - region.row) {
+        region.rowCount = mM - region.row;
+    }
+    if (region.columnCount == 0 || region.columnCount > mN - region.column) {
+        region.columnCount = mN - region.column;
+    }
+    if (region.rowCount == 0 || region.columnCount == 0) {
+        printf("WARNING: the region to check is outside of the %dx%d output.\n", mM, mN);
+        return;
+    }
+
+    // The NUMA and Strassen references are computed for the whole region before the first block
+    // is read back. The NUMA one gives the same result as the naive one, the Strassen one needs a
+    // wider tolerance.
+    std::vector<float> referenceData;
+    int32_t toleranceULP = kToleranceULP;
+    if (mSettings.cpuReference == CPUReference::Numa) {
+        referenceData = ComputeNumaReference(region);
+    } else if (mSettings.cpuReference == CPUReference::Strassen) {
+        referenceData = ComputeStrassenReference(region, &toleranceULP);
+        if (referenceData.empty()) {
+            printf("The result is checked with the NUMA partitioned reference instead.\n");
+            referenceData = ComputeNumaReference(region);
+        }
+    }
+
+    printf(
+        "Check the GPU result of rows [%d, %d) and columns [%d, %d) with the CPU result. "
+        "Tolerance: %d ULPs\n",
+        region.row, region.row + region.rowCount, region.column,
+        region.column + region.columnCount, toleranceULP);
+
+    // Only the rows and columns of the region are read back, in blocks of rows small enough for
+    // several of them to be in flight, so that the CPU checks a block while the next ones are
+    // copied.
+    const uint64_t rowSize = region.columnCount * sizeof(float);
+    ReserveReadbackRing(rowSize);
+    const int32_t rowsPerReadback = static_cast<int32_t>(std::max<uint64_t>(
+        1, std::min<uint64_t>(region.rowCount, mReadbackRing->GetSize() / 4 / rowSize)));
+
+    uint64_t mismatchCount = 0;
+    int32_t checkedRowCount = 0;
+    for (int32_t row = region.row; row < region.row + region.rowCount; row += rowsPerReadback) {
+        const int32_t rowCount = std::min(rowsPerReadback, region.row + region.rowCount - row);
+        ReadbackRing::Callback compare = [&, row, rowCount](const void* data) {
+            mismatchCount += CompareRows(
+                region, row, rowCount, static_cast<const float*>(data),
+                referenceData.empty() ? nullptr : referenceData.data(), toleranceULP);
+            checkedRowCount += rowCount;
+        };
+
+        ID3D12GraphicsCommandList* commandList = mQueue->BeginFrame();
+        RecordResourceBarrier(
+            commandList, mOutputBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+            D3D12_RESOURCE_STATE_COPY_SOURCE);
+        while (!mReadbackRing->ReadRows(
+            commandList, mOutputBuffer.Get(), mN * sizeof(float), row, rowCount,
+            region.column * sizeof(float), rowSize, compare)) {
+            // The ring is full of blocks the CPU hasn't checked yet.
+            mQueue->WaitForFenceValue(mReadbackRing->GetOldestPendingFenceValue());
+            mReadbackRing->DeliverCompleted(mQueue->GetCompletedFenceValue());
+        }
+        RecordResourceBarrier(
+            commandList, mOutputBuffer.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE,
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        mReadbackRing->FinishSubmit(mQueue->GetNextFenceValue());
+        mQueue->SubmitFrame();
+
+        mReadbackRing->DeliverCompleted(mQueue->GetCompletedFenceValue());
+    }
+    mQueue->WaitForIdle();
+    mReadbackRing->DeliverCompleted(mQueue->GetCompletedFenceValue());
+
+    printf(
+        "Checked %d rows of %d columns (%llu bytes read back).\n", checkedRowCount,
+        region.columnCount, static_cast<unsigned long long>(region.rowCount * rowSize));
+
+    VerificationSummary& verification = mResults.verification;
+    verification.checked = true;
+    verification.passed = mismatchCount == 0;
+    verification.checkedElements = static_cast<uint64_t>(checkedRowCount) * region.columnCount;
+    verification.mismatchedElements = mismatchCount;
+    verification.toleranceULP = toleranceULP;
+    if (verification.passed) {
         printf("\nThe GPU result is acceptable compared with the CPU result.\n");
     }
-    readbackBuffer->Unmap(0, nullptr);
 }
@@ -27,6 +27,14 @@
 #ifndef D3D12_MAT_MUL_
 #define D3D12_MAT_MUL_
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 #include <d3d12.h>
@@ -36,72 +44,382 @@
 #define INTC_IGDEXT_D3D12
 #include "igdext.h"
 
+#include "AsyncSubmissionQueue.h"
+#include "BenchmarkResults.h"
+#include "CPUMatMul.h"
+#include "CooperativeMatMul.h"
+#include "MatMulJob.h"
+#include "MatMulJobTable.h"
+#include "MatMulService.h"
+#include "PlacedBufferAllocator.h"
+#include "PolicyComparison.h"
+#include "PriorityScheduler.h"
+#include "ReadbackRing.h"
+#include "ShaderCache.h"
+#include "SizeSweep.h"
+#include "StrassenMatMul.h"
+#include "SubmissionQueue.h"
+#include "ThrottlePolicy.h"
+#include "TimestampQueryRing.h"
+#include "UploadRing.h"
+
 using Microsoft::WRL::ComPtr;
 
 struct Settings {
     bool disableCommandThrottlePolicyExtension = false;
+
+    // Number of dispatches executed before the measured ones. They are excluded from the reported
+    // distribution but still used to split the run into cold-start and steady-state phases.
+    uint32_t warmupIterations = 10;
+    // Number of measured dispatches. Ignored when timeBudgetMs is not 0.
+    uint32_t iterations = 100;
+    // When not 0, keep dispatching after the warm-up until this much wall time has elapsed.
+    uint32_t timeBudgetMs = 0;
+    // Number of timed dispatches recorded into one command list.
+    uint32_t dispatchesPerSubmit = 10;
+    // Number of command lists that can be in flight on the GPU while the CPU records the next one.
+    uint32_t framesInFlight = 3;
+    // The directory of the on-disk shader bytecode and pipeline state object cache, empty to
+    // disable the cache.
+    std::string shaderCacheDirectory = "ShaderCache";
+    // Run the independent stages of the initialization on several threads.
+    bool parallelInitialization = true;
+    // Keep the CPU copy of the inputs after their upload, for CheckGPUResult(). Otherwise it's
+    // generated again on first use.
+    bool keepInputData = false;
+    // How CheckGPUResult() computes the result on CPU.
+    CPUReference cpuReference = CPUReference::Naive;
+    // The size below which CPUReference::Strassen uses the classical multiplication.
+    int32_t strassenCutoff = kDefaultStrassenCutoff;
+};
+
+// A block of rows and columns of the output matrix. A count of 0 extends the block to the last row
+// or column.
+struct MatrixRegion {
+    int32_t row = 0;
+    int32_t column = 0;
+    int32_t rowCount = 0;
+    int32_t columnCount = 0;
+};
+
+// The root arguments of a dispatch of the kernel. The shape is passed as root constants and the
+// matrices as root descriptors, so neither needs any upload nor descriptor to change.
+struct MatMulArguments {
+    int32_t m;
+    int32_t n;
+    int32_t k;
+    D3D12_GPU_VIRTUAL_ADDRESS inputMatrix1;
+    D3D12_GPU_VIRTUAL_ADDRESS inputMatrix2;
+    D3D12_GPU_VIRTUAL_ADDRESS outputMatrix;
 };
 
 class D3D12MatMul {
 public:
+    // The largest pooled buffer of each operand and the most jobs of a batch of
+    // ExecuteMatMulBatch().
+    static constexpr uint64_t kMaxBatchPoolSize = 8ull << 20;
+    static constexpr uint32_t kMaxBatchJobCount = 64;
+
     explicit D3D12MatMul(const Settings& settings);
 
     // Destroy INTCExtensionContext and unload Intel extension library in the destructor
     ~D3D12MatMul();
 
-    // Do a 1024x1024 matrix multiplication and print out the GPU execution time
+    // Returns the tiling of the kernel, which only supports shapes that are multiples of it.
+    MatMulTiling GetTiling() const;
+    // Returns the size of the largest buffer the device can create.
+    uint64_t GetMaxBufferSize() const;
+
+    // Run the 1024x1024 matrix multiplication benchmark and print out the distribution of the GPU
+    // execution time.
     void DoMatMul();
 
-    // Compare the result of the last GPU matrix multiplication with the one on CPU
-    void CheckGPUResult();
+    // Compare a region of the result of the last GPU matrix multiplication with the one on CPU.
+    // Only that region is read back.
+    void CheckGPUResult(const MatrixRegion& region = {});
+
+    // Submit the measured iterations one by one, first recording a command list for each of them
+    // and then executing a pre-recorded job, and print the CPU time each submit takes.
+    void DoPrerecordedMatMul();
+
+    // Run jobCount independent matrix multiplications of random shapes from a job table, first
+    // recording each of them and then with a single ExecuteIndirect, and print their times.
+    void DoJobTableMatMul(uint32_t jobCount);
+
+    // Measure every shape with the device, the pipeline and one set of pooled buffers of this
+    // instance, and print the GFLOPS and the bandwidth of each of them. The results of every
+    // shape are appended to results if it's not null.
+    std::vector<SweepPointResult> DoSizeSweep(
+        const std::vector<MatMulShape>& shapes,
+        std::vector<BenchmarkResults>* results);
+
+    // Submit one multiplication of the current shape without blocking. callback is called on the
+    // completion thread with its GPU time and, if readBackOutput is set, the output matrix.
+    uint64_t SubmitMatMulAsync(bool readBackOutput, AsyncSubmissionQueue::Callback callback);
+    // Same with a future instead of a callback.
+    std::future<SubmitCompletion> SubmitMatMulAsync(bool readBackOutput);
+
+    // Submit count multiplications from this thread, first waiting for each of them and then
+    // keeping up to one per asynchronous slot in flight, and print the throughput of both.
+    void DoAsyncMatMul(uint32_t count);
+
+    // Execute a batch of a MatMulService with a single ExecuteIndirect on the asynchronous queue,
+    // see MatMulBatchExecutor::Execute(). Only blocks while all the batch slots are in flight.
+    // Must not be called concurrently with the other functions, except WaitForMatMulBatches().
+    void ExecuteMatMulBatch(
+        const MatMulJobTable& table,
+        const MatMulBatchExecutor::WriteInputsFunction& writeInputs,
+        MatMulBatchExecutor::DoneFunction done);
+    void WaitForMatMulBatches();
+
+    // Run jobCount jobs that each upload new inputs and read back their output on a copy queue,
+    // first one job after the other and then with the transfers of the neighbouring jobs overlapped
+    // with the computation of the current one, and print the throughput of both.
+    void DoStreamingMatMul(uint32_t jobCount);
+
+    // Split the rows of the multiplication between the GPU and the CPU, adapting the split to the
+    // throughput of both over the iterations, and print the throughput against the GPU alone.
+    void DoCooperativeMatMul(const CooperativeMatMulSettings& settings);
+    // Compute rows [firstRow, firstRow + rowCount) of the output on the GPU and read them back
+    // into output, which holds the whole output matrix. rowCount must be a multiple of the tile
+    // height. Returns the wall time in seconds.
+    double MultiplyRowsOnGPU(int32_t firstRow, int32_t rowCount, float* output);
+
+    // Returns the metadata of the run, and the results of the last DoMatMul() and
+    // CheckGPUResult().
+    const BenchmarkResults& GetResults() const;
+
+    // Returns true when the command queues can be created with a given throttle policy.
+    bool HasThrottlePolicyExtension() const;
+
+    // Execute dispatchCount timed matrix multiplications on a queue created with the given
+    // throttle policy, wait for them and return their GPU execution times in microseconds.
+    std::vector<double> RunPolicyTrial(ThrottlePolicy policy, uint32_t dispatchCount);
+
+    // Submit dispatchCount matrix multiplications one by one to the queue with the given throttle
+    // policy, one every submitIntervalUS or back to back when it is 0, and return their GPU
+    // execution times and their latencies from the submit to the end of their execution.
+    std::vector<DispatchLatency> RunPolicyBurst(
+        ThrottlePolicy policy,
+        uint32_t dispatchCount,
+        double submitIntervalUS);
+
+    // Create a command queue with the priority and the throttle policy of desc for the priority
+    // scheduler, and return its index.
+    uint32_t CreateScheduledQueue(const ClassQueueDesc& desc);
+    // Submit a job of dispatchCount timed matrix multiplications in one command list to a queue
+    // created by CreateScheduledQueue().
+    void SubmitScheduledJob(uint32_t queue, uint64_t jobId, uint32_t dispatchCount);
+    // Append the scheduled jobs that have completed to completed, with the end of their last
+    // dispatch on the trace clock, and return the number of jobs still in flight.
+    size_t CollectScheduledJobs(std::vector<CompletedJob>* completed);
 
 private:
+    // The buffers of one streaming job, reused by every kStreamingSlotCount-th job.
+    struct StreamingSlot {
+        ComPtr<ID3D12Resource> inputBuffer1;
+        ComPtr<ID3D12Resource> inputBuffer2;
+        ComPtr<ID3D12Resource> outputBuffer;
+        HeapAllocation inputBuffer1Allocation;
+        HeapAllocation inputBuffer2Allocation;
+        HeapAllocation outputBufferAllocation;
+        // The copy queue fence value signaled after the upload of the inputs of the last job.
+        uint64_t uploadFenceValue = 0;
+        // The compute queue fence value signaled after the last job.
+        uint64_t computeFenceValue = 0;
+    };
+
+    // The buffers of a batch of ExecuteMatMulBatch(), reused once its previous batch has
+    // completed.
+    struct BatchSlot {
+        // The pooled inputs, then the indirect commands. Persistently mapped.
+        ComPtr<ID3D12Resource> uploadBuffer;
+        uint8_t* uploadData = nullptr;
+        ComPtr<ID3D12Resource> inputPool1;
+        ComPtr<ID3D12Resource> inputPool2;
+        ComPtr<ID3D12Resource> outputPool;
+        HeapAllocation inputPool1Allocation;
+        HeapAllocation inputPool2Allocation;
+        HeapAllocation outputPoolAllocation;
+    };
+
+    struct PolicyQueue {
+        std::unique_ptr<SubmissionQueue> queue;
+        std::unique_ptr<TimestampQueryRing> timestampRing;
+    };
+
+    struct ScheduledJob {
+        uint64_t jobId;
+        uint64_t fenceValue;
+        // The timed regions of the job end before this one.
+        uint32_t regionEnd;
+    };
+
+    struct ScheduledQueue {
+        std::unique_ptr<SubmissionQueue> queue;
+        std::unique_ptr<TimestampQueryRing> timestampRing;
+        // The timings of the regions that don't belong to a completed job yet.
+        std::vector<TimestampQueryRing::RegionTiming> timings;
+        std::deque<ScheduledJob> jobs;
+        uint32_t nextRegion = 0;
+    };
+
     // Initialize D3D12 resources
     void InitDevice();
     void InitQueue(const Settings& settings);
+    // Create a command queue with the given throttle policy, or with the default one if the
+    // Command Throttle Policy Extension is not available.
+    ComPtr<ID3D12CommandQueue> CreateCommandQueue(
+        D3D12_COMMAND_QUEUE_DESC queueDescriptor,
+        INTC_D3D12_COMMAND_QUEUE_THROTTLE_POLICY throttlePolicy);
 
-    void InitResources();
-    void CreateDescriptorHeap();
     void CreateRootSignature();
+    // Get the bytecode of the kernel from the embedded shader library, or else from the shader
+    // cache or the HLSL compiler, and add what it depends on to shaderKey. Returns where the
+    // bytecode comes from.
+    const char* LoadComputeShader(std::vector<uint8_t>* bytecode, ShaderCacheKey* shaderKey);
     void CreateComputePipeline();
     void CreateBuffers();
-    void CreateBufferViews();
     void CreateTimestampQueryHeap();
-    void CreateCommandList();
 
+    // Upload the inputs to the GPU, without waiting for the upload.
     void InitBufferData();
+    // Generate the CPU copy of the inputs if it was released.
+    void InitInputData();
 
     // Initialize Intel D3D12 extension
     bool InitIntelExtension();
 
-    void WaitForGPUCompletion();
+    void GetDispatchSize(int32_t* dispatchX, int32_t* dispatchY) const;
+    void GetDispatchSize(int32_t m, int32_t n, int32_t* dispatchX, int32_t* dispatchY) const;
+
+    // Returns the arguments of the multiplication of the current shape with these buffers.
+    MatMulArguments GetMatMulArguments(
+        ID3D12Resource* inputBuffer1,
+        ID3D12Resource* inputBuffer2,
+        ID3D12Resource* outputBuffer) const;
+    // Returns the indirect command that multiplies with the given arguments.
+    IndirectMatMulCommand GetIndirectMatMulCommand(const MatMulArguments& arguments) const;
+    // Set the root signature, the pipeline and the root arguments of the next dispatches.
+    void RecordMatMulBindings(
+        ID3D12GraphicsCommandList* commandList,
+        const MatMulArguments& arguments);
+
+    // Record and execute count dispatches in one command list on queue, each of them timed in its
+    // own region identified by its iteration index. Only waits for the GPU when the frame it
+    // records into is still in flight. The timings that are already available are appended to
+    // timings.
+    void SubmitTimedMatMuls(
+        SubmissionQueue* queue,
+        TimestampQueryRing* timestampRing,
+        std::vector<TimestampQueryRing::RegionTiming>* timings,
+        uint32_t firstIteration,
+        uint32_t count);
+    // Same with the given arguments instead of the current shape and buffers.
+    void SubmitTimedMatMuls(
+        SubmissionQueue* queue,
+        TimestampQueryRing* timestampRing,
+        std::vector<TimestampQueryRing::RegionTiming>* timings,
+        const MatMulArguments& arguments,
+        ID3D12Resource* outputBuffer,
+        uint32_t firstIteration,
+        uint32_t count);
+    // Run the warm-up and the measured iterations of the settings on mQueue, and return their
+    // wall time in seconds. The GPU time of every iteration, warm-up included, is written to
+    // gpuTimesUS.
+    double MeasureMatMuls(
+        const MatMulArguments& arguments,
+        ID3D12Resource* outputBuffer,
+        std::vector<double>* gpuTimesUS);
+
+    // Returns the function that converts the GPU timestamps of queue to the trace clock.
+    std::function<double(uint64_t)> GetTraceClockConversion(SubmissionQueue* queue) const;
+    // Add the timed regions of queue to the trace, converted to the trace clock.
+    void TraceGPUTimings(
+        SubmissionQueue* queue,
+        const char* track,
+        const std::vector<TimestampQueryRing::RegionTiming>& timings) const;
+
+    // Create the copy queue and the buffers of the streaming jobs.
+    void CreateStreamingSlots();
+    // Submit the stages of a streaming job, synchronized with the other queue with GPU waits.
+    void SubmitStreamingUpload(uint32_t job);
+    void SubmitStreamingCompute(uint32_t job);
+    void SubmitStreamingReadback(uint32_t job, ReadbackRing::Callback callback);
+    // Run jobCount streaming jobs and return their wall time in seconds.
+    double RunStreamingJobs(uint32_t jobCount, bool overlap);
+
+    // Returns the asynchronous queue on the same command queue as mQueue, creating it and the
+    // completion thread on first use.
+    AsyncSubmissionQueue* GetAsyncQueue();
+
+    // Returns a free batch slot, creating the slots on first use and waiting for one of them to
+    // complete if they are all in flight.
+    uint32_t AcquireBatchSlot();
+
+    // Returns the queue with the given throttle policy, creating it on first use.
+    PolicyQueue& GetPolicyQueue(ThrottlePolicy policy);
+
+    // Wait for the GPU to be done with the transient buffers of the previous phase, so that the
+    // transient buffers created from now on can reuse their memory.
+    void ResetTransientBuffers();
+
+    // Create the readback ring, or replace it with a larger one, so that it holds at least four
+    // rows of rowSize bytes.
+    void ReserveReadbackRing(uint64_t rowSize);
+    // Compare rowCount rows of region starting at firstRow, read back packed in outputData, with
+    // the result on CPU. referenceData is the result of the whole region packed, or nullptr to
+    // compute it here. Returns the number of elements that differ by more than the tolerance.
+    uint64_t CompareRows(
+        const MatrixRegion& region,
+        int32_t firstRow,
+        int32_t rowCount,
+        const float* outputData,
+        const float* referenceData,
+        int32_t toleranceULP) const;
+
+    // Compute the result of region on CPU with NumaMatMul, packed.
+    std::vector<float> ComputeNumaReference(const MatrixRegion& region);
+    // Compute the result of region on CPU with Strassen-Winograd, packed, and widen toleranceULP
+    // by its error bound. Returns an empty result if the widened tolerance would be too large.
+    std::vector<float> ComputeStrassenReference(const MatrixRegion& region, int32_t* toleranceULP);
 
     void PrintAdapterInfo();
 
+    Settings mSettings;
+    // For the time to first dispatch.
+    std::chrono::steady_clock::time_point mConstructionStart;
+    BenchmarkResults mResults;
+
     ComPtr<IDXGIAdapter1> mHardwareAdapter;
     ComPtr<ID3D12Device> mDevice;
 
-    HANDLE mFenceEvent;
-    UINT64 mFenceValue;
-    ComPtr<ID3D12Fence> mFence;
-    ComPtr<ID3D12CommandQueue> mQueue;
+    std::unique_ptr<SubmissionQueue> mQueue;
+    // Created on first use, for the transfers of the streaming jobs.
+    std::unique_ptr<SubmissionQueue> mCopyQueue;
 
-    ComPtr<ID3D12CommandAllocator> mCommandAllocator;
-    ComPtr<ID3D12GraphicsCommandList> mCommandList;
-
-    ComPtr<ID3D12DescriptorHeap> mCBVSRVUAVHeap;
-    uint32_t mCBVSRCUAVDescriptorSize;
     ComPtr<ID3DBlob> mRootSignatureBlob;
     ComPtr<ID3D12RootSignature> mRootSignature;
     ComPtr<ID3D12PipelineState> mComputePipeline;
-    ComPtr<ID3D12Resource> mConstantBuffer;
+    ComPtr<ID3D12CommandSignature> mMatMulCommandSignature;
+    std::unique_ptr<ShaderCache> mShaderCache;
+    // Declared before the buffers placed in its heaps so that it outlives them.
+    std::unique_ptr<PlacedBufferAllocator> mBufferAllocator;
     ComPtr<ID3D12Resource> mInputBuffer1;
     ComPtr<ID3D12Resource> mInputBuffer2;
     ComPtr<ID3D12Resource> mOutputBuffer;
+    HeapAllocation mInputBuffer1Allocation;
+    HeapAllocation mInputBuffer2Allocation;
+    HeapAllocation mOutputBufferAllocation;
+    std::unique_ptr<UploadRing> mUploadRing;
+    std::unique_ptr<ReadbackRing> mReadbackRing;
+    std::vector<StreamingSlot> mStreamingSlots;
+    std::unique_ptr<UploadRing> mStreamingUploadRing;
+    std::unique_ptr<ReadbackRing> mStreamingReadbackRing;
 
     uint64_t mTimestampFrequency;
-    ComPtr<ID3D12QueryHeap> mTimestampQueryHeap;
-    ComPtr<ID3D12Resource> mTimestampBuffer;
+    std::unique_ptr<TimestampQueryRing> mTimestampRing;
+    std::vector<TimestampQueryRing::RegionTiming> mRegionTimings;
 
     std::vector<float> mInputData1;
     std::vector<float> mInputData2;
@@ -118,6 +436,89 @@ private:
 
     // The pointer to an Intel D3D12 extension context.
     INTCExtensionContext* mINTCExtensionContext = nullptr;
+
+    // Created on first use, and guarded by mBatchSlotMutex.
+    std::vector<BatchSlot> mBatchSlots;
+    std::mutex mBatchSlotMutex;
+    std::condition_variable mBatchSlotReleased;
+    std::vector<uint32_t> mFreeBatchSlots;
+
+    // Created on first use. The asynchronous queue waits for the callbacks of its submits, so it's
+    // destroyed before the completion thread and the resources its submits use.
+    std::unique_ptr<FenceCompletionThread> mCompletionThread;
+    std::unique_ptr<AsyncSubmissionQueue> mAsyncQueue;
+
+    // The queues used to compare the throttle policies, indexed by ThrottlePolicy and created on
+    // first use, and the queues of the priority scheduler. They are declared last so that they
+    // are destroyed, and therefore idle, before the resources they use are released.
+    std::vector<ScheduledQueue> mScheduledQueues;
+    PolicyQueue mPolicyQueues[kThrottlePolicyCount];
+};
+
+// Runs the throttle policy comparison trials on the GPU, with one queue per throttle policy.
+class D3D12PolicyTrialExecutor : public PolicyTrialExecutor {
+public:
+    explicit D3D12PolicyTrialExecutor(D3D12MatMul* matMul);
+
+    const char* GetName() const override;
+    std::vector<double> RunTrial(ThrottlePolicy policy, uint32_t dispatchCount) override;
+    std::vector<DispatchLatency> RunBurst(
+        ThrottlePolicy policy,
+        uint32_t dispatchCount,
+        double submitIntervalUS) override;
+    void Idle(double microseconds) override;
+
+private:
+    D3D12MatMul* mMatMul;
+};
+
+// Runs the jobs of the priority scheduler on the GPU, with one command queue per distinct queue
+// priority and throttle policy.
+class D3D12MultiQueueExecutor : public MultiQueueExecutor {
+public:
+    explicit D3D12MultiQueueExecutor(D3D12MatMul* matMul);
+
+    const char* GetName() const override;
+    uint32_t CreateQueue(const ClassQueueDesc& desc) override;
+    void Submit(uint32_t queue, uint64_t jobId, uint32_t dispatchCount) override;
+    // The trace clock, which the GPU timestamps are converted to.
+    double GetTimeUS() override;
+    void Wait(double timeUS, std::vector<CompletedJob>* completed) override;
+
+private:
+    D3D12MatMul* mMatMul;
+};
+
+// Computes rows of the output on the GPU and reads them back into the shared output.
+class D3D12RowRangeExecutor : public RowRangeExecutor {
+public:
+    D3D12RowRangeExecutor(D3D12MatMul* matMul, float* outputMatrix);
+
+    const char* GetName() const override;
+    double MultiplyRows(int32_t firstRow, int32_t rowCount) override;
+
+private:
+    D3D12MatMul* mMatMul;
+    float* mOutputMatrix;
+};
+
+// Executes the batches of a MatMulService on the GPU with the pipeline of a D3D12MatMul.
+class D3D12MatMulBatchExecutor : public MatMulBatchExecutor {
+public:
+    explicit D3D12MatMulBatchExecutor(D3D12MatMul* matMul);
+
+    const char* GetName() const override;
+    MatMulTiling GetTiling() const override;
+    uint64_t GetMaxPoolSize() const override;
+    uint32_t GetMaxJobCount() const override;
+    void Execute(
+        const MatMulJobTable& table,
+        const WriteInputsFunction& writeInputs,
+        DoneFunction done) override;
+    void WaitForIdle() override;
+
+private:
+    D3D12MatMul* mMatMul;
 };
 
 #endif
@@ -0,0 +1,168 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "FenceCompletionThread.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include "DXSampleHelper.h"
+#include "Tracer.h"
+
+namespace {
+
+// The smallest fence value on the top of the heap, and the first added of equal values.
+bool IsLater(uint64_t valueA, uint64_t orderA, uint64_t valueB, uint64_t orderB) {
+    return valueA != valueB ? valueA > valueB : orderA > orderB;
+}
+
+HANDLE CreateAutoResetEvent() {
+    HANDLE event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if (event == nullptr) {
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+    }
+    return event;
+}
+
+}  // anonymous namespace
+
+FenceCompletionThread::FenceCompletionThread() : mWakeEvent(CreateAutoResetEvent()) {
+    mThread = std::thread(&FenceCompletionThread::Run, this);
+}
+
+FenceCompletionThread::~FenceCompletionThread() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    SetEvent(mWakeEvent);
+    mThread.join();
+
+    for (const std::unique_ptr<WatchedFence>& watchedFence : mFences) {
+        CloseHandle(watchedFence->event);
+    }
+    CloseHandle(mWakeEvent);
+}
+
+void FenceCompletionThread::NotifyOnCompletion(
+    ID3D12Fence* fence,
+    uint64_t fenceValue,
+    Callback callback) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto watchedFence = std::find_if(
+            mFences.begin(), mFences.end(),
+            [&](const std::unique_ptr<WatchedFence>& watched) {
+                return watched->fence.Get() == fence;
+            });
+        if (watchedFence == mFences.end()) {
+            // WaitForMultipleObjects() waits for at most MAXIMUM_WAIT_OBJECTS handles, the
+            // wake-up event included.
+            if (mFences.size() + 1 >= MAXIMUM_WAIT_OBJECTS) {
+                throw std::runtime_error("The fence completion thread watches too many fences");
+            }
+            auto newFence = std::make_unique<WatchedFence>();
+            newFence->fence = fence;
+            newFence->event = CreateAutoResetEvent();
+            watchedFence = mFences.insert(mFences.end(), std::move(newFence));
+        }
+
+        std::vector<PendingCallback>& pendingCallbacks = (*watchedFence)->pendingCallbacks;
+        pendingCallbacks.push_back({ fenceValue, mNextOrder++, std::move(callback) });
+        std::push_heap(
+            pendingCallbacks.begin(), pendingCallbacks.end(),
+            [](const PendingCallback& a, const PendingCallback& b) {
+                return IsLater(a.fenceValue, a.order, b.fenceValue, b.order);
+            });
+    }
+    SetEvent(mWakeEvent);
+}
+
+void FenceCompletionThread::Run() {
+    auto isLater = [](const PendingCallback& a, const PendingCallback& b) {
+        return IsLater(a.fenceValue, a.order, b.fenceValue, b.order);
+    };
+
+    std::vector<HANDLE> events;
+    std::vector<Callback> completedCallbacks;
+    while (true) {
+        events.assign(1, mWakeEvent);
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            bool hasPendingCallbacks = false;
+            for (const std::unique_ptr<WatchedFence>& watchedFence : mFences) {
+                std::vector<PendingCallback>& pendingCallbacks = watchedFence->pendingCallbacks;
+                const uint64_t completedValue = watchedFence->fence->GetCompletedValue();
+                while (!pendingCallbacks.empty() &&
+                       pendingCallbacks.front().fenceValue <= completedValue) {
+                    std::pop_heap(pendingCallbacks.begin(), pendingCallbacks.end(), isLater);
+                    completedCallbacks.push_back(std::move(pendingCallbacks.back().callback));
+                    pendingCallbacks.pop_back();
+                }
+                if (pendingCallbacks.empty()) {
+                    watchedFence->armedValue = 0;
+                } else {
+                    // Signals the event right away if the value completed in the meantime. The
+                    // event stays armed for the value while it is pending.
+                    const uint64_t fenceValue = pendingCallbacks.front().fenceValue;
+                    if (watchedFence->armedValue != fenceValue) {
+                        ThrowIfFailed(watchedFence->fence->SetEventOnCompletion(
+                            fenceValue, watchedFence->event));
+                        watchedFence->armedValue = fenceValue;
+                    }
+                    events.push_back(watchedFence->event);
+                    hasPendingCallbacks = true;
+                }
+            }
+            if (completedCallbacks.empty() && !hasPendingCallbacks && mStopping) {
+                return;
+            }
+        }
+
+        // The callbacks are called without the lock so that they can add new ones.
+        if (!completedCallbacks.empty()) {
+            TRACE_SCOPE("FenceCompletionThread callbacks");
+            for (Callback& callback : completedCallbacks) {
+                callback();
+            }
+            completedCallbacks.clear();
+            continue;
+        }
+
+        const DWORD result = WaitForMultipleObjects(
+            static_cast<DWORD>(events.size()), events.data(), FALSE, INFINITE);
+        if (result == WAIT_FAILED) {
+            ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+        } else if (result >= WAIT_OBJECT_0 + events.size()) {
+            // WAIT_TIMEOUT or WAIT_ABANDONED_0, which an infinite wait for events can't return.
+            printf(
+                "ERROR: WaitForMultipleObjects returned %lu.\n",
+                static_cast<unsigned long>(result));
+            ThrowIfFailed(E_UNEXPECTED);
+        }
+    }
+}
@@ -0,0 +1,95 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef FENCE_COMPLETION_THREAD_
+#define FENCE_COMPLETION_THREAD_
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <d3d12.h>
+#include <wrl.h>
+
+using Microsoft::WRL::ComPtr;
+
+// A thread that calls callbacks when fences reach given values, so that no other thread has to
+// block on a fence.
+//
+// Each fence has one event, armed with SetEventOnCompletion() for the smallest value waited for
+// on it, and the thread waits for the events of all the fences and a wake-up event at once. The
+// callbacks of a fence are called in the order of their values on the completion thread, which
+// they must not block for long. A callback must never wait for another callback, which would
+// deadlock, for instance by submitting to an AsyncSubmissionQueue whose slots are all in flight.
+class FenceCompletionThread {
+public:
+    using Callback = std::function<void()>;
+
+    FenceCompletionThread();
+    // Calls the remaining callbacks as their fences complete, then stops the thread.
+    ~FenceCompletionThread();
+
+    FenceCompletionThread(const FenceCompletionThread&) = delete;
+    FenceCompletionThread& operator=(const FenceCompletionThread&) = delete;
+
+    // Call callback on the completion thread once fence has reached fenceValue. Can be called
+    // from any thread, including from a callback. Throws std::runtime_error if fence would be
+    // one fence more than the MAXIMUM_WAIT_OBJECTS - 1 that can be watched.
+    void NotifyOnCompletion(ID3D12Fence* fence, uint64_t fenceValue, Callback callback);
+
+private:
+    struct PendingCallback {
+        uint64_t fenceValue;
+        // Keeps the callbacks of a fence value in the order they were added.
+        uint64_t order;
+        Callback callback;
+    };
+
+    struct WatchedFence {
+        ComPtr<ID3D12Fence> fence;
+        HANDLE event = nullptr;
+        // The value event is armed for, or 0 if none, so that it is only armed again once the
+        // smallest pending value changes.
+        uint64_t armedValue = 0;
+        // A min-heap on the fence value.
+        std::vector<PendingCallback> pendingCallbacks;
+    };
+
+    void Run();
+
+    std::mutex mMutex;
+    std::vector<std::unique_ptr<WatchedFence>> mFences;
+    uint64_t mNextOrder = 0;
+    bool mStopping = false;
+    // Set when a callback is added or the thread has to stop, to rearm the fence events.
+    HANDLE mWakeEvent = nullptr;
+    // Started last, once everything it uses is initialized.
+    std::thread mThread;
+};
+
+#endif
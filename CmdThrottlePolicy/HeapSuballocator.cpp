@@ -0,0 +1,210 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "HeapSuballocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+namespace {
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // anonymous namespace
+
+HeapSuballocator::HeapSuballocator(const Desc& desc) : mDesc(desc) {
+    assert(mDesc.heapSize % mDesc.blockAlignment == 0);
+    mFreeBlocks.resize(GetSizeClass(mDesc.heapSize) + 1);
+}
+
+HeapAllocation HeapSuballocator::Allocate(uint64_t size) {
+    ++mStats.allocationCount;
+    mStats.requestedBytes += size;
+
+    if (size > mDesc.heapSize) {
+        // Reuse a free dedicated heap if it doesn't waste more than half of it.
+        for (size_t i = 0; i < mFreeDedicatedBlocks.size(); ++i) {
+            HeapAllocation allocation = mFreeDedicatedBlocks[i];
+            if (allocation.size >= size && allocation.size / 2 < size) {
+                mFreeDedicatedBlocks.erase(mFreeDedicatedBlocks.begin() + i);
+                ++mStats.recycledCount;
+                mStats.allocatedBytes += allocation.size;
+                return allocation;
+            }
+        }
+        const uint64_t heapSize = AlignUp(size, mDesc.blockAlignment);
+        mStats.allocatedBytes += heapSize;
+        return { AddHeap(heapSize, HeapKind::Dedicated), 0, heapSize, kDedicatedSizeClass, false };
+    }
+
+    const uint32_t sizeClass = GetSizeClass(size);
+    const uint64_t blockSize = GetSizeClassSize(sizeClass);
+    mStats.allocatedBytes += blockSize;
+    if (!mFreeBlocks[sizeClass].empty()) {
+        HeapAllocation allocation = mFreeBlocks[sizeClass].back();
+        mFreeBlocks[sizeClass].pop_back();
+        ++mStats.recycledCount;
+        return allocation;
+    }
+
+    // The blocks are multiples of the alignment, so carving them one after the other keeps them
+    // aligned.
+    uint32_t heapIndex = UINT32_MAX;
+    for (uint32_t i = 0; i < mHeaps.size(); ++i) {
+        if (mHeaps[i].kind == HeapKind::Regular &&
+            mHeaps[i].size - mHeaps[i].usedSize >= blockSize) {
+            heapIndex = i;
+            break;
+        }
+    }
+    if (heapIndex == UINT32_MAX) {
+        heapIndex = AddHeap(mDesc.heapSize, HeapKind::Regular);
+    }
+
+    HeapAllocation allocation = { heapIndex, mHeaps[heapIndex].usedSize, blockSize, sizeClass,
+                                  false };
+    mHeaps[heapIndex].usedSize += blockSize;
+    return allocation;
+}
+
+void HeapSuballocator::Free(const HeapAllocation& allocation, uint64_t requestedSize) {
+    assert(!allocation.transient);
+    mStats.allocatedBytes -= allocation.size;
+    mStats.requestedBytes -= requestedSize;
+    if (allocation.sizeClass == kDedicatedSizeClass) {
+        mFreeDedicatedBlocks.push_back(allocation);
+    } else {
+        mFreeBlocks[allocation.sizeClass].push_back(allocation);
+    }
+}
+
+HeapAllocation HeapSuballocator::AllocateTransient(uint64_t size) {
+    const uint64_t blockSize = AlignUp(size, mDesc.blockAlignment);
+    while (mCurrentTransientHeap < mTransientHeaps.size() &&
+           mHeaps[mTransientHeaps[mCurrentTransientHeap]].size - mTransientOffset < blockSize) {
+        ++mCurrentTransientHeap;
+        mTransientOffset = 0;
+    }
+    if (mCurrentTransientHeap == mTransientHeaps.size()) {
+        mTransientHeaps.push_back(
+            AddHeap(std::max(mDesc.heapSize, blockSize), HeapKind::Transient));
+        mTransientOffset = 0;
+    }
+
+    const uint32_t heapIndex = mTransientHeaps[mCurrentTransientHeap];
+    HeapAllocation allocation = { heapIndex, mTransientOffset, blockSize, kDedicatedSizeClass,
+                                  true };
+    mTransientOffset += blockSize;
+    mHeaps[heapIndex].usedSize = std::max(mHeaps[heapIndex].usedSize, mTransientOffset);
+    return allocation;
+}
+
+void HeapSuballocator::ResetTransient() {
+    mCurrentTransientHeap = 0;
+    mTransientOffset = 0;
+}
+
+uint32_t HeapSuballocator::GetHeapCount() const {
+    return static_cast<uint32_t>(mHeaps.size());
+}
+
+uint64_t HeapSuballocator::GetHeapSize(uint32_t heapIndex) const {
+    return mHeaps[heapIndex].size;
+}
+
+const HeapSuballocator::Stats& HeapSuballocator::GetStats() const {
+    return mStats;
+}
+
+uint32_t HeapSuballocator::GetSizeClass(uint64_t size) const {
+    uint32_t sizeClass = 0;
+    while (GetSizeClassSize(sizeClass) < size) {
+        ++sizeClass;
+    }
+    return sizeClass;
+}
+
+uint64_t HeapSuballocator::GetSizeClassSize(uint32_t sizeClass) const {
+    return mDesc.blockAlignment << sizeClass;
+}
+
+uint32_t HeapSuballocator::AddHeap(uint64_t size, HeapKind kind) {
+    mHeaps.push_back({ size, kind == HeapKind::Dedicated ? size : 0, kind });
+    mStats.heapBytes += size;
+    return static_cast<uint32_t>(mHeaps.size() - 1);
+}
+
+void BenchmarkHeapSuballocator(uint32_t operationCount, uint32_t seed) {
+    struct LiveBuffer {
+        HeapAllocation allocation;
+        uint64_t size;
+    };
+
+    std::mt19937 random(seed);
+    // Square float matrices from 64x64 to 8192x8192, like the ones of a size sweep.
+    std::uniform_int_distribution<uint32_t> dimensionLog2(6, 13);
+    HeapSuballocator allocator((HeapSuballocator::Desc()));
+    std::vector<LiveBuffer> liveBuffers;
+    uint64_t peakAllocatedBytes = 0;
+    uint64_t peakRequestedBytes = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < operationCount; ++i) {
+        // Keep around 64 live buffers.
+        if (liveBuffers.size() > 64 || (!liveBuffers.empty() && random() % 2 == 0)) {
+            const size_t index = random() % liveBuffers.size();
+            allocator.Free(liveBuffers[index].allocation, liveBuffers[index].size);
+            liveBuffers[index] = liveBuffers.back();
+            liveBuffers.pop_back();
+        } else {
+            const uint64_t dimension = uint64_t(1) << dimensionLog2(random);
+            // Not exactly a power of two, as with odd problem sizes.
+            const uint64_t size = dimension * (dimension - random() % 8) * sizeof(float);
+            liveBuffers.push_back({ allocator.Allocate(size), size });
+        }
+        peakAllocatedBytes = std::max(peakAllocatedBytes, allocator.GetStats().allocatedBytes);
+        peakRequestedBytes = std::max(peakRequestedBytes, allocator.GetStats().requestedBytes);
+    }
+    const std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    const HeapSuballocator::Stats& stats = allocator.GetStats();
+    printf(
+        "Heap sub-allocator: %u operations in %.2f ms, %.1f ns per operation\n", operationCount,
+        elapsed.count() / 1e6, elapsed.count() / operationCount);
+    printf(
+        "%llu allocations, %.1f%% recycled, %u heaps (%.1f MB), peak allocated %.1f MB for "
+        "%.1f MB requested\n\n",
+        static_cast<unsigned long long>(stats.allocationCount),
+        stats.allocationCount > 0 ? 100.0 * stats.recycledCount / stats.allocationCount : 0.0,
+        allocator.GetHeapCount(), stats.heapBytes / 1048576.0, peakAllocatedBytes / 1048576.0,
+        peakRequestedBytes / 1048576.0);
+}
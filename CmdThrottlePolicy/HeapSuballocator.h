@@ -0,0 +1,123 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef HEAP_SUBALLOCATOR_
+#define HEAP_SUBALLOCATOR_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct HeapAllocation {
+    uint32_t heapIndex;
+    uint64_t offset;
+    // The size of the block, which is the size of the size class the request was rounded up to.
+    uint64_t size;
+    uint32_t sizeClass;
+    // Transient allocations alias the ones made before the last ResetTransient().
+    bool transient;
+};
+
+// Places buffers in large heaps, without any device, so that the policy can be tested and
+// benchmarked on any host. The heaps are only identified by their index; the owner creates a heap
+// for every new index returned by GetHeapCount() after an allocation.
+//
+// The requests are rounded up to power of two size classes, starting at the block alignment, and
+// freed blocks are kept in one free list per size class so that buffers of any size in the same
+// class are recycled, for instance when the problem size changes. New blocks are carved out of the
+// regular heaps, and requests larger than a regular heap get a dedicated heap. Transient
+// allocations are carved out of separate heaps that are rewound by ResetTransient(), so that the
+// buffers of successive phases alias the same memory.
+class HeapSuballocator {
+public:
+    struct Desc {
+        uint64_t heapSize = 64ull * 1024 * 1024;
+        // D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT.
+        uint64_t blockAlignment = 64ull * 1024;
+    };
+
+    struct Stats {
+        uint64_t allocationCount = 0;
+        // Allocations served from a free list.
+        uint64_t recycledCount = 0;
+        uint64_t heapBytes = 0;
+        // The size of the blocks in use, including the size class rounding.
+        uint64_t allocatedBytes = 0;
+        // The size that was actually requested for the blocks in use.
+        uint64_t requestedBytes = 0;
+    };
+
+    static constexpr uint32_t kDedicatedSizeClass = UINT32_MAX;
+
+    explicit HeapSuballocator(const Desc& desc);
+
+    HeapAllocation Allocate(uint64_t size);
+    // The block must not be used by the GPU anymore.
+    void Free(const HeapAllocation& allocation, uint64_t requestedSize);
+
+    HeapAllocation AllocateTransient(uint64_t size);
+    // The transient blocks allocated from now on reuse the memory of the previous ones. The caller
+    // needs an aliasing barrier before using a transient buffer whose memory was used before.
+    void ResetTransient();
+
+    uint32_t GetHeapCount() const;
+    uint64_t GetHeapSize(uint32_t heapIndex) const;
+    const Stats& GetStats() const;
+
+private:
+    enum class HeapKind {
+        Regular,
+        Dedicated,
+        Transient,
+    };
+
+    struct Heap {
+        uint64_t size;
+        uint64_t usedSize;
+        HeapKind kind;
+    };
+
+    uint32_t GetSizeClass(uint64_t size) const;
+    uint64_t GetSizeClassSize(uint32_t sizeClass) const;
+    uint32_t AddHeap(uint64_t size, HeapKind kind);
+
+    Desc mDesc;
+    std::vector<Heap> mHeaps;
+    // Indexed by size class.
+    std::vector<std::vector<HeapAllocation>> mFreeBlocks;
+    std::vector<HeapAllocation> mFreeDedicatedBlocks;
+    // The heaps used by the transient allocations, in order, and the current position.
+    std::vector<uint32_t> mTransientHeaps;
+    size_t mCurrentTransientHeap = 0;
+    uint64_t mTransientOffset = 0;
+    Stats mStats;
+};
+
+// Time random allocations and frees of buffers of varying sizes on the host, and print the
+// throughput and the memory overhead of the size classes.
+void BenchmarkHeapSuballocator(uint32_t operationCount, uint32_t seed);
+
+#endif
@@ -0,0 +1,61 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef MAT_MUL_COMMAND_
+#define MAT_MUL_COMMAND_
+
+#include <cstdint>
+
+// The root parameters of the kernel, none of which goes through a descriptor heap.
+enum MatMulRootParameter : uint32_t {
+    kRootConstants = 0,
+    kRootInputMatrix1,
+    kRootInputMatrix2,
+    kRootOutputMatrix,
+    kRootParameterCount,
+};
+
+// The arguments of one indirect matrix multiplication, in the order the command signature of the
+// matrix multiplication jobs reads them: the root constants, which mirror the cbuffer of the
+// kernel, the GPU virtual addresses of the root descriptors and the number of thread groups.
+struct IndirectMatMulCommand {
+    uint32_t m;
+    uint32_t k;
+    uint32_t n;
+    uint32_t tileK;
+    uint64_t inputMatrix1;
+    uint64_t inputMatrix2;
+    uint64_t outputMatrix;
+    uint32_t threadGroupCountX;
+    uint32_t threadGroupCountY;
+    uint32_t threadGroupCountZ;
+    // Keeps the root descriptor addresses of the next command 8-byte aligned.
+    uint32_t padding;
+};
+
+static_assert(sizeof(IndirectMatMulCommand) == 56, "The command signature stride has changed");
+
+#endif
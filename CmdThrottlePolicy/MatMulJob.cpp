@@ -0,0 +1,192 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "MatMulJob.h"
+
+#include <cstddef>
+
+#include "DXSampleHelper.h"
+
+namespace {
+
+ComPtr<ID3D12Resource> CreateMappedBuffer(
+    ID3D12Device* device,
+    D3D12_HEAP_TYPE heapType,
+    uint64_t size,
+    D3D12_RESOURCE_STATES initialState,
+    void** data) {
+    D3D12_HEAP_PROPERTIES heapProperties = {};
+    heapProperties.Type = heapType;
+
+    D3D12_RESOURCE_DESC bufferDescriptor = {};
+    bufferDescriptor.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferDescriptor.Width = size;
+    bufferDescriptor.Height = 1;
+    bufferDescriptor.DepthOrArraySize = 1;
+    bufferDescriptor.MipLevels = 1;
+    bufferDescriptor.Format = DXGI_FORMAT_UNKNOWN;
+    bufferDescriptor.SampleDesc.Count = 1;
+    bufferDescriptor.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    bufferDescriptor.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+    ComPtr<ID3D12Resource> buffer;
+    ThrowIfFailed(device->CreateCommittedResource(
+        &heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDescriptor, initialState, nullptr,
+        IID_PPV_ARGS(&buffer)));
+    ThrowIfFailed(buffer->Map(0, nullptr, data));
+    return buffer;
+}
+
+}  // anonymous namespace
+
+ComPtr<ID3D12CommandSignature> CreateMatMulCommandSignature(
+    ID3D12Device* device,
+    ID3D12RootSignature* rootSignature) {
+    D3D12_INDIRECT_ARGUMENT_DESC arguments[5] = {};
+    arguments[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+    arguments[0].Constant.RootParameterIndex = kRootConstants;
+    arguments[0].Constant.DestOffsetIn32BitValues = 0;
+    arguments[0].Constant.Num32BitValuesToSet =
+        offsetof(IndirectMatMulCommand, inputMatrix1) / sizeof(uint32_t);
+    arguments[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_SHADER_RESOURCE_VIEW;
+    arguments[1].ShaderResourceView.RootParameterIndex = kRootInputMatrix1;
+    arguments[2].Type = D3D12_INDIRECT_ARGUMENT_TYPE_SHADER_RESOURCE_VIEW;
+    arguments[2].ShaderResourceView.RootParameterIndex = kRootInputMatrix2;
+    arguments[3].Type = D3D12_INDIRECT_ARGUMENT_TYPE_UNORDERED_ACCESS_VIEW;
+    arguments[3].UnorderedAccessView.RootParameterIndex = kRootOutputMatrix;
+    arguments[4].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH;
+
+    D3D12_COMMAND_SIGNATURE_DESC signatureDescriptor = {};
+    signatureDescriptor.ByteStride = sizeof(IndirectMatMulCommand);
+    signatureDescriptor.NumArgumentDescs = _countof(arguments);
+    signatureDescriptor.pArgumentDescs = arguments;
+
+    ComPtr<ID3D12CommandSignature> commandSignature;
+    ThrowIfFailed(device->CreateCommandSignature(
+        &signatureDescriptor, rootSignature, IID_PPV_ARGS(&commandSignature)));
+    return commandSignature;
+}
+
+MatMulJob::MatMulJob(
+    ID3D12Device* device,
+    SubmissionQueue* queue,
+    ID3D12RootSignature* rootSignature,
+    ID3D12PipelineState* pipeline,
+    ID3D12CommandSignature* commandSignature,
+    uint32_t slotCount)
+    : mQueue(queue), mSlots(slotCount > 0 ? slotCount : 1) {
+    const uint32_t count = static_cast<uint32_t>(mSlots.size());
+
+    // The arguments are read by the GPU straight from the upload heap, the CPU only writes the
+    // slot of an execution once the previous execution with that slot has completed.
+    void* arguments = nullptr;
+    mArgumentBuffer = CreateMappedBuffer(
+        device, D3D12_HEAP_TYPE_UPLOAD, count * sizeof(IndirectMatMulCommand),
+        D3D12_RESOURCE_STATE_GENERIC_READ, &arguments);
+    mArguments = static_cast<IndirectMatMulCommand*>(arguments);
+
+    D3D12_QUERY_HEAP_DESC queryHeapDescriptor = {};
+    queryHeapDescriptor.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    queryHeapDescriptor.Count = 2 * count;
+    ThrowIfFailed(device->CreateQueryHeap(&queryHeapDescriptor, IID_PPV_ARGS(&mQueryHeap)));
+    void* timestamps = nullptr;
+    mReadbackBuffer = CreateMappedBuffer(
+        device, D3D12_HEAP_TYPE_READBACK, 2 * count * sizeof(uint64_t),
+        D3D12_RESOURCE_STATE_COPY_DEST, &timestamps);
+    mTimestamps = static_cast<const uint64_t*>(timestamps);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        Slot& slot = mSlots[i];
+        ThrowIfFailed(device->CreateCommandAllocator(
+            D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&slot.commandAllocator)));
+        ThrowIfFailed(device->CreateCommandList(
+            0, D3D12_COMMAND_LIST_TYPE_DIRECT, slot.commandAllocator.Get(), pipeline,
+            IID_PPV_ARGS(&slot.commandList)));
+
+        ID3D12GraphicsCommandList* commandList = slot.commandList.Get();
+        commandList->SetComputeRootSignature(rootSignature);
+        commandList->EndQuery(mQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * i);
+        commandList->ExecuteIndirect(
+            commandSignature, 1, mArgumentBuffer.Get(), i * sizeof(IndirectMatMulCommand),
+            nullptr, 0);
+        commandList->EndQuery(mQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * i + 1);
+        commandList->ResolveQueryData(
+            mQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * i, 2, mReadbackBuffer.Get(),
+            2 * i * sizeof(uint64_t));
+        ThrowIfFailed(commandList->Close());
+    }
+}
+
+MatMulJob::~MatMulJob() {
+    // The command lists and the buffers must not be released while the GPU still uses them.
+    mQueue->WaitForIdle();
+
+    D3D12_RANGE writtenRange = { 0, 0 };
+    mReadbackBuffer->Unmap(0, &writtenRange);
+    mArgumentBuffer->Unmap(0, nullptr);
+}
+
+void MatMulJob::Execute(const IndirectMatMulCommand& command) {
+    const uint32_t slotIndex = mNextSlot;
+    mNextSlot = (mNextSlot + 1) % static_cast<uint32_t>(mSlots.size());
+
+    Slot& slot = mSlots[slotIndex];
+    if (slot.fenceValue != 0) {
+        mQueue->WaitForFenceValue(slot.fenceValue);
+        CollectGPUTime(slotIndex);
+    }
+
+    mArguments[slotIndex] = command;
+    ID3D12CommandList* ppCommandLists[] = { slot.commandList.Get() };
+    mQueue->GetQueue()->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+    slot.fenceValue = mQueue->Signal();
+}
+
+std::vector<double> MatMulJob::CollectGPUTimesUS() {
+    mQueue->WaitForIdle();
+
+    // The slots are used in turn, so the oldest execution is the one of the next slot.
+    const uint32_t count = static_cast<uint32_t>(mSlots.size());
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint32_t slotIndex = (mNextSlot + i) % count;
+        if (mSlots[slotIndex].fenceValue != 0) {
+            CollectGPUTime(slotIndex);
+            mSlots[slotIndex].fenceValue = 0;
+        }
+    }
+
+    std::vector<double> gpuTimesUS;
+    gpuTimesUS.swap(mGPUTimesUS);
+    return gpuTimesUS;
+}
+
+void MatMulJob::CollectGPUTime(uint32_t slot) {
+    const uint64_t timestampFrequency = mQueue->GetTimestampFrequency();
+    const uint64_t beginTimestamp = mTimestamps[2 * slot];
+    const uint64_t endTimestamp = mTimestamps[2 * slot + 1];
+    mGPUTimesUS.push_back(
+        static_cast<double>(endTimestamp - beginTimestamp) * 1e6 / timestampFrequency);
+}
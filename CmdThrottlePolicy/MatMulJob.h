@@ -0,0 +1,93 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef MAT_MUL_JOB_
+#define MAT_MUL_JOB_
+
+#include <vector>
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include "MatMulCommand.h"
+#include "SubmissionQueue.h"
+
+using Microsoft::WRL::ComPtr;
+
+// Returns the command signature that sets all the root parameters of the kernel and dispatches it
+// from an IndirectMatMulCommand.
+ComPtr<ID3D12CommandSignature> CreateMatMulCommandSignature(
+    ID3D12Device* device,
+    ID3D12RootSignature* rootSignature);
+
+// A timed matrix multiplication recorded once, and executed any number of times.
+//
+// The job has one closed command list per slot, each of which executes its command from its own
+// slot of a persistently mapped argument buffer with ExecuteIndirect. Executing the job with
+// another shape or other buffers only writes the new command to the next slot and calls
+// ExecuteCommandLists, nothing is recorded again.
+class MatMulJob {
+public:
+    MatMulJob(
+        ID3D12Device* device,
+        SubmissionQueue* queue,
+        ID3D12RootSignature* rootSignature,
+        ID3D12PipelineState* pipeline,
+        ID3D12CommandSignature* commandSignature,
+        uint32_t slotCount);
+    ~MatMulJob();
+
+    // Only waits when the previous execution with the next slot hasn't completed yet.
+    void Execute(const IndirectMatMulCommand& command);
+
+    // Wait for all the executions, and return the GPU times of the executions since the previous
+    // call in microseconds, in order.
+    std::vector<double> CollectGPUTimesUS();
+
+private:
+    struct Slot {
+        ComPtr<ID3D12CommandAllocator> commandAllocator;
+        ComPtr<ID3D12GraphicsCommandList> commandList;
+        // The fence value signaled after the last execution, 0 if never executed.
+        uint64_t fenceValue = 0;
+    };
+
+    // Append the GPU time of the last execution of slot, which must have completed.
+    void CollectGPUTime(uint32_t slot);
+
+    SubmissionQueue* mQueue;
+    ComPtr<ID3D12Resource> mArgumentBuffer;
+    IndirectMatMulCommand* mArguments = nullptr;
+    ComPtr<ID3D12QueryHeap> mQueryHeap;
+    ComPtr<ID3D12Resource> mReadbackBuffer;
+    const uint64_t* mTimestamps = nullptr;
+
+    std::vector<Slot> mSlots;
+    uint32_t mNextSlot = 0;
+    std::vector<double> mGPUTimesUS;
+};
+
+#endif
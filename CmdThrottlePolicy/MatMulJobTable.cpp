@@ -0,0 +1,138 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "MatMulJobTable.h"
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <tuple>
+
+namespace {
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Returns the offset of a matrix of size bytes appended to a pool of *poolSize bytes.
+uint64_t AppendMatrix(uint64_t size, uint64_t* poolSize) {
+    const uint64_t offset = AlignUp(*poolSize, MatMulJobTable::kMatrixAlignment);
+    *poolSize = offset + size;
+    return offset;
+}
+
+}  // anonymous namespace
+
+MatMulJobTable::MatMulJobTable(const MatMulTiling& tiling) : mTiling(tiling) {
+}
+
+bool MatMulJobTable::AddJob(uint32_t m, uint32_t n, uint32_t k) {
+    if (m == 0 || n == 0 || k == 0 || m % mTiling.tileM != 0 || n % mTiling.tileN != 0 ||
+        k % mTiling.tileK != 0) {
+        return false;
+    }
+
+    MatMulJobDesc job;
+    job.m = m;
+    job.n = n;
+    job.k = k;
+    job.inputMatrix1Offset =
+        AppendMatrix(static_cast<uint64_t>(m) * k * sizeof(float), &mInputMatrix1PoolSize);
+    job.inputMatrix2Offset =
+        AppendMatrix(static_cast<uint64_t>(k) * n * sizeof(float), &mInputMatrix2PoolSize);
+    job.outputMatrixOffset =
+        AppendMatrix(static_cast<uint64_t>(m) * n * sizeof(float), &mOutputMatrixPoolSize);
+    mJobs.push_back(job);
+    return true;
+}
+
+void MatMulJobTable::AddRandomJobs(uint32_t count, uint32_t maxSize, uint32_t seed) {
+    std::mt19937 random(seed);
+    auto randomMultiple = [&](uint32_t tile) {
+        std::uniform_int_distribution<uint32_t> multiple(1, std::max(1u, maxSize / tile));
+        return multiple(random) * tile;
+    };
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint32_t m = randomMultiple(mTiling.tileM);
+        const uint32_t n = randomMultiple(mTiling.tileN);
+        const uint32_t k = randomMultiple(mTiling.tileK);
+        AddJob(m, n, k);
+    }
+}
+
+const std::vector<MatMulJobDesc>& MatMulJobTable::GetJobs() const {
+    return mJobs;
+}
+
+uint64_t MatMulJobTable::GetInputMatrix1PoolSize() const {
+    return mInputMatrix1PoolSize;
+}
+
+uint64_t MatMulJobTable::GetInputMatrix2PoolSize() const {
+    return mInputMatrix2PoolSize;
+}
+
+uint64_t MatMulJobTable::GetOutputMatrixPoolSize() const {
+    return mOutputMatrixPoolSize;
+}
+
+uint32_t MatMulJobTable::GetDistinctShapeCount() const {
+    std::set<std::tuple<uint32_t, uint32_t, uint32_t>> shapes;
+    for (const MatMulJobDesc& job : mJobs) {
+        shapes.insert(std::make_tuple(job.m, job.n, job.k));
+    }
+    return static_cast<uint32_t>(shapes.size());
+}
+
+double MatMulJobTable::GetFlops() const {
+    double flops = 0.0;
+    for (const MatMulJobDesc& job : mJobs) {
+        flops += 2.0 * job.m * job.n * job.k;
+    }
+    return flops;
+}
+
+void MatMulJobTable::BuildCommands(
+    uint64_t inputMatrix1Pool,
+    uint64_t inputMatrix2Pool,
+    uint64_t outputMatrixPool,
+    IndirectMatMulCommand* commands) const {
+    for (size_t i = 0; i < mJobs.size(); ++i) {
+        const MatMulJobDesc& job = mJobs[i];
+        IndirectMatMulCommand& command = commands[i];
+        command.m = job.m;
+        command.k = job.k;
+        command.n = job.n;
+        command.tileK = mTiling.tileK;
+        command.inputMatrix1 = inputMatrix1Pool + job.inputMatrix1Offset;
+        command.inputMatrix2 = inputMatrix2Pool + job.inputMatrix2Offset;
+        command.outputMatrix = outputMatrixPool + job.outputMatrixOffset;
+        command.threadGroupCountX = job.n / mTiling.tileN;
+        command.threadGroupCountY = job.m / mTiling.tileM;
+        command.threadGroupCountZ = 1;
+        command.padding = 0;
+    }
+}
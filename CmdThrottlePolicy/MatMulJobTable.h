@@ -0,0 +1,96 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef MAT_MUL_JOB_TABLE_
+#define MAT_MUL_JOB_TABLE_
+
+#include <cstdint>
+#include <vector>
+
+#include "MatMulCommand.h"
+
+// The shape of a matrix multiplication and the offsets of its matrices in the pooled buffers.
+struct MatMulJobDesc {
+    uint32_t m;
+    uint32_t n;
+    uint32_t k;
+    uint64_t inputMatrix1Offset;
+    uint64_t inputMatrix2Offset;
+    uint64_t outputMatrixOffset;
+};
+
+// The block of the output computed by a thread group and the step along K of the kernel, which
+// only supports shapes that are multiples of them.
+struct MatMulTiling {
+    uint32_t tileM;
+    uint32_t tileN;
+    uint32_t tileK;
+};
+
+// A table of independent matrix multiplications of any supported shape, without any device, so
+// that the layout can be tested on any host.
+//
+// The matrices of all the jobs are packed into one pooled buffer per operand, and the whole table
+// is turned into the IndirectMatMulCommand array of a single ExecuteIndirect in one pass. The
+// outputs don't overlap, so the jobs don't need any barrier between them.
+class MatMulJobTable {
+public:
+    // The root descriptors of raw buffers only need 4-byte aligned addresses, this keeps every
+    // matrix on its own cache lines.
+    static constexpr uint64_t kMatrixAlignment = 256;
+
+    explicit MatMulJobTable(const MatMulTiling& tiling);
+
+    // Returns false, without adding the job, if the kernel doesn't support its shape.
+    bool AddJob(uint32_t m, uint32_t n, uint32_t k);
+
+    // Add count jobs with random supported shapes of at most maxSize in each dimension.
+    void AddRandomJobs(uint32_t count, uint32_t maxSize, uint32_t seed);
+
+    const std::vector<MatMulJobDesc>& GetJobs() const;
+    uint64_t GetInputMatrix1PoolSize() const;
+    uint64_t GetInputMatrix2PoolSize() const;
+    uint64_t GetOutputMatrixPoolSize() const;
+    uint32_t GetDistinctShapeCount() const;
+    double GetFlops() const;
+
+    // Write the command of every job, in order, given the GPU virtual addresses of the pooled
+    // buffers. commands must have room for GetJobs().size() commands.
+    void BuildCommands(
+        uint64_t inputMatrix1Pool,
+        uint64_t inputMatrix2Pool,
+        uint64_t outputMatrixPool,
+        IndirectMatMulCommand* commands) const;
+
+private:
+    MatMulTiling mTiling;
+    std::vector<MatMulJobDesc> mJobs;
+    uint64_t mInputMatrix1PoolSize = 0;
+    uint64_t mInputMatrix2PoolSize = 0;
+    uint64_t mOutputMatrixPoolSize = 0;
+};
+
+#endif
@@ -0,0 +1,540 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+
+#include "MatMulService.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+#include "BenchmarkStatistics.h"
+#include "Tracer.h"
+
+namespace {
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// The size a matrix takes in a pooled buffer of MatMulJobTable.
+uint64_t GetPooledSize(uint64_t rowCount, uint64_t columnCount) {
+    return AlignUp(rowCount * columnCount * sizeof(float), MatMulJobTable::kMatrixAlignment);
+}
+
+// Copy rowCount x columnCount floats into a paddedRowCount x paddedColumnCount block, and zero
+// the padding so that it doesn't contribute to the products.
+void CopyPadded(
+    const float* source,
+    uint32_t rowCount,
+    uint32_t columnCount,
+    uint32_t paddedColumnCount,
+    float* destination) {
+    for (uint32_t row = 0; row < rowCount; ++row) {
+        float* destinationRow = destination + static_cast<uint64_t>(row) * paddedColumnCount;
+        memcpy(destinationRow, source + static_cast<uint64_t>(row) * columnCount,
+               columnCount * sizeof(float));
+        std::fill(destinationRow + columnCount, destinationRow + paddedColumnCount, 0.0f);
+    }
+}
+
+}  // anonymous namespace
+
+const char* CPUMatMulBatchExecutor::GetName() const {
+    return "CPU";
+}
+
+MatMulTiling CPUMatMulBatchExecutor::GetTiling() const {
+    // The tiling of the GPU kernel, so that the batches are the same on both.
+    return { 64, 64, 64 };
+}
+
+uint64_t CPUMatMulBatchExecutor::GetMaxPoolSize() const {
+    return 64ull << 20;
+}
+
+uint32_t CPUMatMulBatchExecutor::GetMaxJobCount() const {
+    return 64;
+}
+
+void CPUMatMulBatchExecutor::Execute(
+    const MatMulJobTable& table,
+    const WriteInputsFunction& writeInputs,
+    DoneFunction done) {
+    mInputMatrix1Pool.resize(table.GetInputMatrix1PoolSize());
+    mInputMatrix2Pool.resize(table.GetInputMatrix2PoolSize());
+    mOutputMatrixPool.assign(table.GetOutputMatrixPoolSize(), 0);
+    writeInputs(mInputMatrix1Pool.data(), mInputMatrix2Pool.data());
+
+    for (const MatMulJobDesc& job : table.GetJobs()) {
+        const float* a = reinterpret_cast<const float*>(&mInputMatrix1Pool[job.inputMatrix1Offset]);
+        const float* b = reinterpret_cast<const float*>(&mInputMatrix2Pool[job.inputMatrix2Offset]);
+        float* c = reinterpret_cast<float*>(&mOutputMatrixPool[job.outputMatrixOffset]);
+        for (uint32_t i = 0; i < job.m; ++i) {
+            float* cRow = c + static_cast<uint64_t>(i) * job.n;
+            for (uint32_t k = 0; k < job.k; ++k) {
+                const float aValue = a[static_cast<uint64_t>(i) * job.k + k];
+                const float* bRow = b + static_cast<uint64_t>(k) * job.n;
+                for (uint32_t j = 0; j < job.n; ++j) {
+                    cRow[j] += aValue * bRow[j];
+                }
+            }
+        }
+    }
+    done(mOutputMatrixPool.data());
+}
+
+void CPUMatMulBatchExecutor::WaitForIdle() {
+}
+
+struct MatMulService::PendingRequest {
+    MatMulRequest request;
+    MatMulResponse response;
+    std::promise<MatMulResponse> promise;
+    std::chrono::steady_clock::time_point submitTime;
+    std::atomic<uint32_t> remainingPieceCount{ 0 };
+    std::atomic<bool> failed{ false };
+};
+
+MatMulService::MatMulService(MatMulBatchExecutor* executor, const MatMulServiceSettings& settings)
+    : mExecutor(executor),
+      mSettings(settings),
+      mTiling(executor->GetTiling()),
+      mRequestCount(0),
+      mSplitRequestCount(0),
+      mPieceCount(0),
+      mBatchCount(0),
+      mJobCount(0) {
+    mThread = std::thread(&MatMulService::Run, this);
+}
+
+MatMulService::~MatMulService() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mRequestQueued.notify_one();
+    mThread.join();
+    mExecutor->WaitForIdle();
+}
+
+std::future<MatMulResponse> MatMulService::Submit(MatMulRequest request) {
+    auto pending = std::make_shared<PendingRequest>();
+    std::future<MatMulResponse> future = pending->promise.get_future();
+
+    const uint64_t m = request.m;
+    const uint64_t n = request.n;
+    const uint64_t k = request.k;
+    if (m == 0 || n == 0 || k == 0 || request.inputMatrix1.size() != m * k ||
+        request.inputMatrix2 == nullptr || request.inputMatrix2->size() != k * n) {
+        pending->promise.set_exception(std::make_exception_ptr(
+            std::invalid_argument("The shape of the request doesn't match its operands")));
+        return future;
+    }
+
+    // A piece must fit in a batch on its own, and doesn't have more rows than a full batch.
+    const uint32_t paddedK = static_cast<uint32_t>(AlignUp(k, mTiling.tileK));
+    const uint32_t paddedN = static_cast<uint32_t>(AlignUp(n, mTiling.tileN));
+    const uint64_t maxPoolSize = mExecutor->GetMaxPoolSize();
+    uint64_t maxPieceRowCount = 0;
+    if (GetPooledSize(paddedK, paddedN) <= maxPoolSize) {
+        maxPieceRowCount = maxPoolSize / (std::max(paddedK, paddedN) * sizeof(float));
+        maxPieceRowCount = std::min<uint64_t>(
+            maxPieceRowCount, std::max(mSettings.maxBatchRows, mTiling.tileM));
+        maxPieceRowCount -= maxPieceRowCount % mTiling.tileM;
+    }
+    if (maxPieceRowCount == 0) {
+        pending->promise.set_exception(std::make_exception_ptr(
+            std::invalid_argument("The second operand of the request doesn't fit in a batch")));
+        return future;
+    }
+
+    const uint32_t pieceCount =
+        static_cast<uint32_t>((m + maxPieceRowCount - 1) / maxPieceRowCount);
+    pending->request = std::move(request);
+    pending->response.outputMatrix.resize(m * n);
+    pending->response.pieceCount = pieceCount;
+    pending->remainingPieceCount = pieceCount;
+    pending->submitTime = std::chrono::steady_clock::now();
+    mRequestCount.fetch_add(1, std::memory_order_relaxed);
+    if (pieceCount > 1) {
+        mSplitRequestCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        BatchQueue& queue = mQueues[BatchKey(paddedK, paddedN)];
+        for (uint64_t firstRow = 0; firstRow < m; firstRow += maxPieceRowCount) {
+            const uint32_t rowCount =
+                static_cast<uint32_t>(std::min(maxPieceRowCount, m - firstRow));
+            queue.pieces.push_back({ pending, static_cast<uint32_t>(firstRow), rowCount });
+            queue.rowCount += rowCount;
+        }
+    }
+    mRequestQueued.notify_one();
+    return future;
+}
+
+MatMulService::Stats MatMulService::GetStats() const {
+    Stats stats;
+    stats.requestCount = mRequestCount.load();
+    stats.splitRequestCount = mSplitRequestCount.load();
+    stats.pieceCount = mPieceCount.load();
+    stats.batchCount = mBatchCount.load();
+    stats.jobCount = mJobCount.load();
+    return stats;
+}
+
+void MatMulService::Run() {
+    const auto maxBatchDelay = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double, std::micro>(mSettings.maxBatchDelayUS));
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        // Execute the ready queue whose oldest piece has waited the longest, so that a queue that
+        // keeps filling up can't starve the others.
+        const auto now = std::chrono::steady_clock::now();
+        auto earliestDeadline = std::chrono::steady_clock::time_point::max();
+        auto readyQueue = mQueues.end();
+        for (auto it = mQueues.begin(); it != mQueues.end();) {
+            BatchQueue& queue = it->second;
+            if (queue.pieces.empty()) {
+                it = mQueues.erase(it);
+                continue;
+            }
+            const auto deadline = queue.pieces.front().request->submitTime + maxBatchDelay;
+            const bool ready = mStopping || !mSettings.batching || deadline <= now ||
+                               queue.rowCount >= mSettings.maxBatchRows;
+            if (ready && (readyQueue == mQueues.end() ||
+                          deadline < readyQueue->second.pieces.front().request->submitTime +
+                                         maxBatchDelay)) {
+                readyQueue = it;
+            }
+            earliestDeadline = std::min(earliestDeadline, deadline);
+            ++it;
+        }
+
+        if (readyQueue != mQueues.end()) {
+            ExecuteBatch(readyQueue->first, &readyQueue->second, &lock);
+        } else if (mStopping) {
+            break;
+        } else if (earliestDeadline == std::chrono::steady_clock::time_point::max()) {
+            mRequestQueued.wait(lock);
+        } else {
+            mRequestQueued.wait_until(lock, earliestDeadline);
+        }
+    }
+}
+
+void MatMulService::ExecuteBatch(
+    const BatchKey& key,
+    BatchQueue* queue,
+    std::unique_lock<std::mutex>* lock) {
+    TRACE_SCOPE("MatMulService::ExecuteBatch");
+    const uint32_t k = key.first;
+    const uint32_t n = key.second;
+
+    // The pieces of the requests that share their second operand, stacked into one job.
+    struct Group {
+        const std::vector<float>* inputMatrix2;
+        uint32_t k;
+        uint32_t n;
+        uint32_t rowCount;
+        std::vector<Piece> pieces;
+    };
+    struct Batch {
+        std::vector<Group> groups;
+        std::vector<MatMulJobDesc> jobs;
+    };
+    auto batch = std::make_shared<Batch>();
+    std::vector<Group>& groups = batch->groups;
+
+    // Take the oldest pieces while they fit in the pooled buffers.
+    const uint64_t maxPoolSize = mExecutor->GetMaxPoolSize();
+    const uint32_t maxJobCount = mExecutor->GetMaxJobCount();
+    uint64_t rowCount = 0;
+    uint64_t pieceCount = 0;
+    while (!queue->pieces.empty() && rowCount < mSettings.maxBatchRows) {
+        const Piece& piece = queue->pieces.front();
+        const MatMulRequest& request = piece.request->request;
+        auto group = std::find_if(groups.begin(), groups.end(), [&](const Group& g) {
+            return g.inputMatrix2 == request.inputMatrix2.get() && g.k == request.k &&
+                   g.n == request.n;
+        });
+        if (!groups.empty()) {
+            const Group* target = group != groups.end() ? &*group : nullptr;
+            uint64_t inputPool1Size = 0;
+            uint64_t inputPool2Size = 0;
+            uint64_t outputPoolSize = 0;
+            for (const Group& g : groups) {
+                const uint32_t groupRowCount = g.rowCount + (&g == target ? piece.rowCount : 0);
+                const uint64_t paddedRowCount = AlignUp(groupRowCount, mTiling.tileM);
+                inputPool1Size += GetPooledSize(paddedRowCount, k);
+                inputPool2Size += GetPooledSize(k, n);
+                outputPoolSize += GetPooledSize(paddedRowCount, n);
+            }
+            if (group == groups.end()) {
+                const uint64_t paddedRowCount = AlignUp(piece.rowCount, mTiling.tileM);
+                inputPool1Size += GetPooledSize(paddedRowCount, k);
+                inputPool2Size += GetPooledSize(k, n);
+                outputPoolSize += GetPooledSize(paddedRowCount, n);
+            }
+            const size_t jobCount = groups.size() + (group == groups.end() ? 1 : 0);
+            if (inputPool1Size > maxPoolSize || inputPool2Size > maxPoolSize ||
+                outputPoolSize > maxPoolSize || jobCount > maxJobCount) {
+                break;
+            }
+        }
+        if (group == groups.end()) {
+            groups.push_back({ request.inputMatrix2.get(), request.k, request.n, 0, {} });
+            group = groups.end() - 1;
+        }
+        group->rowCount += piece.rowCount;
+        group->pieces.push_back(piece);
+        ++pieceCount;
+        rowCount += piece.rowCount;
+        queue->rowCount -= piece.rowCount;
+        queue->pieces.pop_front();
+        if (!mSettings.batching) {
+            break;
+        }
+    }
+    lock->unlock();
+
+    MatMulJobTable table(mTiling);
+    for (const Group& group : groups) {
+        table.AddJob(static_cast<uint32_t>(AlignUp(group.rowCount, mTiling.tileM)), n, k);
+    }
+    batch->jobs = table.GetJobs();
+    mBatchCount.fetch_add(1, std::memory_order_relaxed);
+    mPieceCount.fetch_add(pieceCount, std::memory_order_relaxed);
+    mJobCount.fetch_add(groups.size(), std::memory_order_relaxed);
+
+    auto writeInputs = [&](uint8_t* inputMatrix1Pool, uint8_t* inputMatrix2Pool) {
+        for (size_t i = 0; i < groups.size(); ++i) {
+            const Group& group = groups[i];
+            const MatMulJobDesc& job = batch->jobs[i];
+            float* a = reinterpret_cast<float*>(inputMatrix1Pool + job.inputMatrix1Offset);
+            uint32_t row = 0;
+            for (const Piece& piece : group.pieces) {
+                const float* source = piece.request->request.inputMatrix1.data() +
+                                      static_cast<uint64_t>(piece.firstRow) * group.k;
+                CopyPadded(source, piece.rowCount, group.k, k, a + static_cast<uint64_t>(row) * k);
+                row += piece.rowCount;
+            }
+            std::fill(
+                a + static_cast<uint64_t>(row) * k, a + static_cast<uint64_t>(job.m) * k, 0.0f);
+
+            float* b = reinterpret_cast<float*>(inputMatrix2Pool + job.inputMatrix2Offset);
+            CopyPadded(group.inputMatrix2->data(), group.k, group.n, n, b);
+            std::fill(
+                b + static_cast<uint64_t>(group.k) * n, b + static_cast<uint64_t>(k) * n, 0.0f);
+        }
+    };
+
+    // Called once per batch, with outputMatrixPool or, if the batch failed, nullptr. Copies the
+    // rows of every piece of every group back to its request, and completes the requests whose
+    // last piece this was.
+    auto completePieces = [batch, n](const uint8_t* outputMatrixPool) {
+        for (size_t i = 0; i < batch->groups.size(); ++i) {
+            const Group& group = batch->groups[i];
+            const float* c = nullptr;
+            if (outputMatrixPool != nullptr) {
+                c = reinterpret_cast<const float*>(
+                    outputMatrixPool + batch->jobs[i].outputMatrixOffset);
+            }
+            uint32_t row = 0;
+            for (const Piece& piece : group.pieces) {
+                PendingRequest& pending = *piece.request;
+                if (c != nullptr) {
+                    for (uint32_t r = 0; r < piece.rowCount; ++r) {
+                        memcpy(&pending.response.outputMatrix[
+                                   static_cast<uint64_t>(piece.firstRow + r) * group.n],
+                               c + static_cast<uint64_t>(row + r) * n, group.n * sizeof(float));
+                    }
+                } else {
+                    pending.failed = true;
+                }
+                row += piece.rowCount;
+
+                if (pending.remainingPieceCount.fetch_sub(1) != 1) {
+                    continue;
+                }
+                if (pending.failed) {
+                    pending.promise.set_exception(std::make_exception_ptr(
+                        std::runtime_error("The batch of the request failed to execute")));
+                } else {
+                    pending.response.latencyUS = std::chrono::duration<double, std::micro>(
+                        std::chrono::steady_clock::now() - pending.submitTime).count();
+                    pending.promise.set_value(std::move(pending.response));
+                }
+            }
+        }
+    };
+
+    try {
+        mExecutor->Execute(table, writeInputs, completePieces);
+    } catch (const std::exception& e) {
+        printf("ERROR: a batch of the matrix multiplication service failed: %s\n", e.what());
+        completePieces(nullptr);
+    }
+    lock->lock();
+}
+
+void RunMatMulServiceBenchmark(
+    MatMulBatchExecutor* executor,
+    const MatMulServiceBenchmarkSettings& settings) {
+    TRACE_SCOPE("RunMatMulServiceBenchmark");
+    const uint32_t clientCount = std::max(1u, settings.clientCount);
+    const uint32_t requestCount = std::max(1u, settings.requestCount);
+    printf(
+        "Matrix multiplication service on %s: %u requests from %u client threads, maximum "
+        "batch delay %.0f us\n",
+        executor->GetName(), requestCount, clientCount, settings.service.maxBatchDelayUS);
+
+    std::mt19937 random(settings.seed);
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+    std::uniform_int_distribution<uint32_t> size(1, std::max(1u, settings.maxSize));
+    std::uniform_int_distribution<uint32_t> rows(1, std::max(1u, settings.maxRows));
+
+    struct SharedMatrix {
+        uint32_t k;
+        uint32_t n;
+        std::shared_ptr<const std::vector<float>> data;
+    };
+    std::vector<SharedMatrix> sharedMatrices(std::max(1u, settings.sharedMatrixCount));
+    for (SharedMatrix& matrix : sharedMatrices) {
+        matrix.k = size(random);
+        matrix.n = size(random);
+        auto data = std::make_shared<std::vector<float>>(static_cast<size_t>(matrix.k) * matrix.n);
+        for (float& element : *data) {
+            element = value(random);
+        }
+        matrix.data = data;
+    }
+
+    // The same requests are submitted in both modes.
+    std::vector<MatMulRequest> requests(requestCount);
+    std::uniform_int_distribution<size_t> sharedMatrix(0, sharedMatrices.size() - 1);
+    for (uint32_t i = 0; i < requestCount; ++i) {
+        const SharedMatrix& matrix = sharedMatrices[sharedMatrix(random)];
+        MatMulRequest& request = requests[i];
+        const bool large =
+            settings.largeRequestInterval > 0 && i % settings.largeRequestInterval == 0;
+        request.m = large ? 2 * settings.service.maxBatchRows + 1 : rows(random);
+        request.n = matrix.n;
+        request.k = matrix.k;
+        request.inputMatrix1.resize(static_cast<size_t>(request.m) * request.k);
+        for (float& element : request.inputMatrix1) {
+            element = value(random);
+        }
+        request.inputMatrix2 = matrix.data;
+    }
+
+    double flops = 0.0;
+    for (const MatMulRequest& request : requests) {
+        flops += 2.0 * request.m * request.n * request.k;
+    }
+
+    const char* modes[] = { "Unbatched", "Batched" };
+    double wallTimesS[2] = {};
+    for (uint32_t mode = 0; mode < 2; ++mode) {
+        MatMulServiceSettings serviceSettings = settings.service;
+        serviceSettings.batching = mode == 1;
+
+        std::vector<MatMulResponse> responses(requestCount);
+        MatMulService::Stats stats;
+        const auto start = std::chrono::steady_clock::now();
+        {
+            MatMulService service(executor, serviceSettings);
+            std::vector<std::thread> clients;
+            for (uint32_t client = 0; client < clientCount; ++client) {
+                clients.emplace_back([&, client]() {
+                    std::deque<std::pair<uint32_t, std::future<MatMulResponse>>> inFlight;
+                    auto receive = [&]() {
+                        responses[inFlight.front().first] = inFlight.front().second.get();
+                        inFlight.pop_front();
+                    };
+                    for (uint32_t i = client; i < requestCount; i += clientCount) {
+                        inFlight.emplace_back(i, service.Submit(requests[i]));
+                        if (inFlight.size() >= std::max(1u, settings.requestsInFlightPerClient)) {
+                            receive();
+                        }
+                    }
+                    while (!inFlight.empty()) {
+                        receive();
+                    }
+                });
+            }
+            for (std::thread& client : clients) {
+                client.join();
+            }
+            stats = service.GetStats();
+        }
+        wallTimesS[mode] =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // Check every output element against a plain multiplication on the CPU.
+        uint64_t mismatchCount = 0;
+        std::vector<double> latenciesUS(requestCount);
+        for (uint32_t i = 0; i < requestCount; ++i) {
+            const MatMulRequest& request = requests[i];
+            const std::vector<float>& b = *request.inputMatrix2;
+            latenciesUS[i] = responses[i].latencyUS;
+            for (uint32_t row = 0; row < request.m; ++row) {
+                for (uint32_t column = 0; column < request.n; ++column) {
+                    const float* a = &request.inputMatrix1[static_cast<size_t>(row) * request.k];
+                    double expected = 0.0;
+                    for (uint32_t j = 0; j < request.k; ++j) {
+                        expected += static_cast<double>(a[j]) *
+                                    b[static_cast<size_t>(j) * request.n + column];
+                    }
+                    const float actual =
+                        responses[i].outputMatrix[static_cast<size_t>(row) * request.n + column];
+                    if (std::fabs(actual - expected) > 1e-3 * std::max(1.0, std::fabs(expected))) {
+                        ++mismatchCount;
+                    }
+                }
+            }
+        }
+
+        printf(
+            "%s: %.1f requests/s, %.2f GFLOPS, %llu batches of %.1f pieces of requests and %.1f "
+            "jobs on average, %llu requests split, %llu mismatches\n",
+            modes[mode], requestCount / wallTimesS[mode], flops / (wallTimesS[mode] * 1e9),
+            static_cast<unsigned long long>(stats.batchCount),
+            static_cast<double>(stats.pieceCount) / std::max<uint64_t>(1, stats.batchCount),
+            static_cast<double>(stats.jobCount) / std::max<uint64_t>(1, stats.batchCount),
+            static_cast<unsigned long long>(stats.splitRequestCount),
+            static_cast<unsigned long long>(mismatchCount));
+        PrintSummaryHeader();
+        PrintSummaryRow("Latency (us)", Summarize(latenciesUS));
+    }
+    printf("Batched throughput: %.2fx the unbatched one\n\n", wallTimesS[0] / wallTimesS[1]);
+}
@@ -0,0 +1,220 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+
+#ifndef MAT_MUL_SERVICE_
+#define MAT_MUL_SERVICE_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "MatMulJobTable.h"
+
+// A matrix multiplication of any shape submitted to a MatMulService.
+struct MatMulRequest {
+    uint32_t m = 0;
+    uint32_t n = 0;
+    uint32_t k = 0;
+    // m x k, row major.
+    std::vector<float> inputMatrix1;
+    // k x n, row major. Requests that share it are stacked into one dispatch.
+    std::shared_ptr<const std::vector<float>> inputMatrix2;
+};
+
+struct MatMulResponse {
+    // m x n, row major.
+    std::vector<float> outputMatrix;
+    // Time from the submit of the request to its response.
+    double latencyUS = 0.0;
+    // The number of pieces the request was split into, 1 unless it was too large for one batch.
+    uint32_t pieceCount = 0;
+};
+
+// Executes the batches of a MatMulService, on a GPU or on the CPU.
+class MatMulBatchExecutor {
+public:
+    using WriteInputsFunction =
+        std::function<void(uint8_t* inputMatrix1Pool, uint8_t* inputMatrix2Pool)>;
+    using DoneFunction = std::function<void(const uint8_t* outputMatrixPool)>;
+
+    virtual ~MatMulBatchExecutor() = default;
+
+    virtual const char* GetName() const = 0;
+    virtual MatMulTiling GetTiling() const = 0;
+    // The largest pooled buffer of each operand and the most jobs a batch can have.
+    virtual uint64_t GetMaxPoolSize() const = 0;
+    virtual uint32_t GetMaxJobCount() const = 0;
+
+    // Execute the jobs of table. writeInputs is called before Execute() returns to write the
+    // pooled operands laid out as in table, and done is called, possibly on another thread, with
+    // the pooled output once the jobs have completed, or with nullptr if they can't be executed.
+    // Blocks while too many batches are in flight.
+    virtual void Execute(
+        const MatMulJobTable& table,
+        const WriteInputsFunction& writeInputs,
+        DoneFunction done) = 0;
+
+    // Wait until every batch has completed and its done function has returned.
+    virtual void WaitForIdle() = 0;
+};
+
+// Multiplies on the calling thread, so that the service can be exercised on any host.
+class CPUMatMulBatchExecutor : public MatMulBatchExecutor {
+public:
+    const char* GetName() const override;
+    MatMulTiling GetTiling() const override;
+    uint64_t GetMaxPoolSize() const override;
+    uint32_t GetMaxJobCount() const override;
+    void Execute(
+        const MatMulJobTable& table,
+        const WriteInputsFunction& writeInputs,
+        DoneFunction done) override;
+    void WaitForIdle() override;
+
+private:
+    std::vector<uint8_t> mInputMatrix1Pool;
+    std::vector<uint8_t> mInputMatrix2Pool;
+    std::vector<uint8_t> mOutputMatrixPool;
+};
+
+struct MatMulServiceSettings {
+    // When false, every request, or piece of a split request, is executed on its own as soon as
+    // it's submitted.
+    bool batching = true;
+    // How long the oldest request waiting for a batch can wait for more compatible requests.
+    double maxBatchDelayUS = 500.0;
+    // A batch is dispatched without waiting any longer once it has this many rows. Requests with
+    // more rows are split into pieces of at most this many rows.
+    uint32_t maxBatchRows = 2048;
+};
+
+// Multiplies the requests of any number of client threads in batches.
+//
+// The requests are padded to the tiling of the kernel and queued by their padded K and N. The
+// rows of the requests that share their second operand are stacked into one job, and the jobs of
+// one K and N are executed together, e.g. with one ExecuteIndirect, as soon as they have enough
+// rows or the oldest of them has waited for the maximum batch delay. The outputs are then copied
+// back to the requests they belong to.
+class MatMulService {
+public:
+    struct Stats {
+        uint64_t requestCount = 0;
+        // Requests that were split because they didn't fit in one batch.
+        uint64_t splitRequestCount = 0;
+        uint64_t pieceCount = 0;
+        uint64_t batchCount = 0;
+        uint64_t jobCount = 0;
+    };
+
+    MatMulService(MatMulBatchExecutor* executor, const MatMulServiceSettings& settings);
+    // Executes the requests that are still queued and waits for them.
+    ~MatMulService();
+
+    MatMulService(const MatMulService&) = delete;
+    MatMulService& operator=(const MatMulService&) = delete;
+
+    // Can be called from any thread. The future holds an std::invalid_argument if the shape or
+    // the operands of the request are invalid, or if its second operand can't fit in a batch.
+    std::future<MatMulResponse> Submit(MatMulRequest request);
+
+    Stats GetStats() const;
+
+private:
+    struct PendingRequest;
+
+    // Rows [firstRow, firstRow + rowCount) of a request.
+    struct Piece {
+        std::shared_ptr<PendingRequest> request;
+        uint32_t firstRow;
+        uint32_t rowCount;
+    };
+
+    // Padded K and N.
+    using BatchKey = std::pair<uint32_t, uint32_t>;
+
+    struct BatchQueue {
+        std::deque<Piece> pieces;
+        uint64_t rowCount = 0;
+    };
+
+    void Run();
+    // Take the pieces of queue that fit in one batch and execute them.
+    void ExecuteBatch(
+        const BatchKey& key,
+        BatchQueue* queue,
+        std::unique_lock<std::mutex>* lock);
+
+    MatMulBatchExecutor* mExecutor;
+    MatMulServiceSettings mSettings;
+    MatMulTiling mTiling;
+
+    std::mutex mMutex;
+    std::condition_variable mRequestQueued;
+    std::map<BatchKey, BatchQueue> mQueues;
+    bool mStopping = false;
+
+    std::atomic<uint64_t> mRequestCount;
+    std::atomic<uint64_t> mSplitRequestCount;
+    std::atomic<uint64_t> mPieceCount;
+    std::atomic<uint64_t> mBatchCount;
+    std::atomic<uint64_t> mJobCount;
+
+    std::thread mThread;
+};
+
+struct MatMulServiceBenchmarkSettings {
+    uint32_t requestCount = 1000;
+    uint32_t clientCount = 8;
+    // The requests multiply by one of this many shared matrices of random K and N.
+    uint32_t sharedMatrixCount = 4;
+    // The largest K and N of the shared matrices and the most rows of a request.
+    uint32_t maxSize = 256;
+    uint32_t maxRows = 64;
+    // Every this many requests, one has more than twice the rows of a batch and is split.
+    uint32_t largeRequestInterval = 100;
+    // Each client waits for its oldest request once it has this many in flight.
+    uint32_t requestsInFlightPerClient = 4;
+    uint32_t seed = 1;
+    MatMulServiceSettings service;
+};
+
+// Submit the requests from the client threads once with every request in its own batch and once
+// with dynamic batching, and print the throughput, the latency and the batches of both.
+void RunMatMulServiceBenchmark(
+    MatMulBatchExecutor* executor,
+    const MatMulServiceBenchmarkSettings& settings);
+
+#endif
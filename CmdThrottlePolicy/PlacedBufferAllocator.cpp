@@ -0,0 +1,107 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "PlacedBufferAllocator.h"
+
+#include "DXSampleHelper.h"
+
+PlacedBufferAllocator::PlacedBufferAllocator(
+    ID3D12Device* device,
+    const HeapSuballocator::Desc& desc)
+    : mDevice(device), mSuballocator(desc) {
+}
+
+ComPtr<ID3D12Resource> PlacedBufferAllocator::CreateBuffer(
+    uint64_t size,
+    D3D12_RESOURCE_FLAGS flags,
+    D3D12_RESOURCE_STATES initialState,
+    HeapAllocation* allocation) {
+    *allocation = mSuballocator.Allocate(size);
+    return CreatePlacedBuffer(*allocation, size, flags, initialState);
+}
+
+ComPtr<ID3D12Resource> PlacedBufferAllocator::CreateTransientBuffer(
+    uint64_t size,
+    D3D12_RESOURCE_FLAGS flags,
+    D3D12_RESOURCE_STATES initialState) {
+    return CreatePlacedBuffer(mSuballocator.AllocateTransient(size), size, flags, initialState);
+}
+
+void PlacedBufferAllocator::ResetTransient() {
+    mSuballocator.ResetTransient();
+}
+
+void PlacedBufferAllocator::Release(const HeapAllocation& allocation, uint64_t size) {
+    mSuballocator.Free(allocation, size);
+}
+
+const HeapSuballocator::Stats& PlacedBufferAllocator::GetStats() const {
+    return mSuballocator.GetStats();
+}
+
+ComPtr<ID3D12Resource> PlacedBufferAllocator::CreatePlacedBuffer(
+    const HeapAllocation& allocation,
+    uint64_t size,
+    D3D12_RESOURCE_FLAGS flags,
+    D3D12_RESOURCE_STATES initialState) {
+    while (mHeaps.size() < mSuballocator.GetHeapCount()) {
+        D3D12_HEAP_DESC heapDescriptor = {};
+        heapDescriptor.SizeInBytes =
+            mSuballocator.GetHeapSize(static_cast<uint32_t>(mHeaps.size()));
+        heapDescriptor.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+        heapDescriptor.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+        heapDescriptor.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+        ComPtr<ID3D12Heap> heap;
+        ThrowIfFailed(mDevice->CreateHeap(&heapDescriptor, IID_PPV_ARGS(&heap)));
+        mHeaps.push_back(heap);
+    }
+
+    D3D12_RESOURCE_DESC bufferDescriptor = {};
+    bufferDescriptor.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferDescriptor.Width = size;
+    bufferDescriptor.Height = 1;
+    bufferDescriptor.DepthOrArraySize = 1;
+    bufferDescriptor.MipLevels = 1;
+    bufferDescriptor.Format = DXGI_FORMAT_UNKNOWN;
+    bufferDescriptor.SampleDesc.Count = 1;
+    bufferDescriptor.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    bufferDescriptor.Flags = flags;
+
+    ComPtr<ID3D12Resource> buffer;
+    ThrowIfFailed(mDevice->CreatePlacedResource(
+        mHeaps[allocation.heapIndex].Get(), allocation.offset, &bufferDescriptor, initialState,
+        nullptr, IID_PPV_ARGS(&buffer)));
+    return buffer;
+}
+
+void RecordAliasingBarrier(ID3D12GraphicsCommandList* commandList, ID3D12Resource* resource) {
+    D3D12_RESOURCE_BARRIER barrierDesc = {};
+    barrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+    barrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    barrierDesc.Aliasing.pResourceBefore = nullptr;
+    barrierDesc.Aliasing.pResourceAfter = resource;
+    commandList->ResourceBarrier(1, &barrierDesc);
+}
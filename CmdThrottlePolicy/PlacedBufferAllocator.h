@@ -0,0 +1,81 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef PLACED_BUFFER_ALLOCATOR_
+#define PLACED_BUFFER_ALLOCATOR_
+
+#include <vector>
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include "HeapSuballocator.h"
+
+using Microsoft::WRL::ComPtr;
+
+// Creates buffers as placed resources in large default heaps laid out by a HeapSuballocator,
+// instead of one committed resource, and therefore one heap, per buffer.
+class PlacedBufferAllocator {
+public:
+    PlacedBufferAllocator(ID3D12Device* device, const HeapSuballocator::Desc& desc);
+
+    ComPtr<ID3D12Resource> CreateBuffer(
+        uint64_t size,
+        D3D12_RESOURCE_FLAGS flags,
+        D3D12_RESOURCE_STATES initialState,
+        HeapAllocation* allocation);
+
+    // The memory of a transient buffer is reused by the transient buffers created after the next
+    // ResetTransient(). Before using such a buffer, record an aliasing barrier with
+    // RecordAliasingBarrier().
+    ComPtr<ID3D12Resource> CreateTransientBuffer(
+        uint64_t size,
+        D3D12_RESOURCE_FLAGS flags,
+        D3D12_RESOURCE_STATES initialState);
+    void ResetTransient();
+
+    // Return the memory of a buffer created by CreateBuffer() to its size class. The buffer must
+    // be released and not used by the GPU anymore.
+    void Release(const HeapAllocation& allocation, uint64_t size);
+
+    const HeapSuballocator::Stats& GetStats() const;
+
+private:
+    ComPtr<ID3D12Resource> CreatePlacedBuffer(
+        const HeapAllocation& allocation,
+        uint64_t size,
+        D3D12_RESOURCE_FLAGS flags,
+        D3D12_RESOURCE_STATES initialState);
+
+    ComPtr<ID3D12Device> mDevice;
+    HeapSuballocator mSuballocator;
+    // Indexed like the heaps of mSuballocator.
+    std::vector<ComPtr<ID3D12Heap>> mHeaps;
+};
+
+void RecordAliasingBarrier(ID3D12GraphicsCommandList* commandList, ID3D12Resource* resource);
+
+#endif
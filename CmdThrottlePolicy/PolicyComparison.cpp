@@ -0,0 +1,140 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "PolicyComparison.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+SimulatedPolicyTrialExecutor::SimulatedPolicyTrialExecutor(
+    const SimulatedGPUDesc& desc,
+    double flopsPerDispatch)
+    : mGPU(desc), mFlopsPerDispatch(flopsPerDispatch) {
+}
+
+const char* SimulatedPolicyTrialExecutor::GetName() const {
+    return "simulated GPU";
+}
+
+std::vector<double> SimulatedPolicyTrialExecutor::RunTrial(
+    ThrottlePolicy policy,
+    uint32_t dispatchCount) {
+    std::vector<double> timesUS(dispatchCount);
+    for (uint32_t i = 0; i < dispatchCount; ++i) {
+        timesUS[i] = mGPU.Execute(mFlopsPerDispatch, policy);
+    }
+    return timesUS;
+}
+
+std::vector<DispatchLatency> SimulatedPolicyTrialExecutor::RunBurst(
+    ThrottlePolicy policy,
+    uint32_t dispatchCount,
+    double submitIntervalUS) {
+    std::vector<DispatchLatency> latencies(dispatchCount);
+    const double burstStartUS = mGPU.GetTimeUS();
+    for (uint32_t i = 0; i < dispatchCount; ++i) {
+        // The dispatches submitted while the previous one still runs are queued behind it.
+        const double submitTimeUS = burstStartUS + submitIntervalUS * i;
+        mGPU.Idle(submitTimeUS - mGPU.GetTimeUS());
+        latencies[i].gpuTimeUS = mGPU.Execute(mFlopsPerDispatch, policy);
+        latencies[i].latencyUS = mGPU.GetTimeUS() - submitTimeUS;
+    }
+    return latencies;
+}
+
+void SimulatedPolicyTrialExecutor::Idle(double microseconds) {
+    mGPU.Idle(microseconds);
+}
+
+std::vector<ThrottlePolicy> BuildTrialSchedule(uint32_t trialsPerPolicy, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::vector<ThrottlePolicy> schedule;
+    schedule.reserve(trialsPerPolicy * kThrottlePolicyCount);
+    for (uint32_t i = 0; i < trialsPerPolicy; ++i) {
+        ThrottlePolicy block[] = { ThrottlePolicy::Dynamic, ThrottlePolicy::MaxPerformance };
+        std::shuffle(std::begin(block), std::end(block), random);
+        schedule.insert(schedule.end(), std::begin(block), std::end(block));
+    }
+    return schedule;
+}
+
+PolicyComparisonResult ComparePolicies(
+    PolicyTrialExecutor* executor,
+    const PolicyComparisonSettings& settings) {
+    printf(
+        "Comparing throttle policies on %s: %u trials per policy, %u dispatches per trial, "
+        "%.1f ms idle before each trial\n",
+        executor->GetName(), settings.trialsPerPolicy, settings.dispatchesPerTrial,
+        settings.idleBetweenTrialsUS / 1000.0);
+
+    PolicyComparisonResult result;
+    for (ThrottlePolicy policy : BuildTrialSchedule(settings.trialsPerPolicy, settings.seed)) {
+        executor->Idle(settings.idleBetweenTrialsUS);
+        std::vector<double> timesUS = executor->RunTrial(policy, settings.dispatchesPerTrial);
+
+        const int index = static_cast<int>(policy);
+        result.trialMediansUS[index].push_back(Summarize(timesUS).median);
+        result.dispatchTimesUS[index].insert(
+            result.dispatchTimesUS[index].end(), timesUS.begin(), timesUS.end());
+    }
+
+    const std::vector<double>& dynamicMedians =
+        result.trialMediansUS[static_cast<int>(ThrottlePolicy::Dynamic)];
+    const std::vector<double>& maxPerformanceMedians =
+        result.trialMediansUS[static_cast<int>(ThrottlePolicy::MaxPerformance)];
+    result.test = MannWhitneyUTest(dynamicMedians, maxPerformanceMedians);
+
+    printf("\nAll dispatches (us):\n");
+    PrintSummaryHeader();
+    for (int i = 0; i < kThrottlePolicyCount; ++i) {
+        PrintSummaryRow(
+            GetThrottlePolicyName(static_cast<ThrottlePolicy>(i)),
+            Summarize(result.dispatchTimesUS[i]));
+    }
+    printf("Trial medians (us):\n");
+    PrintSummaryHeader();
+    for (int i = 0; i < kThrottlePolicyCount; ++i) {
+        PrintSummaryRow(
+            GetThrottlePolicyName(static_cast<ThrottlePolicy>(i)),
+            Summarize(result.trialMediansUS[i]));
+    }
+
+    const double dynamicMedian = Summarize(dynamicMedians).median;
+    const double maxPerformanceMedian = Summarize(maxPerformanceMedians).median;
+    printf(
+        "\nMAX_PERFORMANCE median trial time is %.1f%% %s than DYNAMIC.\n",
+        std::fabs(1.0 - maxPerformanceMedian / dynamicMedian) * 100.0,
+        maxPerformanceMedian <= dynamicMedian ? "lower" : "higher");
+    printf(
+        "Mann-Whitney U = %.1f, z = %.2f, p = %.4f: the difference is %ssignificant at "
+        "alpha = %.2f.\n\n",
+        result.test.u, result.test.z, result.test.pValue,
+        result.test.pValue < settings.alpha ? "" : "NOT ", settings.alpha);
+
+    return result;
+}
@@ -0,0 +1,113 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef POLICY_COMPARISON_
+#define POLICY_COMPARISON_
+
+#include <cstdint>
+#include <vector>
+
+#include "BenchmarkStatistics.h"
+#include "SimulatedGPU.h"
+#include "ThrottlePolicy.h"
+
+struct DispatchLatency {
+    // Execution time on the GPU.
+    double gpuTimeUS;
+    // Time from the submit of the dispatch to the end of its execution.
+    double latencyUS;
+};
+
+// Runs timed matrix multiplications on a queue with a given throttle policy, either on a real GPU
+// or on a simulated one.
+class PolicyTrialExecutor {
+public:
+    virtual ~PolicyTrialExecutor() = default;
+
+    virtual const char* GetName() const = 0;
+
+    // Execute dispatchCount matrix multiplications back to back on the queue with the given
+    // throttle policy, wait for them, and return their GPU execution times in microseconds.
+    virtual std::vector<double> RunTrial(ThrottlePolicy policy, uint32_t dispatchCount) = 0;
+
+    // Submit dispatchCount matrix multiplications one by one to the queue with the given throttle
+    // policy, one every submitIntervalUS or back to back when it is 0, wait for them, and return
+    // their execution times and latencies.
+    virtual std::vector<DispatchLatency> RunBurst(
+        ThrottlePolicy policy,
+        uint32_t dispatchCount,
+        double submitIntervalUS) = 0;
+
+    // Leave the GPU idle for the given time.
+    virtual void Idle(double microseconds) = 0;
+};
+
+class SimulatedPolicyTrialExecutor : public PolicyTrialExecutor {
+public:
+    SimulatedPolicyTrialExecutor(const SimulatedGPUDesc& desc, double flopsPerDispatch);
+
+    const char* GetName() const override;
+    std::vector<double> RunTrial(ThrottlePolicy policy, uint32_t dispatchCount) override;
+    std::vector<DispatchLatency> RunBurst(
+        ThrottlePolicy policy,
+        uint32_t dispatchCount,
+        double submitIntervalUS) override;
+    void Idle(double microseconds) override;
+
+private:
+    SimulatedGPU mGPU;
+    double mFlopsPerDispatch;
+};
+
+struct PolicyComparisonSettings {
+    uint32_t trialsPerPolicy = 20;
+    uint32_t dispatchesPerTrial = 20;
+    // Idle time before each trial, so that a trial doesn't inherit the clock of the previous one.
+    double idleBetweenTrialsUS = 100000.0;
+    // Significance level of the Mann-Whitney U test.
+    double alpha = 0.05;
+    uint32_t seed = 1;
+};
+
+struct PolicyComparisonResult {
+    // Indexed by ThrottlePolicy.
+    std::vector<double> dispatchTimesUS[kThrottlePolicyCount];
+    std::vector<double> trialMediansUS[kThrottlePolicyCount];
+    // The test is done on the trial medians, as the dispatches of one trial are not independent.
+    MannWhitneyResult test;
+};
+
+// Returns the order in which the trials are run: every consecutive pair holds one trial of each
+// policy in a random order, so that slow drifts like the thermal state affect both policies alike.
+std::vector<ThrottlePolicy> BuildTrialSchedule(uint32_t trialsPerPolicy, uint32_t seed);
+
+// Interleave randomized trials of the DYNAMIC and MAX_PERFORMANCE throttle policies on executor
+// and print the per-policy distributions and whether their difference is significant.
+PolicyComparisonResult ComparePolicies(
+    PolicyTrialExecutor* executor,
+    const PolicyComparisonSettings& settings);
+
+#endif
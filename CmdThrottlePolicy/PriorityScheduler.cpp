@@ -0,0 +1,299 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+
+#include "PriorityScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <string>
+
+#include "BenchmarkStatistics.h"
+#include "Tracer.h"
+
+SimulatedMultiQueueExecutor::SimulatedMultiQueueExecutor(
+    const SimulatedGPUDesc& desc,
+    double flopsPerDispatch)
+    : mGPU(desc), mFlopsPerDispatch(flopsPerDispatch) {
+}
+
+const char* SimulatedMultiQueueExecutor::GetName() const {
+    return "Simulated GPU";
+}
+
+uint32_t SimulatedMultiQueueExecutor::CreateQueue(const ClassQueueDesc& desc) {
+    mQueues.push_back({ desc, {} });
+    return static_cast<uint32_t>(mQueues.size() - 1);
+}
+
+void SimulatedMultiQueueExecutor::Submit(uint32_t queue, uint64_t jobId, uint32_t dispatchCount) {
+    mQueues[queue].jobs.push_back({ jobId, std::max(1u, dispatchCount), 0.0, mNextOrder++ });
+    StartDispatch();
+}
+
+double SimulatedMultiQueueExecutor::GetTimeUS() {
+    return mTimeUS;
+}
+
+bool SimulatedMultiQueueExecutor::StartDispatch() {
+    if (mRunning) {
+        return false;
+    }
+
+    // The highest priority queue with pending work, or of those the one with the oldest job.
+    SimulatedQueue* next = nullptr;
+    for (SimulatedQueue& queue : mQueues) {
+        if (queue.jobs.empty()) {
+            continue;
+        }
+        if (next == nullptr || queue.desc.priority > next->desc.priority ||
+            (queue.desc.priority == next->desc.priority &&
+             queue.jobs.front().order < next->jobs.front().order)) {
+            next = &queue;
+        }
+    }
+    if (next == nullptr) {
+        return false;
+    }
+
+    // The GPU has been idle since the end of its last dispatch.
+    if (mGPU.GetTimeUS() < mTimeUS) {
+        mGPU.Idle(mTimeUS - mGPU.GetTimeUS());
+    }
+    mRunningGPUTimeUS = mGPU.Execute(mFlopsPerDispatch, next->desc.policy);
+    mRunningEndUS = mGPU.GetTimeUS();
+    mRunningQueue = static_cast<uint32_t>(next - mQueues.data());
+    mRunning = true;
+    return true;
+}
+
+void SimulatedMultiQueueExecutor::Wait(double timeUS, std::vector<CompletedJob>* completed) {
+    const size_t initialCompletedCount = completed->size();
+    while (true) {
+        if (!mRunning && !StartDispatch()) {
+            if (std::isfinite(timeUS)) {
+                mTimeUS = std::max(mTimeUS, timeUS);
+            }
+            return;
+        }
+        if (mRunningEndUS > timeUS) {
+            mTimeUS = std::max(mTimeUS, timeUS);
+            return;
+        }
+
+        mTimeUS = std::max(mTimeUS, mRunningEndUS);
+        mRunning = false;
+        std::deque<PendingJob>& jobs = mQueues[mRunningQueue].jobs;
+        PendingJob& job = jobs.front();
+        job.gpuTimeUS += mRunningGPUTimeUS;
+        if (--job.remainingDispatchCount == 0) {
+            completed->push_back({ job.jobId, mRunningEndUS, job.gpuTimeUS });
+            jobs.pop_front();
+        }
+        if (completed->size() > initialCompletedCount) {
+            // The GPU goes on with the next dispatch while the caller handles the completions.
+            StartDispatch();
+            return;
+        }
+    }
+}
+
+PriorityScheduler::PriorityScheduler(
+    MultiQueueExecutor* executor,
+    const PrioritySchedulerSettings& settings)
+    : mExecutor(executor), mSettings(settings) {
+    for (int jobClass = 0; jobClass < kJobClassCount; ++jobClass) {
+        int sharedClass = -1;
+        for (int other = 0; other < jobClass; ++other) {
+            if (settings.queues[other] == settings.queues[jobClass]) {
+                sharedClass = other;
+            }
+        }
+        mQueues[jobClass] = sharedClass >= 0 ? mQueues[sharedClass]
+                                             : executor->CreateQueue(settings.queues[jobClass]);
+    }
+}
+
+void PriorityScheduler::Submit(JobClass jobClass, uint32_t dispatchCount) {
+    const uint64_t jobId = mNextJobId++;
+    mJobs[jobId] = { jobClass, dispatchCount, mExecutor->GetTimeUS() };
+    mQueuedJobs[static_cast<int>(jobClass)].push_back(jobId);
+    SubmitReadyJobs();
+}
+
+void PriorityScheduler::SubmitReadyJobs() {
+    // The latency-critical jobs go first when the classes share a queue.
+    for (int jobClass = 0; jobClass < kJobClassCount; ++jobClass) {
+        std::deque<uint64_t>& queuedJobs = mQueuedJobs[jobClass];
+        const uint32_t maxJobsInFlight = mSettings.maxJobsInFlight[jobClass];
+        while (!queuedJobs.empty() &&
+               (maxJobsInFlight == 0 || mJobsInFlight[jobClass] < maxJobsInFlight)) {
+            const uint64_t jobId = queuedJobs.front();
+            queuedJobs.pop_front();
+            mExecutor->Submit(mQueues[jobClass], jobId, mJobs[jobId].dispatchCount);
+            ++mJobsInFlight[jobClass];
+        }
+    }
+}
+
+void PriorityScheduler::WaitUntil(double timeUS) {
+    std::vector<CompletedJob> completedJobs;
+    mExecutor->Wait(timeUS, &completedJobs);
+    for (const CompletedJob& completedJob : completedJobs) {
+        auto job = mJobs.find(completedJob.jobId);
+        const int jobClass = static_cast<int>(job->second.jobClass);
+        ClassStats& stats = mStats[jobClass];
+        stats.latenciesUS.push_back(completedJob.endTimeUS - job->second.submitTimeUS);
+        stats.gpuTimesUS.push_back(completedJob.gpuTimeUS);
+        stats.dispatchCount += job->second.dispatchCount;
+        --mJobsInFlight[jobClass];
+        mJobs.erase(job);
+    }
+    SubmitReadyJobs();
+}
+
+void PriorityScheduler::Drain() {
+    while (!mJobs.empty()) {
+        WaitUntil(std::numeric_limits<double>::infinity());
+    }
+}
+
+uint32_t PriorityScheduler::GetPendingJobCount(JobClass jobClass) const {
+    const int index = static_cast<int>(jobClass);
+    return static_cast<uint32_t>(mQueuedJobs[index].size()) + mJobsInFlight[index];
+}
+
+const PriorityScheduler::ClassStats& PriorityScheduler::GetStats(JobClass jobClass) const {
+    return mStats[static_cast<int>(jobClass)];
+}
+
+void ComparePriorityScheduling(
+    MultiQueueExecutor* executor,
+    const PrioritySchedulerSettings& settings,
+    const PriorityWorkloadSettings& workload) {
+    TRACE_SCOPE("ComparePriorityScheduling");
+    printf(
+        "Priority scheduling on %s: latency-critical jobs of %u dispatches every %.1f ms on "
+        "average, background jobs of %u dispatches with %u pending at all times\n",
+        executor->GetName(), workload.criticalDispatchCount, workload.criticalIntervalUS / 1000.0,
+        workload.backgroundDispatchCount, workload.backgroundBacklog);
+
+    // Both configurations get the same arrivals.
+    std::vector<double> arrivalsUS;
+    std::mt19937 random(workload.seed);
+    std::exponential_distribution<double> interval(
+        1.0 / std::max(1.0, workload.criticalIntervalUS));
+    for (double timeUS = interval(random); timeUS < workload.durationUS;
+         timeUS += interval(random)) {
+        arrivalsUS.push_back(timeUS);
+    }
+
+    PrioritySchedulerSettings sharedSettings;
+    for (int jobClass = 0; jobClass < kJobClassCount; ++jobClass) {
+        sharedSettings.queues[jobClass] = {
+            QueuePriority::Normal, ThrottlePolicy::MaxPerformance };
+        sharedSettings.maxJobsInFlight[jobClass] = 0;
+    }
+    struct Configuration {
+        const char* name;
+        const PrioritySchedulerSettings* settings;
+    };
+    const Configuration configurations[] = {
+        { "Shared queue", &sharedSettings },
+        { "Queue per class", &settings },
+    };
+
+    double criticalMediansUS[2] = {};
+    for (int i = 0; i < 2; ++i) {
+        const Configuration& configuration = configurations[i];
+        printf("%s:\n", configuration.name);
+        for (int jobClass = 0; jobClass < kJobClassCount; ++jobClass) {
+            const ClassQueueDesc& desc = configuration.settings->queues[jobClass];
+            const uint32_t maxJobsInFlight = configuration.settings->maxJobsInFlight[jobClass];
+            const std::string limit = maxJobsInFlight == 0
+                                          ? "no limit in flight"
+                                          : std::to_string(maxJobsInFlight) + " in flight at most";
+            printf(
+                "  %s jobs: %s priority queue with %s, %s\n",
+                GetJobClassName(static_cast<JobClass>(jobClass)),
+                GetQueuePriorityName(desc.priority), GetThrottlePolicyName(desc.policy),
+                limit.c_str());
+        }
+
+        std::vector<CompletedJob> completedJobs;
+        const double idleEndUS = executor->GetTimeUS() + workload.idleBeforeRunUS;
+        while (executor->GetTimeUS() < idleEndUS) {
+            executor->Wait(idleEndUS, &completedJobs);
+        }
+
+        PriorityScheduler scheduler(executor, *configuration.settings);
+        const double startUS = executor->GetTimeUS();
+        const double endUS = startUS + workload.durationUS;
+        size_t nextArrival = 0;
+        while (true) {
+            const double nowUS = executor->GetTimeUS();
+            while (nextArrival < arrivalsUS.size() && startUS + arrivalsUS[nextArrival] <= nowUS) {
+                scheduler.Submit(JobClass::LatencyCritical, workload.criticalDispatchCount);
+                ++nextArrival;
+            }
+            if (nowUS >= endUS) {
+                break;
+            }
+            while (scheduler.GetPendingJobCount(JobClass::Background) <
+                   workload.backgroundBacklog) {
+                scheduler.Submit(JobClass::Background, workload.backgroundDispatchCount);
+            }
+            scheduler.WaitUntil(
+                nextArrival < arrivalsUS.size() ? startUS + arrivalsUS[nextArrival] : endUS);
+        }
+        scheduler.Drain();
+        const double elapsedS = (executor->GetTimeUS() - startUS) / 1e6;
+
+        PrintSummaryHeader();
+        for (int jobClass = 0; jobClass < kJobClassCount; ++jobClass) {
+            const std::string name =
+                std::string(GetJobClassName(static_cast<JobClass>(jobClass))) + " (us)";
+            PrintSummaryRow(
+                name.c_str(), Summarize(scheduler.GetStats(static_cast<JobClass>(jobClass))
+                                            .latenciesUS));
+        }
+        const PriorityScheduler::ClassStats& critical =
+            scheduler.GetStats(JobClass::LatencyCritical);
+        criticalMediansUS[i] = Summarize(critical.latenciesUS).median;
+        printf(
+            "%zu latency-critical jobs, background throughput %.1f dispatches/s\n",
+            critical.latenciesUS.size(),
+            scheduler.GetStats(JobClass::Background).dispatchCount / elapsedS);
+    }
+    printf(
+        "Latency-critical median latency: %.1f us with a queue per class, %.1f us with a shared "
+        "queue (%.2fx)\n\n",
+        criticalMediansUS[1], criticalMediansUS[0],
+        criticalMediansUS[1] > 0.0 ? criticalMediansUS[0] / criticalMediansUS[1] : 0.0);
+}
@@ -0,0 +1,230 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+
+#ifndef PRIORITY_SCHEDULER_
+#define PRIORITY_SCHEDULER_
+
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "SimulatedGPU.h"
+#include "ThrottlePolicy.h"
+
+// The classes of work routed to their own command queue.
+enum class JobClass {
+    LatencyCritical = 0,
+    Background = 1,
+};
+
+constexpr int kJobClassCount = 2;
+
+inline const char* GetJobClassName(JobClass jobClass) {
+    switch (jobClass) {
+        case JobClass::LatencyCritical:
+            return "Latency-critical";
+        case JobClass::Background:
+            return "Background";
+    }
+    return "Unknown";
+}
+
+// Mirrors the D3D12_COMMAND_QUEUE_PRIORITY values used by this sample.
+enum class QueuePriority {
+    Normal = 0,
+    High = 1,
+};
+
+inline const char* GetQueuePriorityName(QueuePriority priority) {
+    return priority == QueuePriority::High ? "HIGH" : "NORMAL";
+}
+
+// How the command queue of a class is created.
+struct ClassQueueDesc {
+    QueuePriority priority;
+    ThrottlePolicy policy;
+};
+
+inline bool operator==(const ClassQueueDesc& lhs, const ClassQueueDesc& rhs) {
+    return lhs.priority == rhs.priority && lhs.policy == rhs.policy;
+}
+
+struct CompletedJob {
+    uint64_t jobId;
+    // On the clock of the executor.
+    double endTimeUS;
+    // The sum of the execution times of its dispatches.
+    double gpuTimeUS;
+};
+
+// Executes jobs of matrix multiplications on several command queues, on a real GPU or on a
+// simulated one.
+class MultiQueueExecutor {
+public:
+    virtual ~MultiQueueExecutor() = default;
+
+    virtual const char* GetName() const = 0;
+
+    // Create a command queue and return its index.
+    virtual uint32_t CreateQueue(const ClassQueueDesc& desc) = 0;
+
+    // Submit a job of dispatchCount matrix multiplications to a queue, in one command list.
+    virtual void Submit(uint32_t queue, uint64_t jobId, uint32_t dispatchCount) = 0;
+
+    virtual double GetTimeUS() = 0;
+
+    // Wait until timeUS or until some jobs have completed, whichever comes first, and append the
+    // completed jobs to completed. Returns right away if nothing is in flight and timeUS is
+    // infinite.
+    virtual void Wait(double timeUS, std::vector<CompletedJob>* completed) = 0;
+};
+
+// Executes the dispatches of its queues one at a time on a SimulatedGPU, always picking the next
+// dispatch from the highest priority queue with pending work, the way a GPU that doesn't preempt
+// dispatches honors queue priorities. The clock ramps up with the throttle policy of the queue of
+// the dispatch.
+class SimulatedMultiQueueExecutor : public MultiQueueExecutor {
+public:
+    SimulatedMultiQueueExecutor(const SimulatedGPUDesc& desc, double flopsPerDispatch);
+
+    const char* GetName() const override;
+    uint32_t CreateQueue(const ClassQueueDesc& desc) override;
+    void Submit(uint32_t queue, uint64_t jobId, uint32_t dispatchCount) override;
+    double GetTimeUS() override;
+    void Wait(double timeUS, std::vector<CompletedJob>* completed) override;
+
+private:
+    struct PendingJob {
+        uint64_t jobId;
+        uint32_t remainingDispatchCount;
+        double gpuTimeUS;
+        // Orders the queues of the same priority by their oldest job.
+        uint64_t order;
+    };
+
+    struct SimulatedQueue {
+        ClassQueueDesc desc;
+        std::deque<PendingJob> jobs;
+    };
+
+    // Start the next dispatch if the GPU is idle and there is one. Returns false otherwise.
+    bool StartDispatch();
+
+    SimulatedGPU mGPU;
+    double mFlopsPerDispatch;
+    double mTimeUS = 0.0;
+    std::vector<SimulatedQueue> mQueues;
+    uint64_t mNextOrder = 0;
+
+    // The dispatch running on the GPU, if mRunning.
+    bool mRunning = false;
+    uint32_t mRunningQueue = 0;
+    double mRunningEndUS = 0.0;
+    double mRunningGPUTimeUS = 0.0;
+};
+
+struct PrioritySchedulerSettings {
+    // The queue of each class, indexed by JobClass. Classes with the same desc share a queue.
+    ClassQueueDesc queues[kJobClassCount] = {
+        { QueuePriority::High, ThrottlePolicy::MaxPerformance },
+        { QueuePriority::Normal, ThrottlePolicy::Dynamic },
+    };
+    // The most jobs of each class in flight on the GPU, or 0 for no limit. Keeps the background
+    // work from queuing up on the GPU ahead of the latency-critical work.
+    uint32_t maxJobsInFlight[kJobClassCount] = { 0, 2 };
+};
+
+// Routes the jobs of each class to the command queue of its class and accounts their latency,
+// from the time they are submitted to the scheduler to the end of their last dispatch.
+class PriorityScheduler {
+public:
+    struct ClassStats {
+        std::vector<double> latenciesUS;
+        std::vector<double> gpuTimesUS;
+        uint64_t dispatchCount = 0;
+    };
+
+    PriorityScheduler(MultiQueueExecutor* executor, const PrioritySchedulerSettings& settings);
+
+    // Queue a job, which is submitted as soon as its class has room in flight.
+    void Submit(JobClass jobClass, uint32_t dispatchCount);
+
+    // Wait until timeUS or until some jobs have completed, whichever comes first, and submit the
+    // jobs that then have room in flight.
+    void WaitUntil(double timeUS);
+    // Wait until every job has completed.
+    void Drain();
+
+    // The jobs of a class that are queued or in flight.
+    uint32_t GetPendingJobCount(JobClass jobClass) const;
+    const ClassStats& GetStats(JobClass jobClass) const;
+
+private:
+    struct Job {
+        JobClass jobClass;
+        uint32_t dispatchCount;
+        double submitTimeUS;
+    };
+
+    void SubmitReadyJobs();
+
+    MultiQueueExecutor* mExecutor;
+    PrioritySchedulerSettings mSettings;
+    // The executor queue of each class.
+    uint32_t mQueues[kJobClassCount];
+    std::deque<uint64_t> mQueuedJobs[kJobClassCount];
+    uint32_t mJobsInFlight[kJobClassCount] = {};
+    std::unordered_map<uint64_t, Job> mJobs;
+    uint64_t mNextJobId = 0;
+    ClassStats mStats[kJobClassCount];
+};
+
+struct PriorityWorkloadSettings {
+    // The latency-critical jobs arrive as a Poisson process with this mean interval.
+    double criticalIntervalUS = 20000.0;
+    uint32_t criticalDispatchCount = 1;
+    // Background jobs are queued whenever fewer than backgroundBacklog are pending, so that the
+    // GPU is never idle.
+    uint32_t backgroundDispatchCount = 4;
+    uint32_t backgroundBacklog = 4;
+    double durationUS = 2000000.0;
+    // Idle time before each configuration, so that it doesn't inherit the clock of the previous
+    // one.
+    double idleBeforeRunUS = 100000.0;
+    uint32_t seed = 1;
+};
+
+// Run the same arrivals once with every class on one shared queue of normal priority, as created
+// by D3D12MatMul::InitQueue(), and once with the queue of each class from settings, and print the
+// latency of each class and the background throughput of both.
+void ComparePriorityScheduling(
+    MultiQueueExecutor* executor,
+    const PrioritySchedulerSettings& settings,
+    const PriorityWorkloadSettings& workload);
+
+#endif
@@ -0,0 +1,141 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "ReadbackRing.h"
+
+#include <stdexcept>
+
+#include "DXSampleHelper.h"
+
+namespace {
+
+// Enough for the float4 loads of the CPU code reading the data.
+constexpr uint64_t kReadbackAlignment = 16;
+
+}  // anonymous namespace
+
+ReadbackRing::ReadbackRing(ID3D12Device* device, uint64_t size) : mAllocator(size) {
+    D3D12_HEAP_PROPERTIES heapProperties = {};
+    heapProperties.Type = D3D12_HEAP_TYPE_READBACK;
+
+    D3D12_RESOURCE_DESC bufferDescriptor = {};
+    bufferDescriptor.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferDescriptor.Width = size;
+    bufferDescriptor.Height = 1;
+    bufferDescriptor.DepthOrArraySize = 1;
+    bufferDescriptor.MipLevels = 1;
+    bufferDescriptor.Format = DXGI_FORMAT_UNKNOWN;
+    bufferDescriptor.SampleDesc.Count = 1;
+    bufferDescriptor.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    bufferDescriptor.Flags = D3D12_RESOURCE_FLAG_NONE;
+    ThrowIfFailed(device->CreateCommittedResource(
+        &heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDescriptor, D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr, IID_PPV_ARGS(&mBuffer)));
+
+    // Readback buffers can stay mapped for their whole lifetime. A range is only read after the
+    // fence value of the submit that writes it has completed.
+    void* data = nullptr;
+    ThrowIfFailed(mBuffer->Map(0, nullptr, &data));
+    mMappedData = static_cast<const uint8_t*>(data);
+}
+
+ReadbackRing::~ReadbackRing() {
+    D3D12_RANGE writtenRange = { 0, 0 };
+    mBuffer->Unmap(0, &writtenRange);
+}
+
+bool ReadbackRing::ReadBuffer(
+    ID3D12GraphicsCommandList* commandList,
+    ID3D12Resource* source,
+    uint64_t sourceOffset,
+    uint64_t size,
+    Callback callback) {
+    return ReadRows(commandList, source, size, 0, 1, sourceOffset, size, std::move(callback));
+}
+
+bool ReadbackRing::ReadRows(
+    ID3D12GraphicsCommandList* commandList,
+    ID3D12Resource* source,
+    uint64_t rowPitch,
+    uint64_t firstRow,
+    uint64_t rowCount,
+    uint64_t columnOffset,
+    uint64_t rowSize,
+    Callback callback) {
+    const uint64_t offset = mAllocator.Allocate(rowCount * rowSize, kReadbackAlignment);
+    if (offset == RingAllocator::kInvalidOffset) {
+        return false;
+    }
+
+    if (columnOffset == 0 && rowSize == rowPitch) {
+        commandList->CopyBufferRegion(
+            mBuffer.Get(), offset, source, firstRow * rowPitch, rowCount * rowSize);
+    } else {
+        for (uint64_t row = 0; row < rowCount; ++row) {
+            commandList->CopyBufferRegion(
+                mBuffer.Get(), offset + row * rowSize, source,
+                (firstRow + row) * rowPitch + columnOffset, rowSize);
+        }
+    }
+    mCurrentReadbacks.push_back({ 0, offset, std::move(callback) });
+    return true;
+}
+
+void ReadbackRing::FinishSubmit(uint64_t fenceValue) {
+    mAllocator.FinishSubmit(fenceValue);
+    for (PendingReadback& readback : mCurrentReadbacks) {
+        readback.fenceValue = fenceValue;
+        mPendingReadbacks.push_back(std::move(readback));
+    }
+    mCurrentReadbacks.clear();
+}
+
+void ReadbackRing::DeliverCompleted(uint64_t completedFenceValue) {
+    while (!mPendingReadbacks.empty() &&
+           mPendingReadbacks.front().fenceValue <= completedFenceValue) {
+        // Pop before calling back, so that the callback can record new readbacks.
+        PendingReadback readback = std::move(mPendingReadbacks.front());
+        mPendingReadbacks.pop_front();
+        readback.callback(mMappedData + readback.offset);
+    }
+    mAllocator.Reclaim(completedFenceValue);
+}
+
+bool ReadbackRing::HasPendingReadbacks() const {
+    return !mPendingReadbacks.empty();
+}
+
+uint64_t ReadbackRing::GetOldestPendingFenceValue() const {
+    if (mPendingReadbacks.empty()) {
+        // Waiting for it would never make room for a readback that doesn't fit in the ring.
+        throw std::logic_error("The readback ring has no pending readback to wait for");
+    }
+    return mPendingReadbacks.front().fenceValue;
+}
+
+uint64_t ReadbackRing::GetSize() const {
+    return mAllocator.GetSize();
+}
@@ -0,0 +1,103 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef READBACK_RING_
+#define READBACK_RING_
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include "RingAllocator.h"
+
+using Microsoft::WRL::ComPtr;
+
+// A persistently mapped readback buffer shared by all the readbacks from one queue.
+//
+// Only the requested bytes are copied: a range of a buffer, or a tile of the rows of a row-major
+// matrix, which is packed row after row. Each readback is delivered to its callback, in submission
+// order, once the fence value of its submit has completed, and its range is reused right after the
+// callback returns.
+class ReadbackRing {
+public:
+    // data is only valid during the call.
+    using Callback = std::function<void(const void* data)>;
+
+    ReadbackRing(ID3D12Device* device, uint64_t size);
+    ~ReadbackRing();
+
+    // Record the copy of size bytes of source at sourceOffset. source must be in the COPY_SOURCE
+    // state. Returns false if the ring doesn't have enough room left; the caller then needs to
+    // wait for GetOldestPendingFenceValue() and call DeliverCompleted() before trying again.
+    bool ReadBuffer(
+        ID3D12GraphicsCommandList* commandList,
+        ID3D12Resource* source,
+        uint64_t sourceOffset,
+        uint64_t size,
+        Callback callback);
+
+    // Record the copy of rowSize bytes at columnOffset of rowCount rows of rowPitch bytes starting
+    // at firstRow, packed into rowCount * rowSize bytes. Full rows are copied at once.
+    bool ReadRows(
+        ID3D12GraphicsCommandList* commandList,
+        ID3D12Resource* source,
+        uint64_t rowPitch,
+        uint64_t firstRow,
+        uint64_t rowCount,
+        uint64_t columnOffset,
+        uint64_t rowSize,
+        Callback callback);
+
+    // fenceValue must be the value signaled on the queue right after the command list that
+    // records the readbacks made since the previous call.
+    void FinishSubmit(uint64_t fenceValue);
+
+    // Call the callbacks of all the readbacks whose fence value is not above completedFenceValue.
+    void DeliverCompleted(uint64_t completedFenceValue);
+
+    bool HasPendingReadbacks() const;
+    // Throws std::logic_error if there is no pending readback.
+    uint64_t GetOldestPendingFenceValue() const;
+    uint64_t GetSize() const;
+
+private:
+    struct PendingReadback {
+        uint64_t fenceValue;
+        uint64_t offset;
+        Callback callback;
+    };
+
+    ComPtr<ID3D12Resource> mBuffer;
+    const uint8_t* mMappedData = nullptr;
+    RingAllocator mAllocator;
+    std::vector<PendingReadback> mCurrentReadbacks;
+    std::deque<PendingReadback> mPendingReadbacks;
+};
+
+#endif
@@ -0,0 +1,282 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "RegressionGate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "BenchmarkStatistics.h"
+
+namespace {
+
+// Keys are written as one whitespace-free token.
+std::string MakeToken(std::string text) {
+    std::replace_if(
+        text.begin(), text.end(), [](char c) { return c == ' ' || c == '\t' || c == '\n'; }, '_');
+    return text;
+}
+
+const char* GetVerdictName(RegressionVerdict verdict) {
+    switch (verdict) {
+        case RegressionVerdict::NoBaseline:
+            return "NO BASELINE";
+        case RegressionVerdict::Unchanged:
+            return "UNCHANGED";
+        case RegressionVerdict::Improved:
+            return "IMPROVED";
+        case RegressionVerdict::Regressed:
+            return "REGRESSED";
+    }
+    return "UNKNOWN";
+}
+
+// The driver version is the second field of a baseline key.
+std::string RemoveDriverVersion(const std::string& key) {
+    const size_t begin = key.find('/');
+    const size_t end = begin == std::string::npos ? begin : key.find('/', begin + 1);
+    return end == std::string::npos ? key : key.substr(0, begin + 1) + key.substr(end);
+}
+
+std::vector<double> GetMeasuredTimes(const BenchmarkResults& run) {
+    const size_t warmupCount = std::min<size_t>(run.warmupIterations, run.gpuTimesUS.size());
+    return std::vector<double>(run.gpuTimesUS.begin() + warmupCount, run.gpuTimesUS.end());
+}
+
+}  // anonymous namespace
+
+std::string MakeBaselineKey(const RunMetadata& metadata) {
+    char ids[64];
+    snprintf(
+        ids, sizeof(ids), "%04x:%04x:%08x:%02x", metadata.vendorId, metadata.deviceId,
+        metadata.subSysId, metadata.revision);
+    const std::string driverVersion =
+        metadata.driverVersion.empty() ? "unknown" : metadata.driverVersion;
+    return MakeToken(
+        std::string(ids) + "/" + driverVersion + "/" + metadata.throttlePolicy + "/" +
+        metadata.kernelVariant + "/" + std::to_string(metadata.m) + "x" +
+        std::to_string(metadata.n) + "x" + std::to_string(metadata.k));
+}
+
+std::string GetBaselineKeyDriverVersion(const std::string& key) {
+    const size_t begin = key.find('/');
+    const size_t end = begin == std::string::npos ? begin : key.find('/', begin + 1);
+    return end == std::string::npos ? std::string() : key.substr(begin + 1, end - begin - 1);
+}
+
+bool BaselineStore::Load(const std::string& path) {
+    mBaselines.clear();
+    mNextSequence = 0;
+    std::ifstream file(path);
+    if (!file) {
+        return true;
+    }
+
+    std::string line;
+    for (uint32_t lineNumber = 1; std::getline(file, line); ++lineNumber) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream stream(line);
+        std::string key;
+        size_t count = 0;
+        if (!(stream >> key >> count)) {
+            printf("ERROR: %s:%u is not a valid baseline.\n", path.c_str(), lineNumber);
+            return false;
+        }
+        // The times are read before trusting count, which is only checked against them.
+        std::vector<double> timesUS;
+        double time;
+        while (stream >> time) {
+            timesUS.push_back(time);
+        }
+        if (!stream.eof() || timesUS.size() != count) {
+            printf(
+                "ERROR: %s:%u doesn't have the %zu times it declares.\n", path.c_str(), lineNumber,
+                count);
+            return false;
+        }
+        Set(key, timesUS);
+    }
+    return true;
+}
+
+bool BaselineStore::Save(const std::string& path) const {
+    // Written to a temporary file first so that a failure doesn't lose the previous baselines.
+    const std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::trunc);
+        file << "# <device>/<driver>/<throttle policy>/<kernel variant>/<MxNxK> <count> "
+                "<GPU times in us>...\n";
+        std::vector<const std::pair<const std::string, Baseline>*> baselines;
+        for (const auto& baseline : mBaselines) {
+            baselines.push_back(&baseline);
+        }
+        std::sort(baselines.begin(), baselines.end(), [](const auto* a, const auto* b) {
+            return a->second.sequence < b->second.sequence;
+        });
+        for (const auto* baseline : baselines) {
+            file << baseline->first << " " << baseline->second.timesUS.size();
+            char time[32];
+            for (double timeUS : baseline->second.timesUS) {
+                snprintf(time, sizeof(time), " %.3f", timeUS);
+                file << time;
+            }
+            file << "\n";
+        }
+        if (!file.flush()) {
+            printf("ERROR: failed to write %s.\n", temporaryPath.c_str());
+            return false;
+        }
+    }
+    std::remove(path.c_str());
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        printf("ERROR: failed to replace %s.\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+const std::vector<double>* BaselineStore::Find(const std::string& key) const {
+    auto baseline = mBaselines.find(key);
+    return baseline != mBaselines.end() ? &baseline->second.timesUS : nullptr;
+}
+
+const std::vector<double>* BaselineStore::FindAnyDriver(
+    const std::string& key,
+    std::string* foundKey) const {
+    const std::string configuration = RemoveDriverVersion(key);
+    const Baseline* latest = nullptr;
+    for (const auto& baseline : mBaselines) {
+        if (RemoveDriverVersion(baseline.first) == configuration &&
+            (latest == nullptr || baseline.second.sequence > latest->sequence)) {
+            latest = &baseline.second;
+            *foundKey = baseline.first;
+        }
+    }
+    return latest != nullptr ? &latest->timesUS : nullptr;
+}
+
+void BaselineStore::Set(const std::string& key, const std::vector<double>& timesUS) {
+    mBaselines[key] = { timesUS, mNextSequence++ };
+}
+
+RegressionReport CheckRegression(
+    const std::vector<double>& baselineTimesUS,
+    const std::vector<double>& currentTimesUS,
+    const RegressionSettings& settings) {
+    RegressionReport report;
+    if (baselineTimesUS.empty() || currentTimesUS.empty()) {
+        return report;
+    }
+
+    report.baselineMedianUS = Summarize(baselineTimesUS).median;
+    report.currentMedianUS = Summarize(currentTimesUS).median;
+    if (report.baselineMedianUS > 0.0) {
+        report.relativeChange =
+            (report.currentMedianUS - report.baselineMedianUS) / report.baselineMedianUS;
+    }
+
+    const MannWhitneyResult test = MannWhitneyUTest(currentTimesUS, baselineTimesUS);
+    report.pValue = test.pValue;
+    report.verdict = RegressionVerdict::Unchanged;
+    if (test.pValue < settings.significance &&
+        std::fabs(report.relativeChange) >= settings.minRelativeChange) {
+        // A positive z means that the current times tend to be larger.
+        report.verdict = test.z > 0.0 ? RegressionVerdict::Regressed : RegressionVerdict::Improved;
+    }
+    return report;
+}
+
+bool RunRegressionGate(
+    const std::string& baselinePath,
+    const std::vector<BenchmarkResults>& runs,
+    bool updateBaseline,
+    const RegressionSettings& settings) {
+    BaselineStore store;
+    if (!store.Load(baselinePath)) {
+        return false;
+    }
+
+    printf(
+        "Regression check against %s (p < %.3g and median change of at least %.1f%%):\n",
+        baselinePath.c_str(), settings.significance, settings.minRelativeChange * 100.0);
+    bool passed = true;
+    bool missingBaseline = false;
+    for (const BenchmarkResults& run : runs) {
+        const std::string key = MakeBaselineKey(run.metadata);
+        const std::vector<double> currentTimesUS = GetMeasuredTimes(run);
+        const std::vector<double>* baselineTimesUS = store.Find(key);
+        // A new driver has no baseline of its own yet, so it is compared with the previous one.
+        std::string baselineKey = key;
+        if (baselineTimesUS == nullptr) {
+            baselineTimesUS = store.FindAnyDriver(key, &baselineKey);
+        }
+
+        RegressionReport report;
+        if (baselineTimesUS != nullptr) {
+            report = CheckRegression(*baselineTimesUS, currentTimesUS, settings);
+        }
+        printf("%s: %s", key.c_str(), GetVerdictName(report.verdict));
+        if (report.verdict != RegressionVerdict::NoBaseline) {
+            printf(
+                ", median %.2f us -> %.2f us (%+.1f%%), p = %.3g", report.baselineMedianUS,
+                report.currentMedianUS, report.relativeChange * 100.0, report.pValue);
+        }
+        if (baselineKey != key) {
+            printf(
+                ", driver changed from %s", GetBaselineKeyDriverVersion(baselineKey).c_str());
+        }
+        printf("\n");
+        if (report.verdict == RegressionVerdict::Regressed) {
+            passed = false;
+        } else if (report.verdict == RegressionVerdict::NoBaseline && settings.requireBaseline) {
+            missingBaseline = true;
+        }
+
+        if (updateBaseline && !currentTimesUS.empty()) {
+            store.Set(key, currentTimesUS);
+        }
+    }
+
+    if (updateBaseline) {
+        if (!store.Save(baselinePath)) {
+            return false;
+        }
+        printf("The baselines in %s were updated.\n", baselinePath.c_str());
+    }
+    if (!passed) {
+        printf("ERROR: the performance regressed.\n");
+    }
+    if (missingBaseline) {
+        printf("ERROR: some runs have no baseline.\n");
+    }
+    printf("\n");
+    return passed && !missingBaseline;
+}
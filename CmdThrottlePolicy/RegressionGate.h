@@ -0,0 +1,116 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef REGRESSION_GATE_
+#define REGRESSION_GATE_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "BenchmarkResults.h"
+
+// Returns the key of the baseline of a run: the device, the driver, the throttle policy, the
+// kernel variant and the shape, so that a run is only ever compared with the same configuration.
+std::string MakeBaselineKey(const RunMetadata& metadata);
+
+// Returns the driver version in a key of MakeBaselineKey().
+std::string GetBaselineKeyDriverVersion(const std::string& key);
+
+// The measured GPU times of the baseline runs, in a text file with one line per key:
+//     <key> <count> <time in us>...
+// Lines starting with '#' are ignored. The lines are kept in the order their baselines were last
+// set, so the last one of a configuration is its most recent baseline.
+class BaselineStore {
+public:
+    // Returns false if the file exists but can't be parsed. A missing file is an empty store.
+    bool Load(const std::string& path);
+    bool Save(const std::string& path) const;
+
+    // Returns nullptr if there is no baseline for key.
+    const std::vector<double>* Find(const std::string& key) const;
+    // Returns the most recent baseline of the same configuration as key with any driver and sets
+    // foundKey to its key, or returns nullptr if there is none.
+    const std::vector<double>* FindAnyDriver(const std::string& key, std::string* foundKey) const;
+    void Set(const std::string& key, const std::vector<double>& timesUS);
+
+private:
+    struct Baseline {
+        std::vector<double> timesUS;
+        uint64_t sequence;
+    };
+
+    std::map<std::string, Baseline> mBaselines;
+    uint64_t mNextSequence = 0;
+};
+
+struct RegressionSettings {
+    // The p-value below which a difference between the baseline and the current run is
+    // significant.
+    double significance = 0.01;
+    // The relative change of the median below which a significant difference is still ignored,
+    // as with enough samples even a negligible change is significant.
+    double minRelativeChange = 0.03;
+    // Fail when a run has no baseline with any driver, instead of only reporting it.
+    bool requireBaseline = false;
+};
+
+enum class RegressionVerdict {
+    NoBaseline,
+    Unchanged,
+    Improved,
+    Regressed,
+};
+
+struct RegressionReport {
+    RegressionVerdict verdict = RegressionVerdict::NoBaseline;
+    double baselineMedianUS = 0.0;
+    double currentMedianUS = 0.0;
+    // (current - baseline) / baseline of the medians, positive when the current run is slower.
+    double relativeChange = 0.0;
+    double pValue = 1.0;
+};
+
+// Compare the distribution of the current GPU times with the baseline ones with a Mann-Whitney U
+// test, which is robust to the skewed and noisy distributions of GPU timings.
+RegressionReport CheckRegression(
+    const std::vector<double>& baselineTimesUS,
+    const std::vector<double>& currentTimesUS,
+    const RegressionSettings& settings);
+
+// Check the measured iterations of every run against baselinePath, and replace their baselines
+// with them when updateBaseline is set. A run without a baseline for its driver is compared with
+// the most recent baseline of another driver. Returns false if any run regressed, if a run has no
+// baseline at all and settings.requireBaseline is set, or if the baseline file couldn't be read or
+// written.
+bool RunRegressionGate(
+    const std::string& baselinePath,
+    const std::vector<BenchmarkResults>& runs,
+    bool updateBaseline,
+    const RegressionSettings& settings);
+
+#endif
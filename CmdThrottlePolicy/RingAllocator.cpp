@@ -0,0 +1,110 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "RingAllocator.h"
+
+#include <cassert>
+
+namespace {
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // anonymous namespace
+
+RingAllocator::RingAllocator(uint64_t size) : mSize(size) {
+}
+
+uint64_t RingAllocator::Allocate(uint64_t size, uint64_t alignment) {
+    assert(alignment > 0);
+    if (size == 0 || size > mSize) {
+        return kInvalidOffset;
+    }
+    if (mUsedSize == 0) {
+        mHead = 0;
+        mTail = 0;
+    }
+
+    uint64_t offset = AlignUp(mHead, alignment);
+    if (mHead >= mTail && mUsedSize < mSize) {
+        // The free space is [mHead, mSize) followed by [0, mTail).
+        if (offset + size > mSize) {
+            if (size > mTail) {
+                return kInvalidOffset;
+            }
+            offset = 0;
+        }
+    } else if (offset + size > mTail || mUsedSize == mSize) {
+        // The free space is [mHead, mTail).
+        return kInvalidOffset;
+    }
+
+    const uint64_t end = offset + size;
+    const uint64_t usedSize = offset >= mHead ? end - mHead : (mSize - mHead) + end;
+    mUsedSize += usedSize;
+    mCurrentSubmitUsedSize += usedSize;
+    mHead = end;
+    return offset;
+}
+
+void RingAllocator::FinishSubmit(uint64_t fenceValue) {
+    if (mCurrentSubmitUsedSize == 0) {
+        return;
+    }
+    mPendingSubmits.push_back({ fenceValue, mHead, mCurrentSubmitUsedSize });
+    mCurrentSubmitUsedSize = 0;
+}
+
+void RingAllocator::Reclaim(uint64_t completedFenceValue) {
+    while (!mPendingSubmits.empty() &&
+           mPendingSubmits.front().fenceValue <= completedFenceValue) {
+        mTail = mPendingSubmits.front().end;
+        mUsedSize -= mPendingSubmits.front().usedSize;
+        mPendingSubmits.pop_front();
+    }
+}
+
+bool RingAllocator::HasPendingSubmits() const {
+    return !mPendingSubmits.empty();
+}
+
+uint64_t RingAllocator::GetOldestPendingFenceValue() const {
+    assert(!mPendingSubmits.empty());
+    return mPendingSubmits.front().fenceValue;
+}
+
+bool RingAllocator::HasCurrentSubmitAllocations() const {
+    return mCurrentSubmitUsedSize > 0;
+}
+
+uint64_t RingAllocator::GetSize() const {
+    return mSize;
+}
+
+uint64_t RingAllocator::GetUsedSize() const {
+    return mUsedSize;
+}
@@ -0,0 +1,85 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef RING_ALLOCATOR_
+#define RING_ALLOCATOR_
+
+#include <cstdint>
+#include <deque>
+
+// Sub-allocates aligned ranges of a fixed-size ring and reclaims them by fence value.
+//
+// The ranges allocated since the last FinishSubmit() belong to the submit that FinishSubmit() tags
+// with the fence value signaled after it, and they are only reused once that fence value has
+// completed. A range never wraps around the end of the ring. Only offsets are managed, so the same
+// allocator works for any memory indexed by offset.
+class RingAllocator {
+public:
+    static constexpr uint64_t kInvalidOffset = UINT64_MAX;
+
+    explicit RingAllocator(uint64_t size);
+
+    // Returns the offset of the range, or kInvalidOffset if the ring doesn't have enough room
+    // left, in which case the caller needs to wait for GetOldestPendingFenceValue() and call
+    // Reclaim() before trying again.
+    uint64_t Allocate(uint64_t size, uint64_t alignment);
+
+    // fenceValue must be the value signaled on the queue right after the submit that uses the
+    // ranges allocated since the previous call.
+    void FinishSubmit(uint64_t fenceValue);
+
+    // Free the ranges of all the submits whose fence value is not above completedFenceValue.
+    void Reclaim(uint64_t completedFenceValue);
+
+    bool HasPendingSubmits() const;
+    uint64_t GetOldestPendingFenceValue() const;
+    // Returns true if some ranges were allocated since the last FinishSubmit().
+    bool HasCurrentSubmitAllocations() const;
+
+    uint64_t GetSize() const;
+    // The allocated size, including the alignment padding and the space skipped at the end of the
+    // ring when wrapping around.
+    uint64_t GetUsedSize() const;
+
+private:
+    struct PendingSubmit {
+        uint64_t fenceValue;
+        // The end of the last range of the submit.
+        uint64_t end;
+        uint64_t usedSize;
+    };
+
+    uint64_t mSize;
+    // The next free byte and the first byte in use, which are equal both when the ring is empty
+    // and when it is full; mUsedSize tells them apart.
+    uint64_t mHead = 0;
+    uint64_t mTail = 0;
+    uint64_t mUsedSize = 0;
+    uint64_t mCurrentSubmitUsedSize = 0;
+    std::deque<PendingSubmit> mPendingSubmits;
+};
+
+#endif
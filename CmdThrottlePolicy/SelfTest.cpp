@@ -0,0 +1,1168 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+
+#include "SelfTest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "BenchmarkStatistics.h"
+#include "BurstyWorkload.h"
+#include "CPUMatMul.h"
+#include "CPUTopology.h"
+#include "CooperativeMatMul.h"
+#include "HeapSuballocator.h"
+#include "MatMulCommand.h"
+#include "MatMulJobTable.h"
+#include "MatMulService.h"
+#include "PolicyComparison.h"
+#include "PriorityScheduler.h"
+#include "RegressionGate.h"
+#include "RingAllocator.h"
+#include "SimulatedGPU.h"
+#include "StrassenMatMul.h"
+#include "ThrottlePolicy.h"
+
+namespace {
+
+// 2 * M * N * K of the 1024x1024x1024 matrix multiplication done by D3D12MatMul.
+constexpr double kFlopsPerDispatch = 2.0 * 1024.0 * 1024.0 * 1024.0;
+
+// Print an error for the check what of the test if it failed, and return whether it passed.
+bool Expect(bool passed, const char* test, const char* what) {
+    if (!passed) {
+        printf("ERROR: %s: %s.\n", test, what);
+    }
+    return passed;
+}
+
+bool IsNear(double value, double expected, double tolerance = 1e-9) {
+    return std::abs(value - expected) <= tolerance;
+}
+
+bool TestBenchmarkStatistics(const char* test) {
+    bool passed = true;
+
+    const std::vector<double> sorted = { 1.0, 2.0, 3.0, 4.0, 5.0 };
+    passed &= Expect(
+        IsNear(Percentile(sorted, 0.0), 1.0) && IsNear(Percentile(sorted, 25.0), 2.0) &&
+            IsNear(Percentile(sorted, 50.0), 3.0) && IsNear(Percentile(sorted, 90.0), 4.6) &&
+            IsNear(Percentile(sorted, 100.0), 5.0) &&
+            IsNear(Percentile({ 10.0, 20.0 }, 50.0), 15.0),
+        test, "a percentile isn't interpolated between the closest ranks");
+    const DistributionSummary summary = Summarize({ 9.0, 4.0, 2.0, 4.0, 5.0, 4.0, 7.0, 5.0 });
+    passed &= Expect(
+        summary.count == 8 && summary.min == 2.0 && summary.max == 9.0 &&
+            IsNear(summary.median, 4.5) && IsNear(summary.mean, 5.0) &&
+            IsNear(summary.stddev, std::sqrt(32.0 / 7.0)),
+        test, "the summary of a known distribution is wrong");
+
+    // The median is 11 and the MAD 1, so only the planted 50 has a modified z-score above 3.5.
+    const std::vector<size_t> outliers =
+        DetectOutliers({ 10.0, 11.0, 10.0, 12.0, 11.0, 10.0, 11.0, 50.0 });
+    passed &= Expect(
+        outliers == std::vector<size_t>{ 7 }, test, "the planted outlier isn't the only one found");
+
+    // No ties: U = 0, and z = (0 - 4.5 + 0.5) / sqrt(3 * 3 * 7 / 12) with the continuity
+    // correction.
+    const MannWhitneyResult separated = MannWhitneyUTest({ 1.0, 2.0, 3.0 }, { 4.0, 5.0, 6.0 });
+    passed &= Expect(
+        IsNear(separated.u, 0.0) && IsNear(separated.z, -4.0 / std::sqrt(5.25)) &&
+            IsNear(separated.pValue, std::erfc(4.0 / std::sqrt(5.25) / std::sqrt(2.0))),
+        test, "the U test of separated samples is wrong");
+    // One tie of two samples: U = 0.5, and the variance 2 * 2 / 12 * (5 - 6 / 12) = 1.5.
+    const MannWhitneyResult tied = MannWhitneyUTest({ 1.0, 2.0 }, { 2.0, 3.0 });
+    passed &= Expect(
+        IsNear(tied.u, 0.5) && IsNear(tied.z, -1.0 / std::sqrt(1.5)), test,
+        "the U test of tied samples is wrong");
+
+    // A ramp from 200 down to 110 followed by a plateau at 100: the windows of 5 samples have a
+    // median within 5% of the plateau from the one starting at 8, which holds 120, 110 and 100.
+    std::vector<double> rampAndPlateau;
+    for (int i = 0; i < 10; ++i) {
+        rampAndPlateau.push_back(200.0 - 10.0 * i);
+    }
+    rampAndPlateau.resize(100, 100.0);
+    passed &= Expect(
+        FindSteadyStateStart(rampAndPlateau) == 8 &&
+            FindSteadyStateStart(std::vector<double>(100, 100.0)) == 0,
+        test, "the steady state doesn't start at the end of the ramp");
+    return passed;
+}
+
+bool TestPolicyComparison(const char* test) {
+    bool passed = true;
+
+    constexpr uint32_t kTrialsPerPolicy = 10;
+    const std::vector<ThrottlePolicy> schedule = BuildTrialSchedule(kTrialsPerPolicy, 1);
+    bool balanced = schedule.size() == 2 * kTrialsPerPolicy;
+    for (size_t i = 0; balanced && i + 1 < schedule.size(); i += 2) {
+        balanced = schedule[i] != schedule[i + 1];
+    }
+    passed &= Expect(balanced, test, "a pair of trials doesn't hold one trial of each policy");
+
+    PolicyComparisonSettings settings;
+    settings.trialsPerPolicy = kTrialsPerPolicy;
+    settings.dispatchesPerTrial = 5;
+    SimulatedPolicyTrialExecutor executor(SimulatedGPUDesc(), kFlopsPerDispatch);
+    const PolicyComparisonResult result = ComparePolicies(&executor, settings);
+    for (int i = 0; i < kThrottlePolicyCount; ++i) {
+        passed &= Expect(
+            result.trialMediansUS[i].size() == settings.trialsPerPolicy &&
+                result.dispatchTimesUS[i].size() ==
+                    settings.trialsPerPolicy * settings.dispatchesPerTrial,
+            test, "a policy doesn't have the samples of all its trials");
+    }
+
+    // The simulated clock ramps up 60 times faster with MAX_PERFORMANCE, so the difference of the
+    // first dispatches after the idle time must be found.
+    const double dynamicMedianUS =
+        Summarize(result.trialMediansUS[static_cast<int>(ThrottlePolicy::Dynamic)]).median;
+    const double maxPerformanceMedianUS =
+        Summarize(result.trialMediansUS[static_cast<int>(ThrottlePolicy::MaxPerformance)]).median;
+    passed &= Expect(
+        maxPerformanceMedianUS < dynamicMedianUS, test,
+        "MAX_PERFORMANCE isn't faster than DYNAMIC on the simulated GPU");
+    passed &= Expect(
+        result.test.pValue < settings.alpha, test,
+        "the difference between the policies isn't significant");
+    return passed;
+}
+
+bool TestBurstyWorkload(const char* test) {
+    bool passed = true;
+
+    BurstyWorkloadSettings settings;
+    settings.gapDistribution = GapDistribution::Poisson;
+    settings.burstCount = 8;
+    settings.burstLength = 3;
+    settings.submissionRateHz = 2000.0;
+    std::vector<double> gapsUS;
+    passed &= Expect(
+        BuildIdleGaps(settings, &gapsUS) && gapsUS.size() == settings.burstCount, test,
+        "the Poisson gaps don't hold one gap per burst");
+    BurstyWorkloadSettings zeroGapSettings = settings;
+    zeroGapSettings.gapUS = 0.0;
+    std::vector<double> zeroGapsUS;
+    passed &= Expect(
+        BuildIdleGaps(zeroGapSettings, &zeroGapsUS) &&
+            zeroGapsUS == std::vector<double>(settings.burstCount, 0.0),
+        test, "the Poisson gaps with a zero mean aren't all zero");
+
+    // Every gap is used once per policy, and every dispatch of the bursts is sampled once.
+    SimulatedPolicyTrialExecutor executor(SimulatedGPUDesc(), kFlopsPerDispatch);
+    const std::vector<BurstSample> samples = RunBurstyWorkload(&executor, settings);
+    std::vector<uint32_t> sampleCounts(
+        kThrottlePolicyCount * settings.burstCount * settings.burstLength);
+    bool validSamples = samples.size() == sampleCounts.size();
+    for (const BurstSample& sample : samples) {
+        if (sample.burst >= settings.burstCount || sample.dispatch >= settings.burstLength ||
+            sample.precedingIdleUS != gapsUS[sample.burst] ||
+            sample.latency.gpuTimeUS <= 0.0 ||
+            sample.latency.latencyUS < sample.latency.gpuTimeUS) {
+            validSamples = false;
+            break;
+        }
+        ++sampleCounts[(static_cast<uint32_t>(sample.policy) * settings.burstCount +
+                        sample.burst) * settings.burstLength + sample.dispatch];
+    }
+    for (uint32_t count : sampleCounts) {
+        validSamples &= count == 1;
+    }
+    passed &= Expect(
+        validSamples, test, "the samples don't hold every dispatch of every burst once");
+
+    // After a long gap, the clock has decayed and the first dispatch of a burst is faster with
+    // MAX_PERFORMANCE.
+    settings.gapDistribution = GapDistribution::Fixed;
+    settings.gapUS = 50000.0;
+    std::vector<double> firstLatenciesUS[kThrottlePolicyCount];
+    for (const BurstSample& sample : RunBurstyWorkload(&executor, settings)) {
+        if (sample.dispatch == 0) {
+            firstLatenciesUS[static_cast<int>(sample.policy)].push_back(
+                sample.latency.latencyUS);
+        }
+    }
+    passed &= Expect(
+        Summarize(firstLatenciesUS[static_cast<int>(ThrottlePolicy::MaxPerformance)]).median <
+            Summarize(firstLatenciesUS[static_cast<int>(ThrottlePolicy::Dynamic)]).median,
+        test, "the first dispatch after a gap isn't faster with MAX_PERFORMANCE");
+    return passed;
+}
+
+bool Overlap(const HeapAllocation& lhs, const HeapAllocation& rhs) {
+    return lhs.heapIndex == rhs.heapIndex && lhs.offset < rhs.offset + rhs.size &&
+           rhs.offset < lhs.offset + lhs.size;
+}
+
+bool TestHeapSuballocator(const char* test) {
+    bool passed = true;
+
+    struct LiveBuffer {
+        HeapAllocation allocation;
+        uint64_t size;
+    };
+    HeapSuballocator::Desc desc;
+    desc.heapSize = 4ull * 1024 * 1024;
+    HeapSuballocator allocator(desc);
+    std::vector<LiveBuffer> liveBuffers;
+    std::mt19937 random(1);
+    // From a fraction of a block to twice the heap size, for the dedicated heaps.
+    std::uniform_int_distribution<uint64_t> size(1, 2 * desc.heapSize);
+    bool validPlacement = true;
+    bool validStats = true;
+    for (uint32_t i = 0; i < 2000 && validPlacement && validStats; ++i) {
+        if (liveBuffers.size() > 32 || (!liveBuffers.empty() && random() % 2 == 0)) {
+            const size_t index = random() % liveBuffers.size();
+            allocator.Free(liveBuffers[index].allocation, liveBuffers[index].size);
+            liveBuffers[index] = liveBuffers.back();
+            liveBuffers.pop_back();
+        } else {
+            // Mostly small buffers, so that the regular heaps hold several of them.
+            const uint64_t bufferSize = random() % 4 == 0 ? size(random) : size(random) / 64 + 1;
+            const HeapAllocation allocation = allocator.Allocate(bufferSize);
+            validPlacement = allocation.heapIndex < allocator.GetHeapCount() &&
+                             allocation.offset % desc.blockAlignment == 0 &&
+                             allocation.size >= bufferSize &&
+                             allocation.offset + allocation.size <=
+                                 allocator.GetHeapSize(allocation.heapIndex);
+            for (const LiveBuffer& liveBuffer : liveBuffers) {
+                validPlacement &= !Overlap(allocation, liveBuffer.allocation);
+            }
+            liveBuffers.push_back({ allocation, bufferSize });
+        }
+
+        uint64_t allocatedBytes = 0;
+        uint64_t requestedBytes = 0;
+        for (const LiveBuffer& liveBuffer : liveBuffers) {
+            allocatedBytes += liveBuffer.allocation.size;
+            requestedBytes += liveBuffer.size;
+        }
+        validStats = allocator.GetStats().allocatedBytes == allocatedBytes &&
+                     allocator.GetStats().requestedBytes == requestedBytes;
+    }
+    passed &= Expect(
+        validPlacement, test,
+        "a block is misaligned, out of its heap, too small or overlaps a live one");
+    passed &= Expect(validStats, test, "the stats don't match the live blocks");
+
+    // A freed block is recycled by the next buffer of its size class, even of another size.
+    const HeapAllocation freed = allocator.Allocate(100 * 1024);
+    allocator.Free(freed, 100 * 1024);
+    const uint64_t recycledCount = allocator.GetStats().recycledCount;
+    const HeapAllocation recycled = allocator.Allocate(120 * 1024);
+    passed &= Expect(
+        recycled.heapIndex == freed.heapIndex && recycled.offset == freed.offset &&
+            allocator.GetStats().recycledCount == recycledCount + 1,
+        test, "a freed block isn't recycled by a buffer of its size class");
+
+    // The transient blocks don't overlap each other or the live ones, and alias the previous ones
+    // after a reset.
+    const uint64_t transientSizes[] = { 3 * desc.heapSize / 4, desc.heapSize / 2, 1000 };
+    std::vector<HeapAllocation> transients;
+    for (uint64_t transientSize : transientSizes) {
+        const HeapAllocation transient = allocator.AllocateTransient(transientSize);
+        bool validTransient = transient.transient && transient.size >= transientSize &&
+                              transient.offset + transient.size <=
+                                  allocator.GetHeapSize(transient.heapIndex);
+        for (const HeapAllocation& previous : transients) {
+            validTransient &= !Overlap(transient, previous);
+        }
+        for (const LiveBuffer& liveBuffer : liveBuffers) {
+            validTransient &= !Overlap(transient, liveBuffer.allocation);
+        }
+        passed &= Expect(validTransient, test, "a transient block overlaps another block");
+        transients.push_back(transient);
+    }
+    allocator.ResetTransient();
+    bool aliased = true;
+    for (size_t i = 0; i < transients.size(); ++i) {
+        const HeapAllocation transient = allocator.AllocateTransient(transientSizes[i]);
+        aliased &= transient.heapIndex == transients[i].heapIndex &&
+                   transient.offset == transients[i].offset;
+    }
+    passed &= Expect(
+        aliased, test, "the transient blocks don't reuse the same memory after a reset");
+    return passed;
+}
+
+// Returns whether the matrices at offsets of the given sizes are aligned, fit in a pool of poolSize
+// bytes and don't overlap each other.
+bool ArePooledMatricesValid(
+    std::vector<std::pair<uint64_t, uint64_t>> offsetsAndSizes,
+    uint64_t poolSize) {
+    std::sort(offsetsAndSizes.begin(), offsetsAndSizes.end());
+    uint64_t end = 0;
+    for (const std::pair<uint64_t, uint64_t>& matrix : offsetsAndSizes) {
+        if (matrix.first % MatMulJobTable::kMatrixAlignment != 0 || matrix.first < end) {
+            return false;
+        }
+        end = matrix.first + matrix.second;
+    }
+    return end <= poolSize;
+}
+
+bool TestMatMulJobTable(const char* test) {
+    bool passed = true;
+
+    // Not square, so that mixing up the dimensions of the tile is caught.
+    const MatMulTiling tiling = { 64, 32, 16 };
+    MatMulJobTable table(tiling);
+    passed &= Expect(
+        !table.AddJob(0, 32, 16) && !table.AddJob(96, 32, 16) && !table.AddJob(64, 48, 16) &&
+            !table.AddJob(64, 32, 8) && table.GetJobs().empty(),
+        test, "a shape the kernel doesn't support was added");
+    constexpr uint32_t kJobCount = 64;
+    table.AddRandomJobs(kJobCount, 512, 1);
+    const std::vector<MatMulJobDesc>& jobs = table.GetJobs();
+    passed &= Expect(jobs.size() == kJobCount, test, "a random job wasn't added");
+
+    std::vector<std::pair<uint64_t, uint64_t>> inputMatrices1;
+    std::vector<std::pair<uint64_t, uint64_t>> inputMatrices2;
+    std::vector<std::pair<uint64_t, uint64_t>> outputMatrices;
+    double flops = 0.0;
+    for (const MatMulJobDesc& job : jobs) {
+        inputMatrices1.push_back(
+            { job.inputMatrix1Offset, static_cast<uint64_t>(job.m) * job.k * sizeof(float) });
+        inputMatrices2.push_back(
+            { job.inputMatrix2Offset, static_cast<uint64_t>(job.k) * job.n * sizeof(float) });
+        outputMatrices.push_back(
+            { job.outputMatrixOffset, static_cast<uint64_t>(job.m) * job.n * sizeof(float) });
+        flops += 2.0 * job.m * job.n * job.k;
+    }
+    passed &= Expect(
+        ArePooledMatricesValid(inputMatrices1, table.GetInputMatrix1PoolSize()) &&
+            ArePooledMatricesValid(inputMatrices2, table.GetInputMatrix2PoolSize()) &&
+            ArePooledMatricesValid(outputMatrices, table.GetOutputMatrixPoolSize()),
+        test, "a matrix is misaligned, out of its pool or overlaps another one");
+    passed &= Expect(table.GetFlops() == flops, test, "the flops don't match the jobs");
+
+    const uint64_t inputMatrix1Pool = 0x10000;
+    const uint64_t inputMatrix2Pool = 0x100000000;
+    const uint64_t outputMatrixPool = 0x200000000;
+    std::vector<IndirectMatMulCommand> commands(jobs.size());
+    table.BuildCommands(inputMatrix1Pool, inputMatrix2Pool, outputMatrixPool, commands.data());
+    bool validCommands = true;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const MatMulJobDesc& job = jobs[i];
+        const IndirectMatMulCommand& command = commands[i];
+        validCommands &= command.m == job.m && command.n == job.n && command.k == job.k &&
+                         command.tileK == tiling.tileK &&
+                         command.inputMatrix1 == inputMatrix1Pool + job.inputMatrix1Offset &&
+                         command.inputMatrix2 == inputMatrix2Pool + job.inputMatrix2Offset &&
+                         command.outputMatrix == outputMatrixPool + job.outputMatrixOffset &&
+                         command.threadGroupCountX * tiling.tileN == job.n &&
+                         command.threadGroupCountY * tiling.tileM == job.m &&
+                         command.threadGroupCountZ == 1;
+    }
+    passed &= Expect(validCommands, test, "a command doesn't match its job");
+    return passed;
+}
+
+// Forwards to a SimulatedMultiQueueExecutor and records how the jobs go through its queues.
+class RecordingMultiQueueExecutor : public MultiQueueExecutor {
+public:
+    explicit RecordingMultiQueueExecutor(double flopsPerDispatch)
+        : mExecutor(SimulatedGPUDesc(), flopsPerDispatch) {
+    }
+
+    const char* GetName() const override {
+        return mExecutor.GetName();
+    }
+
+    uint32_t CreateQueue(const ClassQueueDesc& desc) override {
+        queueDescs.push_back(desc);
+        jobsInFlight.push_back(0);
+        maxJobsInFlight.push_back(0);
+        return mExecutor.CreateQueue(desc);
+    }
+
+    void Submit(uint32_t queue, uint64_t jobId, uint32_t dispatchCount) override {
+        if (jobId >= jobQueues.size()) {
+            jobQueues.resize(jobId + 1, UINT32_MAX);
+            completionCounts.resize(jobId + 1, 0);
+        }
+        jobQueues[jobId] = queue;
+        maxJobsInFlight[queue] = std::max(maxJobsInFlight[queue], ++jobsInFlight[queue]);
+        mExecutor.Submit(queue, jobId, dispatchCount);
+    }
+
+    double GetTimeUS() override {
+        return mExecutor.GetTimeUS();
+    }
+
+    void Wait(double timeUS, std::vector<CompletedJob>* completed) override {
+        const size_t initialCompletedCount = completed->size();
+        mExecutor.Wait(timeUS, completed);
+        for (size_t i = initialCompletedCount; i < completed->size(); ++i) {
+            const uint64_t jobId = (*completed)[i].jobId;
+            --jobsInFlight[jobQueues[jobId]];
+            ++completionCounts[jobId];
+        }
+    }
+
+    std::vector<ClassQueueDesc> queueDescs;
+    // Indexed by job id.
+    std::vector<uint32_t> jobQueues;
+    std::vector<uint32_t> completionCounts;
+    // Indexed by queue.
+    std::vector<uint32_t> jobsInFlight;
+    std::vector<uint32_t> maxJobsInFlight;
+
+private:
+    SimulatedMultiQueueExecutor mExecutor;
+};
+
+bool TestRingAllocator(const char* test) {
+    bool passed = true;
+
+    struct LiveRange {
+        uint64_t offset;
+        uint64_t size;
+        uint64_t fenceValue;
+    };
+    // Not a multiple of the alignments, so that the end of the ring gets skipped when wrapping.
+    constexpr uint64_t kRingSize = 1000;
+    RingAllocator ring(kRingSize);
+    passed &= Expect(
+        ring.Allocate(kRingSize + 1, 1) == RingAllocator::kInvalidOffset &&
+            ring.Allocate(0, 1) == RingAllocator::kInvalidOffset,
+        test, "an allocation larger than the ring or empty was accepted");
+
+    std::vector<LiveRange> liveRanges;
+    std::mt19937 random(1);
+    std::uniform_int_distribution<uint64_t> size(1, 300);
+    const uint64_t alignments[] = { 1, 16, 64, 256 };
+    uint64_t nextFenceValue = 1;
+    uint64_t completedFenceValue = 0;
+    uint32_t wrapCount = 0;
+    uint64_t previousOffset = 0;
+    bool validRanges = true;
+    bool neverStuck = true;
+    auto reclaim = [&](uint64_t fenceValue) {
+        completedFenceValue = fenceValue;
+        ring.Reclaim(completedFenceValue);
+        liveRanges.erase(
+            std::remove_if(
+                liveRanges.begin(), liveRanges.end(),
+                [&](const LiveRange& range) { return range.fenceValue <= completedFenceValue; }),
+            liveRanges.end());
+    };
+    for (uint32_t i = 0; i < 5000 && validRanges && neverStuck; ++i) {
+        const uint64_t rangeSize = size(random);
+        const uint64_t alignment = alignments[random() % std::size(alignments)];
+        const uint64_t offset = ring.Allocate(rangeSize, alignment);
+        if (offset == RingAllocator::kInvalidOffset) {
+            // The ring is only full with ranges in use, and then the oldest submit frees some.
+            if (ring.HasCurrentSubmitAllocations()) {
+                ring.FinishSubmit(nextFenceValue++);
+            }
+            neverStuck = ring.HasPendingSubmits();
+            if (neverStuck) {
+                reclaim(ring.GetOldestPendingFenceValue());
+            }
+            continue;
+        }
+
+        validRanges = offset % alignment == 0 && offset + rangeSize <= kRingSize;
+        for (const LiveRange& range : liveRanges) {
+            validRanges &=
+                offset + rangeSize <= range.offset || range.offset + range.size <= offset;
+        }
+        wrapCount += offset < previousOffset;
+        previousOffset = offset;
+        // The ranges of the current submit are tagged with the fence value it will signal.
+        liveRanges.push_back({ offset, rangeSize, nextFenceValue });
+
+        if (random() % 3 == 0) {
+            ring.FinishSubmit(nextFenceValue++);
+        }
+        // The GPU lags behind by a few submits.
+        if (random() % 4 == 0 && completedFenceValue + 3 < nextFenceValue) {
+            reclaim(completedFenceValue + 1);
+        }
+    }
+    passed &= Expect(
+        validRanges, test, "a range is misaligned, out of the ring or overlaps a live one");
+    passed &= Expect(neverStuck, test, "an allocation failed with an empty ring");
+    passed &= Expect(wrapCount > 10, test, "the allocations didn't wrap around the ring");
+
+    // Once every submit has completed, the whole ring is free again.
+    ring.FinishSubmit(nextFenceValue);
+    reclaim(nextFenceValue);
+    passed &= Expect(
+        ring.GetUsedSize() == 0 && !ring.HasPendingSubmits() && ring.Allocate(kRingSize, 256) == 0,
+        test, "the ring isn't empty once every submit has completed");
+    return passed;
+}
+
+bool WriteTextFile(const std::string& path, const char* text) {
+    std::ofstream file(path, std::ios::trunc);
+    return static_cast<bool>(file << text);
+}
+
+// Returns times around medianUS with a relative spread of 1%, the same for every seed.
+std::vector<double> MakeTimes(double medianUS, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::normal_distribution<double> noise(1.0, 0.01);
+    std::vector<double> timesUS(50);
+    for (double& timeUS : timesUS) {
+        timeUS = medianUS * noise(random);
+    }
+    return timesUS;
+}
+
+bool TestRegressionGate(const char* test) {
+    bool passed = true;
+
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "CmdThrottlePolicySelfTestBaselines.txt")
+            .string();
+    RunMetadata metadata;
+    metadata.vendorId = 0x8086;
+    metadata.deviceId = 0x56a0;
+    metadata.throttlePolicy = "DYNAMIC";
+    metadata.kernelVariant = "SLM_4X4_16X16_4_floats";
+    metadata.m = metadata.n = metadata.k = 1024;
+    auto makeKey = [&](const char* driverVersion) {
+        metadata.driverVersion = driverVersion;
+        return MakeBaselineKey(metadata);
+    };
+    const std::string oldDriverKey = makeKey("31.0.101.1");
+    const std::string newDriverKey = makeKey("31.0.101.2");
+    const std::string nextDriverKey = makeKey("31.0.101.3");
+    metadata.m = 2048;
+    const std::string otherShapeKey = makeKey("31.0.101.1");
+
+    // The times are written with 3 decimals, so these ones come back exactly.
+    BaselineStore store;
+    store.Set(newDriverKey, { 101.5, 102.25 });
+    store.Set(oldDriverKey, { 100.125, 100.5, 99.75 });
+    store.Set(otherShapeKey, { 400.0 });
+    store.Set(newDriverKey, { 98.0, 99.0 });
+    BaselineStore loadedStore;
+    const bool saved = store.Save(path);
+    passed &= Expect(
+        saved && loadedStore.Load(path) && loadedStore.Find(oldDriverKey) != nullptr &&
+            *loadedStore.Find(oldDriverKey) == std::vector<double>{ 100.125, 100.5, 99.75 } &&
+            loadedStore.Find(newDriverKey) != nullptr &&
+            *loadedStore.Find(newDriverKey) == std::vector<double>{ 98.0, 99.0 } &&
+            loadedStore.Find(nextDriverKey) == nullptr,
+        test, "the baselines don't survive a save and a load");
+    // The baseline of the new driver was set last, so it is the most recent of the shape.
+    std::string foundKey;
+    const std::vector<double>* anyDriverTimesUS =
+        loadedStore.FindAnyDriver(nextDriverKey, &foundKey);
+    passed &= Expect(
+        anyDriverTimesUS != nullptr && *anyDriverTimesUS == std::vector<double>{ 98.0, 99.0 } &&
+            foundKey == newDriverKey &&
+            GetBaselineKeyDriverVersion(foundKey) == "31.0.101.2",
+        test, "the fallback isn't the most recent baseline of the same configuration");
+    metadata.m = 4096;
+    passed &= Expect(
+        loadedStore.FindAnyDriver(makeKey("31.0.101.1"), &foundKey) == nullptr, test,
+        "a baseline of another configuration was used as the fallback");
+
+    // Malformed lines and counts that don't match the times fail the load, a missing file is an
+    // empty store.
+    const char* invalidFiles[] = {
+        "key\n",
+        "key two 1.0 2.0\n",
+        "key 3 1.0 2.0\n",
+        "key 1 1.0 2.0\n",
+        "key 2 1.0 x\n",
+    };
+    for (const char* invalidFile : invalidFiles) {
+        printf(
+            "Expecting an error for \"%.*s\":\n", static_cast<int>(strlen(invalidFile) - 1),
+            invalidFile);
+        passed &= Expect(
+            WriteTextFile(path, invalidFile) && !loadedStore.Load(path), test,
+            "a malformed baseline was loaded");
+    }
+    passed &= Expect(
+        WriteTextFile(path, "# comment\n\nkey 2 1.5 2.5\n") && loadedStore.Load(path) &&
+            loadedStore.Find("key") != nullptr,
+        test, "a valid baseline with comments and empty lines wasn't loaded");
+    std::error_code error;
+    std::filesystem::remove(path, error);
+    passed &= Expect(
+        loadedStore.Load(path) && loadedStore.Find("key") == nullptr, test,
+        "a missing baseline file isn't an empty store");
+
+    // The verdict needs both a significant difference and a large enough change of the median.
+    const RegressionSettings settings;
+    const std::vector<double> baselineTimesUS = MakeTimes(100.0, 1);
+    struct VerdictCase {
+        double currentMedianUS;
+        RegressionVerdict verdict;
+        const char* what;
+    };
+    const VerdictCase verdictCases[] = {
+        { 100.0, RegressionVerdict::Unchanged, "the same distribution isn't unchanged" },
+        { 110.0, RegressionVerdict::Regressed, "a 10% slower distribution didn't regress" },
+        { 90.0, RegressionVerdict::Improved, "a 10% faster distribution didn't improve" },
+        { 101.5, RegressionVerdict::Unchanged,
+          "a significant change below the minimum change isn't unchanged" },
+    };
+    for (const VerdictCase& verdictCase : verdictCases) {
+        const RegressionReport report =
+            CheckRegression(baselineTimesUS, MakeTimes(verdictCase.currentMedianUS, 2), settings);
+        passed &= Expect(report.verdict == verdictCase.verdict, test, verdictCase.what);
+    }
+    passed &= Expect(
+        CheckRegression(baselineTimesUS, MakeTimes(101.5, 2), settings).pValue <
+            settings.significance,
+        test, "the change below the minimum change isn't significant");
+    passed &= Expect(
+        CheckRegression({}, baselineTimesUS, settings).verdict == RegressionVerdict::NoBaseline,
+        test, "an empty baseline isn't reported as missing");
+    return passed;
+}
+
+bool TestPriorityScheduler(const char* test) {
+    bool passed = true;
+
+    constexpr uint32_t kCriticalJobCount = 40;
+    constexpr double kCriticalIntervalUS = 7000.0;
+    constexpr uint32_t kBackgroundDispatchCount = 4;
+    constexpr uint32_t kBackgroundBacklog = 4;
+
+    // Every class on one shared queue, and the queue of each class from the default settings.
+    PrioritySchedulerSettings sharedSettings;
+    for (int jobClass = 0; jobClass < kJobClassCount; ++jobClass) {
+        sharedSettings.queues[jobClass] = { QueuePriority::Normal, ThrottlePolicy::MaxPerformance };
+        sharedSettings.maxJobsInFlight[jobClass] = 0;
+    }
+    const PrioritySchedulerSettings perClassSettings;
+    const PrioritySchedulerSettings* configurations[] = { &sharedSettings, &perClassSettings };
+
+    double criticalMediansUS[2] = {};
+    for (int i = 0; i < 2; ++i) {
+        const PrioritySchedulerSettings& settings = *configurations[i];
+        RecordingMultiQueueExecutor executor(kFlopsPerDispatch);
+        PriorityScheduler scheduler(&executor, settings);
+
+        // The scheduler numbers the jobs in the order they are submitted.
+        std::vector<JobClass> jobClasses;
+        uint32_t criticalJobCount = 0;
+        while (criticalJobCount < kCriticalJobCount) {
+            const double nextArrivalUS = (criticalJobCount + 1) * kCriticalIntervalUS;
+            while (scheduler.GetPendingJobCount(JobClass::Background) < kBackgroundBacklog) {
+                scheduler.Submit(JobClass::Background, kBackgroundDispatchCount);
+                jobClasses.push_back(JobClass::Background);
+            }
+            scheduler.WaitUntil(nextArrivalUS);
+            if (executor.GetTimeUS() >= nextArrivalUS) {
+                scheduler.Submit(JobClass::LatencyCritical, 1);
+                jobClasses.push_back(JobClass::LatencyCritical);
+                ++criticalJobCount;
+            }
+        }
+        scheduler.Drain();
+
+        uint32_t jobCounts[kJobClassCount] = {};
+        for (JobClass jobClass : jobClasses) {
+            ++jobCounts[static_cast<int>(jobClass)];
+        }
+        bool allCompleted = executor.completionCounts.size() == jobClasses.size();
+        for (int jobClass = 0; jobClass < kJobClassCount; ++jobClass) {
+            const PriorityScheduler::ClassStats& stats =
+                scheduler.GetStats(static_cast<JobClass>(jobClass));
+            const uint32_t dispatchCount =
+                jobClass == static_cast<int>(JobClass::Background) ? kBackgroundDispatchCount : 1;
+            allCompleted &= scheduler.GetPendingJobCount(static_cast<JobClass>(jobClass)) == 0 &&
+                            stats.latenciesUS.size() == jobCounts[jobClass] &&
+                            stats.dispatchCount ==
+                                static_cast<uint64_t>(jobCounts[jobClass]) * dispatchCount;
+            for (size_t job = 0; job < stats.latenciesUS.size(); ++job) {
+                allCompleted &= stats.latenciesUS[job] >= stats.gpuTimesUS[job];
+            }
+        }
+        for (uint32_t completionCount : executor.completionCounts) {
+            allCompleted &= completionCount == 1;
+        }
+        passed &= Expect(allCompleted, test, "a job didn't complete exactly once");
+
+        // The classes with the same desc share a queue, the others get a queue with their desc.
+        const bool shared = settings.queues[0] == settings.queues[1];
+        bool validQueues = executor.queueDescs.size() == (shared ? 1u : 2u);
+        for (size_t job = 0; validQueues && job < jobClasses.size(); ++job) {
+            const uint32_t queue = executor.jobQueues[job];
+            validQueues = queue < executor.queueDescs.size() &&
+                          executor.queueDescs[queue] ==
+                              settings.queues[static_cast<int>(jobClasses[job])];
+        }
+        passed &= Expect(validQueues, test, "a job wasn't submitted to the queue of its class");
+        if (!shared) {
+            // The first job is a background one.
+            const uint32_t backgroundQueue = executor.jobQueues[0];
+            passed &= Expect(
+                executor.maxJobsInFlight[backgroundQueue] <=
+                    settings.maxJobsInFlight[static_cast<int>(JobClass::Background)],
+                test, "more background jobs than allowed were in flight");
+        }
+        criticalMediansUS[i] = Summarize(scheduler.GetStats(JobClass::LatencyCritical).latenciesUS)
+                                   .median;
+    }
+
+    // On the high priority queue, the latency-critical jobs only wait for the dispatch running
+    // when they arrive instead of the whole background backlog.
+    printf(
+        "Latency-critical median latency: %.1f us with a queue per class, %.1f us with a shared "
+        "queue\n",
+        criticalMediansUS[1], criticalMediansUS[0]);
+    passed &= Expect(
+        criticalMediansUS[1] < criticalMediansUS[0], test,
+        "the latency-critical jobs aren't faster on a queue of their own");
+    return passed;
+}
+
+// Computes the rows with another executor, but returns a time proportional to the row count so
+// that the split doesn't depend on the load of the host.
+class ModeledRowRangeExecutor : public RowRangeExecutor {
+public:
+    ModeledRowRangeExecutor(RowRangeExecutor* executor, double secondsPerRow)
+        : mExecutor(executor), mSecondsPerRow(secondsPerRow) {
+    }
+
+    const char* GetName() const override {
+        return mExecutor->GetName();
+    }
+
+    double MultiplyRows(int32_t firstRow, int32_t rowCount) override {
+        mExecutor->MultiplyRows(firstRow, rowCount);
+        return rowCount * mSecondsPerRow;
+    }
+
+private:
+    RowRangeExecutor* mExecutor;
+    double mSecondsPerRow;
+};
+
+bool TestCooperativeMatMul(const char* test) {
+    bool passed = true;
+
+    // With the first executor 3 times faster, the split settles at 3/4 of the rows, in blocks.
+    constexpr int32_t kRowCount = 1000;
+    constexpr int32_t kRowBlockSize = 64;
+    RowPartitioner partitioner(kRowCount, kRowBlockSize, 0.5, 0.5);
+    for (int i = 0; i < 20; ++i) {
+        const int32_t splitRow = partitioner.GetSplitRow();
+        partitioner.Update(splitRow / 3.0, kRowCount - splitRow);
+    }
+    passed &= Expect(
+        std::abs(partitioner.GetFraction() - 0.75) < 0.01 && partitioner.GetSplitRow() == 768,
+        test, "the split doesn't converge to the rows each executor does in the same time");
+    // Each executor keeps a block however slow it is.
+    for (int i = 0; i < 20; ++i) {
+        partitioner.Update(1e-6, 1.0);
+    }
+    const int32_t lastBlockRow = (kRowCount - 1) / kRowBlockSize * kRowBlockSize;
+    passed &= Expect(
+        partitioner.GetSplitRow() == lastBlockRow, test,
+        "the split doesn't leave the last block to the slow executor");
+    for (int i = 0; i < 20; ++i) {
+        partitioner.Update(1.0, 1e-6);
+    }
+    passed &= Expect(
+        partitioner.GetSplitRow() == kRowBlockSize, test,
+        "the split doesn't leave the first block to the slow executor");
+
+    // The output merged from both executors is the one of a single multiplication, and every row
+    // of it is written, as the output starts as NaN.
+    constexpr int32_t kSize = 256;
+    const size_t elementCount = size_t(kSize) * kSize;
+    std::vector<float> inputMatrix1(elementCount);
+    std::vector<float> inputMatrix2(elementCount);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    for (size_t i = 0; i < elementCount; ++i) {
+        inputMatrix1[i] = distribution(random);
+        inputMatrix2[i] = distribution(random);
+    }
+    std::vector<float> output(elementCount, std::nanf(""));
+    CPURowRangeExecutor fast(
+        "Fast", kSize, kSize, inputMatrix1.data(), inputMatrix2.data(), output.data(), 2);
+    CPURowRangeExecutor slow(
+        "Slow", kSize, kSize, inputMatrix1.data(), inputMatrix2.data(), output.data(), 1);
+    ModeledRowRangeExecutor modeledFast(&fast, 1e-6);
+    ModeledRowRangeExecutor modeledSlow(&slow, 3e-6);
+    CooperativeMatMulSettings settings;
+    settings.singleIterations = 1;
+    settings.cooperativeIterations = 10;
+    settings.rowBlockSize = 32;
+    const CooperativeMatMulResult result = RunCooperativeMatMul(
+        &modeledFast, &modeledSlow, kSize, 2.0 * kSize * kSize * kSize, settings);
+    passed &= Expect(
+        result.splitRow == 3 * kSize / 4, test,
+        "the split of the multiplication doesn't match the speed of the executors");
+
+    std::vector<float> reference(elementCount);
+    MultiplyMatricesBlocked(
+        kSize, kSize, kSize, inputMatrix1.data(), kSize, inputMatrix2.data(), kSize,
+        reference.data(), kSize);
+    passed &= Expect(
+        output == reference, test, "the merged output isn't the one of a single executor");
+    return passed;
+}
+
+bool TestNumaMatMul(const char* test) {
+    bool passed = true;
+
+    passed &= Expect(
+        ParseCPUList("0-3,8,10-11") == std::vector<uint32_t>{ 0, 1, 2, 3, 8, 10, 11 }, test,
+        "\"0-3,8,10-11\" doesn't parse to its ranges and single nodes");
+    passed &= Expect(
+        ParseCPUList("5\n") == std::vector<uint32_t>{ 5 } && ParseCPUList("").empty(), test,
+        "a single node or an empty list doesn't parse");
+
+    // Two nodes of 3 and 2 workers, so that no row count below splits evenly. Pinning to the
+    // processors may fail on this machine, which only leaves the workers unpinned.
+    CPUTopology topology;
+    const uint32_t processorCount = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t node = 0, number = 0; node < 2; ++node) {
+        topology.nodes.push_back({ node, {} });
+        for (uint32_t worker = 0; worker < 3 - node; ++worker, ++number) {
+            topology.nodes.back().processors.push_back({ 0, number % processorCount });
+        }
+    }
+
+    // The inputs have a stride larger than a row, which the copy to the nodes must drop.
+    constexpr int32_t kN = 29;
+    constexpr int32_t kK = 23;
+    constexpr size_t kStride1 = kK + 3;
+    constexpr size_t kStride2 = kN + 5;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    for (const int32_t m : { 1, 4, 37, 101 }) {
+        std::vector<float> inputMatrix1(m * kStride1);
+        std::vector<float> inputMatrix2(kK * kStride2);
+        for (float& value : inputMatrix1) {
+            value = distribution(random);
+        }
+        for (float& value : inputMatrix2) {
+            value = distribution(random);
+        }
+        std::vector<float> reference(size_t(m) * kN);
+        MultiplyMatricesBlocked(
+            m, kN, kK, inputMatrix1.data(), kStride1, inputMatrix2.data(), kStride2,
+            reference.data(), kN);
+
+        for (const uint32_t nodeCount : { 0u, 1u }) {
+            for (const bool localPlacement : { true, false }) {
+                NumaMatMul numaMatMul(topology, nodeCount, localPlacement);
+                numaMatMul.SetInputs(
+                    m, kN, kK, inputMatrix1.data(), kStride1, inputMatrix2.data(), kStride2);
+                numaMatMul.Multiply();
+                std::vector<float> output(size_t(m) * kN, std::nanf(""));
+                numaMatMul.GetOutput(output.data());
+                char what[128];
+                snprintf(
+                    what, sizeof(what),
+                    "%d rows on %u node(s) with %s placement aren't the single-threaded result",
+                    m, numaMatMul.GetNodeCount(), localPlacement ? "local" : "remote");
+                passed &= Expect(output == reference, test, what);
+            }
+        }
+    }
+    return passed;
+}
+
+bool TestStrassenMatMul(const char* test) {
+    bool passed = true;
+
+    // With a cutoff of 16, these shapes recurse 3 times, and between them have odd rows, columns
+    // and inner dimensions to peel off at every level.
+    struct Shape {
+        int32_t m;
+        int32_t n;
+        int32_t k;
+    };
+    constexpr int32_t kCutoff = 16;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    for (const Shape& shape : { Shape{ 75, 69, 83 }, Shape{ 71, 139, 77 }, Shape{ 101, 68, 97 } }) {
+        std::vector<float> inputMatrix1(size_t(shape.m) * shape.k);
+        std::vector<float> inputMatrix2(size_t(shape.k) * shape.n);
+        float maxInput1 = 0.0f;
+        for (float& value : inputMatrix1) {
+            value = distribution(random);
+            maxInput1 = std::max(maxInput1, std::fabs(value));
+        }
+        float maxInput2 = 0.0f;
+        for (float& value : inputMatrix2) {
+            value = distribution(random);
+            maxInput2 = std::max(maxInput2, std::fabs(value));
+        }
+        std::vector<float> reference(size_t(shape.m) * shape.n);
+        MultiplyMatricesBlocked(
+            shape.m, shape.n, shape.k, inputMatrix1.data(), shape.k, inputMatrix2.data(),
+            shape.n, reference.data(), shape.n);
+
+        // Both results are within their own bound of the exact product.
+        const StrassenErrorBound bound =
+            GetStrassenErrorBound(shape.m, shape.n, shape.k, kCutoff);
+        const double tolerance = (bound.strassenFactor + bound.classicalFactor) *
+                                 std::ldexp(1.0, -24) * maxInput1 * maxInput2;
+        char what[128];
+        snprintf(
+            what, sizeof(what), "%d x %d x %d doesn't recurse 3 times", shape.m, shape.n,
+            shape.k);
+        passed &= Expect(bound.levelCount == 3, test, what);
+
+        // 0 picks the parallel levels, and 3 runs every level with a child arena per sub-product.
+        for (const uint32_t parallelLevels : { 0u, 1u, 2u, 3u }) {
+            StrassenSettings settings;
+            settings.cutoff = kCutoff;
+            settings.parallelLevels = parallelLevels;
+            std::vector<float> output(reference.size(), std::nanf(""));
+            size_t workspaceSize = 0;
+            MultiplyMatricesStrassen(
+                shape.m, shape.n, shape.k, inputMatrix1.data(), shape.k, inputMatrix2.data(),
+                shape.n, output.data(), shape.n, settings, &workspaceSize);
+            double maxError = 0.0;
+            for (size_t i = 0; i < output.size(); ++i) {
+                const double error = std::fabs(double(output[i]) - reference[i]);
+                // A NaN left in the output fails the comparison.
+                maxError = error <= maxError ? maxError : error;
+            }
+            snprintf(
+                what, sizeof(what),
+                "%d x %d x %d with %u parallel levels is %.3g off, above the bound of %.3g",
+                shape.m, shape.n, shape.k, parallelLevels, maxError, tolerance);
+            passed &= Expect(maxError <= tolerance && workspaceSize != 0, test, what);
+        }
+    }
+    return passed;
+}
+
+// A k x n second operand of random values, to share between requests.
+std::shared_ptr<const std::vector<float>> MakeSharedMatrix(
+    uint32_t k,
+    uint32_t n,
+    std::mt19937* random) {
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    auto matrix = std::make_shared<std::vector<float>>(size_t(k) * n);
+    for (float& value : *matrix) {
+        value = distribution(*random);
+    }
+    return matrix;
+}
+
+// A request multiplying m rows of random values by inputMatrix2, which is k x n, and the output
+// it must get. The executor sums the products in the same order as MultiplyMatricesBlocked() and
+// the padding only adds zeros, so the output is exact.
+MatMulRequest MakeMatMulRequest(
+    uint32_t m,
+    uint32_t n,
+    uint32_t k,
+    std::shared_ptr<const std::vector<float>> inputMatrix2,
+    std::mt19937* random,
+    std::vector<float>* expected) {
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    MatMulRequest request;
+    request.m = m;
+    request.n = n;
+    request.k = k;
+    request.inputMatrix1.resize(size_t(m) * k);
+    for (float& value : request.inputMatrix1) {
+        value = distribution(*random);
+    }
+    request.inputMatrix2 = std::move(inputMatrix2);
+    expected->resize(size_t(m) * n);
+    MultiplyMatricesBlocked(
+        m, n, k, request.inputMatrix1.data(), k, request.inputMatrix2->data(), n,
+        expected->data(), n);
+    return request;
+}
+
+bool TestMatMulService(const char* test) {
+    bool passed = true;
+    CPUMatMulBatchExecutor executor;
+    std::mt19937 random(1);
+
+    // Small requests by two matrices of different shapes but the same padded K and N fill a batch
+    // of 64 rows exactly, so it's dispatched at once, long before its delay, as one job per
+    // matrix.
+    {
+        MatMulServiceSettings settings;
+        settings.maxBatchDelayUS = 1e7;
+        settings.maxBatchRows = 64;
+        MatMulService service(&executor, settings);
+        const auto inputMatrix2A = MakeSharedMatrix(50, 40, &random);
+        const auto inputMatrix2B = MakeSharedMatrix(60, 33, &random);
+        std::vector<std::future<MatMulResponse>> futures;
+        std::vector<std::vector<float>> expected(8);
+        for (size_t i = 0; i < expected.size(); ++i) {
+            const bool a = i % 2 == 0;
+            futures.push_back(service.Submit(MakeMatMulRequest(
+                8, a ? 40 : 33, a ? 50 : 60, a ? inputMatrix2A : inputMatrix2B, &random,
+                &expected[i])));
+        }
+        for (size_t i = 0; i < futures.size(); ++i) {
+            const MatMulResponse response = futures[i].get();
+            passed &= Expect(
+                response.outputMatrix == expected[i] && response.pieceCount == 1, test,
+                "a batched request doesn't get its own output");
+        }
+        const MatMulService::Stats stats = service.GetStats();
+        passed &= Expect(
+            stats.batchCount == 1 && stats.jobCount == 2 && stats.pieceCount == 8, test,
+            "small compatible requests aren't stacked into one batch of a job per matrix");
+    }
+
+    // A request of more rows than a batch is split into pieces of at most 64 rows, each in a
+    // batch of its own, and its output is reassembled from them.
+    {
+        MatMulServiceSettings settings;
+        settings.maxBatchDelayUS = 1000.0;
+        settings.maxBatchRows = 64;
+        MatMulService service(&executor, settings);
+        std::vector<float> expected;
+        std::future<MatMulResponse> future = service.Submit(
+            MakeMatMulRequest(250, 70, 90, MakeSharedMatrix(90, 70, &random), &random, &expected));
+        const MatMulResponse response = future.get();
+        passed &= Expect(
+            response.outputMatrix == expected && response.pieceCount == 4, test,
+            "the output of a request split into 4 pieces isn't reassembled");
+        const MatMulService::Stats stats = service.GetStats();
+        passed &= Expect(
+            stats.splitRequestCount == 1 && stats.pieceCount == 4 && stats.batchCount == 4, test,
+            "a request of 250 rows isn't split into 4 batches of at most 64 rows");
+    }
+
+    // Client threads submit requests of mixed shapes by shared matrices, some of them split, and
+    // each gets the output of its own operands back.
+    {
+        MatMulServiceSettings settings;
+        settings.maxBatchDelayUS = 200.0;
+        settings.maxBatchRows = 64;
+        MatMulService service(&executor, settings);
+        struct SharedMatrix {
+            uint32_t k;
+            uint32_t n;
+            std::shared_ptr<const std::vector<float>> data;
+        };
+        const SharedMatrix sharedMatrices[] = {
+            { 50, 40, MakeSharedMatrix(50, 40, &random) },
+            { 60, 33, MakeSharedMatrix(60, 33, &random) },
+            { 100, 130, MakeSharedMatrix(100, 130, &random) },
+        };
+        constexpr uint32_t kClientCount = 4;
+        constexpr uint32_t kRequestCount = 25;
+        std::vector<uint32_t> failureCounts(kClientCount, 0);
+        std::vector<uint64_t> pieceCounts(kClientCount, 0);
+        std::vector<std::thread> clients;
+        for (uint32_t client = 0; client < kClientCount; ++client) {
+            clients.emplace_back([&, client] {
+                std::mt19937 clientRandom(client + 2);
+                std::uniform_int_distribution<uint32_t> rowDistribution(1, 100);
+                std::vector<std::future<MatMulResponse>> futures;
+                std::vector<std::vector<float>> expected(kRequestCount);
+                for (uint32_t i = 0; i < kRequestCount; ++i) {
+                    const SharedMatrix& matrix =
+                        sharedMatrices[(client + i) % std::size(sharedMatrices)];
+                    futures.push_back(service.Submit(MakeMatMulRequest(
+                        rowDistribution(clientRandom), matrix.n, matrix.k, matrix.data,
+                        &clientRandom, &expected[i])));
+                }
+                for (uint32_t i = 0; i < kRequestCount; ++i) {
+                    const MatMulResponse response = futures[i].get();
+                    failureCounts[client] += response.outputMatrix == expected[i] ? 0 : 1;
+                    pieceCounts[client] += response.pieceCount;
+                }
+            });
+        }
+        for (std::thread& client : clients) {
+            client.join();
+        }
+        const MatMulService::Stats stats = service.GetStats();
+        uint64_t pieceCount = 0;
+        for (uint32_t client = 0; client < kClientCount; ++client) {
+            passed &= Expect(
+                failureCounts[client] == 0, test,
+                "a request submitted from a client thread doesn't get its own output");
+            pieceCount += pieceCounts[client];
+        }
+        passed &= Expect(
+            stats.requestCount == kClientCount * kRequestCount && stats.splitRequestCount != 0 &&
+                stats.pieceCount == pieceCount,
+            test, "the requests of the client threads aren't all executed in their pieces");
+    }
+    return passed;
+}
+
+}  // anonymous namespace
+
+bool RunSelfTest() {
+    struct Test {
+        const char* name;
+        bool (*run)(const char* name);
+    };
+    const Test tests[] = {
+        { "Benchmark statistics", TestBenchmarkStatistics },
+        { "Policy comparison", TestPolicyComparison },
+        { "Bursty workload", TestBurstyWorkload },
+        { "Heap sub-allocator", TestHeapSuballocator },
+        { "Matrix multiplication job table", TestMatMulJobTable },
+        { "Ring allocator", TestRingAllocator },
+        { "Regression gate", TestRegressionGate },
+        { "Priority scheduler", TestPriorityScheduler },
+        { "Cooperative multiplication", TestCooperativeMatMul },
+        { "NUMA multiplication", TestNumaMatMul },
+        { "Strassen-Winograd multiplication", TestStrassenMatMul },
+        { "Matrix multiplication service", TestMatMulService },
+    };
+
+    uint32_t failedCount = 0;
+    for (const Test& test : tests) {
+        printf("Self-test: %s\n", test.name);
+        if (!test.run(test.name)) {
+            ++failedCount;
+        }
+        printf("\n");
+    }
+    if (failedCount > 0) {
+        printf("ERROR: %u of %zu self-tests failed.\n", failedCount, std::size(tests));
+        return false;
+    }
+    printf("All %zu self-tests passed.\n", std::size(tests));
+    return true;
+}
@@ -0,0 +1,174 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "ShaderCache.h"
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr uint32_t kMagic = 0x43535443;  // "CTSC"
+constexpr uint32_t kVersion = 1;
+
+struct EntryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint64_t size;
+    uint64_t checksum;
+};
+
+uint64_t Checksum(const void* data, size_t size) {
+    return ShaderCacheKey().Add(data, size).Get();
+}
+
+uint64_t GetProcessId() {
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<uint64_t>(getpid());
+#endif
+}
+
+// Returns a temporary path next to path that no other process or thread writes to.
+std::string GetTemporaryPath(const std::string& path) {
+    static std::atomic<uint64_t> counter{ 0 };
+    char suffix[64];
+    snprintf(
+        suffix, sizeof(suffix), ".%" PRIu64 "-%" PRIu64 ".tmp", GetProcessId(), counter++);
+    return path + suffix;
+}
+
+}  // anonymous namespace
+
+ShaderCacheKey& ShaderCacheKey::Add(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        mHash ^= bytes[i];
+        mHash *= 0x100000001b3ull;
+    }
+    return *this;
+}
+
+ShaderCacheKey& ShaderCacheKey::Add(const std::string& text) {
+    Add(static_cast<uint64_t>(text.size()));
+    return Add(text.data(), text.size());
+}
+
+ShaderCacheKey& ShaderCacheKey::Add(uint64_t value) {
+    return Add(&value, sizeof(value));
+}
+
+uint64_t ShaderCacheKey::Get() const {
+    return mHash;
+}
+
+ShaderCache::ShaderCache(const std::string& directory) : mDirectory(directory) {
+    std::error_code error;
+    std::filesystem::create_directories(mDirectory, error);
+    if (error) {
+        printf(
+            "WARNING: failed to create the shader cache directory %s: %s\n", mDirectory.c_str(),
+            error.message().c_str());
+    }
+}
+
+bool ShaderCache::Load(const char* kind, uint64_t key, std::vector<uint8_t>* data) const {
+    std::ifstream file(GetPath(kind, key), std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    EntryHeader header = {};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != kMagic ||
+        header.version != kVersion || header.key != key) {
+        printf("WARNING: ignoring the invalid %s cache entry %016" PRIx64 ".\n", kind, key);
+        return false;
+    }
+
+    // A corrupted size must not make the load allocate more than the entry can hold.
+    const std::streampos payloadBegin = file.tellg();
+    file.seekg(0, std::ios::end);
+    const std::streampos fileEnd = file.tellg();
+    file.seekg(payloadBegin);
+    if (!file || fileEnd < payloadBegin ||
+        header.size != static_cast<uint64_t>(fileEnd - payloadBegin)) {
+        printf("WARNING: ignoring the truncated %s cache entry %016" PRIx64 ".\n", kind, key);
+        return false;
+    }
+
+    data->resize(static_cast<size_t>(header.size));
+    if (!file.read(reinterpret_cast<char*>(data->data()), data->size()) ||
+        Checksum(data->data(), data->size()) != header.checksum) {
+        printf("WARNING: ignoring the corrupted %s cache entry %016" PRIx64 ".\n", kind, key);
+        data->clear();
+        return false;
+    }
+    return true;
+}
+
+void ShaderCache::Store(const char* kind, uint64_t key, const void* data, size_t size) const {
+    const std::string path = GetPath(kind, key);
+    const std::string temporaryPath = GetTemporaryPath(path);
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        EntryHeader header = { kMagic, kVersion, key, size, Checksum(data, size) };
+        if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header)) ||
+            !file.write(static_cast<const char*>(data), size)) {
+            printf("WARNING: failed to write %s.\n", temporaryPath.c_str());
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        printf("WARNING: failed to write %s: %s\n", path.c_str(), error.message().c_str());
+        std::filesystem::remove(temporaryPath, error);
+    }
+}
+
+void ShaderCache::Remove(const char* kind, uint64_t key) const {
+    std::error_code error;
+    std::filesystem::remove(GetPath(kind, key), error);
+}
+
+std::string ShaderCache::GetPath(const char* kind, uint64_t key) const {
+    char name[64];
+    snprintf(name, sizeof(name), "%s-%016" PRIx64 ".bin", kind, key);
+    return (std::filesystem::path(mDirectory) / name).string();
+}
@@ -0,0 +1,72 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef SHADER_CACHE_
+#define SHADER_CACHE_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Accumulates everything a cached shader or pipeline depends on into a 64-bit FNV-1a hash.
+class ShaderCacheKey {
+public:
+    ShaderCacheKey& Add(const void* data, size_t size);
+    // The length is hashed too, so that consecutive strings can't be confused.
+    ShaderCacheKey& Add(const std::string& text);
+    ShaderCacheKey& Add(uint64_t value);
+
+    uint64_t Get() const;
+
+private:
+    uint64_t mHash = 0xcbf29ce484222325ull;
+};
+
+// A content-addressed on-disk cache of blobs such as shader bytecode and pipeline state objects.
+//
+// Each entry is a file named after its kind and key, holding a header with the key, the size and a
+// checksum of the blob. Entries that don't match are reported as misses, so a corrupted or
+// truncated file only costs a recompilation. Entries are written to a temporary file unique to the
+// process and the call first and then renamed, so concurrent runs never see partial files.
+class ShaderCache {
+public:
+    explicit ShaderCache(const std::string& directory);
+
+    // Returns false if there is no valid entry for kind and key.
+    bool Load(const char* kind, uint64_t key, std::vector<uint8_t>* data) const;
+    // Errors are only reported, the cache is an optimization.
+    void Store(const char* kind, uint64_t key, const void* data, size_t size) const;
+    // Remove an entry that turned out to be unusable, for instance a pipeline state object blob
+    // rejected by the driver.
+    void Remove(const char* kind, uint64_t key) const;
+
+private:
+    std::string GetPath(const char* kind, uint64_t key) const;
+
+    std::string mDirectory;
+};
+
+#endif
@@ -0,0 +1,121 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "ShaderLibrary.h"
+
+#include <cstdio>
+#include <cstring>
+
+// Defined in the source file generated by tools/compile_shaders.py.
+extern const uint8_t kShaderLibraryBlob[];
+extern const size_t kShaderLibraryBlobSize;
+
+namespace {
+
+constexpr uint32_t kMagic = 0x4C535443;  // "CTSL"
+constexpr uint32_t kVersion = 1;
+
+struct LibraryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+};
+
+struct LibraryEntry {
+    uint32_t keyOffset;
+    uint32_t keyLength;
+    uint32_t format;
+    uint32_t reserved;
+    uint64_t dataOffset;
+    uint64_t dataSize;
+};
+
+bool IsInBlob(uint64_t offset, uint64_t size, size_t blobSize) {
+    return offset <= blobSize && size <= blobSize - offset;
+}
+
+}  // anonymous namespace
+
+std::string MakeShaderVariantKey(
+    const char* kernelName,
+    const std::vector<std::pair<std::string, std::string>>& defines) {
+    std::string key = kernelName;
+    for (const auto& define : defines) {
+        key += ":" + define.first + "=" + define.second;
+    }
+    return key;
+}
+
+const ShaderLibrary& ShaderLibrary::GetEmbedded() {
+    static const ShaderLibrary library(kShaderLibraryBlob, kShaderLibraryBlobSize);
+    return library;
+}
+
+ShaderLibrary::ShaderLibrary(const uint8_t* blob, size_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    LibraryHeader header;
+    if (size < sizeof(header)) {
+        printf("WARNING: the shader library is truncated.\n");
+        return;
+    }
+    memcpy(&header, blob, sizeof(header));
+    if (header.magic != kMagic || header.version != kVersion ||
+        !IsInBlob(sizeof(header), uint64_t(header.entryCount) * sizeof(LibraryEntry), size)) {
+        printf("WARNING: the shader library is invalid.\n");
+        return;
+    }
+
+    for (uint32_t i = 0; i < header.entryCount; ++i) {
+        LibraryEntry entry;
+        memcpy(&entry, blob + sizeof(header) + i * sizeof(entry), sizeof(entry));
+        if (!IsInBlob(entry.keyOffset, entry.keyLength, size) ||
+            !IsInBlob(entry.dataOffset, entry.dataSize, size)) {
+            printf("WARNING: the shader library is invalid.\n");
+            mShaders.clear();
+            return;
+        }
+        std::string key(reinterpret_cast<const char*>(blob + entry.keyOffset), entry.keyLength);
+        Shader shader = { blob + entry.dataOffset, static_cast<size_t>(entry.dataSize) };
+        mShaders[std::make_pair(key, static_cast<ShaderFormat>(entry.format))] = shader;
+    }
+}
+
+bool ShaderLibrary::Find(const std::string& variantKey, ShaderFormat format, Shader* shader) const {
+    auto it = mShaders.find(std::make_pair(variantKey, format));
+    if (it == mShaders.end()) {
+        return false;
+    }
+    *shader = it->second;
+    return true;
+}
+
+size_t ShaderLibrary::GetShaderCount() const {
+    return mShaders.size();
+}
@@ -0,0 +1,72 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef SHADER_LIBRARY_
+#define SHADER_LIBRARY_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum class ShaderFormat : uint32_t {
+    DXIL = 0,
+    SPIRV = 1,
+};
+
+// Returns the key of a kernel variant: the name of the kernel followed by its macro defines, e.g.
+// "SLM_4X4_16X16_4_floats:LOCAL_GROUP_SIZE_X=16:LOCAL_GROUP_SIZE_Y=16".
+std::string MakeShaderVariantKey(
+    const char* kernelName,
+    const std::vector<std::pair<std::string, std::string>>& defines);
+
+// The shaders precompiled by tools/compile_shaders.py, indexed by variant key and format.
+//
+// The blob starts with a header and a table of entries giving the offset and size of the key and
+// of the bytecode of every shader, all little-endian. The bytecode is used in place, the library
+// only holds pointers into the blob.
+class ShaderLibrary {
+public:
+    struct Shader {
+        const void* bytecode;
+        size_t size;
+    };
+
+    // Returns the library linked into the executable.
+    static const ShaderLibrary& GetEmbedded();
+
+    // An invalid blob is reported and results in an empty library.
+    ShaderLibrary(const uint8_t* blob, size_t size);
+
+    bool Find(const std::string& variantKey, ShaderFormat format, Shader* shader) const;
+    size_t GetShaderCount() const;
+
+private:
+    std::map<std::pair<std::string, ShaderFormat>, Shader> mShaders;
+};
+
+#endif
@@ -0,0 +1,92 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "SimulatedGPU.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// The clock is integrated with this step while a dispatch runs.
+constexpr double kSimulationStepUS = 10.0;
+
+}  // anonymous namespace
+
+SimulatedGPU::SimulatedGPU(const SimulatedGPUDesc& desc)
+    : mDesc(desc),
+      mFrequencyMHz(desc.minFrequencyMHz),
+      mRandom(desc.seed),
+      mNoise(0.0, desc.noise) {
+}
+
+double SimulatedGPU::Execute(double flops, ThrottlePolicy policy) {
+    const double rampUpUS = policy == ThrottlePolicy::MaxPerformance
+                                ? mDesc.maxPerformanceRampUpUS
+                                : mDesc.dynamicRampUpUS;
+
+    // MHz * us = cycles.
+    double remainingCycles = flops / mDesc.flopsPerCycle;
+    double executionTimeUS = 0.0;
+    while (remainingCycles > 0.0) {
+        double stepUS = kSimulationStepUS;
+        const double stepCycles = mFrequencyMHz * stepUS;
+        if (stepCycles >= remainingCycles) {
+            stepUS = remainingCycles / mFrequencyMHz;
+            remainingCycles = 0.0;
+        } else {
+            remainingCycles -= stepCycles;
+        }
+        executionTimeUS += stepUS;
+        mFrequencyMHz +=
+            (mDesc.maxFrequencyMHz - mFrequencyMHz) * (1.0 - std::exp(-stepUS / rampUpUS));
+    }
+
+    executionTimeUS *= std::max(0.5, 1.0 + mNoise(mRandom));
+    mTimeUS += mDesc.launchLatencyUS + executionTimeUS;
+    return executionTimeUS;
+}
+
+void SimulatedGPU::Idle(double microseconds) {
+    if (microseconds <= 0.0) {
+        return;
+    }
+    mFrequencyMHz = mDesc.minFrequencyMHz + (mFrequencyMHz - mDesc.minFrequencyMHz) *
+                                                std::exp(-microseconds / mDesc.idleRampDownUS);
+    mTimeUS += microseconds;
+}
+
+double SimulatedGPU::GetTimeUS() const {
+    return mTimeUS;
+}
+
+double SimulatedGPU::GetFrequencyMHz() const {
+    return mFrequencyMHz;
+}
+
+const SimulatedGPUDesc& SimulatedGPU::GetDesc() const {
+    return mDesc;
+}
@@ -0,0 +1,81 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef SIMULATED_GPU_
+#define SIMULATED_GPU_
+
+#include <cstdint>
+#include <random>
+
+#include "ThrottlePolicy.h"
+
+struct SimulatedGPUDesc {
+    double minFrequencyMHz = 300.0;
+    double maxFrequencyMHz = 1300.0;
+    // Time constant of the clock ramp-up while the GPU is busy with work submitted to a queue with
+    // the dynamic throttle policy.
+    double dynamicRampUpUS = 3000.0;
+    // Time constant of the clock ramp-up with the max-performance throttle policy.
+    double maxPerformanceRampUpUS = 50.0;
+    // Time constant of the clock decay while the GPU is idle.
+    double idleRampDownUS = 10000.0;
+    // Floating point operations retired per clock cycle.
+    double flopsPerCycle = 1024.0;
+    // Time between the submit and the start of the execution.
+    double launchLatencyUS = 20.0;
+    // Relative standard deviation of the execution time.
+    double noise = 0.02;
+    uint32_t seed = 1;
+};
+
+// A deterministic model of a GPU whose clock ramps up while it's busy and decays while it's idle,
+// faster or slower depending on the throttle policy of the queue the work comes from. Time is
+// virtual: nothing sleeps, so the scheduling and statistics code can be exercised on any host,
+// including ones without a GPU.
+class SimulatedGPU {
+public:
+    explicit SimulatedGPU(const SimulatedGPUDesc& desc);
+
+    // Execute a dispatch of flops operations submitted at the current time, and return its
+    // execution time in microseconds. The current time is advanced to the end of the dispatch.
+    double Execute(double flops, ThrottlePolicy policy);
+
+    // Let the GPU idle for the given time.
+    void Idle(double microseconds);
+
+    double GetTimeUS() const;
+    double GetFrequencyMHz() const;
+    const SimulatedGPUDesc& GetDesc() const;
+
+private:
+    SimulatedGPUDesc mDesc;
+    double mTimeUS = 0.0;
+    double mFrequencyMHz;
+    std::mt19937 mRandom;
+    std::normal_distribution<double> mNoise;
+};
+
+#endif
@@ -0,0 +1,239 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "SizeSweep.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <tuple>
+
+#include "BenchmarkStatistics.h"
+
+namespace {
+
+constexpr uint32_t kDefaultSize = 1024;
+// Keeps a typo like "64-4096+1" from running for hours.
+constexpr size_t kMaxSizeCount = 1024;
+
+bool ParseSize(const char* begin, const char* end, uint32_t* size) {
+    if (begin == end) {
+        return false;
+    }
+    char* parsedEnd = nullptr;
+    const unsigned long value = strtoul(begin, &parsedEnd, 10);
+    if (parsedEnd != end || value == 0 || value > UINT32_MAX) {
+        return false;
+    }
+    *size = static_cast<uint32_t>(value);
+    return true;
+}
+
+bool ParseSizeRange(const char* begin, const char* end, std::vector<uint32_t>* sizes) {
+    const char* dash = std::find(begin, end, '-');
+    if (dash == end) {
+        uint32_t size;
+        if (!ParseSize(begin, end, &size)) {
+            return false;
+        }
+        sizes->push_back(size);
+        return true;
+    }
+
+    const char* op = std::find_if(dash, end, [](char c) { return c == '*' || c == '+'; });
+    uint32_t first;
+    uint32_t last;
+    uint32_t step;
+    if (op == end || !ParseSize(begin, dash, &first) || !ParseSize(dash + 1, op, &last) ||
+        !ParseSize(op + 1, end, &step) || first > last || (*op == '*' && step < 2)) {
+        return false;
+    }
+    for (uint64_t size = first; size <= last; size = *op == '*' ? size * step : size + step) {
+        if (sizes->size() >= kMaxSizeCount) {
+            return false;
+        }
+        sizes->push_back(static_cast<uint32_t>(size));
+    }
+    return true;
+}
+
+uint32_t RoundUp(uint32_t size, uint32_t tile) {
+    return (size + tile - 1) / tile * tile;
+}
+
+double GetMatrixBytes(const MatMulShape& shape) {
+    return (static_cast<double>(shape.m) * shape.k + static_cast<double>(shape.k) * shape.n +
+            static_cast<double>(shape.m) * shape.n) *
+           sizeof(float);
+}
+
+}  // anonymous namespace
+
+bool ParseSizeList(const char* text, std::vector<uint32_t>* sizes) {
+    std::vector<uint32_t> parsed;
+    const char* end = text + strlen(text);
+    for (const char* begin = text; begin <= end;) {
+        const char* comma = std::find(begin, end, ',');
+        if (!ParseSizeRange(begin, comma, &parsed)) {
+            return false;
+        }
+        begin = comma + 1;
+    }
+    sizes->insert(sizes->end(), parsed.begin(), parsed.end());
+    return true;
+}
+
+bool ParseSweepPreset(const char* name, SweepPreset* preset) {
+    if (strcmp(name, "square") == 0) {
+        *preset = SweepPreset::Square;
+    } else if (strcmp(name, "tall-skinny") == 0) {
+        *preset = SweepPreset::TallSkinny;
+    } else if (strcmp(name, "short-wide") == 0) {
+        *preset = SweepPreset::ShortWide;
+    } else if (strcmp(name, "small-k") == 0) {
+        *preset = SweepPreset::SmallK;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::vector<MatMulShape> BuildSweepShapes(
+    const SizeSweepDesc& desc,
+    const MatMulTiling& tiling,
+    uint64_t maxBufferSize) {
+    std::vector<MatMulShape> requested;
+    if (!desc.m.empty() || !desc.n.empty() || !desc.k.empty()) {
+        const std::vector<uint32_t> defaultSizes = { kDefaultSize };
+        for (uint32_t m : desc.m.empty() ? defaultSizes : desc.m) {
+            for (uint32_t n : desc.n.empty() ? defaultSizes : desc.n) {
+                for (uint32_t k : desc.k.empty() ? defaultSizes : desc.k) {
+                    requested.push_back({ m, n, k });
+                }
+            }
+        }
+    }
+    for (SweepPreset preset : desc.presets) {
+        for (uint32_t size : desc.presetSizes) {
+            switch (preset) {
+                case SweepPreset::Square:
+                    requested.push_back({ size, size, size });
+                    break;
+                case SweepPreset::TallSkinny:
+                    requested.push_back({ size, tiling.tileN, size });
+                    break;
+                case SweepPreset::ShortWide:
+                    requested.push_back({ tiling.tileM, size, size });
+                    break;
+                case SweepPreset::SmallK:
+                    requested.push_back({ size, size, tiling.tileK });
+                    break;
+            }
+        }
+    }
+
+    std::vector<MatMulShape> shapes;
+    std::set<std::tuple<uint32_t, uint32_t, uint32_t>> seen;
+    for (const MatMulShape& shape : requested) {
+        MatMulShape rounded;
+        rounded.m = RoundUp(shape.m, tiling.tileM);
+        rounded.n = RoundUp(shape.n, tiling.tileN);
+        rounded.k = RoundUp(shape.k, tiling.tileK);
+        if (rounded.m != shape.m || rounded.n != shape.n || rounded.k != shape.k) {
+            printf(
+                "WARNING: %ux%ux%u is rounded up to %ux%ux%u, the multiples of the %ux%ux%u "
+                "tiling of the kernel.\n",
+                shape.m, shape.n, shape.k, rounded.m, rounded.n, rounded.k, tiling.tileM,
+                tiling.tileN, tiling.tileK);
+        }
+        const uint64_t largestMatrixSize =
+            std::max({ uint64_t(rounded.m) * rounded.k, uint64_t(rounded.k) * rounded.n,
+                       uint64_t(rounded.m) * rounded.n }) *
+            sizeof(float);
+        if (largestMatrixSize > maxBufferSize) {
+            printf(
+                "WARNING: skipping %ux%ux%u, its %.1f MB matrix is larger than the %.1f MB buffers "
+                "of the device.\n",
+                rounded.m, rounded.n, rounded.k, largestMatrixSize / (1024.0 * 1024.0),
+                maxBufferSize / (1024.0 * 1024.0));
+            continue;
+        }
+        if (seen.insert(std::make_tuple(rounded.m, rounded.n, rounded.k)).second) {
+            shapes.push_back(rounded);
+        }
+    }
+    return shapes;
+}
+
+SweepPointResult SummarizeSweepPoint(const MatMulShape& shape, const std::vector<double>& timesUS) {
+    const double flops = 2.0 * shape.m * shape.n * shape.k;
+    const double bytes = GetMatrixBytes(shape);
+
+    SweepPointResult point;
+    point.shape = shape;
+    point.medianTimeUS = Summarize(timesUS).median;
+    point.gflops = point.medianTimeUS > 0.0 ? flops / (point.medianTimeUS * 1e3) : 0.0;
+    point.bandwidthGBs = point.medianTimeUS > 0.0 ? bytes / (point.medianTimeUS * 1e3) : 0.0;
+    point.arithmeticIntensity = flops / bytes;
+    point.workingSetMB = bytes / (1024.0 * 1024.0);
+    return point;
+}
+
+void PrintSweepHeader() {
+    printf(
+        "%8s%8s%8s%14s%12s%12s%12s%14s\n", "M", "N", "K", "median (us)", "GFLOPS", "GB/s",
+        "FLOP/byte", "memory (MB)");
+}
+
+void PrintSweepPoint(const SweepPointResult& point) {
+    printf(
+        "%8u%8u%8u%14.2f%12.2f%12.2f%12.1f%14.2f\n", point.shape.m, point.shape.n, point.shape.k,
+        point.medianTimeUS, point.gflops, point.bandwidthGBs, point.arithmeticIntensity,
+        point.workingSetMB);
+}
+
+bool WriteSweepCSV(const std::string& path, const std::vector<SweepPointResult>& points) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        printf("ERROR: failed to open %s.\n", path.c_str());
+        return false;
+    }
+    fprintf(file, "m,n,k,median_time_us,gflops,bandwidth_gbs,flops_per_byte,memory_mb\n");
+    for (const SweepPointResult& point : points) {
+        fprintf(
+            file, "%u,%u,%u,%.3f,%.3f,%.3f,%.3f,%.3f\n", point.shape.m, point.shape.n,
+            point.shape.k, point.medianTimeUS, point.gflops, point.bandwidthGBs,
+            point.arithmeticIntensity, point.workingSetMB);
+    }
+    const bool written = ferror(file) == 0;
+    if (fclose(file) != 0 || !written) {
+        printf("ERROR: failed to write %s.\n", path.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,98 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef SIZE_SWEEP_
+#define SIZE_SWEEP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MatMulJobTable.h"
+
+struct MatMulShape {
+    uint32_t m;
+    uint32_t n;
+    uint32_t k;
+};
+
+// Shapes of a family around a size s, to find where the kernel falls off a cliff. The thin
+// dimension is one tile of the kernel.
+enum class SweepPreset {
+    // s x s x s.
+    Square,
+    // An s x tileN output with K = s.
+    TallSkinny,
+    // A tileM x s output with K = s.
+    ShortWide,
+    // An s x s output with K = tileK.
+    SmallK,
+};
+
+// The shapes of a size sweep: the cartesian product of the M, N and K lists, plus every preset
+// applied to every size. An empty M, N or K list defaults to 1024 when the other ones aren't all
+// empty.
+struct SizeSweepDesc {
+    std::vector<uint32_t> m;
+    std::vector<uint32_t> n;
+    std::vector<uint32_t> k;
+    std::vector<SweepPreset> presets;
+    std::vector<uint32_t> presetSizes;
+};
+
+// Parse a comma separated list of sizes, each being a size, "first-last*factor" for a geometric
+// range or "first-last+step" for an arithmetic one, e.g. "64-4096*2,96,1000-1200+100".
+bool ParseSizeList(const char* text, std::vector<uint32_t>* sizes);
+bool ParseSweepPreset(const char* name, SweepPreset* preset);
+
+// Returns the shapes of desc in order, without duplicates. The kernel only supports multiples of
+// the tiling, so the other sizes are rounded up to them with a warning. The shapes with a matrix
+// larger than maxBufferSize bytes are skipped with a warning.
+std::vector<MatMulShape> BuildSweepShapes(
+    const SizeSweepDesc& desc,
+    const MatMulTiling& tiling,
+    uint64_t maxBufferSize);
+
+struct SweepPointResult {
+    MatMulShape shape;
+    double medianTimeUS;
+    double gflops;
+    // The bytes of the inputs and the output divided by the median time. It's the bandwidth the
+    // kernel would need if every matrix was only read or written once; values above the memory
+    // bandwidth mean that the caches absorb the reuse of the tiles.
+    double bandwidthGBs;
+    // FLOPs per byte of the inputs and the output.
+    double arithmeticIntensity;
+    double workingSetMB;
+};
+
+SweepPointResult SummarizeSweepPoint(const MatMulShape& shape, const std::vector<double>& timesUS);
+
+void PrintSweepHeader();
+void PrintSweepPoint(const SweepPointResult& point);
+bool WriteSweepCSV(const std::string& path, const std::vector<SweepPointResult>& points);
+
+#endif
@@ -0,0 +1,472 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+
+#include "StrassenMatMul.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "CPUMatMul.h"
+#include "CPUTopology.h"
+#include "Tracer.h"
+
+namespace {
+
+// Temporaries are taken from the arena in the order of the recursion and given back when it
+// returns, so it never needs more than the size computed by GetWorkspaceSize().
+struct Arena {
+    float* data;
+    size_t size;
+    size_t used;
+
+    float* Allocate(size_t count) {
+        float* block = data + used;
+        used += count;
+        assert(used <= size);
+        return block;
+    }
+};
+
+bool UseStrassen(int32_t m, int32_t n, int32_t k, int32_t cutoff) {
+    return std::min({ m, n, k }) > std::max(cutoff, 1);
+}
+
+size_t GetWorkspaceSize(
+    int32_t m,
+    int32_t n,
+    int32_t k,
+    uint32_t level,
+    const StrassenSettings& settings) {
+    if (!UseStrassen(m, n, k, settings.cutoff)) {
+        return 0;
+    }
+    const size_t mh = m / 2;
+    const size_t nh = n / 2;
+    const size_t kh = k / 2;
+    const size_t childSize = GetWorkspaceSize(
+        static_cast<int32_t>(mh), static_cast<int32_t>(nh), static_cast<int32_t>(kh), level + 1,
+        settings);
+    if (level < settings.parallelLevels) {
+        // S1 to S4, T1 to T4, the three products without a quadrant of c to go to, and an arena
+        // for each of the seven sub-products.
+        return 4 * mh * kh + 4 * kh * nh + 3 * mh * nh + 7 * childSize;
+    }
+    return mh * kh + kh * nh + mh * nh + childSize;
+}
+
+void Add(
+    int32_t rows,
+    int32_t columns,
+    const float* a,
+    size_t lda,
+    const float* b,
+    size_t ldb,
+    float* c,
+    size_t ldc) {
+    for (int32_t y = 0; y < rows; ++y) {
+        for (int32_t x = 0; x < columns; ++x) {
+            c[y * ldc + x] = a[y * lda + x] + b[y * ldb + x];
+        }
+    }
+}
+
+void Subtract(
+    int32_t rows,
+    int32_t columns,
+    const float* a,
+    size_t lda,
+    const float* b,
+    size_t ldb,
+    float* c,
+    size_t ldc) {
+    for (int32_t y = 0; y < rows; ++y) {
+        for (int32_t x = 0; x < columns; ++x) {
+            c[y * ldc + x] = a[y * lda + x] - b[y * ldb + x];
+        }
+    }
+}
+
+// The quadrants of a matrix whose dimensions are even.
+struct Quadrants {
+    float* q11;
+    float* q12;
+    float* q21;
+    float* q22;
+};
+
+Quadrants GetQuadrants(const float* matrix, size_t stride, int32_t rowsHalf, int32_t columnsHalf) {
+    float* data = const_cast<float*>(matrix);
+    return { data, data + columnsHalf, data + rowsHalf * stride,
+             data + rowsHalf * stride + columnsHalf };
+}
+
+void MultiplyRecursive(
+    int32_t m,
+    int32_t n,
+    int32_t k,
+    const float* a,
+    size_t lda,
+    const float* b,
+    size_t ldb,
+    float* c,
+    size_t ldc,
+    uint32_t level,
+    const StrassenSettings& settings,
+    Arena* arena);
+
+// The Winograd variant with the schedule of Douglas et al. (1994), which only needs three
+// temporaries besides c.
+void MultiplySequential(
+    int32_t mh,
+    int32_t nh,
+    int32_t kh,
+    const float* a,
+    size_t lda,
+    const float* b,
+    size_t ldb,
+    float* c,
+    size_t ldc,
+    uint32_t level,
+    const StrassenSettings& settings,
+    Arena* arena) {
+    const Quadrants qa = GetQuadrants(a, lda, mh, kh);
+    const Quadrants qb = GetQuadrants(b, ldb, kh, nh);
+    const Quadrants qc = GetQuadrants(c, ldc, mh, nh);
+
+    const size_t mark = arena->used;
+    float* x = arena->Allocate(size_t(mh) * kh);
+    float* y = arena->Allocate(size_t(kh) * nh);
+    float* z = arena->Allocate(size_t(mh) * nh);
+    auto multiply = [&](const float* lhs, size_t ldl, const float* rhs, size_t ldr, float* out,
+                        size_t ldo) {
+        MultiplyRecursive(mh, nh, kh, lhs, ldl, rhs, ldr, out, ldo, level + 1, settings, arena);
+    };
+
+    // S3 = A11 - A21, T3 = B22 - B12, P7 = S3 T3 in C21.
+    Subtract(mh, kh, qa.q11, lda, qa.q21, lda, x, kh);
+    Subtract(kh, nh, qb.q22, ldb, qb.q12, ldb, y, nh);
+    multiply(x, kh, y, nh, qc.q21, ldc);
+    // S1 = A21 + A22, T1 = B12 - B11, P5 = S1 T1 in C22.
+    Add(mh, kh, qa.q21, lda, qa.q22, lda, x, kh);
+    Subtract(kh, nh, qb.q12, ldb, qb.q11, ldb, y, nh);
+    multiply(x, kh, y, nh, qc.q22, ldc);
+    // S2 = S1 - A11, T2 = B22 - T1, P6 = S2 T2 in C12.
+    Subtract(mh, kh, x, kh, qa.q11, lda, x, kh);
+    Subtract(kh, nh, qb.q22, ldb, y, nh, y, nh);
+    multiply(x, kh, y, nh, qc.q12, ldc);
+    // S4 = A12 - S2, P3 = S4 B22 in C11.
+    Subtract(mh, kh, qa.q12, lda, x, kh, x, kh);
+    multiply(x, kh, qb.q22, ldb, qc.q11, ldc);
+    // P1 = A11 B11 in Z.
+    multiply(qa.q11, lda, qb.q11, ldb, z, nh);
+    // U2 = P1 + P6 in C12, U3 = U2 + P7 in C21, U4 = U2 + P5 in C12, U7 = U3 + P5 in C22 and
+    // U5 = U4 + P3 in C12.
+    Add(mh, nh, z, nh, qc.q12, ldc, qc.q12, ldc);
+    Add(mh, nh, qc.q12, ldc, qc.q21, ldc, qc.q21, ldc);
+    Add(mh, nh, qc.q12, ldc, qc.q22, ldc, qc.q12, ldc);
+    Add(mh, nh, qc.q21, ldc, qc.q22, ldc, qc.q22, ldc);
+    Add(mh, nh, qc.q12, ldc, qc.q11, ldc, qc.q12, ldc);
+    // T4 = T2 - B21, P4 = A22 T4 in C11, U6 = U3 - P4 in C21.
+    Subtract(kh, nh, y, nh, qb.q21, ldb, y, nh);
+    multiply(qa.q22, lda, y, nh, qc.q11, ldc);
+    Subtract(mh, nh, qc.q21, ldc, qc.q11, ldc, qc.q21, ldc);
+    // P2 = A12 B21 in C11, U1 = P1 + P2 in C11.
+    multiply(qa.q12, lda, qb.q21, ldb, qc.q11, ldc);
+    Add(mh, nh, z, nh, qc.q11, ldc, qc.q11, ldc);
+    arena->used = mark;
+}
+
+// The Winograd variant with the seven sub-products on threads of their own, each with its own
+// part of the arena. Four of them go straight to the quadrants of c.
+void MultiplyParallel(
+    int32_t mh,
+    int32_t nh,
+    int32_t kh,
+    const float* a,
+    size_t lda,
+    const float* b,
+    size_t ldb,
+    float* c,
+    size_t ldc,
+    uint32_t level,
+    const StrassenSettings& settings,
+    Arena* arena) {
+    const Quadrants qa = GetQuadrants(a, lda, mh, kh);
+    const Quadrants qb = GetQuadrants(b, ldb, kh, nh);
+    const Quadrants qc = GetQuadrants(c, ldc, mh, nh);
+
+    const size_t mark = arena->used;
+    float* s[4];
+    float* t[4];
+    for (int i = 0; i < 4; ++i) {
+        s[i] = arena->Allocate(size_t(mh) * kh);
+        t[i] = arena->Allocate(size_t(kh) * nh);
+    }
+    float* p1 = arena->Allocate(size_t(mh) * nh);
+    float* p6 = arena->Allocate(size_t(mh) * nh);
+    float* p7 = arena->Allocate(size_t(mh) * nh);
+
+    Add(mh, kh, qa.q21, lda, qa.q22, lda, s[0], kh);
+    Subtract(mh, kh, s[0], kh, qa.q11, lda, s[1], kh);
+    Subtract(mh, kh, qa.q11, lda, qa.q21, lda, s[2], kh);
+    Subtract(mh, kh, qa.q12, lda, s[1], kh, s[3], kh);
+    Subtract(kh, nh, qb.q12, ldb, qb.q11, ldb, t[0], nh);
+    Subtract(kh, nh, qb.q22, ldb, t[0], nh, t[1], nh);
+    Subtract(kh, nh, qb.q22, ldb, qb.q12, ldb, t[2], nh);
+    Subtract(kh, nh, t[1], nh, qb.q21, ldb, t[3], nh);
+
+    struct Product {
+        const float* lhs;
+        size_t ldl;
+        const float* rhs;
+        size_t ldr;
+        float* out;
+        size_t ldo;
+    };
+    const Product products[7] = {
+        { qa.q11, lda, qb.q11, ldb, p1, size_t(nh) },
+        { qa.q12, lda, qb.q21, ldb, qc.q11, ldc },
+        { s[3], size_t(kh), qb.q22, ldb, qc.q12, ldc },
+        { qa.q22, lda, t[3], size_t(nh), qc.q21, ldc },
+        { s[0], size_t(kh), t[0], size_t(nh), qc.q22, ldc },
+        { s[1], size_t(kh), t[1], size_t(nh), p6, size_t(nh) },
+        { s[2], size_t(kh), t[2], size_t(nh), p7, size_t(nh) },
+    };
+    const size_t childSize = GetWorkspaceSize(mh, nh, kh, level + 1, settings);
+    float* childWorkspace = arena->Allocate(7 * childSize);
+    auto multiply = [&](int i) {
+        Arena childArena = { childWorkspace + i * childSize, childSize, 0 };
+        const Product& product = products[i];
+        MultiplyRecursive(
+            mh, nh, kh, product.lhs, product.ldl, product.rhs, product.ldr, product.out,
+            product.ldo, level + 1, settings, &childArena);
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < 7; ++i) {
+        threads.emplace_back(multiply, i);
+    }
+    multiply(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    // U2 = P1 + P6, U3 = U2 + P7, and then C11 = P1 + P2, C12 = U2 + P5 + P3, C21 = U3 - P4 and
+    // C22 = U3 + P5.
+    Add(mh, nh, p1, nh, p6, nh, p6, nh);
+    Add(mh, nh, p6, nh, p7, nh, p7, nh);
+    Add(mh, nh, p1, nh, qc.q11, ldc, qc.q11, ldc);
+    Add(mh, nh, p6, nh, qc.q12, ldc, qc.q12, ldc);
+    Add(mh, nh, qc.q22, ldc, qc.q12, ldc, qc.q12, ldc);
+    Subtract(mh, nh, p7, nh, qc.q21, ldc, qc.q21, ldc);
+    Add(mh, nh, p7, nh, qc.q22, ldc, qc.q22, ldc);
+    arena->used = mark;
+}
+
+void MultiplyRecursive(
+    int32_t m,
+    int32_t n,
+    int32_t k,
+    const float* a,
+    size_t lda,
+    const float* b,
+    size_t ldb,
+    float* c,
+    size_t ldc,
+    uint32_t level,
+    const StrassenSettings& settings,
+    Arena* arena) {
+    if (!UseStrassen(m, n, k, settings.cutoff)) {
+        MultiplyMatricesBlocked(m, n, k, a, lda, b, ldb, c, ldc);
+        return;
+    }
+
+    // The even part is multiplied recursively, and the last row, column or slice of the inner
+    // dimension of odd dimensions is peeled off.
+    const int32_t mEven = m & ~1;
+    const int32_t nEven = n & ~1;
+    const int32_t kEven = k & ~1;
+    if (level < settings.parallelLevels) {
+        MultiplyParallel(
+            mEven / 2, nEven / 2, kEven / 2, a, lda, b, ldb, c, ldc, level, settings, arena);
+    } else {
+        MultiplySequential(
+            mEven / 2, nEven / 2, kEven / 2, a, lda, b, ldb, c, ldc, level, settings, arena);
+    }
+    if (kEven != k) {
+        const float* lastRow2 = b + kEven * ldb;
+        for (int32_t y = 0; y < mEven; ++y) {
+            const float value = a[y * lda + kEven];
+            float* outputRow = c + y * ldc;
+            for (int32_t x = 0; x < nEven; ++x) {
+                outputRow[x] += value * lastRow2[x];
+            }
+        }
+    }
+    if (nEven != n) {
+        MultiplyMatricesBlocked(m, 1, k, a, lda, b + nEven, ldb, c + nEven, ldc);
+    }
+    if (mEven != m) {
+        MultiplyMatricesBlocked(1, nEven, k, a + mEven * lda, lda, b, ldb, c + mEven * ldc, ldc);
+    }
+}
+
+StrassenSettings ResolveSettings(
+    int32_t m,
+    int32_t n,
+    int32_t k,
+    const StrassenSettings& settings) {
+    StrassenSettings resolved = settings;
+    if (resolved.parallelLevels == 0) {
+        // One level keeps 7 processors busy, two levels 49. A level is dropped while the arena
+        // would take more than half of the available memory.
+        resolved.parallelLevels = std::thread::hardware_concurrency() > 7 ? 2 : 1;
+        const uint64_t memoryBudget = GetAvailableMemorySize() / 2;
+        while (memoryBudget != 0 && resolved.parallelLevels > 0 &&
+               GetWorkspaceSize(m, n, k, 0, resolved) * sizeof(float) > memoryBudget) {
+            --resolved.parallelLevels;
+        }
+    }
+    return resolved;
+}
+
+}  // anonymous namespace
+
+StrassenErrorBound GetStrassenErrorBound(int32_t m, int32_t n, int32_t k, int32_t cutoff) {
+    StrassenErrorBound bound = {};
+    bound.leafSize = k;
+    while (UseStrassen(m, n, bound.leafSize, cutoff)) {
+        m /= 2;
+        n /= 2;
+        bound.leafSize /= 2;
+        ++bound.levelCount;
+    }
+
+    // Classical: n^2. Winograd variant: (n / n0)^log2(18) (n0^2 + 6 n0) - 6 n, where n0 is the
+    // size of the leaves.
+    const double size = k;
+    const double leafSize = bound.leafSize;
+    bound.classicalFactor = size * size;
+    bound.strassenFactor = std::pow(18.0, bound.levelCount) * (leafSize * leafSize + 6 * leafSize) -
+                           6 * size;
+    bound.strassenFactor = std::max(bound.strassenFactor, bound.classicalFactor);
+    return bound;
+}
+
+void MultiplyMatricesStrassen(
+    int32_t m,
+    int32_t n,
+    int32_t k,
+    const float* a,
+    size_t lda,
+    const float* b,
+    size_t ldb,
+    float* c,
+    size_t ldc,
+    const StrassenSettings& settings,
+    size_t* workspaceSize) {
+    TRACE_SCOPE("MultiplyMatricesStrassen");
+    const StrassenSettings resolved = ResolveSettings(m, n, k, settings);
+    const size_t size = GetWorkspaceSize(m, n, k, 0, resolved);
+    if (workspaceSize != nullptr) {
+        *workspaceSize = size * sizeof(float);
+    }
+    std::unique_ptr<float[]> workspace(new float[std::max<size_t>(size, 1)]);
+    Arena arena = { workspace.get(), size, 0 };
+    MultiplyRecursive(m, n, k, a, lda, b, ldb, c, ldc, 0, resolved, &arena);
+}
+
+void BenchmarkStrassenCutoffs(int32_t size) {
+    TRACE_SCOPE("BenchmarkStrassenCutoffs");
+    const size_t elementCount = size_t(size) * size;
+    std::vector<float> inputMatrix1(elementCount);
+    std::vector<float> inputMatrix2(elementCount);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    for (size_t i = 0; i < elementCount; ++i) {
+        inputMatrix1[i] = distribution(random);
+        inputMatrix2[i] = distribution(random);
+    }
+
+    const double flops = 2.0 * size * size * size;
+    const CPUTopology topology = DetectCPUTopology();
+    std::vector<float> classical(elementCount);
+    NumaMatMul numaMatMul(topology);
+    numaMatMul.SetInputs(size, size, size, inputMatrix1.data(), size, inputMatrix2.data(), size);
+    const double classicalMS = numaMatMul.Multiply() * 1e3;
+    numaMatMul.GetOutput(classical.data());
+
+    printf(
+        "Multiply %dx%d matrices on %u threads, classical: %.2f ms (%.2f GFLOPS)\n", size, size,
+        numaMatMul.GetThreadCount(), classicalMS, flops / (classicalMS * 1e6));
+    printf(
+        "%-8s%8s%14s%10s%14s%16s%16s\n", "Cutoff", "Levels", "Time (ms)", "Speedup",
+        "Arena (MB)", "Max error ULPs", "Bound ratio");
+
+    std::vector<float> output(elementCount);
+    for (int32_t cutoff = 2048; cutoff >= 64; cutoff /= 2) {
+        if (cutoff >= size) {
+            continue;
+        }
+        StrassenSettings settings;
+        settings.cutoff = cutoff;
+        size_t workspaceSize = 0;
+        const auto start = std::chrono::steady_clock::now();
+        MultiplyMatricesStrassen(
+            size, size, size, inputMatrix1.data(), size, inputMatrix2.data(), size, output.data(),
+            size, settings, &workspaceSize);
+        const double timeMS =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                .count();
+
+        // The difference of the representations, in the units of the tolerance of
+        // CheckGPUResult().
+        int64_t maxErrorULPs = 0;
+        for (size_t i = 0; i < elementCount; ++i) {
+            int32_t strassenBytes = 0;
+            int32_t classicalBytes = 0;
+            memcpy(&strassenBytes, &output[i], sizeof(float));
+            memcpy(&classicalBytes, &classical[i], sizeof(float));
+            maxErrorULPs = std::max<int64_t>(
+                maxErrorULPs, std::llabs(int64_t(strassenBytes) - int64_t(classicalBytes)));
+        }
+        const StrassenErrorBound bound = GetStrassenErrorBound(size, size, size, cutoff);
+        printf(
+            "%-8d%8u%14.2f%9.2fx%14.1f%16lld%16.1f\n", cutoff, bound.levelCount, timeMS,
+            classicalMS / timeMS, workspaceSize / double(1 << 20),
+            static_cast<long long>(maxErrorULPs),
+            bound.strassenFactor / bound.classicalFactor);
+    }
+    printf("\n");
+}
@@ -0,0 +1,85 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+
+#ifndef STRASSEN_MAT_MUL_
+#define STRASSEN_MAT_MUL_
+
+#include <cstddef>
+#include <cstdint>
+
+// Measured with BenchmarkStrassenCutoffs(): one more level of recursion below this size doesn't
+// make the multiplication faster any more.
+constexpr int32_t kDefaultStrassenCutoff = 256;
+// Below this size, the levels of recursion multiply the error bound so much that the widened
+// tolerance no longer checks anything.
+constexpr int32_t kMinStrassenCutoff = 32;
+
+struct StrassenSettings {
+    // Recurse while every dimension is above the cutoff.
+    int32_t cutoff = kDefaultStrassenCutoff;
+    // The number of top levels whose seven sub-products run on threads of their own, or 0 to pick
+    // it from the number of logical processors and the available memory, as each parallel level
+    // needs the temporaries of its seven sub-products at once: at 8192 x 8192 the arena is
+    // 0.25 GB without any parallel level, 1.1 GB with one and 2.6 GB with two.
+    uint32_t parallelLevels = 0;
+};
+
+// The normwise bound of the error of an element of the result, in units of
+// u * max|a| * max|b| with u = 2^-24 the unit roundoff of float, from Higham, Accuracy and
+// Stability of Numerical Algorithms, chapter 23, with n the inner dimension.
+struct StrassenErrorBound {
+    uint32_t levelCount;
+    // The inner dimension of the multiplications done by the classical kernel.
+    int32_t leafSize;
+    double strassenFactor;
+    double classicalFactor;
+};
+
+StrassenErrorBound GetStrassenErrorBound(int32_t m, int32_t n, int32_t k, int32_t cutoff);
+
+// c = a * b with the Strassen-Winograd algorithm, where a is m x k, b is k x n and c is m x n, and
+// the rows of each matrix are lda, ldb and ldc floats apart. Odd dimensions are peeled off and
+// multiplied by the classical kernel. All the temporaries are taken from one arena allocated up
+// front, whose size is returned in workspaceSize if it isn't nullptr.
+void MultiplyMatricesStrassen(
+    int32_t m,
+    int32_t n,
+    int32_t k,
+    const float* a,
+    size_t lda,
+    const float* b,
+    size_t ldb,
+    float* c,
+    size_t ldc,
+    const StrassenSettings& settings,
+    size_t* workspaceSize = nullptr);
+
+// Multiply size x size matrices with the classical NUMA partitioned multiplication and with
+// Strassen-Winograd at several cutoffs, and print their times and errors, to tune the cutoff.
+void BenchmarkStrassenCutoffs(int32_t size);
+
+#endif
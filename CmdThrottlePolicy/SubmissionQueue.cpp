@@ -0,0 +1,151 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "SubmissionQueue.h"
+
+#include <cassert>
+
+#include "DXSampleHelper.h"
+#include "Tracer.h"
+
+SubmissionQueue::SubmissionQueue(
+    ID3D12Device* device,
+    ComPtr<ID3D12CommandQueue> queue,
+    D3D12_COMMAND_LIST_TYPE type,
+    uint32_t frameCount)
+    : mQueue(queue), mFrames(frameCount > 0 ? frameCount : 1) {
+    // The copy queues may not support timestamps.
+    if (FAILED(mQueue->GetTimestampFrequency(&mTimestampFrequency))) {
+        mTimestampFrequency = 0;
+    }
+
+    ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
+    mFenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if (mFenceEvent == nullptr) {
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+    }
+
+    for (Frame& frame : mFrames) {
+        ThrowIfFailed(device->CreateCommandAllocator(type, IID_PPV_ARGS(&frame.commandAllocator)));
+        ThrowIfFailed(device->CreateCommandList(
+            0, type, frame.commandAllocator.Get(), nullptr, IID_PPV_ARGS(&frame.commandList)));
+        // Command lists are created in the recording state, but BeginFrame() always resets them.
+        ThrowIfFailed(frame.commandList->Close());
+    }
+}
+
+SubmissionQueue::~SubmissionQueue() {
+    // The command allocators must not be released while the GPU still uses them.
+    if (SUCCEEDED(mQueue->Signal(mFence.Get(), mNextFenceValue)) &&
+        SUCCEEDED(mFence->SetEventOnCompletion(mNextFenceValue, mFenceEvent))) {
+        WaitForSingleObjectEx(mFenceEvent, INFINITE, FALSE);
+    }
+    CloseHandle(mFenceEvent);
+}
+
+ID3D12GraphicsCommandList* SubmissionQueue::BeginFrame(ID3D12PipelineState* initialState) {
+    assert(!mRecording);
+    Frame& frame = mFrames[mCurrentFrame];
+    WaitForFenceValue(frame.fenceValue);
+
+    ThrowIfFailed(frame.commandAllocator->Reset());
+    ThrowIfFailed(frame.commandList->Reset(frame.commandAllocator.Get(), initialState));
+    mRecording = true;
+    return frame.commandList.Get();
+}
+
+uint64_t SubmissionQueue::SubmitFrame() {
+    assert(mRecording);
+    mRecording = false;
+
+    Frame& frame = mFrames[mCurrentFrame];
+    ThrowIfFailed(frame.commandList->Close());
+    ID3D12CommandList* ppCommandLists[] = { frame.commandList.Get() };
+    {
+        TRACE_SCOPE("ExecuteCommandLists");
+        mQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+    }
+
+    frame.fenceValue = Signal();
+    mCurrentFrame = (mCurrentFrame + 1) % static_cast<uint32_t>(mFrames.size());
+    return frame.fenceValue;
+}
+
+uint64_t SubmissionQueue::GetNextFenceValue() const {
+    return mNextFenceValue;
+}
+
+uint64_t SubmissionQueue::GetCompletedFenceValue() const {
+    return mFence->GetCompletedValue();
+}
+
+bool SubmissionQueue::IsFenceValueCompleted(uint64_t fenceValue) const {
+    return fenceValue <= GetCompletedFenceValue();
+}
+
+uint64_t SubmissionQueue::GetLastSubmittedFenceValue() const {
+    return mNextFenceValue - 1;
+}
+
+uint64_t SubmissionQueue::Signal() {
+    const uint64_t fenceValue = mNextFenceValue;
+    ThrowIfFailed(mQueue->Signal(mFence.Get(), fenceValue));
+    ++mNextFenceValue;
+    return fenceValue;
+}
+
+void SubmissionQueue::WaitForFenceValue(uint64_t fenceValue) {
+    if (IsFenceValueCompleted(fenceValue)) {
+        return;
+    }
+    TRACE_SCOPE("SubmissionQueue::WaitForFenceValue");
+    ThrowIfFailed(mFence->SetEventOnCompletion(fenceValue, mFenceEvent));
+    WaitForSingleObjectEx(mFenceEvent, INFINITE, FALSE);
+}
+
+void SubmissionQueue::WaitOnGPU(const SubmissionQueue& other, uint64_t fenceValue) {
+    ThrowIfFailed(mQueue->Wait(other.GetFence(), fenceValue));
+}
+
+void SubmissionQueue::WaitForIdle() {
+    WaitForFenceValue(Signal());
+}
+
+ID3D12CommandQueue* SubmissionQueue::GetQueue() const {
+    return mQueue.Get();
+}
+
+ID3D12Fence* SubmissionQueue::GetFence() const {
+    return mFence.Get();
+}
+
+uint64_t SubmissionQueue::GetTimestampFrequency() const {
+    return mTimestampFrequency;
+}
+
+uint32_t SubmissionQueue::GetFrameCount() const {
+    return static_cast<uint32_t>(mFrames.size());
+}
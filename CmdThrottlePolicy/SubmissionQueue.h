@@ -0,0 +1,99 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef SUBMISSION_QUEUE_
+#define SUBMISSION_QUEUE_
+
+#include <vector>
+
+#include <d3d12.h>
+#include <wrl.h>
+
+using Microsoft::WRL::ComPtr;
+
+// A command queue with a ring of frames in flight.
+//
+// Each frame owns a command allocator and a command list, and remembers the fence value signaled
+// after its last submit. The fence value increases monotonically with every submit, and the CPU
+// only waits when it wants to reuse a frame that the GPU hasn't finished yet, so it can record
+// the next frames while the GPU executes the previous ones.
+class SubmissionQueue {
+public:
+    SubmissionQueue(
+        ID3D12Device* device,
+        ComPtr<ID3D12CommandQueue> queue,
+        D3D12_COMMAND_LIST_TYPE type,
+        uint32_t frameCount);
+    ~SubmissionQueue();
+
+    // Wait until the GPU is done with the next frame, and return its command list reset and ready
+    // for recording.
+    ID3D12GraphicsCommandList* BeginFrame(ID3D12PipelineState* initialState = nullptr);
+
+    // Close and execute the command list of the current frame. Returns the fence value signaled
+    // right after it.
+    uint64_t SubmitFrame();
+
+    // Returns the fence value the next SubmitFrame() or Signal() will signal.
+    uint64_t GetNextFenceValue() const;
+    uint64_t GetCompletedFenceValue() const;
+    bool IsFenceValueCompleted(uint64_t fenceValue) const;
+    uint64_t GetLastSubmittedFenceValue() const;
+
+    // Signal the next fence value on the queue without submitting anything and return it.
+    uint64_t Signal();
+    void WaitForFenceValue(uint64_t fenceValue);
+    // Make the GPU wait until fenceValue has completed on other before executing the command
+    // lists submitted to this queue from now on. The CPU doesn't wait.
+    void WaitOnGPU(const SubmissionQueue& other, uint64_t fenceValue);
+    // Wait until all the work submitted so far is completed.
+    void WaitForIdle();
+
+    ID3D12CommandQueue* GetQueue() const;
+    ID3D12Fence* GetFence() const;
+    uint64_t GetTimestampFrequency() const;
+    uint32_t GetFrameCount() const;
+
+private:
+    struct Frame {
+        ComPtr<ID3D12CommandAllocator> commandAllocator;
+        ComPtr<ID3D12GraphicsCommandList> commandList;
+        // The fence value signaled after the last submit of this frame, 0 if never submitted.
+        uint64_t fenceValue = 0;
+    };
+
+    ComPtr<ID3D12CommandQueue> mQueue;
+    ComPtr<ID3D12Fence> mFence;
+    HANDLE mFenceEvent = nullptr;
+    uint64_t mNextFenceValue = 1;
+    uint64_t mTimestampFrequency = 0;
+
+    std::vector<Frame> mFrames;
+    uint32_t mCurrentFrame = 0;
+    bool mRecording = false;
+};
+
+#endif
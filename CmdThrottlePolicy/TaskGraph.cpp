@@ -0,0 +1,146 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "TaskGraph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "Tracer.h"
+
+TaskGraph::TaskId TaskGraph::AddTask(
+    const char* name,
+    std::function<void()> function,
+    std::initializer_list<TaskId> dependencies) {
+    const TaskId id = static_cast<TaskId>(mTasks.size());
+    Task task;
+    task.name = name;
+    task.function = std::move(function);
+    task.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    mTasks.push_back(std::move(task));
+    for (TaskId dependency : dependencies) {
+        assert(dependency < id);
+        mTasks[dependency].dependents.push_back(id);
+    }
+    return id;
+}
+
+void TaskGraph::Run(uint32_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    mThreadCount = std::min(threadCount, std::max(1u, static_cast<uint32_t>(mTasks.size())));
+
+    std::mutex mutex;
+    std::condition_variable taskDone;
+    std::deque<TaskId> readyTasks;
+    std::vector<uint32_t> remainingDependencies(mTasks.size());
+    for (TaskId id = 0; id < mTasks.size(); ++id) {
+        remainingDependencies[id] = mTasks[id].dependencyCount;
+        if (remainingDependencies[id] == 0) {
+            readyTasks.push_back(id);
+        }
+    }
+    size_t doneCount = 0;
+    std::exception_ptr exception;
+
+    const auto start = std::chrono::steady_clock::now();
+    auto elapsedMS = [&]() {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+            .count();
+    };
+    auto runTasks = [&](uint32_t thread) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            taskDone.wait(lock, [&]() {
+                return !readyTasks.empty() || doneCount == mTasks.size() || exception != nullptr;
+            });
+            if (doneCount == mTasks.size() || exception != nullptr) {
+                return;
+            }
+            // The ready tasks are run in the order they were added.
+            auto next = std::min_element(readyTasks.begin(), readyTasks.end());
+            const TaskId id = *next;
+            readyTasks.erase(next);
+            Task& task = mTasks[id];
+            task.thread = thread;
+            task.startMS = elapsedMS();
+            lock.unlock();
+
+            std::exception_ptr taskException;
+            try {
+                TraceScope traceScope(task.name);
+                task.function();
+            } catch (...) {
+                taskException = std::current_exception();
+            }
+
+            lock.lock();
+            task.durationMS = elapsedMS() - task.startMS;
+            ++doneCount;
+            if (taskException != nullptr && exception == nullptr) {
+                exception = taskException;
+            }
+            for (TaskId dependent : task.dependents) {
+                if (--remainingDependencies[dependent] == 0) {
+                    readyTasks.push_back(dependent);
+                }
+            }
+            taskDone.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (uint32_t thread = 1; thread < mThreadCount; ++thread) {
+        workers.emplace_back(runTasks, thread);
+    }
+    runTasks(0);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    mTotalMS = elapsedMS();
+
+    if (exception != nullptr) {
+        std::rethrow_exception(exception);
+    }
+}
+
+void TaskGraph::PrintTimings() const {
+    printf("%zu tasks on %u threads in %.2f ms:\n", mTasks.size(), mThreadCount, mTotalMS);
+    for (const Task& task : mTasks) {
+        printf(
+            "  %-28s thread %u, %8.2f ms -> %8.2f ms (%.2f ms)\n", task.name, task.thread,
+            task.startMS, task.startMS + task.durationMS, task.durationMS);
+    }
+    printf("\n");
+}
@@ -0,0 +1,73 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef TASK_GRAPH_
+#define TASK_GRAPH_
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+// A graph of tasks run once on a few threads, each task starting as soon as the tasks it depends
+// on are done. Used to overlap the independent stages of the initialization.
+class TaskGraph {
+public:
+    using TaskId = uint32_t;
+
+    // name must outlive the graph, e.g. be a string literal. A task can only depend on tasks added
+    // before it, so the graph can't have cycles.
+    TaskId AddTask(
+        const char* name,
+        std::function<void()> function,
+        std::initializer_list<TaskId> dependencies = {});
+
+    // Run every task on up to threadCount threads including the calling one, or on one per
+    // hardware thread when it is 0. With one thread, the tasks run in the order they were added.
+    // If a task throws, no other task is started and the exception is rethrown once the running
+    // tasks are done.
+    void Run(uint32_t threadCount);
+
+    // Print when each task of the last Run() started and how long it took.
+    void PrintTimings() const;
+
+private:
+    struct Task {
+        const char* name;
+        std::function<void()> function;
+        std::vector<TaskId> dependents;
+        uint32_t dependencyCount = 0;
+        double startMS = 0.0;
+        double durationMS = 0.0;
+        uint32_t thread = 0;
+    };
+
+    std::vector<Task> mTasks;
+    uint32_t mThreadCount = 0;
+    double mTotalMS = 0.0;
+};
+
+#endif
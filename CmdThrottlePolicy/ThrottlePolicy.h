@@ -0,0 +1,50 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef THROTTLE_POLICY_
+#define THROTTLE_POLICY_
+
+// The command queue throttle policies compared by this sample. They mirror
+// INTC_D3D12_COMMAND_QUEUE_THROTTLE_POLICY so that the code that only schedules work and analyzes
+// timings doesn't depend on D3D12 and can also run against a simulated GPU.
+enum class ThrottlePolicy {
+    Dynamic = 0,
+    MaxPerformance = 1,
+};
+
+constexpr int kThrottlePolicyCount = 2;
+
+inline const char* GetThrottlePolicyName(ThrottlePolicy policy) {
+    switch (policy) {
+        case ThrottlePolicy::Dynamic:
+            return "DYNAMIC";
+        case ThrottlePolicy::MaxPerformance:
+            return "MAX_PERFORMANCE";
+    }
+    return "UNKNOWN";
+}
+
+#endif
@@ -0,0 +1,185 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "TimestampQueryRing.h"
+
+#include <cassert>
+#include <stdexcept>
+
+#include "DXSampleHelper.h"
+
+TimestampQueryRing::TimestampQueryRing(
+    ID3D12Device* device,
+    uint32_t queryCount,
+    uint64_t timestampFrequency)
+    : mQueryCount(queryCount), mTimestampFrequency(timestampFrequency) {
+    D3D12_QUERY_HEAP_DESC timestampHeapDesc = {};
+    timestampHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    timestampHeapDesc.Count = mQueryCount;
+    ThrowIfFailed(device->CreateQueryHeap(&timestampHeapDesc, IID_PPV_ARGS(&mQueryHeap)));
+
+    D3D12_HEAP_PROPERTIES heapProperties = {};
+    heapProperties.Type = D3D12_HEAP_TYPE_READBACK;
+
+    D3D12_RESOURCE_DESC bufferDescriptor = {};
+    bufferDescriptor.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferDescriptor.Width = mQueryCount * sizeof(uint64_t);
+    bufferDescriptor.Height = 1;
+    bufferDescriptor.DepthOrArraySize = 1;
+    bufferDescriptor.MipLevels = 1;
+    bufferDescriptor.Format = DXGI_FORMAT_UNKNOWN;
+    bufferDescriptor.SampleDesc.Count = 1;
+    bufferDescriptor.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    bufferDescriptor.Flags = D3D12_RESOURCE_FLAG_NONE;
+    ThrowIfFailed(device->CreateCommittedResource(
+        &heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDescriptor, D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr, IID_PPV_ARGS(&mReadbackBuffer)));
+
+    // Readback buffers can stay mapped for their whole lifetime. The data of a submit is only read
+    // after its fence value has completed.
+    void* data = nullptr;
+    ThrowIfFailed(mReadbackBuffer->Map(0, nullptr, &data));
+    mReadbackData = static_cast<const uint64_t*>(data);
+}
+
+TimestampQueryRing::~TimestampQueryRing() {
+    D3D12_RANGE writtenRange = { 0, 0 };
+    mReadbackBuffer->Unmap(0, &writtenRange);
+}
+
+bool TimestampQueryRing::BeginSubmit(uint32_t maxRegions) {
+    assert(!mRecording);
+    const uint32_t requiredQueryCount = maxRegions * 2;
+    if (requiredQueryCount > mQueryCount) {
+        return false;
+    }
+
+    uint32_t firstQuery = mHead;
+    if (mPendingSubmits.empty()) {
+        firstQuery = 0;
+    } else {
+        // The ranges of a submit never wrap around, as they are resolved with a single
+        // ResolveQueryData. mHead never catches up with the oldest pending submit so that
+        // mHead == tail always means the ring is empty.
+        const uint32_t tail = mPendingSubmits.front().firstQuery;
+        if (mHead >= tail) {
+            if (mQueryCount - mHead < requiredQueryCount) {
+                if (requiredQueryCount >= tail) {
+                    return false;
+                }
+                firstQuery = 0;
+            }
+        } else if (tail - mHead <= requiredQueryCount) {
+            return false;
+        }
+    }
+
+    mRecording = true;
+    mReservedQueryCount = requiredQueryCount;
+    mCurrentSubmit.firstQuery = firstQuery;
+    mCurrentSubmit.regionIds.clear();
+    return true;
+}
+
+uint32_t TimestampQueryRing::BeginRegion(
+    ID3D12GraphicsCommandList* commandList,
+    uint64_t regionId) {
+    assert(mRecording);
+    const uint32_t region = static_cast<uint32_t>(mCurrentSubmit.regionIds.size());
+    assert((region + 1) * 2 <= mReservedQueryCount);
+    mCurrentSubmit.regionIds.push_back(regionId);
+    commandList->EndQuery(
+        mQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, mCurrentSubmit.firstQuery + region * 2);
+    return region;
+}
+
+void TimestampQueryRing::EndRegion(ID3D12GraphicsCommandList* commandList, uint32_t region) {
+    assert(mRecording);
+    commandList->EndQuery(
+        mQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, mCurrentSubmit.firstQuery + region * 2 + 1);
+}
+
+void TimestampQueryRing::EndSubmit(ID3D12GraphicsCommandList* commandList, uint64_t fenceValue) {
+    assert(mRecording);
+    mRecording = false;
+
+    const uint32_t usedQueryCount = static_cast<uint32_t>(mCurrentSubmit.regionIds.size()) * 2;
+    if (usedQueryCount == 0) {
+        return;
+    }
+
+    commandList->ResolveQueryData(
+        mQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, mCurrentSubmit.firstQuery, usedQueryCount,
+        mReadbackBuffer.Get(), mCurrentSubmit.firstQuery * sizeof(uint64_t));
+
+    mHead = mCurrentSubmit.firstQuery + usedQueryCount;
+    mCurrentSubmit.fenceValue = fenceValue;
+    mPendingSubmits.push_back(std::move(mCurrentSubmit));
+    mCurrentSubmit = {};
+}
+
+void TimestampQueryRing::CollectCompleted(
+    uint64_t completedFenceValue,
+    std::vector<RegionTiming>* timings) {
+    while (!mPendingSubmits.empty() &&
+           mPendingSubmits.front().fenceValue <= completedFenceValue) {
+        const PendingSubmit& submit = mPendingSubmits.front();
+        for (size_t i = 0; i < submit.regionIds.size(); ++i) {
+            RegionTiming timing = {};
+            timing.regionId = submit.regionIds[i];
+            timing.beginTimestamp = mReadbackData[submit.firstQuery + i * 2];
+            timing.endTimestamp = mReadbackData[submit.firstQuery + i * 2 + 1];
+            timing.gpuTimeUS = static_cast<double>(timing.endTimestamp - timing.beginTimestamp) *
+                               1e6 / static_cast<double>(mTimestampFrequency);
+            timings->push_back(timing);
+        }
+        mPendingSubmits.pop_front();
+    }
+
+    if (mPendingSubmits.empty() && !mRecording) {
+        mHead = 0;
+    }
+}
+
+bool TimestampQueryRing::HasPendingSubmits() const {
+    return !mPendingSubmits.empty();
+}
+
+uint64_t TimestampQueryRing::GetOldestPendingFenceValue() const {
+    if (mPendingSubmits.empty()) {
+        // Waiting for it would never make room for a submit that doesn't fit in the ring.
+        throw std::logic_error("The timestamp query ring has no pending submit to wait for");
+    }
+    return mPendingSubmits.front().fenceValue;
+}
+
+uint32_t TimestampQueryRing::GetMaxRegionsPerSubmit() const {
+    return mQueryCount / 2;
+}
+
+uint64_t TimestampQueryRing::GetTimestampFrequency() const {
+    return mTimestampFrequency;
+}
@@ -0,0 +1,103 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef TIMESTAMP_QUERY_RING_
+#define TIMESTAMP_QUERY_RING_
+
+#include <deque>
+#include <vector>
+
+#include <d3d12.h>
+#include <wrl.h>
+
+using Microsoft::WRL::ComPtr;
+
+// A ring of timestamp queries shared by all the command lists submitted to one queue.
+//
+// Each submit reserves a contiguous range of queries, writes one begin/end pair per timed region
+// and resolves the whole range with a single ResolveQueryData into a persistently mapped readback
+// buffer. The submit is tagged with the fence value signaled after it, and its timestamps are only
+// read once that fence value has completed, so timing never makes the CPU wait for the GPU.
+class TimestampQueryRing {
+public:
+    struct RegionTiming {
+        // The identifier passed to BeginRegion().
+        uint64_t regionId;
+        uint64_t beginTimestamp;
+        uint64_t endTimestamp;
+        double gpuTimeUS;
+    };
+
+    TimestampQueryRing(ID3D12Device* device, uint32_t queryCount, uint64_t timestampFrequency);
+    ~TimestampQueryRing();
+
+    // Reserve the queries for up to maxRegions regions in the command list being recorded.
+    // Returns false when the ring doesn't have enough room left; the caller then needs to wait for
+    // GetOldestPendingFenceValue() and call CollectCompleted() before trying again. maxRegions
+    // must not be above GetMaxRegionsPerSubmit(), or the ring never has enough room.
+    bool BeginSubmit(uint32_t maxRegions);
+    uint32_t GetMaxRegionsPerSubmit() const;
+
+    // Write the begin timestamp of a region and return the handle to pass to EndRegion().
+    uint32_t BeginRegion(ID3D12GraphicsCommandList* commandList, uint64_t regionId);
+    void EndRegion(ID3D12GraphicsCommandList* commandList, uint32_t region);
+
+    // Record the ResolveQueryData of all the regions of the current submit. fenceValue must be the
+    // value signaled on the queue right after the command list is executed.
+    void EndSubmit(ID3D12GraphicsCommandList* commandList, uint64_t fenceValue);
+
+    // Append the timings of all the submits whose fence value is not above completedFenceValue.
+    void CollectCompleted(uint64_t completedFenceValue, std::vector<RegionTiming>* timings);
+
+    bool HasPendingSubmits() const;
+    // Throws std::logic_error if there is no pending submit.
+    uint64_t GetOldestPendingFenceValue() const;
+
+    uint64_t GetTimestampFrequency() const;
+
+private:
+    struct PendingSubmit {
+        uint64_t fenceValue;
+        uint32_t firstQuery;
+        std::vector<uint64_t> regionIds;
+    };
+
+    ComPtr<ID3D12QueryHeap> mQueryHeap;
+    ComPtr<ID3D12Resource> mReadbackBuffer;
+    const uint64_t* mReadbackData = nullptr;
+
+    uint32_t mQueryCount;
+    uint64_t mTimestampFrequency;
+
+    // The next free query. The queries between the first pending submit and mHead are in use.
+    uint32_t mHead = 0;
+    bool mRecording = false;
+    uint32_t mReservedQueryCount = 0;
+    PendingSubmit mCurrentSubmit = {};
+    std::deque<PendingSubmit> mPendingSubmits;
+};
+
+#endif
@@ -0,0 +1,205 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "Tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "BenchmarkResults.h"
+
+namespace tracer_internal {
+std::atomic<bool> gEnabled(false);
+}  // namespace tracer_internal
+
+namespace {
+
+struct CPUSpan {
+    const char* name;
+    int64_t beginNS;
+    int64_t endNS;
+};
+
+struct GPUSpan {
+    const char* track;
+    std::string name;
+    double beginUS;
+    double endUS;
+};
+
+// Owned by the registry so that the spans of a thread outlive it. The mutex is only contended
+// while WriteChromeTrace() copies the spans.
+struct ThreadBuffer {
+    uint32_t threadIndex;
+    std::mutex mutex;
+    std::vector<CPUSpan> spans;
+};
+
+struct TraceRegistry {
+    const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+    std::vector<GPUSpan> gpuSpans;
+};
+
+TraceRegistry& GetRegistry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+int64_t GetTraceTimeNS() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - GetRegistry().epoch)
+        .count();
+}
+
+ThreadBuffer* GetThreadBuffer() {
+    // The lock is only taken the first time a thread records a span.
+    thread_local ThreadBuffer* threadBuffer = nullptr;
+    if (threadBuffer == nullptr) {
+        TraceRegistry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto buffer = std::make_unique<ThreadBuffer>();
+        buffer->threadIndex = static_cast<uint32_t>(registry.threadBuffers.size());
+        buffer->spans.reserve(4096);
+        threadBuffer = buffer.get();
+        registry.threadBuffers.push_back(std::move(buffer));
+    }
+    return threadBuffer;
+}
+
+}  // anonymous namespace
+
+void EnableTracing() {
+    // Start the clock before the first span.
+    GetRegistry();
+    tracer_internal::gEnabled.store(true, std::memory_order_relaxed);
+}
+
+double GetTraceTimeUS() {
+    return GetTraceTimeNS() * 1e-3;
+}
+
+TraceScope::TraceScope(const char* name) : mName(name) {
+    if (IsTracingEnabled()) {
+        mBeginNS = GetTraceTimeNS();
+    }
+}
+
+TraceScope::~TraceScope() {
+    if (mBeginNS >= 0) {
+        const int64_t endNS = GetTraceTimeNS();
+        ThreadBuffer* buffer = GetThreadBuffer();
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        buffer->spans.push_back({ mName, mBeginNS, endNS });
+    }
+}
+
+void AddGPUTraceSpan(const char* track, const std::string& name, double beginUS, double endUS) {
+    if (!IsTracingEnabled()) {
+        return;
+    }
+    TraceRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.gpuSpans.push_back({ track, name, beginUS, endUS });
+}
+
+bool WriteChromeTrace(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        printf("ERROR: failed to open %s.\n", path.c_str());
+        return false;
+    }
+
+    // The CPU threads are in process 1 and the GPU queues in process 2, one thread per queue.
+    constexpr uint32_t kCPUProcess = 1;
+    constexpr uint32_t kGPUProcess = 2;
+    TraceRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    fprintf(
+        file,
+        "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %u, \"args\": {\"name\": \"CPU\"}},\n"
+        "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %u, \"args\": {\"name\": \"GPU\"}}",
+        kCPUProcess, kGPUProcess);
+
+    for (const std::unique_ptr<ThreadBuffer>& buffer : registry.threadBuffers) {
+        // The spans are copied so that the thread isn't blocked while they are written.
+        std::vector<CPUSpan> spans;
+        {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            spans = buffer->spans;
+        }
+        fprintf(
+            file,
+            ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %u, \"tid\": %u, \"args\": "
+            "{\"name\": \"Thread %u\"}}",
+            kCPUProcess, buffer->threadIndex, buffer->threadIndex);
+        for (const CPUSpan& span : spans) {
+            fprintf(
+                file,
+                ",\n{\"name\": \"%s\", \"cat\": \"cpu\", \"ph\": \"X\", \"pid\": %u, \"tid\": %u, "
+                "\"ts\": %.3f, \"dur\": %.3f}",
+                EscapeJSON(span.name).c_str(), kCPUProcess, buffer->threadIndex,
+                span.beginNS * 1e-3, (span.endNS - span.beginNS) * 1e-3);
+        }
+    }
+
+    std::vector<const char*> tracks;
+    for (const GPUSpan& span : registry.gpuSpans) {
+        auto track = std::find_if(tracks.begin(), tracks.end(), [&](const char* name) {
+            return strcmp(name, span.track) == 0;
+        });
+        if (track == tracks.end()) {
+            fprintf(
+                file,
+                ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %u, \"tid\": %zu, "
+                "\"args\": {\"name\": \"%s\"}}",
+                kGPUProcess, tracks.size(), EscapeJSON(span.track).c_str());
+            track = tracks.insert(tracks.end(), span.track);
+        }
+        fprintf(
+            file,
+            ",\n{\"name\": \"%s\", \"cat\": \"gpu\", \"ph\": \"X\", \"pid\": %u, \"tid\": %zu, "
+            "\"ts\": %.3f, \"dur\": %.3f}",
+            EscapeJSON(span.name).c_str(), kGPUProcess,
+            static_cast<size_t>(track - tracks.begin()), span.beginUS,
+            span.endUS - span.beginUS);
+    }
+    fprintf(file, "\n]}\n");
+
+    const bool written = ferror(file) == 0;
+    if (fclose(file) != 0 || !written) {
+        printf("ERROR: failed to write %s.\n", path.c_str());
+        return false;
+    }
+    return true;
+}
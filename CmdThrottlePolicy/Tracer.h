@@ -0,0 +1,82 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef TRACER_
+#define TRACER_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// A scoped-span tracer of the host, exported as a Chrome trace that chrome://tracing and Perfetto
+// can open together with the GPU execution of the timed regions.
+//
+// Each thread appends its spans to its own buffer, so that a span only costs two reads of the
+// monotonic clock and an append under the uncontended lock of that buffer. WriteChromeTrace()
+// takes the same lock to copy the spans, so it can run while other threads are still tracing.
+
+namespace tracer_internal {
+extern std::atomic<bool> gEnabled;
+}  // namespace tracer_internal
+
+inline bool IsTracingEnabled() {
+    return tracer_internal::gEnabled.load(std::memory_order_relaxed);
+}
+
+// Start recording the spans. Until then the spans cost a single relaxed load.
+void EnableTracing();
+
+// Returns the time of the trace clock in microseconds.
+double GetTraceTimeUS();
+
+// Records the time between its construction and its destruction. name must outlive the trace,
+// e.g. be a string literal.
+class TraceScope {
+public:
+    explicit TraceScope(const char* name);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* mName;
+    int64_t mBeginNS = -1;
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+// Add a span of the GPU to the track of a queue, which must outlive the trace like the names of the
+// TraceScopes. The times must already be converted to the trace clock, see GetTraceTimeUS().
+void AddGPUTraceSpan(const char* track, const std::string& name, double beginUS, double endUS);
+
+// Write every span recorded so far as Chrome trace event JSON. Returns false if the file couldn't
+// be written.
+bool WriteChromeTrace(const std::string& path);
+
+#endif
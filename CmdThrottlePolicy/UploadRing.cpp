@@ -0,0 +1,142 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#include "UploadRing.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "DXSampleHelper.h"
+
+UploadRing::UploadRing(ID3D12Device* device, uint64_t size) : mAllocator(size) {
+    D3D12_HEAP_PROPERTIES heapProperties = {};
+    heapProperties.Type = D3D12_HEAP_TYPE_UPLOAD;
+
+    D3D12_RESOURCE_DESC bufferDescriptor = {};
+    bufferDescriptor.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferDescriptor.Width = size;
+    bufferDescriptor.Height = 1;
+    bufferDescriptor.DepthOrArraySize = 1;
+    bufferDescriptor.MipLevels = 1;
+    bufferDescriptor.Format = DXGI_FORMAT_UNKNOWN;
+    bufferDescriptor.SampleDesc.Count = 1;
+    bufferDescriptor.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    bufferDescriptor.Flags = D3D12_RESOURCE_FLAG_NONE;
+    ThrowIfFailed(device->CreateCommittedResource(
+        &heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDescriptor,
+        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&mBuffer)));
+
+    // Upload buffers can stay mapped for their whole lifetime. The CPU never reads them.
+    D3D12_RANGE readRange = { 0, 0 };
+    void* data = nullptr;
+    ThrowIfFailed(mBuffer->Map(0, &readRange, &data));
+    mMappedData = static_cast<uint8_t*>(data);
+    mGPUAddress = mBuffer->GetGPUVirtualAddress();
+}
+
+UploadRing::~UploadRing() {
+    mBuffer->Unmap(0, nullptr);
+}
+
+bool UploadRing::Allocate(uint64_t size, uint64_t alignment, Allocation* allocation) {
+    const uint64_t offset = mAllocator.Allocate(size, alignment);
+    if (offset == RingAllocator::kInvalidOffset) {
+        return false;
+    }
+    allocation->buffer = mBuffer.Get();
+    allocation->offset = offset;
+    allocation->cpuAddress = mMappedData + offset;
+    allocation->gpuAddress = mGPUAddress + offset;
+    return true;
+}
+
+void UploadRing::FinishSubmit(uint64_t fenceValue) {
+    mAllocator.FinishSubmit(fenceValue);
+}
+
+void UploadRing::Reclaim(uint64_t completedFenceValue) {
+    mAllocator.Reclaim(completedFenceValue);
+}
+
+ID3D12GraphicsCommandList* UploadRing::Upload(
+    SubmissionQueue* queue,
+    ID3D12GraphicsCommandList* commandList,
+    ID3D12Resource* destination,
+    uint64_t destinationOffset,
+    uint64_t size,
+    const WriteCallback& write) {
+    const uint64_t maxChunkSize = mAllocator.GetSize() / 2;
+    for (uint64_t written = 0; written < size;) {
+        const uint64_t chunkSize = std::min(maxChunkSize, size - written);
+        mAllocator.Reclaim(queue->GetCompletedFenceValue());
+
+        Allocation allocation;
+        while (!Allocate(chunkSize, sizeof(uint32_t), &allocation)) {
+            if (mAllocator.HasCurrentSubmitAllocations()) {
+                // Other allocations of the frame being recorded fill the ring, submit them.
+                mAllocator.FinishSubmit(queue->GetNextFenceValue());
+                queue->SubmitFrame();
+                commandList = queue->BeginFrame();
+            }
+            queue->WaitForFenceValue(mAllocator.GetOldestPendingFenceValue());
+            mAllocator.Reclaim(queue->GetCompletedFenceValue());
+        }
+
+        write(allocation.cpuAddress, written, chunkSize);
+        commandList->CopyBufferRegion(
+            destination, destinationOffset + written, allocation.buffer, allocation.offset,
+            chunkSize);
+        written += chunkSize;
+
+        // Submitting the chunk now lets the GPU copy it while the next one is written into the
+        // other half of the ring, which then only waits for the chunk before this one.
+        if (written < size) {
+            mAllocator.FinishSubmit(queue->GetNextFenceValue());
+            queue->SubmitFrame();
+            commandList = queue->BeginFrame();
+        }
+    }
+    return commandList;
+}
+
+ID3D12GraphicsCommandList* UploadRing::Upload(
+    SubmissionQueue* queue,
+    ID3D12GraphicsCommandList* commandList,
+    ID3D12Resource* destination,
+    uint64_t destinationOffset,
+    const void* data,
+    uint64_t size) {
+    const uint8_t* source = static_cast<const uint8_t*>(data);
+    return Upload(
+        queue, commandList, destination, destinationOffset, size,
+        [source](void* chunk, uint64_t offset, uint64_t chunkSize) {
+            memcpy(chunk, source + offset, chunkSize);
+        });
+}
+
+uint64_t UploadRing::GetSize() const {
+    return mAllocator.GetSize();
+}
@@ -0,0 +1,100 @@
+//*********************************************************
+//
+// Copyright 2023 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any
+// person obtaining a copy of this software and associated
+// documentation files(the "Software"), to deal in the Software
+// without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to
+// whom the Software is furnished to do so, subject to the
+// following conditions :
+// The above copyright notice and this permission notice shall
+// be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+//*********************************************************
+
+#ifndef UPLOAD_RING_
+#define UPLOAD_RING_
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include <functional>
+
+#include "RingAllocator.h"
+#include "SubmissionQueue.h"
+
+using Microsoft::WRL::ComPtr;
+
+// A persistently mapped upload buffer shared by all the uploads to one queue.
+//
+// Every upload, including the constants, is sub-allocated from the ring and written in place
+// through the mapped pointer, so uploads don't create nor map any resource. The ranges are
+// reclaimed once the fence value of the submit that read them has completed.
+class UploadRing {
+public:
+    struct Allocation {
+        ID3D12Resource* buffer;
+        uint64_t offset;
+        void* cpuAddress;
+        D3D12_GPU_VIRTUAL_ADDRESS gpuAddress;
+    };
+
+    UploadRing(ID3D12Device* device, uint64_t size);
+    ~UploadRing();
+
+    // Returns false if the ring doesn't have enough room left. The allocation can be used by the
+    // command list being recorded until FinishSubmit() is called.
+    bool Allocate(uint64_t size, uint64_t alignment, Allocation* allocation);
+
+    // fenceValue must be the value signaled on the queue right after the command list that uses
+    // the allocations made since the previous call.
+    void FinishSubmit(uint64_t fenceValue);
+    void Reclaim(uint64_t completedFenceValue);
+
+    // Writes the size bytes that start at offset in the uploaded data to destination, the mapped
+    // memory of one chunk. It is called for consecutive chunks in order.
+    using WriteCallback = std::function<void(void* destination, uint64_t offset, uint64_t size)>;
+
+    // Upload size bytes to destination at destinationOffset with the command list of the frame
+    // being recorded on queue, in chunks of at most half the ring. Each chunk is written in place
+    // by write and submitted right away, so the next one is written while the GPU copies it.
+    // Since the frame is submitted and a new one begun, the command list to continue recording
+    // with is returned. destination must be in the COPY_DEST state.
+    ID3D12GraphicsCommandList* Upload(
+        SubmissionQueue* queue,
+        ID3D12GraphicsCommandList* commandList,
+        ID3D12Resource* destination,
+        uint64_t destinationOffset,
+        uint64_t size,
+        const WriteCallback& write);
+    // Same as above, copying the chunks from data.
+    ID3D12GraphicsCommandList* Upload(
+        SubmissionQueue* queue,
+        ID3D12GraphicsCommandList* commandList,
+        ID3D12Resource* destination,
+        uint64_t destinationOffset,
+        const void* data,
+        uint64_t size);
+
+    uint64_t GetSize() const;
+
+private:
+    ComPtr<ID3D12Resource> mBuffer;
+    uint8_t* mMappedData = nullptr;
+    D3D12_GPU_VIRTUAL_ADDRESS mGPUAddress;
+    RingAllocator mAllocator;
+};
+
+#endif
@@ -0,0 +1,13 @@
+// Copied to Generated/ShaderLibraryData.cpp by the pre-build event when Python is not available.
+// The executable then compiles every kernel variant at runtime from the .hlsl file.
+
+#include <cstddef>
+#include <cstdint>
+
+extern const uint8_t kShaderLibraryBlob[];
+extern const size_t kShaderLibraryBlobSize;
+
+alignas(16) const uint8_t kShaderLibraryBlob[] = {
+    0x00,
+};
+const size_t kShaderLibraryBlobSize = 0;
@@ -0,0 +1,222 @@
+#!/usr/bin/env python3
+#*********************************************************
+#
+# Copyright 2023 Intel Corporation
+#
+# Permission is hereby granted, free of charge, to any
+# person obtaining a copy of this software and associated
+# documentation files(the "Software"), to deal in the Software
+# without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to
+# whom the Software is furnished to do so, subject to the
+# following conditions :
+# The above copyright notice and this permission notice shall
+# be included in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+# HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+# WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+# DEALINGS IN THE SOFTWARE.
+#
+#*********************************************************
+
+"""Compiles all the kernel variants with DXC and packs them into a C++ source file.
+
+Every variant is compiled to DXIL and to SPIR-V in parallel. The shaders are packed into one
+indexed blob, in the format read by ShaderLibrary.cpp, and written as a byte array into the
+generated source file, which is linked into the executable. The output file is only rewritten when
+its content changes, so that it doesn't trigger needless rebuilds.
+
+DXC runs on Windows and Linux, e.g.:
+    python3 tools/compile_shaders.py --dxc dxc --output Generated/ShaderLibraryData.cpp
+
+When DXC can't be found, an empty library is written instead, unless --require-dxc is passed, and
+the executable compiles every variant at runtime from the .hlsl file.
+"""
+
+import argparse
+import concurrent.futures
+import os
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+# The kernels and the values of their macro defines to compile. Every combination of the values of
+# a kernel is a variant.
+#
+# SLM_4X4_16X16_4_floats.hlsl computes 4x4 floats per thread and requires square work groups, as
+# the rows of the B tile loaded by the work group must cover its K tile, and its two shared memory
+# tiles only fit in the 32 KB of groupshared memory up to 16x16 threads. The data type and the
+# per-thread blocking are hard-coded in the kernel, and it has no edge handling, so they are not
+# variant dimensions yet.
+KERNELS = [
+    {
+        'source': 'SLM_4X4_16X16_4_floats.hlsl',
+        'defines': [
+            ('LOCAL_GROUP_SIZE_X', 'LOCAL_GROUP_SIZE_Y'),
+            [(4, 4), (8, 8), (16, 16)],
+        ],
+    },
+]
+
+ENTRY_POINT = 'main'
+
+# The target profile and extra DXC arguments of each ShaderFormat in ShaderLibrary.h.
+FORMATS = [
+    (0, 'dxil', ['-T', 'cs_6_0']),
+    (1, 'spirv', ['-T', 'cs_6_0', '-spirv', '-fspv-target-env=vulkan1.1']),
+]
+
+MAGIC = 0x4C535443  # "CTSL"
+VERSION = 1
+HEADER_FORMAT = '<IIII'
+ENTRY_FORMAT = '<IIIIQQ'
+DATA_ALIGNMENT = 16
+
+
+def variant_key(kernel_name, defines):
+    """Must match MakeShaderVariantKey() in ShaderLibrary.cpp."""
+    return kernel_name + ''.join(':%s=%s' % (name, value) for name, value in defines)
+
+
+def enumerate_variants(shader_dir):
+    for kernel in KERNELS:
+        names, values = kernel['defines']
+        kernel_name = os.path.splitext(kernel['source'])[0]
+        for combination in values:
+            defines = list(zip(names, combination))
+            yield (os.path.join(shader_dir, kernel['source']), variant_key(kernel_name, defines),
+                   defines)
+
+
+def compile_variant(dxc, source, defines, format_args):
+    with tempfile.TemporaryDirectory() as temporary_dir:
+        output = os.path.join(temporary_dir, 'shader.bin')
+        command = [dxc, '-E', ENTRY_POINT, '-O3', '-Fo', output] + format_args
+        for name, value in defines:
+            command += ['-D', '%s=%s' % (name, value)]
+        command.append(source)
+        result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                                universal_newlines=True)
+        if result.returncode != 0:
+            raise RuntimeError('%s failed:\n%s' % (' '.join(command), result.stdout))
+        with open(output, 'rb') as file:
+            return file.read()
+
+
+def align(offset):
+    return (offset + DATA_ALIGNMENT - 1) // DATA_ALIGNMENT * DATA_ALIGNMENT
+
+
+def pack_library(shaders):
+    """shaders is a list of (key, format, bytecode) sorted by key and format."""
+    keys_offset = struct.calcsize(HEADER_FORMAT) + struct.calcsize(ENTRY_FORMAT) * len(shaders)
+    keys = b''.join(key.encode('utf-8') for key, _, _ in shaders)
+    data_offset = align(keys_offset + len(keys))
+
+    header = struct.pack(HEADER_FORMAT, MAGIC, VERSION, len(shaders), 0)
+    entries = b''
+    data = b''
+    key_offset = keys_offset
+    for key, shader_format, bytecode in shaders:
+        encoded_key = key.encode('utf-8')
+        entries += struct.pack(ENTRY_FORMAT, key_offset, len(encoded_key), shader_format, 0,
+                               data_offset + len(data), len(bytecode))
+        key_offset += len(encoded_key)
+        data += bytecode + b'\0' * (align(len(bytecode)) - len(bytecode))
+
+    blob = header + entries + keys
+    return blob + b'\0' * (data_offset - len(blob)) + data
+
+
+def write_source(path, blob):
+    lines = [
+        '// Generated by tools/compile_shaders.py. Do not edit.',
+        '',
+        '#include <cstddef>',
+        '#include <cstdint>',
+        '',
+        'extern const uint8_t kShaderLibraryBlob[];',
+        'extern const size_t kShaderLibraryBlobSize;',
+        '',
+        'alignas(16) const uint8_t kShaderLibraryBlob[] = {',
+    ]
+    for begin in range(0, len(blob), 16):
+        lines.append('    ' + ' '.join('0x%02x,' % byte for byte in blob[begin:begin + 16]))
+    # An empty array is ill-formed.
+    if not blob:
+        lines.append('    0x00,')
+    lines += [
+        '};',
+        'const size_t kShaderLibraryBlobSize = %d;' % len(blob),
+        '',
+    ]
+    content = '\n'.join(lines)
+
+    if os.path.exists(path):
+        with open(path, 'r') as file:
+            if file.read() == content:
+                return False
+    os.makedirs(os.path.dirname(os.path.abspath(path)), exist_ok=True)
+    with open(path, 'w', newline='\n') as file:
+        file.write(content)
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--dxc', default='dxc', help='Path to the DXC executable.')
+    parser.add_argument('--shader-dir', default=os.path.dirname(os.path.dirname(
+        os.path.abspath(__file__))), help='Directory of the HLSL kernels.')
+    parser.add_argument('--output', required=True, help='The C++ source file to generate.')
+    parser.add_argument('--jobs', type=int, default=os.cpu_count(),
+                        help='Number of parallel compilations.')
+    parser.add_argument('--require-dxc', action='store_true',
+                        help='Fail instead of writing an empty library when DXC is not found.')
+    args = parser.parse_args()
+
+    if shutil.which(args.dxc) is None:
+        if args.require_dxc:
+            print('ERROR: %s was not found.' % args.dxc, file=sys.stderr)
+            return 1
+        updated = write_source(args.output, b'')
+        print('WARNING: %s was not found, %s an empty shader library in %s. The kernel variants '
+              'will be compiled at runtime.' % (args.dxc, 'wrote' if updated else 'kept',
+                                                args.output))
+        return 0
+
+    jobs = []
+    for source, key, defines in enumerate_variants(args.shader_dir):
+        for shader_format, _, format_args in FORMATS:
+            jobs.append((key, shader_format, source, defines, format_args))
+
+    with concurrent.futures.ThreadPoolExecutor(max_workers=args.jobs) as executor:
+        futures = [
+            executor.submit(compile_variant, args.dxc, source, defines, format_args)
+            for _, _, source, defines, format_args in jobs
+        ]
+        try:
+            bytecodes = [future.result() for future in futures]
+        except (OSError, RuntimeError) as error:
+            print('ERROR: %s' % error, file=sys.stderr)
+            return 1
+
+    shaders = sorted((key, shader_format, bytecode)
+                     for (key, shader_format, _, _, _), bytecode in zip(jobs, bytecodes))
+    blob = pack_library(shaders)
+    updated = write_source(args.output, blob)
+    print('%s %d shaders (%d bytes) in %s' % ('Packed' if updated else 'Up to date:', len(shaders),
+                                              len(blob), args.output))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())